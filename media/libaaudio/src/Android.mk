@@ -37,12 +37,14 @@ LOCAL_SRC_FILES = \
     legacy/AudioStreamRecord.cpp \
     legacy/AudioStreamTrack.cpp \
     utility/AAudioUtilities.cpp \
+    utility/SampleConversion.cpp \
     utility/FixedBlockAdapter.cpp \
     utility/FixedBlockReader.cpp \
     utility/FixedBlockWriter.cpp \
     utility/LinearRamp.cpp \
     fifo/FifoBuffer.cpp \
     fifo/FifoControllerBase.cpp \
+    client/AdaptiveWakeupScheduler.cpp \
     client/AudioEndpoint.cpp \
     client/AudioStreamInternal.cpp \
     client/AudioStreamInternalCapture.cpp \
@@ -95,12 +97,14 @@ LOCAL_SRC_FILES = core/AudioStream.cpp \
     legacy/AudioStreamRecord.cpp \
     legacy/AudioStreamTrack.cpp \
     utility/AAudioUtilities.cpp \
+    utility/SampleConversion.cpp \
     utility/FixedBlockAdapter.cpp \
     utility/FixedBlockReader.cpp \
     utility/FixedBlockWriter.cpp \
     utility/LinearRamp.cpp \
     fifo/FifoBuffer.cpp \
     fifo/FifoControllerBase.cpp \
+    client/AdaptiveWakeupScheduler.cpp \
     client/AudioEndpoint.cpp \
     client/AudioStreamInternal.cpp \
     client/AudioStreamInternalCapture.cpp \
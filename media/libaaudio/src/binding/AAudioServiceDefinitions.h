@@ -70,6 +70,7 @@ typedef struct RingBufferDescriptor_s {
     uint8_t* dataAddress;       // offset from read or write block
     int64_t* writeCounterAddress;
     int64_t* readCounterAddress;
+    void*    timestampAddress;  // android::FifoTimestampSlot, null if not shared
     int32_t  bytesPerFrame;     // index is in frames
     int32_t  framesPerBurst;    // for ISOCHRONOUS queues
     int32_t  capacityInFrames;  // zero if unused
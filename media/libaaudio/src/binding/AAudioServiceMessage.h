@@ -29,6 +29,7 @@ namespace aaudio {
 struct AAudioMessageTimestamp {
     int64_t position;     // number of frames transferred so far
     int64_t timestamp;    // time when that position was reached
+    double  rate;         // frames per second measured by the service, or 0.0 if unknown
 };
 
 typedef enum aaudio_service_event_e : uint32_t {
@@ -51,6 +51,12 @@ void RingBufferParcelable::setupMemory(int32_t sharedMemoryIndex,
     mDataParcelable.setup(sharedMemoryIndex, dataMemoryOffset, dataSizeInBytes);
 }
 
+void RingBufferParcelable::setupTimestamp(int32_t sharedMemoryIndex,
+                 int32_t timestampOffset,
+                 int32_t timestampSizeInBytes) {
+    mTimestampParcelable.setup(sharedMemoryIndex, timestampOffset, timestampSizeInBytes);
+}
+
 int32_t RingBufferParcelable::getBytesPerFrame() {
     return mBytesPerFrame;
 }
@@ -94,6 +100,8 @@ status_t RingBufferParcelable::writeToParcel(Parcel* parcel) const {
         if (status != NO_ERROR) goto error;
         status = mDataParcelable.writeToParcel(parcel);
         if (status != NO_ERROR) goto error;
+        status = mTimestampParcelable.writeToParcel(parcel);
+        if (status != NO_ERROR) goto error;
     }
     return NO_ERROR;
 error:
@@ -117,6 +125,8 @@ status_t RingBufferParcelable::readFromParcel(const Parcel* parcel) {
         if (status != NO_ERROR) goto error;
         status = mDataParcelable.readFromParcel(parcel);
         if (status != NO_ERROR) goto error;
+        status = mTimestampParcelable.readFromParcel(parcel);
+        if (status != NO_ERROR) goto error;
     }
     return NO_ERROR;
 error:
@@ -144,6 +154,11 @@ aaudio_result_t RingBufferParcelable::resolve(SharedMemoryParcelable *memoryParc
         return result;
     }
 
+    result = mTimestampParcelable.resolve(memoryParcels, &descriptor->timestampAddress);
+    if (result != AAUDIO_OK) {
+        return result;
+    }
+
     descriptor->bytesPerFrame = mBytesPerFrame;
     descriptor->framesPerBurst = mFramesPerBurst;
     descriptor->capacityInFrames = mCapacityInFrames;
@@ -177,6 +192,10 @@ aaudio_result_t RingBufferParcelable::validate() {
         ALOGE("RingBufferParcelable invalid mDataParcelable = %d", result);
         return result;
     }
+    if ((result = mTimestampParcelable.validate()) != AAUDIO_OK) {
+        ALOGE("RingBufferParcelable invalid mTimestampParcelable = %d", result);
+        return result;
+    }
     return AAUDIO_OK;
 }
 
@@ -190,5 +209,6 @@ void RingBufferParcelable::dump() {
         mReadCounterParcelable.dump();
         mWriteCounterParcelable.dump();
         mDataParcelable.dump();
+        mTimestampParcelable.dump();
     }
 }
@@ -43,6 +43,13 @@ public:
                      int32_t dataMemoryOffset,
                      int32_t dataSizeInBytes);
 
+    /**
+     * Optional FifoTimestampSlot shared with the counters.
+     */
+    void setupTimestamp(int32_t sharedMemoryIndex,
+                        int32_t timestampOffset,
+                        int32_t timestampSizeInBytes);
+
     int32_t getBytesPerFrame();
 
     void setBytesPerFrame(int32_t bytesPerFrame);
@@ -74,6 +81,7 @@ private:
     SharedRegionParcelable  mReadCounterParcelable;
     SharedRegionParcelable  mWriteCounterParcelable;
     SharedRegionParcelable  mDataParcelable;
+    SharedRegionParcelable  mTimestampParcelable;   // size zero if not shared
     int32_t                 mBytesPerFrame = 0;     // index is in frames
     int32_t                 mFramesPerBurst = 0;    // for ISOCHRONOUS queues
     int32_t                 mCapacityInFrames = 0;  // zero if unused
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AAudio"
+//#define LOG_NDEBUG 0
+#include <log/log.h>
+
+#include <algorithm>
+#include <stdint.h>
+
+#include "utility/AudioClock.h"
+#include "AdaptiveWakeupScheduler.h"
+
+using namespace aaudio;
+
+AdaptiveWakeupScheduler::AdaptiveWakeupScheduler()
+        : mSampleRate(48000)
+        , mFramesPerBurst(64)
+        , mMinWakeupDelayNanos(0)
+        , mMaxWakeupDelayNanos(0)
+        , mWakeupDelayNanos(0)
+        , mJitterDecay(0.0)
+        , mJitterNanos(0.0)
+        , mMinBufferFrames(0)
+        , mMaxBufferFrames(0)
+        , mLastXRunCount(0)
+        , mLastChangeNanos(0)
+        , mHoldNanos(kMinHoldNanos)
+        , mLastChangeWasShrink(false)
+{
+}
+
+void AdaptiveWakeupScheduler::configure(int32_t sampleRate,
+                                        int32_t framesPerBurst,
+                                        int32_t minWakeupDelayNanos,
+                                        int32_t minBufferFrames,
+                                        int32_t maxBufferFrames) {
+    mSampleRate = sampleRate;
+    mFramesPerBurst = framesPerBurst;
+    const int64_t burstNanos = convertFramesToNanos(framesPerBurst);
+
+    // Waking up later than half a burst would eat into the time left to transfer the data.
+    mMinWakeupDelayNanos = minWakeupDelayNanos;
+    mMaxWakeupDelayNanos = std::max(minWakeupDelayNanos, (int32_t) (burstNanos / 2));
+    mWakeupDelayNanos = minWakeupDelayNanos;
+    // There is about one timestamp per burst.
+    mJitterDecay = std::max(0.0, 1.0 - (double) burstNanos / kJitterDecayNanos);
+    mJitterNanos = 0.0;
+
+    mMinBufferFrames.store(minBufferFrames);
+    mMaxBufferFrames = maxBufferFrames;
+    ALOGD("AdaptiveWakeupScheduler::configure() wakeup delay %d to %d usec, buffer %d to %d frames",
+          mMinWakeupDelayNanos / 1000, mMaxWakeupDelayNanos / 1000,
+          minBufferFrames, mMaxBufferFrames);
+}
+
+void AdaptiveWakeupScheduler::start(int64_t nanoTime, int32_t xRunCount) {
+    mLastXRunCount = xRunCount;
+    mLastChangeNanos = nanoTime;
+    mLastChangeWasShrink = false;
+}
+
+void AdaptiveWakeupScheduler::processLateness(int64_t latenessNanos) {
+    mJitterNanos = std::max((double) std::max(latenessNanos, (int64_t) 0),
+                            mJitterNanos * mJitterDecay);
+    int64_t delay = (int64_t) mJitterNanos + kWakeupMarginNanos;
+    delay = std::min(std::max(delay, (int64_t) mMinWakeupDelayNanos),
+                     (int64_t) mMaxWakeupDelayNanos);
+    if (delay != mWakeupDelayNanos) {
+        ALOGV("AdaptiveWakeupScheduler: jitter %d usec, wakeup delay %d usec",
+              (int) (mJitterNanos / 1000), (int) (delay / 1000));
+        mWakeupDelayNanos = (int32_t) delay;
+    }
+}
+
+int32_t AdaptiveWakeupScheduler::processXRuns(int64_t nanoTime,
+                                              int32_t xRunCount,
+                                              int32_t bufferSizeFrames) {
+    // Read once, the application may change it while we decide.
+    const int32_t minBufferFrames = mMinBufferFrames.load();
+    if (mMaxBufferFrames <= minBufferFrames) {
+        return bufferSizeFrames; // no room in the latency budget
+    }
+
+    if (xRunCount > mLastXRunCount) {
+        mLastXRunCount = xRunCount;
+        if (mLastChangeWasShrink && (nanoTime - mLastChangeNanos) < 2 * mHoldNanos) {
+            // Shrinking caused an XRun, so wait longer before trying again.
+            mHoldNanos = std::min(2 * mHoldNanos, kMaxHoldNanos);
+        }
+        mLastChangeNanos = nanoTime;
+        mLastChangeWasShrink = false;
+        if (bufferSizeFrames + mFramesPerBurst > mMaxBufferFrames) {
+            ALOGD("AdaptiveWakeupScheduler: XRun #%d, buffer already at %d of %d frames",
+                  xRunCount, bufferSizeFrames, mMaxBufferFrames);
+            return bufferSizeFrames;
+        }
+        ALOGD("AdaptiveWakeupScheduler: XRun #%d, grow buffer from %d to %d frames,"
+              " jitter = %d usec",
+              xRunCount, bufferSizeFrames, bufferSizeFrames + mFramesPerBurst,
+              (int) (mJitterNanos / 1000));
+        return bufferSizeFrames + mFramesPerBurst;
+    }
+
+    if ((nanoTime - mLastChangeNanos) >= mHoldNanos
+            && (bufferSizeFrames - mFramesPerBurst) >= minBufferFrames) {
+        // After shrinking there must still be room for the jitter besides the burst
+        // being transferred.
+        int64_t headroomNanos = convertFramesToNanos(bufferSizeFrames - 2 * mFramesPerBurst);
+        if (headroomNanos > mJitterNanos + kWakeupMarginNanos) {
+            ALOGD("AdaptiveWakeupScheduler: no XRun for %d msec, shrink buffer from %d to %d"
+                  " frames, jitter = %d usec",
+                  (int) ((nanoTime - mLastChangeNanos) / AAUDIO_NANOS_PER_MILLISECOND),
+                  bufferSizeFrames, bufferSizeFrames - mFramesPerBurst,
+                  (int) (mJitterNanos / 1000));
+            mLastChangeNanos = nanoTime;
+            mLastChangeWasShrink = true;
+            return bufferSizeFrames - mFramesPerBurst;
+        }
+    }
+    return bufferSizeFrames;
+}
+
+int64_t AdaptiveWakeupScheduler::convertFramesToNanos(int32_t frames) const {
+    return (AAUDIO_NANOS_PER_SECOND * frames) / mSampleRate;
+}
+
+void AdaptiveWakeupScheduler::dump() const {
+    ALOGD("AdaptiveWakeupScheduler::mJitterNanos         = %6d", (int) mJitterNanos);
+    ALOGD("AdaptiveWakeupScheduler::mWakeupDelayNanos    = %6d", mWakeupDelayNanos);
+    ALOGD("AdaptiveWakeupScheduler::mMinBufferFrames     = %6d", mMinBufferFrames.load());
+    ALOGD("AdaptiveWakeupScheduler::mMaxBufferFrames     = %6d", mMaxBufferFrames);
+    ALOGD("AdaptiveWakeupScheduler::mHoldNanos           = %lld", (long long) mHoldNanos);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AAUDIO_ADAPTIVE_WAKEUP_SCHEDULER_H
+#define ANDROID_AAUDIO_ADAPTIVE_WAKEUP_SCHEDULER_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace aaudio {
+
+/**
+ * Decide how long after the predicted burst time a client thread should wake up,
+ * and how large the buffer should be, based on the jitter observed by the clock model.
+ *
+ * The wakeup delay follows a decaying peak of the lateness of the timestamps
+ * from the other side of the FIFO, so the client wakes up just after the other side
+ * instead of polling or sleeping a fixed time.
+ *
+ * If a latency budget is given, the buffer grows by one burst after an XRun, up to the budget,
+ * and shrinks again by one burst after a period without XRuns, if the jitter leaves room for it.
+ *
+ * This class is not thread safe and should only be called from one thread,
+ * except for setMinBufferSize(), which the application may call at any time.
+ */
+class AdaptiveWakeupScheduler {
+public:
+    AdaptiveWakeupScheduler();
+
+    /**
+     * @param sampleRate rate of the stream in frames per second
+     * @param framesPerBurst number of frames that the other side of the FIFO transfers at once
+     * @param minWakeupDelayNanos lower limit of the wakeup delay
+     * @param minBufferFrames buffer size that is never reduced
+     * @param maxBufferFrames latency budget, or 0 to never change the buffer size
+     */
+    void configure(int32_t sampleRate,
+                   int32_t framesPerBurst,
+                   int32_t minWakeupDelayNanos,
+                   int32_t minBufferFrames,
+                   int32_t maxBufferFrames);
+
+    /**
+     * Called when the application sets the buffer size, which is then never reduced.
+     * The new minimum is picked up by the next call to processXRuns().
+     */
+    void setMinBufferSize(int32_t minBufferFrames) {
+        mMinBufferFrames.store(minBufferFrames);
+    }
+
+    /**
+     * Called when the stream starts.
+     */
+    void start(int64_t nanoTime, int32_t xRunCount);
+
+    /**
+     * @param latenessNanos from IsochronousClockModel::getLatenessNanos()
+     */
+    void processLateness(int64_t latenessNanos);
+
+    /**
+     * @return nanoseconds to wait after the time predicted by the clock model
+     */
+    int32_t getWakeupDelayNanos() const {
+        return mWakeupDelayNanos;
+    }
+
+    /**
+     * @param nanoTime current time
+     * @param xRunCount total number of XRuns of the stream
+     * @param bufferSizeFrames current buffer size
+     * @return buffer size to use, in frames
+     */
+    int32_t processXRuns(int64_t nanoTime, int32_t xRunCount, int32_t bufferSizeFrames);
+
+    int64_t getJitterNanos() const {
+        return (int64_t) mJitterNanos;
+    }
+
+    void dump() const;
+
+private:
+    // Decay time constant of the jitter peak.
+    static constexpr int64_t kJitterDecayNanos = 2000000000LL;
+    // Added to the jitter so that the client wakes up after the other side.
+    static constexpr int32_t kWakeupMarginNanos = 50000;
+    // Time without XRuns before the buffer is reduced by one burst.
+    static constexpr int64_t kMinHoldNanos = 5000000000LL;
+    static constexpr int64_t kMaxHoldNanos = 60000000000LL;
+
+    int64_t convertFramesToNanos(int32_t frames) const;
+
+    int32_t  mSampleRate;
+    int32_t  mFramesPerBurst;
+    int32_t  mMinWakeupDelayNanos;
+    int32_t  mMaxWakeupDelayNanos;
+    int32_t  mWakeupDelayNanos;
+    double   mJitterDecay;        // applied to the peak for each timestamp
+    double   mJitterNanos;        // decaying peak of the lateness
+    std::atomic<int32_t> mMinBufferFrames; // written by the application thread
+    int32_t  mMaxBufferFrames;
+    int32_t  mLastXRunCount;
+    int64_t  mLastChangeNanos;
+    int64_t  mHoldNanos;
+    bool     mLastChangeWasShrink;
+};
+
+} /* namespace aaudio */
+
+#endif //ANDROID_AAUDIO_ADAPTIVE_WAKEUP_SCHEDULER_H
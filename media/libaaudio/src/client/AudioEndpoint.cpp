@@ -177,7 +177,8 @@ aaudio_result_t AudioEndpoint::configure(const EndpointDescriptor *pEndpointDesc
             descriptor->capacityInFrames,
             readCounterAddress,
             writeCounterAddress,
-            descriptor->dataAddress
+            descriptor->dataAddress,
+            static_cast<FifoTimestampSlot *>(descriptor->timestampAddress)
     );
     uint32_t threshold = descriptor->capacityInFrames / 2;
     mDataQueue->setThreshold(threshold);
@@ -208,6 +209,11 @@ int32_t AudioEndpoint::getFullFramesAvailable()
     return mDataQueue->getFifoControllerBase()->getFullFramesAvailable();
 }
 
+bool AudioEndpoint::getDataTimestamp(FifoTimestamp *timestamp) const
+{
+    return mDataQueue->getTimestamp(timestamp);
+}
+
 void AudioEndpoint::advanceWriteIndex(int32_t deltaFrames) {
     mDataQueue->getFifoControllerBase()->advanceWriteIndex(deltaFrames);
 }
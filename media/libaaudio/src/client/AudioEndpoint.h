@@ -57,6 +57,12 @@ public:
 
     int32_t getFullFramesAvailable();
 
+    /**
+     * Latest timestamp published by the service next to the data queue counters.
+     * @return false if the service did not publish one
+     */
+    bool getDataTimestamp(android::FifoTimestamp *timestamp) const;
+
     void advanceReadIndex(int32_t deltaFrames);
 
     void advanceWriteIndex(int32_t deltaFrames);
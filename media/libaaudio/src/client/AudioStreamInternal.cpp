@@ -22,6 +22,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
+#include <algorithm>
 #include <stdint.h>
 
 #include <binder/IServiceManager.h>
@@ -46,6 +47,7 @@
 using android::String16;
 using android::Mutex;
 using android::WrappingBuffer;
+using android::FifoTimestamp;
 
 using namespace aaudio;
 
@@ -59,6 +61,7 @@ using namespace aaudio;
 AudioStreamInternal::AudioStreamInternal(AAudioServiceInterface  &serviceInterface, bool inService)
         : AudioStream()
         , mClockModel()
+        , mWakeupScheduler()
         , mAudioEndpoint()
         , mServiceStreamHandle(AAUDIO_HANDLE_INVALID)
         , mFramesPerBurst(16)
@@ -169,6 +172,15 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
     mClockModel.setSampleRate(getSampleRate());
     mClockModel.setFramesPerBurst(mFramesPerBurst);
 
+    {
+        // Let the buffer grow after XRuns, up to the latency budget if there is one.
+        int64_t budgetFrames = (int64_t) AAudioProperty_getLatencyBudgetMicros()
+                * getSampleRate() / (AAUDIO_NANOS_PER_SECOND / AAUDIO_NANOS_PER_MICROSECOND);
+        mWakeupScheduler.configure(getSampleRate(), mFramesPerBurst, mWakeupDelayNanos,
+                                   getBufferSize(),
+                                   (int32_t) std::min(budgetFrames, (int64_t) capacity));
+    }
+
     if (getDataCallbackProc()) {
         mCallbackFrames = builder.getFramesPerDataCallback();
         if (mCallbackFrames > getBufferCapacity() / 2) {
@@ -285,6 +297,8 @@ aaudio_result_t AudioStreamInternal::requestStart()
 
     startTime = AudioClock::getNanoseconds();
     mClockModel.start(startTime);
+    mWakeupScheduler.start(startTime, getXRunCount());
+    mLastDataTimestampNanos = startTime; // ignore the ones published before this start
     mNeedCatchUp.request();  // Ask data processing code to catch up when first timestamp received.
 
     // Start data callback thread.
@@ -441,6 +455,10 @@ aaudio_result_t AudioStreamInternal::onTimestampService(AAudioServiceMessage *me
 aaudio_result_t AudioStreamInternal::onTimestampHardware(AAudioServiceMessage *message) {
     Timestamp timestamp(message->timestamp.position, message->timestamp.timestamp);
     mAtomicTimestamp.write(timestamp);
+    if (message->timestamp.rate > 0.0) {
+        // Predict the position with the real rate of the device.
+        mClockModel.setMeasuredSampleRate(message->timestamp.rate);
+    }
     return AAUDIO_OK;
 }
 
@@ -558,6 +576,16 @@ aaudio_result_t AudioStreamInternal::processCommands() {
             break;
         }
     }
+
+    // The service also publishes its latest transfer time next to the data queue counters,
+    // once per burst, which is fresher than the periodic TIMESTAMP_SERVICE messages.
+    FifoTimestamp dataTimestamp;
+    if (result == AAUDIO_OK
+            && mAudioEndpoint.getDataTimestamp(&dataTimestamp)
+            && dataTimestamp.nanoseconds > mLastDataTimestampNanos) {
+        mLastDataTimestampNanos = dataTimestamp.nanoseconds;
+        processTimestamp(dataTimestamp.position, dataTimestamp.nanoseconds);
+    }
     return result;
 }
 
@@ -601,7 +629,8 @@ aaudio_result_t AudioStreamInternal::processData(void *buffer, int32_t numFrames
             if (!mAudioEndpoint.isFreeRunning()) {
                 // If there is software on the other end of the FIFO then it may get delayed.
                 // So wake up just a little after we expect it to be ready.
-                wakeTimeNanos += mWakeupDelayNanos;
+                // The delay is adapted to the jitter of its timestamps.
+                wakeTimeNanos += mWakeupScheduler.getWakeupDelayNanos();
             }
 
             currentTimeNanos = AudioClock::getNanoseconds();
@@ -623,6 +652,7 @@ aaudio_result_t AudioStreamInternal::processData(void *buffer, int32_t numFrames
                 ALOGW("AudioStreamInternal::processData(): past deadline by %d micros",
                       (int)((wakeTimeNanos - deadlineNanos) / AAUDIO_NANOS_PER_MICROSECOND));
                 mClockModel.dump();
+                mWakeupScheduler.dump();
                 mAudioEndpoint.dump();
                 break;
             }
@@ -639,6 +669,20 @@ aaudio_result_t AudioStreamInternal::processData(void *buffer, int32_t numFrames
         }
     }
 
+    if (result >= 0) {
+        // Follow the XRuns with the buffer size, within the latency budget.
+        int32_t bufferSize = getBufferSize();
+        int32_t adaptedBufferSize = mWakeupScheduler.processXRuns(currentTimeNanos,
+                                                                  getXRunCount(), bufferSize);
+        if (adaptedBufferSize != bufferSize) {
+            int32_t actualFrames = 0;
+            mAudioEndpoint.setBufferSizeInFrames(adaptedBufferSize, &actualFrames);
+            if (ATRACE_ENABLED()) {
+                ATRACE_INT("aaBufSize", actualFrames);
+            }
+        }
+    }
+
     if (ATRACE_ENABLED()) {
         int32_t fullFrames = mAudioEndpoint.getFullFramesAvailable();
         ATRACE_INT(fifoName, fullFrames);
@@ -652,6 +696,7 @@ aaudio_result_t AudioStreamInternal::processData(void *buffer, int32_t numFrames
 
 void AudioStreamInternal::processTimestamp(uint64_t position, int64_t time) {
     mClockModel.processTimestamp(position, time);
+    mWakeupScheduler.processLateness(mClockModel.getLatenessNanos());
 }
 
 aaudio_result_t AudioStreamInternal::setBufferSize(int32_t requestedFrames) {
@@ -667,6 +712,8 @@ aaudio_result_t AudioStreamInternal::setBufferSize(int32_t requestedFrames) {
     if (result < 0) {
         return result;
     } else {
+        // Never go below the size chosen by the application.
+        mWakeupScheduler.setMinBufferSize(actualFrames);
         return (aaudio_result_t) actualFrames;
     }
 }
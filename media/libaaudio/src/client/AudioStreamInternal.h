@@ -23,6 +23,7 @@
 #include "binding/IAAudioService.h"
 #include "binding/AudioEndpointParcelable.h"
 #include "binding/AAudioServiceInterface.h"
+#include "client/AdaptiveWakeupScheduler.h"
 #include "client/IsochronousClockModel.h"
 #include "client/AudioEndpoint.h"
 #include "core/AudioStream.h"
@@ -137,6 +138,7 @@ protected:
     aaudio_format_t          mDeviceFormat = AAUDIO_FORMAT_UNSPECIFIED;
 
     IsochronousClockModel    mClockModel;      // timing model for chasing the HAL
+    AdaptiveWakeupScheduler  mWakeupScheduler; // wakeup delay and buffer size from the jitter
 
     AudioEndpoint            mAudioEndpoint;   // source for reads or sink for writes
     aaudio_handle_t          mServiceStreamHandle; // opaque handle returned from service
@@ -159,6 +161,8 @@ protected:
 
     AtomicRequestor          mNeedCatchUp;   // Ask read() or write() to sync on first timestamp.
 
+    int64_t                  mLastDataTimestampNanos = 0; // last one read from the data queue
+
     float                    mStreamVolume = 1.0f;
 
 private:
@@ -176,7 +180,7 @@ private:
 
     // Thread on other side of FIFO will have wakeup jitter.
     // By delaying slightly we can avoid waking up before other side is ready.
-    const int32_t            mWakeupDelayNanos; // delay past typical wakeup jitter
+    const int32_t            mWakeupDelayNanos; // minimum delay past typical wakeup jitter
     const int32_t            mMinimumSleepNanos; // minimum sleep while polling
 
     AudioEndpointParcelable  mEndPointParcelable; // description of the buffers filled by service
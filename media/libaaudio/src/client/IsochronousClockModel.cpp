@@ -18,12 +18,15 @@
 //#define LOG_NDEBUG 0
 #include <log/log.h>
 
+#include <math.h>
 #include <stdint.h>
 
 #include "utility/AudioClock.h"
 #include "IsochronousClockModel.h"
 
 #define MIN_LATENESS_NANOS (10 * AAUDIO_NANOS_PER_MICROSECOND)
+// A measured rate further from the nominal rate is not drift.
+#define MAX_MEASURED_RATE_DEVIATION  0.001
 
 using namespace aaudio;
 
@@ -31,8 +34,10 @@ IsochronousClockModel::IsochronousClockModel()
         : mMarkerFramePosition(0)
         , mMarkerNanoTime(0)
         , mSampleRate(48000)
+        , mMeasuredSampleRate(0.0)
         , mFramesPerBurst(64)
         , mMaxLatenessInNanos(0)
+        , mLatenessNanos(0)
         , mState(STATE_STOPPED)
 {
 }
@@ -85,6 +90,7 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
 
 //    ALOGD("processTimestamp() - mSampleRate = %d", mSampleRate);
 //    ALOGD("processTimestamp() - mState = %d", mState);
+    mLatenessNanos = 0;
     switch (mState) {
     case STATE_STOPPED:
         break;
@@ -109,12 +115,16 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
 //            ALOGD("processTimestamp() - STATE_RUNNING - %d < %d micros - EARLY",
 //                 (int) (nanosDelta / 1000), (int)(expectedNanosDelta / 1000));
             setPositionAndTime(framePosition, nanoTime);
-        } else if (nanosDelta > (expectedNanosDelta + mMaxLatenessInNanos)) {
-            // Later than expected timestamp.
-//            ALOGD("processTimestamp() - STATE_RUNNING - %d > %d + %d micros - LATE",
-//                 (int) (nanosDelta / 1000), (int)(expectedNanosDelta / 1000),
-//                 (int) (mMaxLatenessInNanos / 1000));
-            setPositionAndTime(framePosition - mFramesPerBurst,  nanoTime - mMaxLatenessInNanos);
+        } else {
+            mLatenessNanos = nanosDelta - expectedNanosDelta;
+            if (mLatenessNanos > mMaxLatenessInNanos) {
+                // Later than expected timestamp.
+//                ALOGD("processTimestamp() - STATE_RUNNING - %d > %d + %d micros - LATE",
+//                     (int) (nanosDelta / 1000), (int)(expectedNanosDelta / 1000),
+//                     (int) (mMaxLatenessInNanos / 1000));
+                setPositionAndTime(framePosition - mFramesPerBurst,
+                                   nanoTime - mMaxLatenessInNanos);
+            }
         }
         break;
     default:
@@ -126,9 +136,17 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
 
 void IsochronousClockModel::setSampleRate(int32_t sampleRate) {
     mSampleRate = sampleRate;
+    mMeasuredSampleRate = 0.0;
     update();
 }
 
+void IsochronousClockModel::setMeasuredSampleRate(double framesPerSecond) {
+    // Only accept a drift, not a different rate.
+    if (fabs(framesPerSecond - mSampleRate) < mSampleRate * MAX_MEASURED_RATE_DEVIATION) {
+        mMeasuredSampleRate = framesPerSecond;
+    }
+}
+
 void IsochronousClockModel::setFramesPerBurst(int32_t framesPerBurst) {
     mFramesPerBurst = framesPerBurst;
     update();
@@ -140,10 +158,16 @@ void IsochronousClockModel::update() {
 }
 
 int64_t IsochronousClockModel::convertDeltaPositionToTime(int64_t framesDelta) const {
+    if (mMeasuredSampleRate > 0.0) {
+        return (int64_t) (AAUDIO_NANOS_PER_SECOND * framesDelta / mMeasuredSampleRate);
+    }
     return (AAUDIO_NANOS_PER_SECOND * framesDelta) / mSampleRate;
 }
 
 int64_t IsochronousClockModel::convertDeltaTimeToPosition(int64_t nanosDelta) const {
+    if (mMeasuredSampleRate > 0.0) {
+        return (int64_t) (mMeasuredSampleRate * nanosDelta / AAUDIO_NANOS_PER_SECOND);
+    }
     return (mSampleRate * nanosDelta) / AAUDIO_NANOS_PER_SECOND;
 }
 
@@ -183,7 +207,9 @@ void IsochronousClockModel::dump() const {
     ALOGD("IsochronousClockModel::mMarkerFramePosition = %lld", (long long) mMarkerFramePosition);
     ALOGD("IsochronousClockModel::mMarkerNanoTime      = %lld", (long long) mMarkerNanoTime);
     ALOGD("IsochronousClockModel::mSampleRate          = %6d", mSampleRate);
+    ALOGD("IsochronousClockModel::mMeasuredSampleRate  = %9.2f", mMeasuredSampleRate);
     ALOGD("IsochronousClockModel::mFramesPerBurst      = %6d", mFramesPerBurst);
     ALOGD("IsochronousClockModel::mMaxLatenessInNanos  = %6d", mMaxLatenessInNanos);
+    ALOGD("IsochronousClockModel::mLatenessNanos       = %6lld", (long long) mLatenessNanos);
     ALOGD("IsochronousClockModel::mState               = %6d", mState);
 }
@@ -45,6 +45,14 @@ public:
      */
     void setSampleRate(int32_t sampleRate);
 
+    /**
+     * Use the rate that the service measured against CLOCK_MONOTONIC instead of the nominal one.
+     * It is cleared by setSampleRate().
+     *
+     * @param framesPerSecond measured rate
+     */
+    void setMeasuredSampleRate(double framesPerSecond);
+
     void setPositionAndTime(int64_t framePosition, int64_t nanoTime);
 
     int32_t getSampleRate() const {
@@ -90,6 +98,16 @@ public:
      */
     int64_t convertDeltaTimeToPosition(int64_t nanosDelta) const;
 
+    /**
+     * How late the last timestamp arrived compared to the model, while running.
+     * This is the scheduling jitter of the other side of the FIFO.
+     *
+     * @return nanoseconds after the expected time, or 0 if early or not running
+     */
+    int64_t getLatenessNanos() const {
+        return mLatenessNanos;
+    }
+
     void dump() const;
 
 private:
@@ -103,8 +121,10 @@ private:
     int64_t             mMarkerFramePosition;
     int64_t             mMarkerNanoTime;
     int32_t             mSampleRate;
+    double              mMeasuredSampleRate; // or 0.0 if not measured
     int32_t             mFramesPerBurst;
     int32_t             mMaxLatenessInNanos;
+    int64_t             mLatenessNanos;
     clock_model_state_t mState;
 
     void update();
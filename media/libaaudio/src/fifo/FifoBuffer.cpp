@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstring>
 #include <unistd.h>
 
@@ -39,6 +40,8 @@ FifoBuffer::FifoBuffer(int32_t bytesPerFrame, fifo_frames_t capacityInFrames)
 {
     // TODO Handle possible failures to allocate. Move out of constructor?
     mFifo = new FifoController(capacityInFrames, capacityInFrames);
+    mTimestamp = new FifoTimestampSlot();
+    mTimestampOwned = true;
     // allocate buffer
     int32_t bytesPerBuffer = bytesPerFrame * capacityInFrames;
     mStorage = new uint8_t[bytesPerBuffer];
@@ -51,7 +54,8 @@ FifoBuffer::FifoBuffer( int32_t   bytesPerFrame,
                         fifo_frames_t   capacityInFrames,
                         fifo_counter_t *  readIndexAddress,
                         fifo_counter_t *  writeIndexAddress,
-                        void *  dataStorageAddress
+                        void *  dataStorageAddress,
+                        FifoTimestampSlot *  timestampAddress
                         )
         : mFrameCapacity(capacityInFrames)
         , mBytesPerFrame(bytesPerFrame)
@@ -65,12 +69,20 @@ FifoBuffer::FifoBuffer( int32_t   bytesPerFrame,
                                        readIndexAddress,
                                        writeIndexAddress);
     mStorageOwned = false;
+    // The parcel always carries the timestamp region, but it is empty for the rings that do not
+    // publish timestamps, such as the MMAP buffer of an exclusive stream.  Keep a local slot,
+    // which stays empty, so that readers need not check.
+    mTimestampOwned = (timestampAddress == nullptr);
+    mTimestamp = mTimestampOwned ? new FifoTimestampSlot() : timestampAddress;
 }
 
 FifoBuffer::~FifoBuffer() {
     if (mStorageOwned) {
         delete[] mStorage;
     }
+    if (mTimestampOwned) {
+        delete mTimestamp;
+    }
     delete mFifo;
 }
 
@@ -92,7 +104,7 @@ void FifoBuffer::fillWrappingBuffer(WrappingBuffer *wrappingBuffer,
             wrappingBuffer->data[0] = source;
             wrappingBuffer->numFrames[0] = mFrameCapacity - startIndex;
             wrappingBuffer->data[1] = &mStorage[0];
-            wrappingBuffer->numFrames[1] = mFrameCapacity - startIndex;
+            wrappingBuffer->numFrames[1] = framesAvailable - wrappingBuffer->numFrames[0];
 
         } else {
             wrappingBuffer->data[0] = source;
@@ -119,65 +131,78 @@ fifo_frames_t FifoBuffer::getEmptyRoomAvailable(WrappingBuffer *wrappingBuffer)
     return framesAvailable;
 }
 
+fifo_frames_t FifoBuffer::limitWrappingBuffer(WrappingBuffer *wrappingBuffer,
+                                              fifo_frames_t framesAvailable,
+                                              fifo_frames_t maxFrames) {
+    if (maxFrames < 0 || framesAvailable <= maxFrames) {
+        return std::max(framesAvailable, 0);
+    }
+    if (wrappingBuffer->numFrames[0] >= maxFrames) {
+        wrappingBuffer->numFrames[0] = maxFrames;
+        wrappingBuffer->data[1] = nullptr;
+        wrappingBuffer->numFrames[1] = 0;
+    } else {
+        wrappingBuffer->numFrames[1] = maxFrames - wrappingBuffer->numFrames[0];
+    }
+    return maxFrames;
+}
+
+fifo_frames_t FifoBuffer::beginRead(WrappingBuffer *wrappingBuffer,
+                                    fifo_frames_t maxFrames,
+                                    FifoTimestamp *timestamp) {
+    if (timestamp != nullptr && !mTimestamp->read(timestamp)) {
+        timestamp->position = 0;
+        timestamp->nanoseconds = 0;
+    }
+    fifo_frames_t framesAvailable = getFullDataAvailable(wrappingBuffer);
+    return limitWrappingBuffer(wrappingBuffer, framesAvailable, maxFrames);
+}
+
+void FifoBuffer::endRead(fifo_frames_t numFrames) {
+    mFifo->advanceReadIndex(numFrames);
+}
+
+fifo_frames_t FifoBuffer::beginWrite(WrappingBuffer *wrappingBuffer,
+                                     fifo_frames_t maxFrames) {
+    fifo_frames_t framesAvailable = getEmptyRoomAvailable(wrappingBuffer);
+    return limitWrappingBuffer(wrappingBuffer, framesAvailable, maxFrames);
+}
+
+void FifoBuffer::endWrite(fifo_frames_t numFrames) {
+    mFifo->advanceWriteIndex(numFrames);
+}
+
 fifo_frames_t FifoBuffer::read(void *buffer, fifo_frames_t numFrames) {
     WrappingBuffer wrappingBuffer;
     uint8_t *destination = (uint8_t *) buffer;
-    fifo_frames_t framesLeft = numFrames;
-
-    getFullDataAvailable(&wrappingBuffer);
+    fifo_frames_t framesRead = beginRead(&wrappingBuffer, std::max(numFrames, 0));
 
     // Read data in one or two parts.
-    int partIndex = 0;
-    while (framesLeft > 0 && partIndex < WrappingBuffer::SIZE) {
-        fifo_frames_t framesToRead = framesLeft;
-        fifo_frames_t framesAvailable = wrappingBuffer.numFrames[partIndex];
-        if (framesAvailable > 0) {
-            if (framesToRead > framesAvailable) {
-                framesToRead = framesAvailable;
-            }
-            int32_t numBytes = convertFramesToBytes(framesToRead);
+    for (int partIndex = 0; partIndex < WrappingBuffer::SIZE; partIndex++) {
+        int32_t numBytes = convertFramesToBytes(wrappingBuffer.numFrames[partIndex]);
+        if (numBytes > 0) {
             memcpy(destination, wrappingBuffer.data[partIndex], numBytes);
-
             destination += numBytes;
-            framesLeft -= framesToRead;
-        } else {
-            break;
         }
-        partIndex++;
     }
-    fifo_frames_t framesRead = numFrames - framesLeft;
-    mFifo->advanceReadIndex(framesRead);
+    endRead(framesRead);
     return framesRead;
 }
 
 fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
     WrappingBuffer wrappingBuffer;
-    uint8_t *source = (uint8_t *) buffer;
-    fifo_frames_t framesLeft = numFrames;
-
-    getEmptyRoomAvailable(&wrappingBuffer);
+    const uint8_t *source = (const uint8_t *) buffer;
+    fifo_frames_t framesWritten = beginWrite(&wrappingBuffer, std::max(numFrames, 0));
 
-    // Read data in one or two parts.
-    int partIndex = 0;
-    while (framesLeft > 0 && partIndex < WrappingBuffer::SIZE) {
-        fifo_frames_t framesToWrite = framesLeft;
-        fifo_frames_t framesAvailable = wrappingBuffer.numFrames[partIndex];
-        if (framesAvailable > 0) {
-            if (framesToWrite > framesAvailable) {
-                framesToWrite = framesAvailable;
-            }
-            int32_t numBytes = convertFramesToBytes(framesToWrite);
+    // Write data in one or two parts.
+    for (int partIndex = 0; partIndex < WrappingBuffer::SIZE; partIndex++) {
+        int32_t numBytes = convertFramesToBytes(wrappingBuffer.numFrames[partIndex]);
+        if (numBytes > 0) {
             memcpy(wrappingBuffer.data[partIndex], source, numBytes);
-
             source += numBytes;
-            framesLeft -= framesToWrite;
-        } else {
-            break;
         }
-        partIndex++;
     }
-    fifo_frames_t framesWritten = numFrames - framesLeft;
-    mFifo->advanceWriteIndex(framesWritten);
+    endWrite(framesWritten);
     return framesWritten;
 }
 
@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include "FifoControllerBase.h"
+#include "FifoTimestamp.h"
 
 namespace android {
 
@@ -43,7 +44,8 @@ public:
                fifo_frames_t capacityInFrames,
                fifo_counter_t *readCounterAddress,
                fifo_counter_t *writeCounterAddress,
-               void *dataStorageAddress);
+               void *dataStorageAddress,
+               FifoTimestampSlot *timestampAddress = nullptr);
 
     ~FifoBuffer();
 
@@ -77,6 +79,50 @@ public:
      */
     fifo_frames_t getEmptyRoomAvailable(WrappingBuffer *wrappingBuffer);
 
+    /**
+     * Start a zero-copy read of up to maxFrames. The reader may access the frames
+     * in place until it calls endRead().
+     * @param wrappingBuffer set to the one or two regions of full frames
+     * @param maxFrames limit of the regions, or negative for all the full frames
+     * @param timestamp if not null, set to the latest timestamp published by the writer,
+     *                  or position and nanoseconds set to 0 if there is none
+     * @return number of frames in the regions
+     */
+    fifo_frames_t beginRead(WrappingBuffer *wrappingBuffer, fifo_frames_t maxFrames,
+                            FifoTimestamp *timestamp = nullptr);
+
+    /**
+     * Release frames returned by beginRead() to the writer.
+     * @param numFrames number of frames consumed, not more than returned by beginRead()
+     */
+    void endRead(fifo_frames_t numFrames);
+
+    /**
+     * Start a zero-copy write of up to maxFrames, same as beginRead() for empty frames.
+     */
+    fifo_frames_t beginWrite(WrappingBuffer *wrappingBuffer, fifo_frames_t maxFrames);
+
+    /**
+     * Make frames filled after beginWrite() available to the reader.
+     * @param numFrames number of frames written, not more than returned by beginWrite()
+     */
+    void endWrite(fifo_frames_t numFrames);
+
+    /**
+     * Publish the time at which the frame at a given position of the FIFO was presented or
+     * captured. Only called by one side of the FIFO, normally the service.
+     */
+    void publishTimestamp(fifo_counter_t position, int64_t nanoseconds) {
+        mTimestamp->write(position, nanoseconds);
+    }
+
+    /**
+     * @return true if a timestamp was published
+     */
+    bool getTimestamp(FifoTimestamp *timestamp) const {
+        return mTimestamp->read(timestamp);
+    }
+
     /**
      * Copy data from the FIFO into the buffer.
      * @param buffer
@@ -121,11 +167,17 @@ private:
     void fillWrappingBuffer(WrappingBuffer *wrappingBuffer,
                             int32_t framesAvailable, int32_t startIndex);
 
+    static fifo_frames_t limitWrappingBuffer(WrappingBuffer *wrappingBuffer,
+                                             fifo_frames_t framesAvailable,
+                                             fifo_frames_t maxFrames);
+
     const fifo_frames_t mFrameCapacity;
     const int32_t mBytesPerFrame;
     uint8_t *mStorage;
     bool mStorageOwned; // did this object allocate the storage?
     FifoControllerBase *mFifo;
+    FifoTimestampSlot *mTimestamp;
+    bool mTimestampOwned;
     fifo_counter_t mFramesReadCount;
     fifo_counter_t mFramesUnderrunCount;
     int32_t mUnderrunCount; // need? just use frames
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIFO_FIFO_TIMESTAMP_H
+#define FIFO_FIFO_TIMESTAMP_H
+
+#include <atomic>
+#include <stdint.h>
+
+#include "FifoControllerBase.h"
+
+namespace android {
+
+/**
+ * Position of a frame in the FIFO and the time at which it was presented or captured.
+ */
+struct FifoTimestamp {
+    fifo_counter_t position;
+    int64_t        nanoseconds;
+};
+
+/**
+ * Latest FifoTimestamp of a FIFO, stored next to its counters so it can live in shared memory.
+ *
+ * There is a single writer, which never waits. The reader retries while a write is in progress,
+ * so it always gets a position and time that belong together without any lock or syscall.
+ * The layout must not change because the slot is shared between processes.
+ */
+class FifoTimestampSlot {
+public:
+    FifoTimestampSlot() {
+        clear();
+    }
+
+    void clear() {
+        mSequence.store(0, std::memory_order_relaxed);
+        mPosition.store(0, std::memory_order_relaxed);
+        mNanoseconds.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Only call from the single writer of the slot.
+     */
+    void write(fifo_counter_t position, int64_t nanoseconds) {
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        // An odd sequence means that a write is in progress.
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mPosition.store(position, std::memory_order_relaxed);
+        mNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * @param timestamp set to the latest timestamp written
+     * @return false if nothing was written yet, or if the writer kept it busy
+     */
+    bool read(FifoTimestamp *timestamp) const {
+        for (int i = 0; i < kMaxReadTries; i++) {
+            uint32_t before = mSequence.load(std::memory_order_acquire);
+            if (before == 0) {
+                return false;
+            }
+            if (before & 1) {
+                continue;
+            }
+            fifo_counter_t position = mPosition.load(std::memory_order_relaxed);
+            int64_t nanoseconds = mNanoseconds.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == before) {
+                timestamp->position = position;
+                timestamp->nanoseconds = nanoseconds;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    // A write takes a few nanoseconds and happens once per burst, so a few tries are plenty.
+    static constexpr int kMaxReadTries = 8;
+
+    std::atomic<uint32_t> mSequence;
+    // aligned the same way in 32 and 64-bit processes
+    alignas(8) std::atomic<int64_t> mPosition;
+    std::atomic<int64_t>  mNanoseconds;
+};
+
+}  // android
+
+#endif //FIFO_FIFO_TIMESTAMP_H
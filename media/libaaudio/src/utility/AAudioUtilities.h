@@ -223,6 +223,16 @@ int32_t AAudioProperty_getMinimumSleepMicros();
 
 #define AAUDIO_PROP_MINIMUM_SLEEP_USEC      "aaudio.minimum_sleep_usec"
 
+/**
+ * Read a system property that specifies the maximum latency that a client stream may reach
+ * when its buffer size is adapted to the scheduling jitter after XRuns.
+ *
+ * @return number of microseconds, or 0 if the buffer size should not be adapted
+ */
+int32_t AAudioProperty_getLatencyBudgetMicros();
+
+#define AAUDIO_PROP_LATENCY_BUDGET_USEC     "aaudio.latency_budget_usec"
+
 /**
  * Read system property.
  * This is handy in case the DMA is bursting too quickly for the CPU to keep up.
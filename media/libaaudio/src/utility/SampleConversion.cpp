@@ -0,0 +1,433 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AAudio"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include <stdint.h>
+
+#include <audio_utils/primitives.h>
+
+#include "utility/SampleConversion.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define USE_NEON (true)
+#include <arm_neon.h>
+#else
+#define USE_NEON (false)
+#endif
+
+#if defined(__SSE2__)
+#define USE_SSE2 (true)
+#include <emmintrin.h>
+#else
+#define USE_SSE2 (false)
+#endif
+
+// AVX2 is not part of the x86 ABIs so it is only compiled for the functions that use it,
+// which are only called if the CPU supports it.
+#if USE_SSE2 && (defined(__clang__) || defined(__GNUC__))
+#define USE_AVX2 (true)
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define USE_AVX2 (false)
+#endif
+
+// This is 3 dB, (10^(3/20)), to match the maximum headroom in AudioTrack for float data.
+// It is designed to allow occasional transient peaks.
+#define MAX_HEADROOM (1.41253754f)
+#define MIN_HEADROOM (0 - MAX_HEADROOM)
+
+// Samples are processed as floats, int16_t samples are scaled to +/- 1.0.
+#define SHORT_SCALE  32768
+#define SHORT_TO_FLOAT  (1.0f / SHORT_SCALE)
+
+// ============================== Scalar ==============================
+// Also used for the samples that do not fill a vector.
+
+static inline float loadSample(const float *source) {
+    float sample = *source;
+    // Clip to valid range of a float sample to prevent excessive volume.
+    if (sample > MAX_HEADROOM) sample = MAX_HEADROOM;
+    else if (sample < MIN_HEADROOM) sample = MIN_HEADROOM;
+    return sample;
+}
+
+static inline float loadSample(const int16_t *source) {
+    return *source * SHORT_TO_FLOAT;
+}
+
+static inline void storeSample(float *destination, float sample) {
+    *destination = sample;
+}
+
+static inline void storeSample(int16_t *destination, float sample) {
+    *destination = clamp16_from_float(sample);
+}
+
+template <typename Source, typename Destination>
+static void scaleSamples(const Source *source,
+                         Destination *destination,
+                         int32_t numSamples,
+                         float gain) {
+    for (int32_t i = 0; i < numSamples; i++) {
+        storeSample(&destination[i], loadSample(&source[i]) * gain);
+    }
+}
+
+// Ramp the frames from firstFrame to numFrames.
+// The gain is computed for each frame, rather than accumulated,
+// so that the vector implementations can apply the same gains.
+template <typename Source, typename Destination>
+static void rampSamples(const Source *source,
+                        Destination *destination,
+                        int32_t firstFrame,
+                        int32_t numFrames,
+                        int32_t samplesPerFrame,
+                        float gain1,
+                        float delta) {
+    for (int32_t frame = firstFrame; frame < numFrames; frame++) {
+        float gain = gain1 + delta * frame;
+        int32_t first = frame * samplesPerFrame;
+        for (int32_t i = first; i < first + samplesPerFrame; i++) {
+            storeSample(&destination[i], loadSample(&source[i]) * gain);
+        }
+    }
+}
+
+namespace {
+
+struct ScalarKernels {
+    static constexpr const char *name() { return "scalar"; }
+
+    template <typename Source, typename Destination>
+    static void scale(const Source *source, Destination *destination,
+                      int32_t numSamples, float gain) {
+        scaleSamples(source, destination, numSamples, gain);
+    }
+
+    template <typename Source, typename Destination>
+    static void ramp(const Source *source, Destination *destination,
+                     int32_t numFrames, int32_t samplesPerFrame, float gain1, float delta) {
+        rampSamples(source, destination, 0, numFrames, samplesPerFrame, gain1, delta);
+    }
+};
+
+// ============================== Vector ==============================
+// The kernels are written once for the instruction sets that are always available
+// when they are compiled in.
+
+#if USE_NEON
+struct Neon {
+    static constexpr const char *name() { return "neon"; }
+    typedef float32x4_t Vector;
+    static constexpr int32_t kLanes = 4;
+
+    static inline Vector set1(float value) { return vdupq_n_f32(value); }
+    static inline Vector load(const float *values) { return vld1q_f32(values); }
+    static inline Vector add(Vector a, Vector b) { return vaddq_f32(a, b); }
+    static inline Vector mul(Vector a, Vector b) { return vmulq_f32(a, b); }
+
+    static inline Vector loadSamples(const float *source) {
+        return vminq_f32(vmaxq_f32(vld1q_f32(source), vdupq_n_f32(MIN_HEADROOM)),
+                         vdupq_n_f32(MAX_HEADROOM));
+    }
+
+    static inline Vector loadSamples(const int16_t *source) {
+        return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(source))), SHORT_TO_FLOAT);
+    }
+
+    static inline void storeSamples(float *destination, Vector samples) {
+        vst1q_f32(destination, samples);
+    }
+
+    // Round to nearest even, like clamp16_from_float(), so that all the kernels agree.
+    static inline void storeSamples(int16_t *destination, Vector samples) {
+        Vector scaled = vmulq_n_f32(samples, SHORT_SCALE);
+#if defined(__aarch64__) || defined(__ARM_FEATURE_DIRECTED_ROUNDING)
+        int32x4_t values = vcvtnq_s32_f32(scaled);
+#else
+        // ARMv7 only has vcvtq_s32_f32(), which truncates. NEON arithmetic always rounds to
+        // nearest even, so adding and removing 1.5 * 2^23 rounds the samples, far below 2^22,
+        // to integers that then convert exactly. Larger values still saturate.
+        const Vector magic = vdupq_n_f32(12582912.0f);
+        int32x4_t values = vcvtq_s32_f32(vsubq_f32(vaddq_f32(scaled, magic), magic));
+#endif
+        vst1_s16(destination, vqmovn_s32(values));
+    }
+};
+#endif // USE_NEON
+
+#if USE_SSE2
+struct Sse2 {
+    static constexpr const char *name() { return "sse2"; }
+    typedef __m128 Vector;
+    static constexpr int32_t kLanes = 4;
+
+    static inline Vector set1(float value) { return _mm_set1_ps(value); }
+    static inline Vector load(const float *values) { return _mm_loadu_ps(values); }
+    static inline Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+    static inline Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+
+    static inline Vector loadSamples(const float *source) {
+        return _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source), _mm_set1_ps(MIN_HEADROOM)),
+                          _mm_set1_ps(MAX_HEADROOM));
+    }
+
+    static inline Vector loadSamples(const int16_t *source) {
+        __m128i values = _mm_loadl_epi64((const __m128i *) source);
+        // Sign extend by moving to the upper half.
+        values = _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16);
+        return _mm_mul_ps(_mm_cvtepi32_ps(values), _mm_set1_ps(SHORT_TO_FLOAT));
+    }
+
+    static inline void storeSamples(float *destination, Vector samples) {
+        _mm_storeu_ps(destination, samples);
+    }
+
+    // The samples are within the headroom so they cannot overflow the int32_t conversion.
+    static inline void storeSamples(int16_t *destination, Vector samples) {
+        __m128i values = _mm_cvtps_epi32(_mm_mul_ps(samples, _mm_set1_ps(SHORT_SCALE)));
+        _mm_storel_epi64((__m128i *) destination, _mm_packs_epi32(values, values));
+    }
+};
+#endif // USE_SSE2
+
+template <typename V>
+struct VectorKernels {
+    static constexpr const char *name() { return V::name(); }
+
+    template <typename Source, typename Destination>
+    static void scale(const Source *source, Destination *destination,
+                      int32_t numSamples, float gain) {
+        const typename V::Vector gains = V::set1(gain);
+        int32_t i = 0;
+        for (; i <= numSamples - V::kLanes; i += V::kLanes) {
+            V::storeSamples(&destination[i], V::mul(V::loadSamples(&source[i]), gains));
+        }
+        scaleSamples(&source[i], &destination[i], numSamples - i, gain);
+    }
+
+    template <typename Source, typename Destination>
+    static void ramp(const Source *source, Destination *destination,
+                     int32_t numFrames, int32_t samplesPerFrame, float gain1, float delta) {
+        int32_t frame = 0;
+        if (V::kLanes % samplesPerFrame == 0) {
+            // Each vector holds whole frames, so compute the gain of each lane.
+            const int32_t framesPerVector = V::kLanes / samplesPerFrame;
+            float laneFrames[V::kLanes];
+            for (int32_t lane = 0; lane < V::kLanes; lane++) {
+                laneFrames[lane] = (float) (lane / samplesPerFrame);
+            }
+            const typename V::Vector offsets = V::load(laneFrames);
+            const typename V::Vector gains1 = V::set1(gain1);
+            const typename V::Vector deltas = V::set1(delta);
+            for (; frame <= numFrames - framesPerVector; frame += framesPerVector) {
+                typename V::Vector gains = V::add(gains1,
+                        V::mul(deltas, V::add(V::set1((float) frame), offsets)));
+                int32_t i = frame * samplesPerFrame;
+                V::storeSamples(&destination[i], V::mul(V::loadSamples(&source[i]), gains));
+            }
+        } else if (samplesPerFrame > V::kLanes) {
+            // Wide frames, use the same gain for the whole frame.
+            for (; frame < numFrames; frame++) {
+                int32_t i = frame * samplesPerFrame;
+                scale(&source[i], &destination[i], samplesPerFrame, gain1 + delta * frame);
+            }
+        }
+        rampSamples(source, destination, frame, numFrames, samplesPerFrame, gain1, delta);
+    }
+};
+
+#if USE_AVX2
+// The same kernels as above, compiled for AVX2.
+struct Avx2Kernels {
+    static constexpr const char *name() { return "avx2"; }
+    typedef __m256 Vector;
+    static constexpr int32_t kLanes = 8;
+
+    AVX2_TARGET static inline Vector loadSamples(const float *source) {
+        return _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source),
+                                           _mm256_set1_ps(MIN_HEADROOM)),
+                             _mm256_set1_ps(MAX_HEADROOM));
+    }
+
+    AVX2_TARGET static inline Vector loadSamples(const int16_t *source) {
+        __m256i values = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) source));
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(values), _mm256_set1_ps(SHORT_TO_FLOAT));
+    }
+
+    AVX2_TARGET static inline void storeSamples(float *destination, Vector samples) {
+        _mm256_storeu_ps(destination, samples);
+    }
+
+    AVX2_TARGET static inline void storeSamples(int16_t *destination, Vector samples) {
+        __m256i values = _mm256_cvtps_epi32(_mm256_mul_ps(samples, _mm256_set1_ps(SHORT_SCALE)));
+        _mm_storeu_si128((__m128i *) destination,
+                         _mm_packs_epi32(_mm256_castsi256_si128(values),
+                                         _mm256_extracti128_si256(values, 1)));
+    }
+
+    template <typename Source, typename Destination>
+    AVX2_TARGET static void scale(const Source *source, Destination *destination,
+                                  int32_t numSamples, float gain) {
+        const Vector gains = _mm256_set1_ps(gain);
+        int32_t i = 0;
+        for (; i <= numSamples - kLanes; i += kLanes) {
+            storeSamples(&destination[i], _mm256_mul_ps(loadSamples(&source[i]), gains));
+        }
+        // Avoid the penalty of mixing AVX and SSE in the scalar code.
+        _mm256_zeroupper();
+        scaleSamples(&source[i], &destination[i], numSamples - i, gain);
+    }
+
+    template <typename Source, typename Destination>
+    AVX2_TARGET static void ramp(const Source *source, Destination *destination,
+                                 int32_t numFrames, int32_t samplesPerFrame,
+                                 float gain1, float delta) {
+        int32_t frame = 0;
+        if (kLanes % samplesPerFrame == 0) {
+            const int32_t framesPerVector = kLanes / samplesPerFrame;
+            float laneFrames[kLanes];
+            for (int32_t lane = 0; lane < kLanes; lane++) {
+                laneFrames[lane] = (float) (lane / samplesPerFrame);
+            }
+            const Vector offsets = _mm256_loadu_ps(laneFrames);
+            const Vector gains1 = _mm256_set1_ps(gain1);
+            const Vector deltas = _mm256_set1_ps(delta);
+            for (; frame <= numFrames - framesPerVector; frame += framesPerVector) {
+                Vector gains = _mm256_add_ps(gains1, _mm256_mul_ps(deltas,
+                        _mm256_add_ps(_mm256_set1_ps((float) frame), offsets)));
+                int32_t i = frame * samplesPerFrame;
+                storeSamples(&destination[i], _mm256_mul_ps(loadSamples(&source[i]), gains));
+            }
+        } else if (samplesPerFrame > kLanes) {
+            for (; frame < numFrames; frame++) {
+                int32_t i = frame * samplesPerFrame;
+                scale(&source[i], &destination[i], samplesPerFrame, gain1 + delta * frame);
+            }
+        }
+        _mm256_zeroupper();
+        rampSamples(source, destination, frame, numFrames, samplesPerFrame, gain1, delta);
+    }
+};
+#endif // USE_AVX2
+
+// ============================== Dispatch ==============================
+
+// Adapt the kernels of an instruction set to the conversions.
+template <typename Kernels>
+struct Conversions {
+    static void floatToPcm16(const float *source, int16_t *destination,
+                             int32_t numSamples, float amplitude) {
+        Kernels::scale(source, destination, numSamples, amplitude);
+    }
+
+    // Divide by numFrames so that we almost reach amplitude2.
+    static void floatToPcm16Ramp(const float *source, int16_t *destination,
+                                 int32_t numFrames, int32_t samplesPerFrame,
+                                 float amplitude1, float amplitude2) {
+        Kernels::ramp(source, destination, numFrames, samplesPerFrame,
+                      amplitude1, (amplitude2 - amplitude1) / numFrames);
+    }
+
+    static void pcm16ToFloat(const int16_t *source, float *destination,
+                             int32_t numSamples, float amplitude) {
+        Kernels::scale(source, destination, numSamples, amplitude);
+    }
+
+    static void pcm16ToFloatRamp(const int16_t *source, float *destination,
+                                 int32_t numFrames, int32_t samplesPerFrame,
+                                 float amplitude1, float amplitude2) {
+        Kernels::ramp(source, destination, numFrames, samplesPerFrame,
+                      amplitude1, (amplitude2 - amplitude1) / numFrames);
+    }
+
+    static void floatRamp(const float *source, float *destination,
+                          int32_t numFrames, int32_t samplesPerFrame,
+                          float amplitude1, float amplitude2) {
+        Kernels::ramp(source, destination, numFrames, samplesPerFrame,
+                      amplitude1, (amplitude2 - amplitude1) / numFrames);
+    }
+
+    static void pcm16Ramp(const int16_t *source, int16_t *destination,
+                          int32_t numFrames, int32_t samplesPerFrame,
+                          float amplitude1, float amplitude2) {
+        Kernels::ramp(source, destination, numFrames, samplesPerFrame,
+                      amplitude1, (amplitude2 - amplitude1) / numFrames);
+    }
+
+    static const AAudioSampleConversion table;
+};
+
+template <typename Kernels>
+const AAudioSampleConversion Conversions<Kernels>::table = {
+    Kernels::name(),
+    floatToPcm16,
+    floatToPcm16Ramp,
+    pcm16ToFloat,
+    pcm16ToFloatRamp,
+    floatRamp,
+    pcm16Ramp,
+};
+
+} // anonymous namespace
+
+const AAudioSampleConversion *AAudioSampleConversion_get(aaudio_conversion_isa_t isa) {
+    switch (isa) {
+        case AAUDIO_CONVERSION_ISA_SCALAR:
+            return &Conversions<ScalarKernels>::table;
+#if USE_NEON
+        case AAUDIO_CONVERSION_ISA_NEON:
+            return &Conversions<VectorKernels<Neon>>::table;
+#endif
+#if USE_SSE2
+        case AAUDIO_CONVERSION_ISA_SSE2:
+            return &Conversions<VectorKernels<Sse2>>::table;
+#endif
+#if USE_AVX2
+        case AAUDIO_CONVERSION_ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? &Conversions<Avx2Kernels>::table : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const AAudioSampleConversion *selectBest() {
+    // In order of preference.
+    const aaudio_conversion_isa_t isas[] = {
+        AAUDIO_CONVERSION_ISA_AVX2,
+        AAUDIO_CONVERSION_ISA_NEON,
+        AAUDIO_CONVERSION_ISA_SSE2,
+    };
+    for (aaudio_conversion_isa_t isa : isas) {
+        const AAudioSampleConversion *conversion = AAudioSampleConversion_get(isa);
+        if (conversion != nullptr) {
+            ALOGD("AAudioSampleConversion_getBest() using %s", conversion->name);
+            return conversion;
+        }
+    }
+    return &Conversions<ScalarKernels>::table;
+}
+
+const AAudioSampleConversion &AAudioSampleConversion_getBest() {
+    static const AAudioSampleConversion *best = selectBest();
+    return *best;
+}
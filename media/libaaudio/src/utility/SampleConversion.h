@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UTILITY_SAMPLE_CONVERSION_H
+#define UTILITY_SAMPLE_CONVERSION_H
+
+#include <stdint.h>
+
+/**
+ * Instruction sets that have an implementation of the sample conversions.
+ */
+typedef enum {
+    AAUDIO_CONVERSION_ISA_SCALAR,
+    AAUDIO_CONVERSION_ISA_NEON,
+    AAUDIO_CONVERSION_ISA_SSE2,
+    AAUDIO_CONVERSION_ISA_AVX2,
+    AAUDIO_CONVERSION_ISA_COUNT
+} aaudio_conversion_isa_t;
+
+/**
+ * Bulk sample conversions for one instruction set.
+ *
+ * These have the semantics of AAudioConvert_floatToPcm16(), AAudioConvert_pcm16ToFloat()
+ * and AAudio_linearRamp(), which call the fastest implementation supported by the CPU.
+ * Float samples are clipped to the headroom and int16_t samples are rounded and clamped.
+ * The gain of each frame of a ramp is computed from its index so all implementations
+ * apply the same gains, but the results may differ by the rounding of the last bit.
+ */
+struct AAudioSampleConversion {
+    const char *name;
+
+    void (*floatToPcm16)(const float *source,
+                         int16_t *destination,
+                         int32_t numSamples,
+                         float amplitude);
+
+    void (*floatToPcm16Ramp)(const float *source,
+                             int16_t *destination,
+                             int32_t numFrames,
+                             int32_t samplesPerFrame,
+                             float amplitude1,
+                             float amplitude2);
+
+    void (*pcm16ToFloat)(const int16_t *source,
+                         float *destination,
+                         int32_t numSamples,
+                         float amplitude);
+
+    void (*pcm16ToFloatRamp)(const int16_t *source,
+                             float *destination,
+                             int32_t numFrames,
+                             int32_t samplesPerFrame,
+                             float amplitude1,
+                             float amplitude2);
+
+    void (*floatRamp)(const float *source,
+                      float *destination,
+                      int32_t numFrames,
+                      int32_t samplesPerFrame,
+                      float amplitude1,
+                      float amplitude2);
+
+    void (*pcm16Ramp)(const int16_t *source,
+                      int16_t *destination,
+                      int32_t numFrames,
+                      int32_t samplesPerFrame,
+                      float amplitude1,
+                      float amplitude2);
+};
+
+/**
+ * @param isa instruction set
+ * @return the conversions for that instruction set,
+ *         or nullptr if it is not supported by this build or this CPU
+ */
+const AAudioSampleConversion *AAudioSampleConversion_get(aaudio_conversion_isa_t isa);
+
+/**
+ * The instruction set is chosen when this is first called.
+ *
+ * @return the fastest conversions supported by this CPU
+ */
+const AAudioSampleConversion &AAudioSampleConversion_getBest();
+
+#endif //UTILITY_SAMPLE_CONVERSION_H
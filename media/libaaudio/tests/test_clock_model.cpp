@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Drive the client timing model with jittery timestamps from a simulated service.
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gtest/gtest.h>
+
+#include "client/AdaptiveWakeupScheduler.h"
+#include "client/IsochronousClockModel.h"
+#include "utility/AudioClock.h"
+
+using namespace aaudio;
+
+#define SAMPLE_RATE        48000
+#define FRAMES_PER_BURST   96
+#define BURST_NANOS        (AAUDIO_NANOS_PER_SECOND * FRAMES_PER_BURST / SAMPLE_RATE)
+#define MIN_SLEEP_NANOS    (200 * AAUDIO_NANOS_PER_MICROSECOND)
+#define WAKEUP_DELAY_NANOS (200 * AAUDIO_NANOS_PER_MICROSECOND)
+
+TEST(test_clock_model, lateness) {
+    IsochronousClockModel model;
+    model.setSampleRate(SAMPLE_RATE);
+    model.setFramesPerBurst(FRAMES_PER_BURST);
+    model.start(0);
+
+    int64_t position = 0;
+    int64_t time = 1000000;
+    for (int i = 0; i < 10; i++) {
+        model.processTimestamp(position, time);
+        position += FRAMES_PER_BURST;
+        time += BURST_NANOS;
+    }
+    EXPECT_EQ(0, model.getLatenessNanos());
+
+    model.processTimestamp(position, time + 300000);
+    EXPECT_EQ(300000, model.getLatenessNanos());
+
+    // An early timestamp moves the model instead.
+    position += FRAMES_PER_BURST;
+    time += BURST_NANOS;
+    model.processTimestamp(position, time - 100000);
+    EXPECT_EQ(0, model.getLatenessNanos());
+}
+
+/**
+ * Simulate a client writing a shared stream, as AudioStreamInternalPlay::processData() does.
+ *
+ * The service reads one burst per period, late by its scheduling jitter, and publishes
+ * the read position and time. The client sleeps until the model predicts room for a burst,
+ * plus the wakeup delay, and fills the buffer. It is also late by its own jitter.
+ */
+class StreamSimulation {
+public:
+    StreamSimulation(int64_t serviceJitterNanos, int64_t clientJitterNanos,
+                     int32_t bufferBursts, int32_t budgetBursts, bool adaptive)
+            : mServiceJitterNanos(serviceJitterNanos)
+            , mClientJitterNanos(clientJitterNanos)
+            , mAdaptive(adaptive)
+            , mBufferSize(bufferBursts * FRAMES_PER_BURST) {
+        mModel.setSampleRate(SAMPLE_RATE);
+        mModel.setFramesPerBurst(FRAMES_PER_BURST);
+        mScheduler.configure(SAMPLE_RATE, FRAMES_PER_BURST, WAKEUP_DELAY_NANOS,
+                             mBufferSize, budgetBursts * FRAMES_PER_BURST);
+        mModel.start(0);
+        mScheduler.start(0, 0);
+    }
+
+    void run(int64_t durationNanos) {
+        int64_t endNanos = mNowNanos + durationNanos;
+        while (mNowNanos < endNanos) {
+            if (mNextServiceNanos <= mNextClientNanos) {
+                mNowNanos = mNextServiceNanos;
+                serviceBurst();
+                mServiceBursts++;
+                mNextServiceNanos = mServiceBursts * BURST_NANOS + jitter(mServiceJitterNanos);
+            } else {
+                mNowNanos = mNextClientNanos;
+                mNextClientNanos = clientWakeup() + jitter(mClientJitterNanos);
+            }
+        }
+    }
+
+    void resetCounts() {
+        mWakeups = 0;
+        mEmptyWakeups = 0;
+        mXRunCount = 0;
+        mScheduler.start(mNowNanos, 0);
+    }
+
+    int32_t getWakeups() const { return mWakeups; }
+    int32_t getEmptyWakeups() const { return mEmptyWakeups; }
+    int32_t getXRunCount() const { return mXRunCount; }
+    int32_t getBufferSize() const { return mBufferSize; }
+    const AdaptiveWakeupScheduler &getScheduler() const { return mScheduler; }
+
+private:
+    // Mostly small, sometimes up to the maximum.
+    int64_t jitter(int64_t maxNanos) {
+        if (maxNanos == 0) {
+            return 0;
+        }
+        int64_t random = rand_r(&mSeed);
+        return (random % 10 == 0) ? random % maxNanos : random % (maxNanos / 10 + 1);
+    }
+
+    void serviceBurst() {
+        // Like AAudioMixer::mix(), always advance by a burst.
+        if (mWriteCounter - mReadCounter < FRAMES_PER_BURST) {
+            mXRunCount++;
+        }
+        mReadCounter += FRAMES_PER_BURST;
+        mTimestampPosition = mReadCounter;
+        mTimestampNanos = mNowNanos;
+    }
+
+    // Returns the time for the next wakeup, like processData().
+    int64_t clientWakeup() {
+        mWakeups++;
+        if (mTimestampNanos > mLastTimestampNanos) {
+            mLastTimestampNanos = mTimestampNanos;
+            mModel.processTimestamp(mTimestampPosition, mTimestampNanos);
+            mScheduler.processLateness(mModel.getLatenessNanos());
+        }
+        if (mModel.isStarting()) {
+            return mNowNanos + 2 * AAUDIO_NANOS_PER_MILLISECOND;
+        }
+
+        int64_t full = std::max(mWriteCounter - mReadCounter, (int64_t) 0);
+        if (mWriteCounter < mReadCounter) {
+            mWriteCounter = mReadCounter; // the service already skipped that data
+        }
+        int64_t room = mBufferSize - full;
+        if (room > 0) {
+            mWriteCounter += room;
+        } else {
+            mEmptyWakeups++;
+        }
+
+        if (mAdaptive) {
+            mBufferSize = mScheduler.processXRuns(mNowNanos, mXRunCount, mBufferSize);
+        }
+
+        int64_t nextPosition = mWriteCounter + FRAMES_PER_BURST - mBufferSize;
+        int64_t wakeTime = mModel.convertPositionToTime(nextPosition)
+                + (mAdaptive ? mScheduler.getWakeupDelayNanos() : WAKEUP_DELAY_NANOS);
+        return std::max(wakeTime, mNowNanos + MIN_SLEEP_NANOS);
+    }
+
+    IsochronousClockModel   mModel;
+    AdaptiveWakeupScheduler mScheduler;
+    const int64_t           mServiceJitterNanos;
+    const int64_t           mClientJitterNanos;
+    const bool              mAdaptive;
+    int32_t                 mBufferSize;
+    unsigned                mSeed = 1;
+
+    int64_t                 mNowNanos = 0;
+    int64_t                 mNextServiceNanos = BURST_NANOS;
+    int64_t                 mNextClientNanos = 0;
+    int64_t                 mServiceBursts = 1;
+    int64_t                 mReadCounter = 0;
+    int64_t                 mWriteCounter = 0;
+    int64_t                 mTimestampPosition = 0;
+    int64_t                 mTimestampNanos = 0;
+    int64_t                 mLastTimestampNanos = 0;
+
+    int32_t                 mWakeups = 0;
+    int32_t                 mEmptyWakeups = 0;
+    int32_t                 mXRunCount = 0;
+};
+
+// The service thread is late by up to 1 msec. With a fixed delay the client often wakes up
+// before the service has read the buffer, and has to poll. Following the jitter avoids that.
+TEST(test_clock_model, adaptive_wakeup_avoids_polling) {
+    const int64_t serviceJitter = 1000 * AAUDIO_NANOS_PER_MICROSECOND;
+    StreamSimulation fixed(serviceJitter, 0, 2, 0, false);
+    StreamSimulation adaptive(serviceJitter, 0, 2, 0, true);
+    fixed.run(AAUDIO_NANOS_PER_SECOND);
+    adaptive.run(AAUDIO_NANOS_PER_SECOND);
+    fixed.resetCounts();
+    adaptive.resetCounts();
+    fixed.run(20 * AAUDIO_NANOS_PER_SECOND);
+    adaptive.run(20 * AAUDIO_NANOS_PER_SECOND);
+
+    printf("fixed delay: %d wakeups, %d without room, %d XRuns\n",
+           fixed.getWakeups(), fixed.getEmptyWakeups(), fixed.getXRunCount());
+    printf("adaptive:    %d wakeups, %d without room, %d XRuns, delay %d usec\n",
+           adaptive.getWakeups(), adaptive.getEmptyWakeups(), adaptive.getXRunCount(),
+           adaptive.getScheduler().getWakeupDelayNanos() / 1000);
+
+    EXPECT_LT(adaptive.getEmptyWakeups() * 4, fixed.getEmptyWakeups());
+    EXPECT_LT(adaptive.getWakeups(), fixed.getWakeups());
+    EXPECT_EQ(0, adaptive.getXRunCount());
+    EXPECT_GT(adaptive.getScheduler().getWakeupDelayNanos(), WAKEUP_DELAY_NANOS);
+    EXPECT_LE(adaptive.getScheduler().getWakeupDelayNanos(), BURST_NANOS / 2);
+}
+
+// Without jitter the wakeup delay stays at its minimum.
+TEST(test_clock_model, adaptive_wakeup_no_jitter) {
+    StreamSimulation adaptive(0, 0, 2, 0, true);
+    adaptive.run(AAUDIO_NANOS_PER_SECOND);
+    adaptive.resetCounts(); // the service starts reading before the first timestamp
+    adaptive.run(5 * AAUDIO_NANOS_PER_SECOND);
+    EXPECT_EQ(WAKEUP_DELAY_NANOS, adaptive.getScheduler().getWakeupDelayNanos());
+    EXPECT_EQ(0, adaptive.getXRunCount());
+}
+
+// The client thread is sometimes late by more than a burst, which underruns a buffer
+// of two bursts. The buffer must grow within the budget until the underruns stop.
+TEST(test_clock_model, adaptive_buffer_size) {
+    const int64_t clientJitter = 4000 * AAUDIO_NANOS_PER_MICROSECOND;
+    const int32_t budgetBursts = 8;
+    StreamSimulation fixed(0, clientJitter, 2, budgetBursts, false);
+    StreamSimulation adaptive(0, clientJitter, 2, budgetBursts, true);
+    fixed.run(30 * AAUDIO_NANOS_PER_SECOND);
+    adaptive.run(30 * AAUDIO_NANOS_PER_SECOND);
+    EXPECT_GT(adaptive.getBufferSize(), 2 * FRAMES_PER_BURST);
+    EXPECT_LE(adaptive.getBufferSize(), budgetBursts * FRAMES_PER_BURST);
+
+    fixed.resetCounts();
+    adaptive.resetCounts();
+    fixed.run(30 * AAUDIO_NANOS_PER_SECOND);
+    adaptive.run(30 * AAUDIO_NANOS_PER_SECOND);
+    printf("fixed buffer: %d XRuns, adaptive: %d XRuns with %d frames\n",
+           fixed.getXRunCount(), adaptive.getXRunCount(), adaptive.getBufferSize());
+    EXPECT_GT(fixed.getXRunCount(), 0);
+    EXPECT_LT(adaptive.getXRunCount() * 10, fixed.getXRunCount());
+}
+
+// Without a latency budget, the buffer size is never changed.
+TEST(test_clock_model, no_budget_keeps_buffer_size) {
+    const int64_t clientJitter = 4000 * AAUDIO_NANOS_PER_MICROSECOND;
+    StreamSimulation adaptive(0, clientJitter, 2, 0, true);
+    adaptive.run(10 * AAUDIO_NANOS_PER_SECOND);
+    EXPECT_GT(adaptive.getXRunCount(), 0);
+    EXPECT_EQ(2 * FRAMES_PER_BURST, adaptive.getBufferSize());
+}
+
+// The buffer shrinks back to its minimum once the jitter is gone.
+TEST(test_clock_model, adaptive_buffer_shrinks) {
+    AdaptiveWakeupScheduler scheduler;
+    const int32_t minFrames = 2 * FRAMES_PER_BURST;
+    scheduler.configure(SAMPLE_RATE, FRAMES_PER_BURST, WAKEUP_DELAY_NANOS,
+                        minFrames, 8 * FRAMES_PER_BURST);
+    scheduler.start(0, 0);
+    int32_t bufferSize = minFrames;
+    bufferSize = scheduler.processXRuns(1, 1, bufferSize);
+    bufferSize = scheduler.processXRuns(2, 2, bufferSize);
+    EXPECT_EQ(minFrames + 2 * FRAMES_PER_BURST, bufferSize);
+
+    int64_t time = 2;
+    for (int i = 0; i < 60; i++) {
+        time += AAUDIO_NANOS_PER_SECOND;
+        bufferSize = scheduler.processXRuns(time, 2, bufferSize);
+    }
+    EXPECT_EQ(minFrames, bufferSize);
+}
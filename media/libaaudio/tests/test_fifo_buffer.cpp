@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test and benchmark the FIFO used between AAudio clients and the service.
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fifo/FifoBuffer.h"
+
+using android::FifoBuffer;
+using android::FifoTimestamp;
+using android::FifoTimestampSlot;
+using android::WrappingBuffer;
+using android::fifo_counter_t;
+using android::fifo_frames_t;
+
+#define TEST_CHANNELS      2
+#define TEST_CAPACITY      256
+#define TEST_BURST         96  // does not divide the capacity so the regions wrap
+
+static int64_t getNanoseconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// Frames contain their position in the FIFO, which is easily checked.
+static void fillRegion(void *data, fifo_frames_t numFrames, int32_t *position) {
+    int32_t *samples = (int32_t *) data;
+    for (fifo_frames_t i = 0; i < numFrames; i++) {
+        for (int channel = 0; channel < TEST_CHANNELS; channel++) {
+            *samples++ = *position;
+        }
+        (*position)++;
+    }
+}
+
+static int checkRegion(const void *data, fifo_frames_t numFrames, int32_t *position) {
+    const int32_t *samples = (const int32_t *) data;
+    int errors = 0;
+    for (fifo_frames_t i = 0; i < numFrames; i++) {
+        for (int channel = 0; channel < TEST_CHANNELS; channel++) {
+            if (*samples++ != *position) {
+                errors++;
+            }
+        }
+        (*position)++;
+    }
+    return errors;
+}
+
+TEST(test_fifo_buffer, wrapping_regions) {
+    FifoBuffer fifo(TEST_CHANNELS * sizeof(int32_t), TEST_CAPACITY);
+    int32_t writePosition = 0;
+    int32_t readPosition = 0;
+    WrappingBuffer wrappingBuffer;
+
+    for (int i = 0; i < 100; i++) {
+        fifo_frames_t framesToWrite = fifo.beginWrite(&wrappingBuffer, TEST_BURST);
+        ASSERT_EQ(TEST_BURST, framesToWrite);
+        ASSERT_EQ(framesToWrite, wrappingBuffer.numFrames[0] + wrappingBuffer.numFrames[1]);
+        for (int part = 0; part < WrappingBuffer::SIZE; part++) {
+            fillRegion(wrappingBuffer.data[part], wrappingBuffer.numFrames[part],
+                       &writePosition);
+        }
+        fifo.endWrite(framesToWrite);
+
+        // Read less than written, so the full region crosses the end of the FIFO.
+        fifo_frames_t framesToRead = fifo.beginRead(&wrappingBuffer, TEST_BURST - 1);
+        ASSERT_EQ(TEST_BURST - 1, framesToRead);
+        ASSERT_EQ(framesToRead, wrappingBuffer.numFrames[0] + wrappingBuffer.numFrames[1]);
+        ASSERT_LE(wrappingBuffer.numFrames[1], fifo.getBufferCapacityInFrames());
+        for (int part = 0; part < WrappingBuffer::SIZE; part++) {
+            ASSERT_EQ(0, checkRegion(wrappingBuffer.data[part], wrappingBuffer.numFrames[part],
+                                     &readPosition));
+        }
+        fifo.endRead(framesToRead);
+
+        // Catch up before it gets full.
+        if (fifo.getFifoControllerBase()->getEmptyFramesAvailable() < TEST_BURST) {
+            std::vector<int32_t> buffer(TEST_CAPACITY * TEST_CHANNELS);
+            fifo_frames_t framesRead = fifo.read(buffer.data(), TEST_CAPACITY);
+            ASSERT_EQ(0, checkRegion(buffer.data(), framesRead, &readPosition));
+        }
+    }
+}
+
+TEST(test_fifo_buffer, read_write_copy) {
+    FifoBuffer fifo(TEST_CHANNELS * sizeof(int32_t), TEST_CAPACITY);
+    std::vector<int32_t> buffer(TEST_CAPACITY * TEST_CHANNELS);
+    int32_t writePosition = 0;
+    int32_t readPosition = 0;
+
+    for (int i = 0; i < 100; i++) {
+        fillRegion(buffer.data(), TEST_BURST, &writePosition);
+        ASSERT_EQ(TEST_BURST, fifo.write(buffer.data(), TEST_BURST));
+        ASSERT_EQ(TEST_BURST, fifo.read(buffer.data(), TEST_BURST));
+        ASSERT_EQ(0, checkRegion(buffer.data(), TEST_BURST, &readPosition));
+    }
+    // The FIFO never transfers more than it has.
+    ASSERT_EQ(0, fifo.read(buffer.data(), TEST_BURST));
+    ASSERT_EQ(TEST_CAPACITY, fifo.write(buffer.data(), TEST_CAPACITY + 1));
+    ASSERT_EQ(0, fifo.write(buffer.data(), 1));
+}
+
+TEST(test_fifo_buffer, timestamp) {
+    FifoBuffer fifo(TEST_CHANNELS * sizeof(int32_t), TEST_CAPACITY);
+    FifoTimestamp timestamp;
+    WrappingBuffer wrappingBuffer;
+
+    EXPECT_FALSE(fifo.getTimestamp(&timestamp));
+    fifo.beginRead(&wrappingBuffer, TEST_BURST, &timestamp);
+    EXPECT_EQ(0, timestamp.position);
+    EXPECT_EQ(0, timestamp.nanoseconds);
+
+    fifo.publishTimestamp(1234, 5678);
+    fifo.publishTimestamp(2345, 6789);
+    ASSERT_TRUE(fifo.getTimestamp(&timestamp));
+    EXPECT_EQ(2345, timestamp.position);
+    EXPECT_EQ(6789, timestamp.nanoseconds);
+
+    timestamp.position = 0;
+    fifo.beginRead(&wrappingBuffer, TEST_BURST, &timestamp);
+    EXPECT_EQ(2345, timestamp.position);
+}
+
+// The slot is shared between processes so its layout must not depend on the ABI.
+TEST(test_fifo_buffer, timestamp_slot_layout) {
+    EXPECT_EQ(24u, sizeof(FifoTimestampSlot));
+    EXPECT_EQ(8u, alignof(FifoTimestampSlot));
+}
+
+// Like the service, the writer publishes the position and time of each burst.
+// The reader must never see a position with the time of another burst.
+TEST(test_fifo_buffer, timestamp_consistent) {
+    FifoTimestampSlot slot;
+    const fifo_counter_t kLastPosition = 2000000;
+    std::thread writer([&]() {
+        for (fifo_counter_t position = 1; position <= kLastPosition; position++) {
+            slot.write(position, position * 1000);
+        }
+    });
+    int errors = 0;
+    int reads = 0;
+    FifoTimestamp timestamp = {0, 0};
+    do {
+        if (slot.read(&timestamp)) {
+            reads++;
+            if (timestamp.nanoseconds != timestamp.position * 1000) {
+                errors++;
+            }
+        }
+    } while (timestamp.position < kLastPosition);
+    writer.join();
+    EXPECT_EQ(0, errors);
+    EXPECT_LT(0, reads);
+}
+
+// Single producer, single consumer transfer of bursts between two threads.
+// The consumer either copies each burst out of the FIFO, as read() does,
+// or mixes it in place using beginRead(), as the service mixer does.
+class FifoBenchmark {
+public:
+    FifoBenchmark(bool zeroCopy, fifo_frames_t burst, int32_t numBursts)
+            : mFifo(TEST_CHANNELS * sizeof(float), 4 * burst)
+            , mZeroCopy(zeroCopy)
+            , mBurst(burst)
+            , mNumBursts(numBursts)
+            , mSum(0.0f) {
+    }
+
+    void run() {
+        std::vector<int64_t> writeTimes(mNumBursts);
+        std::atomic<int32_t> burstsWritten(0);
+        std::thread producer([&]() {
+            WrappingBuffer wrappingBuffer;
+            for (int32_t i = 0; i < mNumBursts; i++) {
+                while (mFifo.beginWrite(&wrappingBuffer, mBurst) < mBurst) {
+                    std::this_thread::yield();
+                }
+                for (int part = 0; part < WrappingBuffer::SIZE; part++) {
+                    float *samples = (float *) wrappingBuffer.data[part];
+                    int32_t numSamples = wrappingBuffer.numFrames[part] * TEST_CHANNELS;
+                    for (int32_t j = 0; j < numSamples; j++) {
+                        samples[j] = 0.5f;
+                    }
+                }
+                writeTimes[i] = getNanoseconds();
+                mFifo.endWrite(mBurst);
+                burstsWritten.store(i + 1, std::memory_order_release);
+            }
+        });
+
+        std::vector<float> buffer(mBurst * TEST_CHANNELS);
+        std::vector<int64_t> latencies;
+        latencies.reserve(mNumBursts);
+        int64_t start = getNanoseconds();
+        for (int32_t i = 0; i < mNumBursts; i++) {
+            while (burstsWritten.load(std::memory_order_acquire) <= i) {
+                std::this_thread::yield();
+            }
+            latencies.push_back(getNanoseconds() - writeTimes[i]);
+            if (mZeroCopy) {
+                WrappingBuffer wrappingBuffer;
+                mFifo.beginRead(&wrappingBuffer, mBurst);
+                for (int part = 0; part < WrappingBuffer::SIZE; part++) {
+                    mix((const float *) wrappingBuffer.data[part],
+                        wrappingBuffer.numFrames[part]);
+                }
+                mFifo.endRead(mBurst);
+            } else {
+                mFifo.read(buffer.data(), mBurst);
+                mix(buffer.data(), mBurst);
+            }
+        }
+        mElapsedNanos = getNanoseconds() - start;
+        producer.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        mMedianLatencyNanos = latencies[latencies.size() / 2];
+        mWorstLatencyNanos = latencies[latencies.size() * 99 / 100];
+    }
+
+    double getFramesPerSecond() const {
+        return (double) mBurst * mNumBursts * 1e9 / mElapsedNanos;
+    }
+    int64_t getMedianLatencyNanos() const { return mMedianLatencyNanos; }
+    int64_t get99thLatencyNanos() const { return mWorstLatencyNanos; }
+    float getSum() const { return mSum; }
+
+private:
+    void mix(const float *source, fifo_frames_t numFrames) {
+        int32_t numSamples = numFrames * TEST_CHANNELS;
+        for (int32_t i = 0; i < numSamples; i++) {
+            mSum += source[i];
+        }
+    }
+
+    FifoBuffer          mFifo;
+    const bool          mZeroCopy;
+    const fifo_frames_t mBurst;
+    const int32_t       mNumBursts;
+    float               mSum;
+    int64_t             mElapsedNanos = 0;
+    int64_t             mMedianLatencyNanos = 0;
+    int64_t             mWorstLatencyNanos = 0;
+};
+
+TEST(test_fifo_buffer, benchmark_spsc) {
+    const int32_t kNumBursts = 100000;
+    for (fifo_frames_t burst : {48, 192, 960}) {
+        FifoBenchmark copy(false, burst, kNumBursts);
+        copy.run();
+        FifoBenchmark zeroCopy(true, burst, kNumBursts);
+        zeroCopy.run();
+        EXPECT_EQ(copy.getSum(), zeroCopy.getSum());
+        printf("burst %4d: copy %7.1f Mframes/s latency %6lld/%6lld ns,"
+               " zero-copy %7.1f Mframes/s latency %6lld/%6lld ns (median/99th)\n",
+               burst,
+               copy.getFramesPerSecond() * 1e-6,
+               (long long) copy.getMedianLatencyNanos(),
+               (long long) copy.get99thLatencyNanos(),
+               zeroCopy.getFramesPerSecond() * 1e-6,
+               (long long) zeroCopy.getMedianLatencyNanos(),
+               (long long) zeroCopy.get99thLatencyNanos());
+    }
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Accuracy and speed of the sample conversions for each instruction set.
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utility/AAudioUtilities.h"
+#include "utility/AudioClock.h"
+#include "utility/SampleConversion.h"
+
+#define MAX_HEADROOM       1.41253754
+#define MAX_SAMPLES_PER_FRAME  8
+#define MAX_FRAMES         203
+
+// Tolerances against the exact result in double precision.
+#define PCM16_TOLERANCE    1
+#define FLOAT_TOLERANCE    1.0e-6
+
+static std::vector<const AAudioSampleConversion *> getSupportedConversions() {
+    std::vector<const AAudioSampleConversion *> conversions;
+    for (int isa = 0; isa < AAUDIO_CONVERSION_ISA_COUNT; isa++) {
+        const AAudioSampleConversion *conversion =
+                AAudioSampleConversion_get((aaudio_conversion_isa_t) isa);
+        if (conversion != nullptr) {
+            conversions.push_back(conversion);
+        }
+    }
+    return conversions;
+}
+
+// Float samples beyond the headroom, to check the clipping.
+static std::vector<float> makeFloatSamples(int32_t numSamples) {
+    std::vector<float> samples(numSamples);
+    srandom(numSamples);
+    for (float &sample : samples) {
+        sample = (float) ((random() % 40001 - 20000) / 10000.0);
+    }
+    return samples;
+}
+
+static std::vector<int16_t> makePcm16Samples(int32_t numSamples) {
+    std::vector<int16_t> samples(numSamples);
+    srandom(numSamples);
+    for (int16_t &sample : samples) {
+        sample = (int16_t) (random() % 65536 - 32768);
+    }
+    samples[0] = -32768;
+    samples[numSamples - 1] = 32767;
+    return samples;
+}
+
+static double clip(double sample) {
+    return std::min(std::max(sample, -MAX_HEADROOM), MAX_HEADROOM);
+}
+
+static double toPcm16(double sample) {
+    return std::min(std::max(round(sample * 32768), -32768.0), 32767.0);
+}
+
+// Gain of a frame as specified, the ramp stops just short of amplitude2.
+static double rampGain(int32_t frame, int32_t numFrames, double amplitude1, double amplitude2) {
+    return amplitude1 + (amplitude2 - amplitude1) * frame / numFrames;
+}
+
+TEST(test_sample_conversion, float_to_pcm16) {
+    for (const AAudioSampleConversion *conversion : getSupportedConversions()) {
+        for (int32_t numSamples = 1; numSamples <= MAX_FRAMES; numSamples += 7) {
+            std::vector<float> source = makeFloatSamples(numSamples);
+            std::vector<int16_t> destination(numSamples);
+            conversion->floatToPcm16(source.data(), destination.data(), numSamples, 0.7f);
+            for (int32_t i = 0; i < numSamples; i++) {
+                double expected = toPcm16(clip(source[i]) * 0.7f);
+                ASSERT_NEAR(expected, destination[i], PCM16_TOLERANCE)
+                        << conversion->name << " sample " << i << " of " << numSamples;
+            }
+        }
+    }
+}
+
+// Samples exactly between two int16_t values are rounded to the even one by every instruction
+// set, so the output does not depend on the CPU.
+TEST(test_sample_conversion, float_to_pcm16_rounds_half_to_even) {
+    const AAudioSampleConversion *scalar =
+            AAudioSampleConversion_get(AAUDIO_CONVERSION_ISA_SCALAR);
+    ASSERT_NE(nullptr, scalar);
+    std::vector<float> source;
+    for (int32_t value = -32768; value < 32767; value += 3) {
+        source.push_back((value + 0.5f) / 32768);
+    }
+    std::vector<int16_t> expected(source.size());
+    scalar->floatToPcm16(source.data(), expected.data(), source.size(), 1.0f);
+    for (size_t i = 0; i < source.size(); i++) {
+        ASSERT_EQ(0, expected[i] & 1) << "sample " << i;
+    }
+    for (const AAudioSampleConversion *conversion : getSupportedConversions()) {
+        std::vector<int16_t> destination(source.size());
+        conversion->floatToPcm16(source.data(), destination.data(), source.size(), 1.0f);
+        for (size_t i = 0; i < source.size(); i++) {
+            ASSERT_EQ(expected[i], destination[i]) << conversion->name << " sample " << i;
+        }
+    }
+}
+
+TEST(test_sample_conversion, pcm16_to_float) {
+    for (const AAudioSampleConversion *conversion : getSupportedConversions()) {
+        for (int32_t numSamples = 1; numSamples <= MAX_FRAMES; numSamples += 7) {
+            std::vector<int16_t> source = makePcm16Samples(numSamples);
+            std::vector<float> destination(numSamples);
+            conversion->pcm16ToFloat(source.data(), destination.data(), numSamples, 0.7f);
+            for (int32_t i = 0; i < numSamples; i++) {
+                double expected = source[i] / 32768.0 * 0.7f;
+                ASSERT_NEAR(expected, destination[i], FLOAT_TOLERANCE)
+                        << conversion->name << " sample " << i << " of " << numSamples;
+            }
+        }
+    }
+}
+
+// Run all the ramps for every channel count and many lengths, to cover the vector paths
+// and the tails.
+TEST(test_sample_conversion, ramps) {
+    const float amplitude1 = 0.2f;
+    const float amplitude2 = 0.9f;
+    for (const AAudioSampleConversion *conversion : getSupportedConversions()) {
+        for (int32_t samplesPerFrame = 1; samplesPerFrame <= MAX_SAMPLES_PER_FRAME;
+                samplesPerFrame++) {
+            for (int32_t numFrames = 1; numFrames <= MAX_FRAMES; numFrames += 11) {
+                const int32_t numSamples = numFrames * samplesPerFrame;
+                std::vector<float> floats = makeFloatSamples(numSamples);
+                std::vector<int16_t> shorts = makePcm16Samples(numSamples);
+                std::vector<float> floatsOut(numSamples);
+                std::vector<int16_t> shortsOut(numSamples);
+
+                conversion->floatToPcm16Ramp(floats.data(), shortsOut.data(),
+                        numFrames, samplesPerFrame, amplitude1, amplitude2);
+                for (int32_t i = 0; i < numSamples; i++) {
+                    double gain = rampGain(i / samplesPerFrame, numFrames,
+                                           amplitude1, amplitude2);
+                    ASSERT_NEAR(toPcm16(clip(floats[i]) * gain), shortsOut[i], PCM16_TOLERANCE)
+                            << conversion->name << " floatToPcm16Ramp " << samplesPerFrame
+                            << " x " << numFrames << " sample " << i;
+                }
+
+                conversion->pcm16ToFloatRamp(shorts.data(), floatsOut.data(),
+                        numFrames, samplesPerFrame, amplitude1, amplitude2);
+                for (int32_t i = 0; i < numSamples; i++) {
+                    double gain = rampGain(i / samplesPerFrame, numFrames,
+                                           amplitude1, amplitude2);
+                    ASSERT_NEAR(shorts[i] / 32768.0 * gain, floatsOut[i], FLOAT_TOLERANCE)
+                            << conversion->name << " pcm16ToFloatRamp " << samplesPerFrame
+                            << " x " << numFrames << " sample " << i;
+                }
+
+                conversion->floatRamp(floats.data(), floatsOut.data(),
+                        numFrames, samplesPerFrame, amplitude1, amplitude2);
+                for (int32_t i = 0; i < numSamples; i++) {
+                    double gain = rampGain(i / samplesPerFrame, numFrames,
+                                           amplitude1, amplitude2);
+                    ASSERT_NEAR(clip(floats[i]) * gain, floatsOut[i], FLOAT_TOLERANCE)
+                            << conversion->name << " floatRamp " << samplesPerFrame
+                            << " x " << numFrames << " sample " << i;
+                }
+
+                conversion->pcm16Ramp(shorts.data(), shortsOut.data(),
+                        numFrames, samplesPerFrame, amplitude1, amplitude2);
+                for (int32_t i = 0; i < numSamples; i++) {
+                    double gain = rampGain(i / samplesPerFrame, numFrames,
+                                           amplitude1, amplitude2);
+                    ASSERT_NEAR(toPcm16(shorts[i] / 32768.0 * gain), shortsOut[i],
+                                PCM16_TOLERANCE)
+                            << conversion->name << " pcm16Ramp " << samplesPerFrame
+                            << " x " << numFrames << " sample " << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(test_sample_conversion, full_scale) {
+    const float source[] = {1.0f, -1.0f, 1.5f, -1.5f, 0.5f, -0.5f, 0.0f, 1.0f};
+    const int16_t expected[] = {32767, -32768, 32767, -32768, 16384, -16384, 0, 32767};
+    for (const AAudioSampleConversion *conversion : getSupportedConversions()) {
+        int16_t destination[8];
+        conversion->floatToPcm16(source, destination, 8, 1.0f);
+        for (int i = 0; i < 8; i++) {
+            EXPECT_EQ(expected[i], destination[i]) << conversion->name << " sample " << i;
+        }
+    }
+}
+
+// The public functions give the same results as the best conversions.
+TEST(test_sample_conversion, dispatch) {
+    const AAudioSampleConversion &best = AAudioSampleConversion_getBest();
+    printf("best sample conversion is %s\n", best.name);
+    const int32_t numSamples = 2 * MAX_FRAMES;
+    std::vector<float> source = makeFloatSamples(numSamples);
+    std::vector<int16_t> expected(numSamples);
+    std::vector<int16_t> actual(numSamples);
+    best.floatToPcm16Ramp(source.data(), expected.data(), MAX_FRAMES, 2, 0.0f, 1.0f);
+    AAudioConvert_floatToPcm16(source.data(), actual.data(), MAX_FRAMES, 2, 0.0f, 1.0f);
+    EXPECT_EQ(expected, actual);
+}
+
+// Time each conversion of a typical burst, compared with the scalar code.
+TEST(test_sample_conversion, benchmark) {
+    const int32_t numFrames = 192;
+    const int32_t samplesPerFrame = 2;
+    const int32_t numSamples = numFrames * samplesPerFrame;
+    const int kIterations = 20000;
+    std::vector<float> floats = makeFloatSamples(numSamples);
+    std::vector<int16_t> shorts = makePcm16Samples(numSamples);
+    std::vector<float> floatsOut(numSamples);
+    std::vector<int16_t> shortsOut(numSamples);
+
+    const char *names[] = {"floatToPcm16", "floatToPcm16Ramp", "pcm16ToFloat",
+                           "pcm16ToFloatRamp", "floatRamp", "pcm16Ramp"};
+    double scalarNanos[6] = {};
+    for (const AAudioSampleConversion *conversion : getSupportedConversions()) {
+        for (int function = 0; function < 6; function++) {
+            int64_t startNanos = AudioClock::getNanoseconds();
+            for (int i = 0; i < kIterations; i++) {
+                switch (function) {
+                    case 0:
+                        conversion->floatToPcm16(floats.data(), shortsOut.data(),
+                                                 numSamples, 0.5f);
+                        break;
+                    case 1:
+                        conversion->floatToPcm16Ramp(floats.data(), shortsOut.data(),
+                                                     numFrames, samplesPerFrame, 0.2f, 0.5f);
+                        break;
+                    case 2:
+                        conversion->pcm16ToFloat(shorts.data(), floatsOut.data(),
+                                                 numSamples, 0.5f);
+                        break;
+                    case 3:
+                        conversion->pcm16ToFloatRamp(shorts.data(), floatsOut.data(),
+                                                     numFrames, samplesPerFrame, 0.2f, 0.5f);
+                        break;
+                    case 4:
+                        conversion->floatRamp(floats.data(), floatsOut.data(),
+                                              numFrames, samplesPerFrame, 0.2f, 0.5f);
+                        break;
+                    case 5:
+                        conversion->pcm16Ramp(shorts.data(), shortsOut.data(),
+                                              numFrames, samplesPerFrame, 0.2f, 0.5f);
+                        break;
+                }
+            }
+            double nanosPerSample = (double) (AudioClock::getNanoseconds() - startNanos)
+                                    / ((double) kIterations * numSamples);
+            if (conversion == AAudioSampleConversion_get(AAUDIO_CONVERSION_ISA_SCALAR)) {
+                scalarNanos[function] = nanosPerSample;
+            }
+            printf("%-8s %-18s %6.3f nsec/sample, %5.1fx scalar\n",
+                   conversion->name, names[function], nanosPerSample,
+                   scalarNanos[function] / nanosPerSample);
+        }
+    }
+}
@@ -80,7 +80,8 @@ public:
         FORMAT          = 0x4001,
         MAIN_BUFFER     = 0x4002,
         AUX_BUFFER      = 0x4003,
-        DOWNMIX_TYPE    = 0X4004,
+        DOWNMIX_TYPE    = 0X4004, // downmix_type_t of the downmix effect, used for the
+                                  // channel masks that the effect accepts
         MIXER_FORMAT    = 0x4005, // AUDIO_FORMAT_PCM_(FLOAT|16_BIT)
         MIXER_CHANNEL_MASK = 0x4006, // Channel mask for mixer output
         // for target RESAMPLE
@@ -130,6 +131,19 @@ public:
 
     size_t      getUnreleasedFrames(int name) const;
 
+    // Returns the bytes copied by the buffer provider chain of a track (format conversion,
+    // channel remix, timestretch) and the frames mixed for that track since its name was
+    // allocated.  The ratio is the per mixed frame copy cost of the track configuration.
+    void        getCopyStatistics(int name, uint64_t *bytesCopied, uint64_t *framesMixed) const;
+
+    // Enable or disable CPU time accounting in process().  Disabled by default.
+    void        setCpuAccounting(bool enabled) { mState.cpuAccounting = enabled; }
+
+    // Returns the CPU time in nanoseconds attributed to a track by process() since its name
+    // was allocated.  Tracks mixed by the resampling hook are timed individually; otherwise
+    // the time of the process hook is shared between enabled tracks by channel count.
+    int64_t     getProcessNs(int name) const;
+
     static inline bool isValidPcmTrackFormat(audio_format_t format) {
         switch (format) {
         case AUDIO_FORMAT_PCM_8_BIT:
@@ -226,7 +240,9 @@ private:
          *    requires reformat. For example, it may convert floating point input to
          *    PCM_16_bit if that's required by the downmixer.
          * 3) downmixerBufferProvider: If not NULL, performs the channel remixing to match
-         *    the number of channels required by the mixer sink.
+         *    the number of channels required by the mixer sink.  When this is a
+         *    RemixBufferProvider, it also converts the track format to mMixerInFormat in
+         *    the same pass and mReformatBufferProvider is not used.
          * 4) mPostDownmixReformatBufferProvider: If not NULL, performs reformatting from
          *    the downmixer requirements to the mixer engine input requirements.
          * 5) mTimestretchBufferProvider: Adds timestretching for playback rate
@@ -237,6 +253,10 @@ private:
         PassthruBufferProvider*  mPostDownmixReformatBufferProvider;
         PassthruBufferProvider*  mTimestretchBufferProvider;
 
+        uint64_t    mRetiredBytesCopied; // bytes copied by buffer providers since deleted
+        uint64_t    mFramesMixed;        // frames mixed while enabled
+        int64_t     mProcessNs;          // CPU time attributed by process(), if accounting
+
         int32_t     sessionId;
 
         audio_format_t mMixerFormat;     // output mix format: AUDIO_FORMAT_PCM_(FLOAT|16_BIT)
@@ -246,6 +266,8 @@ private:
         audio_format_t mDownmixRequiresFormat;  // required downmixer format
                                                 // AUDIO_FORMAT_PCM_16_BIT if 16 bit necessary
                                                 // AUDIO_FORMAT_INVALID if no required format
+        downmix_type_t mDownmixType;    // type of the downmix effect, DOWNMIX_TYPE_FOLD or
+                                        // DownmixerBufferProvider::kDownmixTypeMatrix
 
         float          mVolume[MAX_NUM_VOLUMES];     // floating point set volume
         float          mPrevVolume[MAX_NUM_VOLUMES]; // floating point previous volume
@@ -274,6 +296,8 @@ private:
         void        unprepareForReformat();
         bool        setPlaybackRate(const AudioPlaybackRate &playbackRate);
         void        reconfigureBufferProviders();
+        void        deleteBufferProvider(PassthruBufferProvider*& provider);
+        uint64_t    getBytesCopied() const;
     };
 
     typedef void (*process_hook_t)(state_t* state);
@@ -287,7 +311,7 @@ private:
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
         NBLog::Writer*  mNBLogWriter;   // associated NBLog::Writer or &mDummyLog
-        int32_t         reserved[1];
+        bool            cpuAccounting;  // see setCpuAccounting()
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS] __attribute__((aligned(32)));
     };
@@ -26,6 +26,7 @@
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include <cutils/compiler.h>
 #include <utils/Debug.h>
@@ -115,7 +116,7 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
     mState.mNBLogWriter = &mDummyLogWriter;
-    // mState.reserved
+    mState.cpuAccounting = false;
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -218,10 +219,14 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
         t->downmixerBufferProvider = NULL;
         t->mPostDownmixReformatBufferProvider = NULL;
         t->mTimestretchBufferProvider = NULL;
+        t->mRetiredBytesCopied = 0;
+        t->mFramesMixed = 0;
+        t->mProcessNs = 0;
         t->mMixerFormat = AUDIO_FORMAT_PCM_16_BIT;
         t->mFormat = format;
         t->mMixerInFormat = selectMixerInFormat(format);
         t->mDownmixRequiresFormat = AUDIO_FORMAT_INVALID; // no format required
+        t->mDownmixType = DOWNMIX_TYPE_FOLD;
         t->mMixerChannelMask = audio_channel_mask_from_representation_and_bits(
                 AUDIO_CHANNEL_REPRESENTATION_POSITION, AUDIO_CHANNEL_OUT_STEREO);
         t->mMixerChannelCount = audio_channel_count_from_out_mask(t->mMixerChannelMask);
@@ -276,15 +281,14 @@ bool AudioMixer::setChannelMasks(int name,
 
     // channel masks have changed, does this track need a downmixer?
     // update to try using our desired format (if we aren't already using it)
-    const audio_format_t prevDownmixerFormat = track.mDownmixRequiresFormat;
     const status_t status = mState.tracks[name].prepareForDownmix();
     ALOGE_IF(status != OK,
             "prepareForDownmix error %d, track channel mask %#x, mixer channel mask %#x",
             status, track.channelMask, track.mMixerChannelMask);
 
-    if (prevDownmixerFormat != track.mDownmixRequiresFormat) {
-        track.prepareForReformat(); // because of downmixer, track format may change!
-    }
+    // Always reconfigure: because of downmixer, track format may change, and
+    // a remixer created or removed above may take over or give back the format conversion.
+    track.prepareForReformat();
 
     if (track.resampler && mixerChannelCountChanged) {
         // resampler channels may have changed.
@@ -311,8 +315,7 @@ void AudioMixer::track_t::unprepareForDownmix() {
     if (downmixerBufferProvider != NULL) {
         // this track had previously been configured with a downmixer, delete it
         ALOGV(" deleting old downmixer");
-        delete downmixerBufferProvider;
-        downmixerBufferProvider = NULL;
+        deleteBufferProvider(downmixerBufferProvider);
         reconfigureBufferProviders();
     } else {
         ALOGV(" nothing to do, no downmixer to delete");
@@ -337,13 +340,17 @@ status_t AudioMixer::track_t::prepareForDownmix()
     if (audio_channel_mask_get_representation(channelMask)
                 == AUDIO_CHANNEL_REPRESENTATION_POSITION
             && DownmixerBufferProvider::isMultichannelCapable()) {
+        // The matrix downmix also takes float, saving the conversions to and from 16 bit,
+        // the other downmix types take PCM 16 only.
+        const audio_format_t downmixFormat =
+                mDownmixType == DownmixerBufferProvider::kDownmixTypeMatrix
+                        ? mMixerInFormat : AUDIO_FORMAT_PCM_16_BIT;
         DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
-                mMixerChannelMask,
-                AUDIO_FORMAT_PCM_16_BIT /* TODO: use mMixerInFormat, now only PCM 16 */,
-                sampleRate, sessionId, kCopyBufferFrameCount);
+                mMixerChannelMask, downmixFormat,
+                sampleRate, sessionId, kCopyBufferFrameCount, mDownmixType);
 
         if (pDbp->isValid()) { // if constructor completed properly
-            mDownmixRequiresFormat = AUDIO_FORMAT_PCM_16_BIT; // PCM 16 bit required for downmix
+            mDownmixRequiresFormat = downmixFormat;
             downmixerBufferProvider = pDbp;
             reconfigureBufferProviders();
             return NO_ERROR;
@@ -352,8 +359,9 @@ status_t AudioMixer::track_t::prepareForDownmix()
     }
 
     // Effect downmixer does not accept the channel conversion.  Let's use our remixer.
+    // The remixer also converts from the track format, see prepareForReformat().
     RemixBufferProvider* pRbp = new RemixBufferProvider(channelMask,
-            mMixerChannelMask, mMixerInFormat, kCopyBufferFrameCount);
+            mMixerChannelMask, mFormat, mMixerInFormat, kCopyBufferFrameCount);
     // Remix always finds a conversion whereas Downmixer effect above may fail.
     downmixerBufferProvider = pRbp;
     reconfigureBufferProviders();
@@ -364,13 +372,11 @@ void AudioMixer::track_t::unprepareForReformat() {
     ALOGV("AudioMixer::unprepareForReformat(%p)", this);
     bool requiresReconfigure = false;
     if (mReformatBufferProvider != NULL) {
-        delete mReformatBufferProvider;
-        mReformatBufferProvider = NULL;
+        deleteBufferProvider(mReformatBufferProvider);
         requiresReconfigure = true;
     }
     if (mPostDownmixReformatBufferProvider != NULL) {
-        delete mPostDownmixReformatBufferProvider;
-        mPostDownmixReformatBufferProvider = NULL;
+        deleteBufferProvider(mPostDownmixReformatBufferProvider);
         requiresReconfigure = true;
     }
     if (requiresReconfigure) {
@@ -387,7 +393,17 @@ status_t AudioMixer::track_t::prepareForReformat()
     const audio_format_t targetFormat = mDownmixRequiresFormat != AUDIO_FORMAT_INVALID
             ? mDownmixRequiresFormat : mMixerInFormat;
     bool requiresReconfigure = false;
-    if (mFormat != targetFormat) {
+    if (downmixerBufferProvider != NULL && mDownmixRequiresFormat == AUDIO_FORMAT_INVALID) {
+        // The RemixBufferProvider fuses the format conversion with the channel remix,
+        // so it is rebuilt for the new track format instead of chaining a reformatter.
+        RemixBufferProvider* pRbp = static_cast<RemixBufferProvider*>(downmixerBufferProvider);
+        if (pRbp->getInputFormat() != mFormat) {
+            deleteBufferProvider(downmixerBufferProvider);
+            downmixerBufferProvider = new RemixBufferProvider(channelMask,
+                    mMixerChannelMask, mFormat, mMixerInFormat, kCopyBufferFrameCount);
+            requiresReconfigure = true;
+        }
+    } else if (mFormat != targetFormat) {
         mReformatBufferProvider = new ReformatBufferProvider(
                 audio_channel_count_from_out_mask(channelMask),
                 mFormat,
@@ -409,6 +425,31 @@ status_t AudioMixer::track_t::prepareForReformat()
     return NO_ERROR;
 }
 
+void AudioMixer::track_t::deleteBufferProvider(PassthruBufferProvider*& provider)
+{
+    mRetiredBytesCopied += provider->getBytesCopied();
+    delete provider;
+    provider = NULL;
+}
+
+uint64_t AudioMixer::track_t::getBytesCopied() const
+{
+    uint64_t bytesCopied = mRetiredBytesCopied;
+    if (mReformatBufferProvider != NULL) {
+        bytesCopied += mReformatBufferProvider->getBytesCopied();
+    }
+    if (downmixerBufferProvider != NULL) {
+        bytesCopied += downmixerBufferProvider->getBytesCopied();
+    }
+    if (mPostDownmixReformatBufferProvider != NULL) {
+        bytesCopied += mPostDownmixReformatBufferProvider->getBytesCopied();
+    }
+    if (mTimestretchBufferProvider != NULL) {
+        bytesCopied += mTimestretchBufferProvider->getBytesCopied();
+    }
+    return bytesCopied;
+}
+
 void AudioMixer::track_t::reconfigureBufferProviders()
 {
     bufferProvider = mInputBufferProvider;
@@ -449,8 +490,9 @@ void AudioMixer::deleteTrackName(int name)
     // delete the reformatter
     mState.tracks[name].unprepareForReformat();
     // delete the timestretch provider
-    delete track.mTimestretchBufferProvider;
-    track.mTimestretchBufferProvider = NULL;
+    if (track.mTimestretchBufferProvider != NULL) {
+        track.deleteBufferProvider(track.mTimestretchBufferProvider);
+    }
     mTrackNames &= ~(1<<name);
 }
 
@@ -650,10 +692,19 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
                 invalidateState(1 << name);
             }
             } break;
-        // FIXME do we want to support setting the downmix type from AudioFlinger?
-        //         for a specific track? or per mixer?
-        /* case DOWNMIX_TYPE:
-            break          */
+        case DOWNMIX_TYPE: {
+            const downmix_type_t downmixType = static_cast<downmix_type_t>(valueInt);
+            if (track.mDownmixType != downmixType) {
+                track.mDownmixType = downmixType;
+                ALOGV("setParameter(TRACK, DOWNMIX_TYPE, %d)", downmixType);
+                // the downmixer is rebuilt, and may require another format
+                const status_t status = track.prepareForDownmix();
+                ALOGE_IF(status != OK, "prepareForDownmix error %d, downmix type %d",
+                        status, downmixType);
+                track.prepareForReformat();
+                invalidateState(1 << name);
+            }
+            } break;
         case MIXER_FORMAT: {
             audio_format_t format = static_cast<audio_format_t>(valueInt);
             if (track.mMixerFormat != format) {
@@ -909,7 +960,58 @@ void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider
 
 void AudioMixer::process()
 {
-    mState.hook(&mState);
+    if (!mState.cpuAccounting) {
+        mState.hook(&mState);
+    } else {
+        const nsecs_t startNs = systemTime();
+        mState.hook(&mState);
+        const nsecs_t elapsedNs = systemTime() - startNs;
+
+        // process__genericResampling() times each track itself, as the resampler
+        // dominates and differs per track.  The other hooks interleave tracks in small
+        // blocks where per track timing would cost more than the accounting is worth,
+        // so share the hook time by channel count, which is what the mix cost scales with.
+        if (mState.hook != process__genericResampling) {
+            uint32_t channels = 0;
+            uint32_t en = mState.enabledTracks;
+            while (en) {
+                const int i = 31 - __builtin_clz(en);
+                en &= ~(1 << i);
+                channels += mState.tracks[i].mMixerChannelCount;
+            }
+            en = mState.enabledTracks;
+            while (en && channels > 0) {
+                const int i = 31 - __builtin_clz(en);
+                en &= ~(1 << i);
+                track_t& t = mState.tracks[i];
+                t.mProcessNs += elapsedNs * t.mMixerChannelCount / channels;
+            }
+        }
+    }
+
+    // account mixed frames per track for the copy statistics.
+    uint32_t en = mState.enabledTracks;
+    while (en) {
+        const int i = 31 - __builtin_clz(en);
+        en &= ~(1 << i);
+        mState.tracks[i].mFramesMixed += mState.frameCount;
+    }
+}
+
+void AudioMixer::getCopyStatistics(int name, uint64_t *bytesCopied, uint64_t *framesMixed) const
+{
+    name -= TRACK0;
+    ALOG_ASSERT(uint32_t(name) < MAX_NUM_TRACKS, "bad track name %d", name);
+    const track_t& track = mState.tracks[name];
+    *bytesCopied = track.getBytesCopied();
+    *framesMixed = track.mFramesMixed;
+}
+
+int64_t AudioMixer::getProcessNs(int name) const
+{
+    name -= TRACK0;
+    ALOG_ASSERT(uint32_t(name) < MAX_NUM_TRACKS, "bad track name %d", name);
+    return mState.tracks[name].mProcessNs;
 }
 
 
@@ -1553,6 +1655,7 @@ void AudioMixer::process__genericResampling(state_t* state)
             if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
                 aux = t.auxBuffer;
             }
+            const nsecs_t startNs = state->cpuAccounting ? systemTime() : 0;
 
             // this is a little goofy, on the resampling case we don't
             // acquire/release the buffers because it's done by
@@ -1580,6 +1683,9 @@ void AudioMixer::process__genericResampling(state_t* state)
                     t.bufferProvider->releaseBuffer(&t.buffer);
                 }
             }
+            if (state->cpuAccounting) {
+                t.mProcessNs += systemTime() - startNs;
+            }
         }
         convertMixerFormat(out, t1.mMixerFormat,
                 outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
@@ -48,7 +48,8 @@ CopyBufferProvider::CopyBufferProvider(size_t inputFrameSize,
         mOutputFrameSize(outputFrameSize),
         mLocalBufferFrameCount(bufferFrameCount),
         mLocalBufferData(NULL),
-        mConsumed(0)
+        mConsumed(0),
+        mBytesCopied(0)
 {
     ALOGV("CopyBufferProvider(%p)(%zu, %zu, %zu)", this,
             inputFrameSize, outputFrameSize, bufferFrameCount);
@@ -78,6 +79,7 @@ status_t CopyBufferProvider::getNextBuffer(AudioBufferProvider::Buffer *pBuffer)
         status_t res = mTrackBufferProvider->getNextBuffer(pBuffer);
         if (res == OK) {
             copyFrames(pBuffer->raw, pBuffer->raw, pBuffer->frameCount);
+            mBytesCopied += pBuffer->frameCount * mOutputFrameSize;
         }
         return res;
     }
@@ -104,6 +106,7 @@ status_t CopyBufferProvider::getNextBuffer(AudioBufferProvider::Buffer *pBuffer)
     pBuffer->frameCount = count;
     copyFrames(pBuffer->raw, (uint8_t*)mBuffer.raw + mConsumed * mInputFrameSize,
             pBuffer->frameCount);
+    mBytesCopied += pBuffer->frameCount * mOutputFrameSize;
     return OK;
 }
 
@@ -136,15 +139,16 @@ void CopyBufferProvider::reset()
 DownmixerBufferProvider::DownmixerBufferProvider(
         audio_channel_mask_t inputChannelMask,
         audio_channel_mask_t outputChannelMask, audio_format_t format,
-        uint32_t sampleRate, int32_t sessionId, size_t bufferFrameCount) :
+        uint32_t sampleRate, int32_t sessionId, size_t bufferFrameCount,
+        downmix_type_t downmixType) :
         CopyBufferProvider(
             audio_bytes_per_sample(format) * audio_channel_count_from_out_mask(inputChannelMask),
             audio_bytes_per_sample(format) * audio_channel_count_from_out_mask(outputChannelMask),
             bufferFrameCount)  // set bufferFrameCount to 0 to do in-place
 {
-    ALOGV("DownmixerBufferProvider(%p)(%#x, %#x, %#x %u %d %d)",
+    ALOGV("DownmixerBufferProvider(%p)(%#x, %#x, %#x %u %d %d %d)",
             this, inputChannelMask, outputChannelMask, format,
-            sampleRate, sessionId, (int)bufferFrameCount);
+            sampleRate, sessionId, (int)bufferFrameCount, (int)downmixType);
     if (!sIsMultichannelCapable) {
         ALOGE("DownmixerBufferProvider() error: not multichannel capable");
         return;
@@ -206,13 +210,24 @@ DownmixerBufferProvider::DownmixerBufferProvider(
      int cmdStatus;
      uint32_t replySize = sizeof(int);
 
-     // Configure downmixer
+     // Set downmix type, before the configuration which checks the channel mask for the type
+     // parameter size rounded for padding on 32bit boundary
+     const int psizePadded = ((sizeof(downmix_params_t) - 1)/sizeof(int) + 1) * sizeof(int);
+     const int downmixParamSize =
+             sizeof(effect_param_t) + psizePadded + sizeof(downmix_type_t);
+     effect_param_t * const param = (effect_param_t *) malloc(downmixParamSize);
+     param->psize = sizeof(downmix_params_t);
+     const downmix_params_t downmixParam = DOWNMIX_PARAM_TYPE;
+     memcpy(param->data, &downmixParam, param->psize);
+     param->vsize = sizeof(downmix_type_t);
+     memcpy(param->data + psizePadded, &downmixType, param->vsize);
+     replySize = sizeof(int);
      status = mDownmixInterface->command(
-             EFFECT_CMD_SET_CONFIG /*cmdCode*/, sizeof(effect_config_t) /*cmdSize*/,
-             &mDownmixConfig /*pCmdData*/,
-             &replySize, &cmdStatus /*pReplyData*/);
+             EFFECT_CMD_SET_PARAM /* cmdCode */, downmixParamSize /* cmdSize */,
+             param /*pCmdData*/, &replySize, &cmdStatus /*pReplyData*/);
+     free(param);
      if (status != 0 || cmdStatus != 0) {
-         ALOGE("DownmixerBufferProvider() error %d cmdStatus %d while configuring downmixer",
+         ALOGE("DownmixerBufferProvider() error %d cmdStatus %d while setting downmix type",
                  status, cmdStatus);
          mOutBuffer.clear();
          mInBuffer.clear();
@@ -220,14 +235,16 @@ DownmixerBufferProvider::DownmixerBufferProvider(
          mEffectsFactory.clear();
          return;
      }
+     ALOGV("DownmixerBufferProvider() downmix type set to %d", (int) downmixType);
 
-     // Enable downmixer
+     // Configure downmixer
      replySize = sizeof(int);
      status = mDownmixInterface->command(
-             EFFECT_CMD_ENABLE /*cmdCode*/, 0 /*cmdSize*/, NULL /*pCmdData*/,
+             EFFECT_CMD_SET_CONFIG /*cmdCode*/, sizeof(effect_config_t) /*cmdSize*/,
+             &mDownmixConfig /*pCmdData*/,
              &replySize, &cmdStatus /*pReplyData*/);
      if (status != 0 || cmdStatus != 0) {
-         ALOGE("DownmixerBufferProvider() error %d cmdStatus %d while enabling downmixer",
+         ALOGE("DownmixerBufferProvider() error %d cmdStatus %d while configuring downmixer",
                  status, cmdStatus);
          mOutBuffer.clear();
          mInBuffer.clear();
@@ -236,25 +253,13 @@ DownmixerBufferProvider::DownmixerBufferProvider(
          return;
      }
 
-     // Set downmix type
-     // parameter size rounded for padding on 32bit boundary
-     const int psizePadded = ((sizeof(downmix_params_t) - 1)/sizeof(int) + 1) * sizeof(int);
-     const int downmixParamSize =
-             sizeof(effect_param_t) + psizePadded + sizeof(downmix_type_t);
-     effect_param_t * const param = (effect_param_t *) malloc(downmixParamSize);
-     param->psize = sizeof(downmix_params_t);
-     const downmix_params_t downmixParam = DOWNMIX_PARAM_TYPE;
-     memcpy(param->data, &downmixParam, param->psize);
-     const downmix_type_t downmixType = DOWNMIX_TYPE_FOLD;
-     param->vsize = sizeof(downmix_type_t);
-     memcpy(param->data + psizePadded, &downmixType, param->vsize);
+     // Enable downmixer
      replySize = sizeof(int);
      status = mDownmixInterface->command(
-             EFFECT_CMD_SET_PARAM /* cmdCode */, downmixParamSize /* cmdSize */,
-             param /*pCmdData*/, &replySize, &cmdStatus /*pReplyData*/);
-     free(param);
+             EFFECT_CMD_ENABLE /*cmdCode*/, 0 /*cmdSize*/, NULL /*pCmdData*/,
+             &replySize, &cmdStatus /*pReplyData*/);
      if (status != 0 || cmdStatus != 0) {
-         ALOGE("DownmixerBufferProvider() error %d cmdStatus %d while setting downmix type",
+         ALOGE("DownmixerBufferProvider() error %d cmdStatus %d while enabling downmixer",
                  status, cmdStatus);
          mOutBuffer.clear();
          mInBuffer.clear();
@@ -262,7 +267,6 @@ DownmixerBufferProvider::DownmixerBufferProvider(
          mEffectsFactory.clear();
          return;
      }
-     ALOGV("DownmixerBufferProvider() downmix type set to %d", (int) downmixType);
 }
 
 DownmixerBufferProvider::~DownmixerBufferProvider()
@@ -329,31 +333,100 @@ void DownmixerBufferProvider::copyFrames(void *dst, const void *src, size_t fram
 /*static*/ bool DownmixerBufferProvider::sIsMultichannelCapable = false;
 /*static*/ effect_descriptor_t DownmixerBufferProvider::sDwnmFxDesc;
 
+// Single sample conversions used by the fused remix and reformat of RemixBufferProvider.
+// The packed 24 bit type only exists to select the proper overload.
+struct packed24_t {
+    uint8_t bytes[3];
+};
+
+static inline float floatFromSample(uint8_t in) { return float_from_u8(in); }
+static inline float floatFromSample(int16_t in) { return float_from_i16(in); }
+static inline float floatFromSample(const packed24_t &in) { return float_from_p24(in.bytes); }
+static inline float floatFromSample(int32_t in) { return float_from_i32(in); }
+static inline float floatFromSample(float in) { return in; }
+
+static inline void sampleFromFloat(float *out, float in) { *out = in; }
+static inline void sampleFromFloat(int16_t *out, float in) { *out = clamp16_from_float(in); }
+
+// Same as memcpy_by_index_array(), but also converts each sample from TI to TO.
+template <typename TO, typename TI>
+static void remixAndConvert(TO *dst, uint32_t dstChannels,
+        const TI *src, uint32_t srcChannels, const int8_t *idxary, size_t frames)
+{
+    while (frames-- > 0) {
+        for (uint32_t i = 0; i < dstChannels; ++i) {
+            const int8_t index = idxary[i];
+            sampleFromFloat(&dst[i], index < 0 ? 0.f : floatFromSample(src[index]));
+        }
+        dst += dstChannels;
+        src += srcChannels;
+    }
+}
+
+template <typename TO>
+static void remixAndConvert(TO *dst, uint32_t dstChannels,
+        const void *src, audio_format_t srcFormat, uint32_t srcChannels,
+        const int8_t *idxary, size_t frames)
+{
+    switch (srcFormat) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        remixAndConvert(dst, dstChannels, (const uint8_t *)src, srcChannels, idxary, frames);
+        break;
+    case AUDIO_FORMAT_PCM_16_BIT:
+        remixAndConvert(dst, dstChannels, (const int16_t *)src, srcChannels, idxary, frames);
+        break;
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        remixAndConvert(dst, dstChannels, (const packed24_t *)src, srcChannels, idxary, frames);
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        remixAndConvert(dst, dstChannels, (const int32_t *)src, srcChannels, idxary, frames);
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        remixAndConvert(dst, dstChannels, (const float *)src, srcChannels, idxary, frames);
+        break;
+    default:
+        LOG_ALWAYS_FATAL("invalid input format %#x for RemixBufferProvider", srcFormat);
+    }
+}
+
 RemixBufferProvider::RemixBufferProvider(audio_channel_mask_t inputChannelMask,
-        audio_channel_mask_t outputChannelMask, audio_format_t format,
-        size_t bufferFrameCount) :
+        audio_channel_mask_t outputChannelMask, audio_format_t inputFormat,
+        audio_format_t outputFormat, size_t bufferFrameCount) :
         CopyBufferProvider(
-                audio_bytes_per_sample(format)
+                audio_bytes_per_sample(inputFormat)
                     * audio_channel_count_from_out_mask(inputChannelMask),
-                audio_bytes_per_sample(format)
+                audio_bytes_per_sample(outputFormat)
                     * audio_channel_count_from_out_mask(outputChannelMask),
                 bufferFrameCount),
-        mFormat(format),
-        mSampleSize(audio_bytes_per_sample(format)),
+        mInputFormat(inputFormat),
+        mOutputFormat(outputFormat),
+        mSampleSize(audio_bytes_per_sample(outputFormat)),
         mInputChannels(audio_channel_count_from_out_mask(inputChannelMask)),
         mOutputChannels(audio_channel_count_from_out_mask(outputChannelMask))
 {
-    ALOGV("RemixBufferProvider(%p)(%#x, %#x, %#x) %zu %zu",
-            this, format, inputChannelMask, outputChannelMask,
+    ALOGV("RemixBufferProvider(%p)(%#x, %#x, %#x, %#x) %zu %zu",
+            this, inputFormat, outputFormat, inputChannelMask, outputChannelMask,
             mInputChannels, mOutputChannels);
+    LOG_ALWAYS_FATAL_IF(inputFormat != outputFormat
+            && outputFormat != AUDIO_FORMAT_PCM_FLOAT
+            && outputFormat != AUDIO_FORMAT_PCM_16_BIT,
+            "RemixBufferProvider cannot convert to format %#x", outputFormat);
     (void) memcpy_by_index_array_initialization_from_channel_mask(
             mIdxAry, ARRAY_SIZE(mIdxAry), outputChannelMask, inputChannelMask);
 }
 
 void RemixBufferProvider::copyFrames(void *dst, const void *src, size_t frames)
 {
-    memcpy_by_index_array(dst, mOutputChannels,
-            src, mInputChannels, mIdxAry, mSampleSize, frames);
+    if (mInputFormat == mOutputFormat) {
+        memcpy_by_index_array(dst, mOutputChannels,
+                src, mInputChannels, mIdxAry, mSampleSize, frames);
+    } else if (mOutputFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        remixAndConvert((float *)dst, mOutputChannels,
+                src, mInputFormat, mInputChannels, mIdxAry, frames);
+    } else {
+        remixAndConvert((int16_t *)dst, mOutputChannels,
+                src, mInputFormat, mInputChannels, mIdxAry, frames);
+    }
 }
 
 ReformatBufferProvider::ReformatBufferProvider(int32_t channelCount,
@@ -387,7 +460,9 @@ TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
         mRemaining(0),
         mSonicStream(sonicCreateStream(sampleRate, mChannelCount)),
         mFallbackFailErrorShown(false),
-        mAudioPlaybackRateValid(false)
+        mAudioPlaybackRateValid(false),
+        mPassthru(false),
+        mBytesCopied(0)
 {
     LOG_ALWAYS_FATAL_IF(mSonicStream == NULL,
             "TimestretchBufferProvider can't allocate Sonic stream");
@@ -418,6 +493,17 @@ status_t TimestretchBufferProvider::getNextBuffer(
     // BYPASS
     //return mTrackBufferProvider->getNextBuffer(pBuffer);
 
+    // At normal speed and pitch, once the local buffer and sonic are drained,
+    // hand out the upstream buffer directly instead of copying it through sonic.
+    if (mRemaining == 0 && mAudioPlaybackRateValid
+            && mPlaybackRate.mSpeed == AUDIO_TIMESTRETCH_SPEED_NORMAL
+            && mPlaybackRate.mPitch == AUDIO_TIMESTRETCH_PITCH_NORMAL
+            && sonicSamplesAvailable(mSonicStream) == 0) {
+        const status_t res = mTrackBufferProvider->getNextBuffer(pBuffer);
+        mPassthru = res == OK && pBuffer->frameCount != 0;
+        return res;
+    }
+
     // check if previously processed data is sufficient.
     if (pBuffer->frameCount <= mRemaining) {
         ALOGV("previous sufficient");
@@ -474,6 +560,7 @@ status_t TimestretchBufferProvider::getNextBuffer(
 
     // update buffer vars with the actual data processed and return with buffer
     mRemaining += dstAvailable;
+    mBytesCopied += dstAvailable * mFrameSize;
 
     pBuffer->raw = mLocalBufferData;
     pBuffer->frameCount = mRemaining;
@@ -489,12 +576,19 @@ void TimestretchBufferProvider::releaseBuffer(AudioBufferProvider::Buffer *pBuff
     // BYPASS
     //return mTrackBufferProvider->releaseBuffer(pBuffer);
 
+    if (mPassthru) {
+        mPassthru = false;
+        mTrackBufferProvider->releaseBuffer(pBuffer);
+        return;
+    }
+
     // LOG_ALWAYS_FATAL_IF(pBuffer->frameCount == 0, "Invalid framecount");
     if (pBuffer->frameCount < mRemaining) {
         memcpy(mLocalBufferData,
                 (uint8_t*)mLocalBufferData + pBuffer->frameCount * mFrameSize,
                 (mRemaining - pBuffer->frameCount) * mFrameSize);
         mRemaining -= pBuffer->frameCount;
+        mBytesCopied += mRemaining * mFrameSize;
     } else if (pBuffer->frameCount == mRemaining) {
         mRemaining = 0;
     } else {
@@ -509,6 +603,7 @@ void TimestretchBufferProvider::releaseBuffer(AudioBufferProvider::Buffer *pBuff
 void TimestretchBufferProvider::reset()
 {
     mRemaining = 0;
+    mPassthru = false;
 }
 
 status_t TimestretchBufferProvider::setPlaybackRate(const AudioPlaybackRate &playbackRate)
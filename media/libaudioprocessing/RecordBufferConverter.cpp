@@ -25,6 +25,8 @@
 #include <media/RecordBufferConverter.h>
 #include <utils/Log.h>
 
+#include "RecordBufferConverterOps.h"
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
 #endif
@@ -37,6 +39,75 @@ static inline T max(const T& a, const T& b)
 
 namespace android {
 
+// Converts to float and remixes to the destination channels in a single pass,
+// so that the resampler only processes the destination channels.
+class RecordRemixBufferProvider : public CopyBufferProvider {
+public:
+    RecordRemixBufferProvider(audio_channel_mask_t inputChannelMask, audio_format_t inputFormat,
+            audio_channel_mask_t outputChannelMask, bool legacyDownmix, size_t bufferFrameCount)
+        : CopyBufferProvider(
+                audio_bytes_per_sample(inputFormat)
+                    * audio_channel_count_from_in_mask(inputChannelMask),
+                sizeof(float) * audio_channel_count_from_in_mask(outputChannelMask),
+                bufferFrameCount),
+          mInputFormat(inputFormat),
+          mInputChannels(audio_channel_count_from_in_mask(inputChannelMask)),
+          mOutputChannels(audio_channel_count_from_in_mask(outputChannelMask)),
+          mLegacyDownmix(legacyDownmix)
+    {
+        if (!mLegacyDownmix) {
+            (void) memcpy_by_index_array_initialization_from_channel_mask(
+                    mIdxAry, ARRAY_SIZE(mIdxAry), outputChannelMask, inputChannelMask);
+        }
+    }
+
+    static bool isSupported(audio_format_t inputFormat, uint32_t outputChannels) {
+        return (inputFormat == AUDIO_FORMAT_PCM_16_BIT
+                || inputFormat == AUDIO_FORMAT_PCM_24_BIT_PACKED
+                || inputFormat == AUDIO_FORMAT_PCM_32_BIT
+                || inputFormat == AUDIO_FORMAT_PCM_FLOAT)
+                && (outputChannels == 1 || outputChannels == 2);
+    }
+
+    virtual void copyFrames(void *dst, const void *src, size_t frames) {
+        switch (mInputFormat) {
+        case AUDIO_FORMAT_PCM_16_BIT:
+            remix((float *) dst, (const int16_t *) src, frames);
+            break;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            remix((float *) dst, (const record_p24_t *) src, frames);
+            break;
+        case AUDIO_FORMAT_PCM_32_BIT:
+            remix((float *) dst, (const int32_t *) src, frames);
+            break;
+        case AUDIO_FORMAT_PCM_FLOAT:
+            remix((float *) dst, (const float *) src, frames);
+            break;
+        default:
+            LOG_ALWAYS_FATAL("invalid input format %#x for RecordRemixBufferProvider",
+                    mInputFormat);
+        }
+    }
+
+private:
+    template <typename TI>
+    void remix(float *dst, const TI *src, size_t frames) {
+        if (mLegacyDownmix) {
+            recordDownmixToMonoFloat(dst, src, frames);
+        } else if (mOutputChannels == 1) {
+            recordRemixToFloat<1>(dst, src, mInputChannels, mIdxAry, frames);
+        } else {
+            recordRemixToFloat<2>(dst, src, mInputChannels, mIdxAry, frames);
+        }
+    }
+
+    const audio_format_t mInputFormat;
+    const uint32_t       mInputChannels;
+    const uint32_t       mOutputChannels;
+    const bool           mLegacyDownmix;    // average of stereo to mono
+    int8_t               mIdxAry[sizeof(uint32_t) * 8]; // used for channel mask conversion
+};
+
 RecordBufferConverter::RecordBufferConverter(
         audio_channel_mask_t srcChannelMask, audio_format_t srcFormat,
         uint32_t srcSampleRate,
@@ -56,6 +127,7 @@ RecordBufferConverter::RecordBufferConverter(
             mIsLegacyDownmix(false),
             mIsLegacyUpmix(false),
             mRequiresFloat(false),
+            mRemixBeforeResample(false),
             mInputConverterProvider(NULL)
 {
     (void)updateParameters(srcChannelMask, srcFormat, srcSampleRate,
@@ -162,31 +234,41 @@ status_t RecordBufferConverter::updateParameters(
     mDstChannelCount = audio_channel_count_from_in_mask(dstChannelMask);
     mDstFrameSize = mDstChannelCount * audio_bytes_per_sample(mDstFormat);
 
+    // are we running legacy channel conversion modes?
+    mIsLegacyDownmix = (mSrcChannelMask == AUDIO_CHANNEL_IN_STEREO
+                            || mSrcChannelMask == AUDIO_CHANNEL_IN_FRONT_BACK)
+                   && mDstChannelMask == AUDIO_CHANNEL_IN_MONO;
+    mIsLegacyUpmix = mSrcChannelMask == AUDIO_CHANNEL_IN_MONO
+                   && (mDstChannelMask == AUDIO_CHANNEL_IN_STEREO
+                            || mDstChannelMask == AUDIO_CHANNEL_IN_FRONT_BACK);
+
+    // When resampling to fewer channels, e.g. multichannel USB capture to mono or stereo voice,
+    // remix before the resampler so that it only processes the destination channels.
+    // Resampling is linear and per channel, so the remix commutes with it, up to the float
+    // rounding of the downmix sums.
+    mRemixBeforeResample = mSrcSampleRate != mDstSampleRate
+            && mDstChannelCount < mSrcChannelCount
+            && RecordRemixBufferProvider::isSupported(mSrcFormat, mDstChannelCount);
+
     // do we need to resample?
     delete mResampler;
     mResampler = NULL;
+    const uint32_t resamplerChannelCount =
+            mRemixBeforeResample ? mDstChannelCount : mSrcChannelCount;
     if (mSrcSampleRate != mDstSampleRate) {
         mResampler = AudioResampler::create(AUDIO_FORMAT_PCM_FLOAT,
-                mSrcChannelCount, mDstSampleRate);
+                resamplerChannelCount, mDstSampleRate);
         mResampler->setSampleRate(mSrcSampleRate);
         mResampler->setVolume(AudioMixer::UNITY_GAIN_FLOAT, AudioMixer::UNITY_GAIN_FLOAT);
     }
 
-    // are we running legacy channel conversion modes?
-    mIsLegacyDownmix = (mSrcChannelMask == AUDIO_CHANNEL_IN_STEREO
-                            || mSrcChannelMask == AUDIO_CHANNEL_IN_FRONT_BACK)
-                   && mDstChannelMask == AUDIO_CHANNEL_IN_MONO;
-    mIsLegacyUpmix = mSrcChannelMask == AUDIO_CHANNEL_IN_MONO
-                   && (mDstChannelMask == AUDIO_CHANNEL_IN_STEREO
-                            || mDstChannelMask == AUDIO_CHANNEL_IN_FRONT_BACK);
-
     // do we need to process in float?
     mRequiresFloat = mResampler != NULL || mIsLegacyDownmix || mIsLegacyUpmix;
 
     // do we need a staging buffer to convert for destination (we can still optimize this)?
     // we use mBufFrameSize > 0 to indicate both frame size as well as buffer necessity
     if (mResampler != NULL) {
-        mBufFrameSize = max(mSrcChannelCount, (uint32_t)FCC_2)
+        mBufFrameSize = max(resamplerChannelCount, (uint32_t)FCC_2)
                 * audio_bytes_per_sample(AUDIO_FORMAT_PCM_FLOAT);
     } else if (mIsLegacyUpmix || mIsLegacyDownmix) { // legacy modes always float
         mBufFrameSize = mDstChannelCount * audio_bytes_per_sample(AUDIO_FORMAT_PCM_FLOAT);
@@ -200,7 +282,11 @@ status_t RecordBufferConverter::updateParameters(
     // do we need an input converter buffer provider to give us float?
     delete mInputConverterProvider;
     mInputConverterProvider = NULL;
-    if (mRequiresFloat && mSrcFormat != AUDIO_FORMAT_PCM_FLOAT) {
+    if (mRemixBeforeResample) {
+        mInputConverterProvider = new RecordRemixBufferProvider(
+                mSrcChannelMask, mSrcFormat, mDstChannelMask, mIsLegacyDownmix,
+                256 /* provider buffer frame count */);
+    } else if (mRequiresFloat && mSrcFormat != AUDIO_FORMAT_PCM_FLOAT) {
         mInputConverterProvider = new ReformatBufferProvider(
                 audio_channel_count_from_in_mask(mSrcChannelMask),
                 mSrcFormat,
@@ -209,7 +295,8 @@ status_t RecordBufferConverter::updateParameters(
     }
 
     // do we need a remixer to do channel mask conversion
-    if (!mIsLegacyDownmix && !mIsLegacyUpmix && mSrcChannelMask != mDstChannelMask) {
+    if (!mRemixBeforeResample && !mIsLegacyDownmix && !mIsLegacyUpmix
+            && mSrcChannelMask != mDstChannelMask) {
         (void) memcpy_by_index_array_initialization_from_channel_mask(
                 mIdxAry, ARRAY_SIZE(mIdxAry), mDstChannelMask, mSrcChannelMask);
     }
@@ -260,7 +347,17 @@ void RecordBufferConverter::convertResampler(
         void *dst, /*not-a-const*/ void *src, size_t frames)
 {
     // src buffer format is ALWAYS float when entering this routine
-    if (mIsLegacyUpmix) {
+    if (mRemixBeforeResample) {
+        // already remixed; the resampler outputs stereo for mono
+        if (mDstChannelCount == 1 && mDstFormat == AUDIO_FORMAT_PCM_16_BIT) {
+            recordMonoFromStereoFloat((int16_t *)dst, (const float *)src, frames);
+            return;
+        }
+        if (mDstChannelCount == 1) {
+            downmix_to_mono_float_from_stereo_float((float *)src,
+                    (const float *)src, frames);
+        }
+    } else if (mIsLegacyUpmix) {
         ; // mono to stereo already handled by resampler
     } else if (mIsLegacyDownmix
             || (mSrcChannelMask == mDstChannelMask && mSrcChannelCount == 1)) {
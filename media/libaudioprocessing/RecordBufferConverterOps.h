@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RECORD_BUFFER_CONVERTER_OPS_H
+#define ANDROID_RECORD_BUFFER_CONVERTER_OPS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <audio_utils/primitives.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#ifndef USE_NEON
+#define USE_NEON (true)
+#endif
+#else
+#define USE_NEON (false)
+#endif
+#if USE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSSE3__)  // Should be supported in x86 ABI for both 32 & 64-bit.
+#define USE_SSE (true)
+#include <tmmintrin.h>
+#else
+#define USE_SSE (false)
+#endif
+
+namespace android {
+
+/* Kernels for the fused channel remix and conversion to float of RecordBufferConverter.
+ * Remixing before resampling means that only the destination channels are resampled, and the
+ * remix and the conversion to float are done in a single pass over the input.
+ *
+ * The kernels are bit-exact with the separate memcpy_by_audio_format() to float,
+ * memcpy_by_index_array() and downmix_to_mono_float_from_stereo_float() passes on the same
+ * input. The converter output is not: a downmix before the resampler rounds the sums of the
+ * channels before the filter sums, instead of after them. Only the channel selection, which
+ * does not sum, stays exact through the resampler.
+ */
+
+// Packed 24 bit sample, only used to select the proper recordFloatFromSample() overload.
+struct record_p24_t {
+    uint8_t bytes[3];
+};
+
+static inline float recordFloatFromSample(int16_t in) { return float_from_i16(in); }
+static inline float recordFloatFromSample(const record_p24_t &in) {
+    return float_from_p24(in.bytes);
+}
+static inline float recordFloatFromSample(int32_t in) { return float_from_i32(in); }
+static inline float recordFloatFromSample(float in) { return in; }
+
+/* Converts to float the source channel idxary[i] of each frame into destination channel i,
+ * or 0 if idxary[i] is negative.  DST_CHANNELS is 1 or 2, so the inner loop unrolls.
+ */
+template <int DST_CHANNELS, typename TI>
+static inline void recordRemixToFloat(float *dst, const TI *src, uint32_t srcChannels,
+        const int8_t *idxary, size_t frames)
+{
+    for (; frames > 0; --frames) {
+        for (int i = 0; i < DST_CHANNELS; ++i) {
+            const int8_t index = idxary[i];
+            dst[i] = index < 0 ? 0.f : recordFloatFromSample(src[index]);
+        }
+        dst += DST_CHANNELS;
+        src += srcChannels;
+    }
+}
+
+/* Converts to float and averages the channels of each stereo frame (the legacy downmix).
+ * The specializations below are vectorized; all of them give the same results.
+ */
+template <typename TI>
+static inline void recordDownmixToMonoFloat(float *dst, const TI *src, size_t frames)
+{
+    for (; frames > 0; --frames) {
+        dst[0] = (recordFloatFromSample(src[0]) + recordFloatFromSample(src[1])) * 0.5f;
+        dst += 1;
+        src += 2;
+    }
+}
+
+// The sum of two int16 samples is exact in float, and so is its scaling by a power of 2,
+// so summing before conversion gives the same results as converting each sample first.
+template <>
+inline void recordDownmixToMonoFloat(float *dst, const int16_t *src, size_t frames)
+{
+    static const float scale = 1.f / (1 << 16);
+#if USE_NEON
+    for (; frames >= 8; frames -= 8) {
+        const int16x8x2_t lr = vld2q_s16(src);
+        const int32x4_t sumLow = vaddl_s16(vget_low_s16(lr.val[0]), vget_low_s16(lr.val[1]));
+        const int32x4_t sumHigh = vaddl_s16(vget_high_s16(lr.val[0]), vget_high_s16(lr.val[1]));
+        vst1q_f32(dst, vmulq_n_f32(vcvtq_f32_s32(sumLow), scale));
+        vst1q_f32(dst + 4, vmulq_n_f32(vcvtq_f32_s32(sumHigh), scale));
+        dst += 8;
+        src += 16;
+    }
+#elif USE_SSE
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128 scales = _mm_set1_ps(scale);
+    for (; frames >= 4; frames -= 4) {
+        const __m128i lr = _mm_loadu_si128((const __m128i *) src);
+        const __m128i sum = _mm_madd_epi16(lr, ones);   // l + r of each frame as int32
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(sum), scales));
+        dst += 4;
+        src += 8;
+    }
+#endif
+    for (; frames > 0; --frames) {
+        dst[0] = (src[0] + src[1]) * scale;
+        dst += 1;
+        src += 2;
+    }
+}
+
+template <>
+inline void recordDownmixToMonoFloat(float *dst, const int32_t *src, size_t frames)
+{
+    static const float scale = 1.f / (1UL << 31);
+#if USE_NEON
+    for (; frames >= 4; frames -= 4) {
+        const int32x4x2_t lr = vld2q_s32(src);
+        const float32x4_t l = vmulq_n_f32(vcvtq_f32_s32(lr.val[0]), scale);
+        const float32x4_t r = vmulq_n_f32(vcvtq_f32_s32(lr.val[1]), scale);
+        vst1q_f32(dst, vmulq_n_f32(vaddq_f32(l, r), 0.5f));
+        dst += 4;
+        src += 8;
+    }
+#elif USE_SSE
+    const __m128 scales = _mm_set1_ps(scale);
+    const __m128 halves = _mm_set1_ps(0.5f);
+    for (; frames >= 4; frames -= 4) {
+        const __m128 lr0 = _mm_mul_ps(
+                _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) src)), scales);
+        const __m128 lr1 = _mm_mul_ps(
+                _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) (src + 4))), scales);
+        const __m128 l = _mm_shuffle_ps(lr0, lr1, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 r = _mm_shuffle_ps(lr0, lr1, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_add_ps(l, r), halves));
+        dst += 4;
+        src += 8;
+    }
+#endif
+    for (; frames > 0; --frames) {
+        dst[0] = (src[0] * scale + src[1] * scale) * 0.5f;
+        dst += 1;
+        src += 2;
+    }
+}
+
+template <>
+inline void recordDownmixToMonoFloat(float *dst, const float *src, size_t frames)
+{
+#if USE_NEON
+    for (; frames >= 4; frames -= 4) {
+        const float32x4x2_t lr = vld2q_f32(src);
+        vst1q_f32(dst, vmulq_n_f32(vaddq_f32(lr.val[0], lr.val[1]), 0.5f));
+        dst += 4;
+        src += 8;
+    }
+#elif USE_SSE
+    const __m128 halves = _mm_set1_ps(0.5f);
+    for (; frames >= 4; frames -= 4) {
+        const __m128 lr0 = _mm_loadu_ps(src);
+        const __m128 lr1 = _mm_loadu_ps(src + 4);
+        const __m128 l = _mm_shuffle_ps(lr0, lr1, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 r = _mm_shuffle_ps(lr0, lr1, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_add_ps(l, r), halves));
+        dst += 4;
+        src += 8;
+    }
+#endif
+    for (; frames > 0; --frames) {
+        dst[0] = (src[0] + src[1]) * 0.5f;
+        dst += 1;
+        src += 2;
+    }
+}
+
+/* Converts the stereo float output of a mono resampler, where both channels are equal,
+ * to mono in the destination format.  Same as downmix_to_mono_float_from_stereo_float()
+ * followed by memcpy_by_audio_format().
+ */
+static inline void recordMonoFromStereoFloat(int16_t *dst, const float *src, size_t frames)
+{
+    for (; frames > 0; --frames) {
+        *dst++ = clamp16_from_float((src[0] + src[1]) * 0.5f);
+        src += 2;
+    }
+}
+
+static inline void recordMonoFromStereoFloat(float *dst, const float *src, size_t frames)
+{
+    recordDownmixToMonoFloat(dst, src, frames);
+}
+
+} // namespace android
+
+#endif // ANDROID_RECORD_BUFFER_CONVERTER_OPS_H
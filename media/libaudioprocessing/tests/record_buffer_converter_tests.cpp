@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "record_buffer_converter_tests"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+#include <audio_utils/primitives.h>
+#include <media/RecordBufferConverter.h>
+
+#include "RecordBufferConverterOps.h"
+#include "test_utils.h"
+
+using namespace android;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+template <typename T>
+static void fillRandom(std::vector<T> *v)
+{
+    unsigned seed = 1;
+    for (T &sample : *v) {
+        sample = (T) rand_r(&seed);
+    }
+}
+
+static void fillRandom(std::vector<float> *v)
+{
+    unsigned seed = 1;
+    for (float &sample : *v) {
+        sample = (float) rand_r(&seed) / RAND_MAX * 2.f - 1.f;
+    }
+}
+
+// Converts all of the input, in chunks of the output buffer size as done by RecordThread.
+static std::vector<uint8_t> convertAll(RecordBufferConverter *converter, void *input,
+        size_t inputFrames, size_t inputFrameSize, size_t outputFrameSize)
+{
+    static const size_t kChunkFrames = 256;
+    TestProvider provider(input, inputFrames, inputFrameSize, std::vector<int>());
+    std::vector<uint8_t> output;
+    std::vector<uint8_t> chunk(kChunkFrames * outputFrameSize);
+    for (;;) {
+        const size_t frames = converter->convert(chunk.data(), &provider, kChunkFrames);
+        if (frames == 0) {
+            break;
+        }
+        output.insert(output.end(), chunk.begin(), chunk.begin() + frames * outputFrameSize);
+    }
+    return output;
+}
+
+// A frame count that is not a multiple of any vector size, to exercise the tails.
+static const size_t kKernelFrames = 1003;
+
+template <typename T, typename F>
+static void testDownmixKernel(F toFloat)
+{
+    std::vector<T> src(kKernelFrames * 2);
+    fillRandom(&src);
+    std::vector<float> expected(kKernelFrames * 2);
+    toFloat(expected.data(), src.data(), src.size());
+    downmix_to_mono_float_from_stereo_float(expected.data(), expected.data(), kKernelFrames);
+
+    std::vector<float> actual(kKernelFrames);
+    recordDownmixToMonoFloat(actual.data(), src.data(), kKernelFrames);
+    EXPECT_EQ(0, memcmp(expected.data(), actual.data(), kKernelFrames * sizeof(float)));
+}
+
+TEST(record_buffer_converter, downmix_kernels_bitexact) {
+    testDownmixKernel<int16_t>(memcpy_to_float_from_i16);
+    testDownmixKernel<int32_t>(memcpy_to_float_from_i32);
+    testDownmixKernel<float>([](float *dst, const float *src, size_t count) {
+        memcpy(dst, src, count * sizeof(float));
+    });
+}
+
+TEST(record_buffer_converter, remix_kernels_bitexact) {
+    static const uint32_t kSrcChannels = 8;
+    const int8_t idxary[2] = {3, -1};
+    std::vector<int32_t> src(kKernelFrames * kSrcChannels);
+    fillRandom(&src);
+    std::vector<int32_t> selected(kKernelFrames * 2);
+    memcpy_by_index_array(selected.data(), 2, src.data(), kSrcChannels, idxary,
+            sizeof(int32_t), kKernelFrames);
+    std::vector<float> expected(kKernelFrames * 2);
+    memcpy_to_float_from_i32(expected.data(), selected.data(), selected.size());
+
+    std::vector<float> actual(kKernelFrames * 2);
+    recordRemixToFloat<2>(actual.data(), src.data(), kSrcChannels, idxary, kKernelFrames);
+    EXPECT_EQ(0, memcmp(expected.data(), actual.data(), actual.size() * sizeof(float)));
+}
+
+// Capture of 8 channels at 192 kHz to mono 16 kHz resamples only the selected channel,
+// so the result is the same as converting that channel alone.
+TEST(record_buffer_converter, fused_multichannel_to_mono_bitexact) {
+    static const uint32_t kSrcChannels = 8;
+    static const uint32_t kSrcRate = 192000;
+    static const uint32_t kDstRate = 16000;
+    static const size_t kFrames = kSrcRate / 2;
+    std::vector<int32_t> multichannel(kFrames * kSrcChannels);
+    fillRandom(&multichannel);
+    std::vector<int32_t> mono(kFrames);
+    for (size_t i = 0; i < kFrames; ++i) {
+        // the first channel is selected for an index mask source
+        const int32_t sample = (int32_t) (sin(2 * M_PI * 1000. * i / kSrcRate) * INT32_MAX);
+        multichannel[i * kSrcChannels] = sample;
+        mono[i] = sample;
+    }
+
+    RecordBufferConverter fused(AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_32_BIT, kSrcRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_16_BIT, kDstRate);
+    ASSERT_EQ(NO_ERROR, fused.initCheck());
+    RecordBufferConverter reference(AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_32_BIT, kSrcRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_16_BIT, kDstRate);
+    ASSERT_EQ(NO_ERROR, reference.initCheck());
+
+    const std::vector<uint8_t> expected = convertAll(&reference, mono.data(), kFrames,
+            sizeof(int32_t), sizeof(int16_t));
+    const std::vector<uint8_t> actual = convertAll(&fused, multichannel.data(), kFrames,
+            kSrcChannels * sizeof(int32_t), sizeof(int16_t));
+    ASSERT_GT(expected.size(), 0u);
+    ASSERT_EQ(expected.size(), actual.size());
+    EXPECT_EQ(0, memcmp(expected.data(), actual.data(), actual.size()));
+}
+
+// The legacy stereo to mono downmix before resampling is the same as resampling the average.
+TEST(record_buffer_converter, fused_stereo_downmix_bitexact) {
+    static const uint32_t kSrcRate = 48000;
+    static const uint32_t kDstRate = 16000;
+    static const size_t kFrames = kSrcRate / 2;
+    std::vector<float> stereo(kFrames * 2);
+    fillRandom(&stereo);
+    std::vector<float> mono(kFrames);
+    for (size_t i = 0; i < kFrames; ++i) {
+        mono[i] = (stereo[2 * i] + stereo[2 * i + 1]) * 0.5f;
+    }
+
+    RecordBufferConverter fused(AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT, kSrcRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_FLOAT, kDstRate);
+    ASSERT_EQ(NO_ERROR, fused.initCheck());
+    RecordBufferConverter reference(AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_FLOAT, kSrcRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_FLOAT, kDstRate);
+    ASSERT_EQ(NO_ERROR, reference.initCheck());
+
+    const std::vector<uint8_t> expected = convertAll(&reference, mono.data(), kFrames,
+            sizeof(float), sizeof(float));
+    const std::vector<uint8_t> actual = convertAll(&fused, stereo.data(), kFrames,
+            2 * sizeof(float), sizeof(float));
+    ASSERT_GT(expected.size(), 0u);
+    ASSERT_EQ(expected.size(), actual.size());
+    EXPECT_EQ(0, memcmp(expected.data(), actual.data(), actual.size()));
+}
+
+// The previous conversion chain resampled all the source channels, then remixed. The channel
+// selection commutes exactly with the resampler, but the stereo downmix before it rounds the
+// channel sums before the filter sums, so the fused output only matches within float rounding.
+TEST(record_buffer_converter, fused_matches_unfused_chain) {
+    static const uint32_t kSrcRate = 48000;
+    static const uint32_t kDstRate = 16000;
+    static const size_t kFrames = kSrcRate / 2;
+    static const float kFloatTolerance = 1e-6f;
+
+    std::vector<float> stereo(kFrames * 2);
+    fillRandom(&stereo);
+    RecordBufferConverter fused(AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT, kSrcRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_FLOAT, kDstRate);
+    ASSERT_EQ(NO_ERROR, fused.initCheck());
+    RecordBufferConverter resampleStereo(AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT,
+            kSrcRate, AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT, kDstRate);
+    ASSERT_EQ(NO_ERROR, resampleStereo.initCheck());
+
+    std::vector<uint8_t> unfusedBytes = convertAll(&resampleStereo, stereo.data(), kFrames,
+            2 * sizeof(float), 2 * sizeof(float));
+    const size_t unfusedFrames = unfusedBytes.size() / (2 * sizeof(float));
+    std::vector<float> unfused(unfusedFrames);
+    downmix_to_mono_float_from_stereo_float(unfused.data(),
+            (const float *) unfusedBytes.data(), unfusedFrames);
+    const std::vector<uint8_t> actualBytes = convertAll(&fused, stereo.data(), kFrames,
+            2 * sizeof(float), sizeof(float));
+    ASSERT_GT(unfusedFrames, 0u);
+    ASSERT_EQ(unfusedFrames * sizeof(float), actualBytes.size());
+    const float *actual = (const float *) actualBytes.data();
+    float maxDifference = 0.f;
+    for (size_t i = 0; i < unfusedFrames; ++i) {
+        maxDifference = std::max(maxDifference, fabsf(actual[i] - unfused[i]));
+    }
+    EXPECT_LE(maxDifference, kFloatTolerance);
+    printf("stereo to mono float: max difference %g\n", maxDifference);
+
+    // 8 channels of 32 bit to mono 16 bit, by channel selection: within one LSB of the
+    // selection of the first channel after resampling all of them.
+    static const uint32_t kSrcChannels = 8;
+    std::vector<int32_t> multichannel(kFrames * kSrcChannels);
+    fillRandom(&multichannel);
+    RecordBufferConverter fusedSelect(AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_32_BIT,
+            kSrcRate, AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_16_BIT, kDstRate);
+    ASSERT_EQ(NO_ERROR, fusedSelect.initCheck());
+    RecordBufferConverter resampleAll(AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_32_BIT,
+            kSrcRate, AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_16_BIT, kDstRate);
+    ASSERT_EQ(NO_ERROR, resampleAll.initCheck());
+
+    const std::vector<uint8_t> allBytes = convertAll(&resampleAll, multichannel.data(), kFrames,
+            kSrcChannels * sizeof(int32_t), kSrcChannels * sizeof(int16_t));
+    const std::vector<uint8_t> selectedBytes = convertAll(&fusedSelect, multichannel.data(),
+            kFrames, kSrcChannels * sizeof(int32_t), sizeof(int16_t));
+    const size_t selectedFrames = selectedBytes.size() / sizeof(int16_t);
+    ASSERT_GT(selectedFrames, 0u);
+    ASSERT_EQ(selectedFrames * kSrcChannels * sizeof(int16_t), allBytes.size());
+    const int16_t *all = (const int16_t *) allBytes.data();
+    const int16_t *selected = (const int16_t *) selectedBytes.data();
+    int maxLsb = 0;
+    for (size_t i = 0; i < selectedFrames; ++i) {
+        maxLsb = std::max(maxLsb, abs(selected[i] - all[i * kSrcChannels]));
+    }
+    EXPECT_LE(maxLsb, 1);
+}
+
+// Reports the throughput of 8 channel 192 kHz capture converted to mono 16 kHz voice,
+// compared to converting all channels, which is what the converter did before remixing first.
+TEST(record_buffer_converter, throughput_multichannel_to_mono) {
+    static const uint32_t kSrcChannels = 8;
+    static const uint32_t kSrcRate = 192000;
+    static const uint32_t kDstRate = 16000;
+    static const size_t kFrames = kSrcRate * 2;
+    std::vector<int32_t> input(kFrames * kSrcChannels);
+    fillRandom(&input);
+
+    RecordBufferConverter fused(AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_32_BIT, kSrcRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_16_BIT, kDstRate);
+    ASSERT_EQ(NO_ERROR, fused.initCheck());
+    RecordBufferConverter allChannels(AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_32_BIT,
+            kSrcRate, AUDIO_CHANNEL_INDEX_MASK_8, AUDIO_FORMAT_PCM_16_BIT, kDstRate);
+    ASSERT_EQ(NO_ERROR, allChannels.initCheck());
+
+    int64_t start = nowNs();
+    const size_t fusedBytes = convertAll(&fused, input.data(), kFrames,
+            kSrcChannels * sizeof(int32_t), sizeof(int16_t)).size();
+    const int64_t fusedNs = nowNs() - start;
+    start = nowNs();
+    const size_t allChannelsBytes = convertAll(&allChannels, input.data(), kFrames,
+            kSrcChannels * sizeof(int32_t), kSrcChannels * sizeof(int16_t)).size();
+    const int64_t allChannelsNs = nowNs() - start;
+    EXPECT_GT(fusedBytes, 0u);
+    EXPECT_GT(allChannelsBytes, 0u);
+
+    const double audioNs = 1e9 * kFrames / kSrcRate;
+    printf("8ch %u Hz to mono %u Hz: %.1f x realtime, all channels: %.1f x realtime\n",
+            kSrcRate, kDstRate, audioNs / fusedNs, audioNs / allChannelsNs);
+}
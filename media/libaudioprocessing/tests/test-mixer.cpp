@@ -311,6 +311,16 @@ int main(int argc, char* argv[]) {
     }
     outputFrames = i; // reset output frames to the data actually produced.
 
+    // report the copy cost of the buffer provider chain of each track.
+    for (size_t j = 0; j < names.size(); ++j) {
+        uint64_t bytesCopied;
+        uint64_t framesMixed;
+        mixer->getCopyStatistics(names[j], &bytesCopied, &framesMixed);
+        printf("track %zu: %" PRIu64 " bytes copied for %" PRIu64 " frames mixed"
+                " (%.2f bytes per frame)\n", j, bytesCopied, framesMixed,
+                framesMixed == 0 ? 0. : (double)bytesCopied / framesMixed);
+    }
+
     // write to files
     writeFile(outputFilename, outputAddr,
             outputSampleRate, outputChannels, outputFrames, useMixerFloat);
@@ -5,7 +5,8 @@ include $(CLEAR_VARS)
 
 LOCAL_VENDOR_MODULE := true
 LOCAL_SRC_FILES:= \
-	EffectDownmix.c
+	EffectDownmix.c \
+	DownmixMatrix.c
 
 LOCAL_SHARED_LIBRARIES := \
 	libcutils liblog
@@ -26,3 +27,5 @@ LOCAL_CFLAGS += -Wall -Werror
 
 LOCAL_HEADER_LIBRARIES += libhardware_headers
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
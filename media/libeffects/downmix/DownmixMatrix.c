@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "DownmixMatrix"
+//#define LOG_NDEBUG 0
+
+#include <math.h>
+#include <string.h>
+
+#include <audio_utils/primitives.h>
+#include <log/log.h>
+#include <system/audio.h>
+
+#include "DownmixMatrix.h"
+
+#define MINUS_3_DB_IN_FLOAT 0.70710678f // -3dB = 0.70710678f
+// a channel between the front and the front center channels is panned at 22.5 degrees
+#define COS_PI_OVER_8 0.92387953f
+#define SIN_PI_OVER_8 0.38268343f
+
+// Stereo coefficients of each positional channel, indexed by the position of its mask bit.
+// As for the fold functions, the centers and the LFE are mixed at -3dB on both sides,
+// the surround and top channels to their side, and the result is attenuated by 6dB.
+static const float kLeft[DOWNMIX_MATRIX_MAX_CHANNELS] = {
+    1.0f,                // FRONT_LEFT
+    0.0f,                // FRONT_RIGHT
+    MINUS_3_DB_IN_FLOAT, // FRONT_CENTER
+    MINUS_3_DB_IN_FLOAT, // LOW_FREQUENCY
+    1.0f,                // BACK_LEFT
+    0.0f,                // BACK_RIGHT
+    COS_PI_OVER_8,       // FRONT_LEFT_OF_CENTER
+    SIN_PI_OVER_8,       // FRONT_RIGHT_OF_CENTER
+    MINUS_3_DB_IN_FLOAT, // BACK_CENTER
+    1.0f,                // SIDE_LEFT
+    0.0f,                // SIDE_RIGHT
+    MINUS_3_DB_IN_FLOAT, // TOP_CENTER
+    1.0f,                // TOP_FRONT_LEFT
+    MINUS_3_DB_IN_FLOAT, // TOP_FRONT_CENTER
+    0.0f,                // TOP_FRONT_RIGHT
+    1.0f,                // TOP_BACK_LEFT
+    MINUS_3_DB_IN_FLOAT, // TOP_BACK_CENTER
+    0.0f,                // TOP_BACK_RIGHT
+};
+#define DOWNMIX_MATRIX_GAIN 0.5f
+// frames of 16 bit samples widened at once
+#define DOWNMIX_MATRIX_BLOCK_FRAMES 64
+
+static inline float clamp_float(float a) {
+    return a > 1.0f ? 1.0f : (a < -1.0f ? -1.0f : a);
+}
+
+/*----------------------------------------------------------------------------
+ * Downmix_matrixValidChannelMask()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * Whether a channel mask can be downmixed by the matrix: any combination of positional
+ * channels, from mono to 7.1.4 and beyond
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_matrixValidChannelMask(uint32_t mask) {
+    return mask != 0 && (mask & ~(uint32_t)AUDIO_CHANNEL_OUT_ALL) == 0;
+}
+
+/*----------------------------------------------------------------------------
+ * Downmix_matrixInit()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * Compute the stereo downmix coefficients of the channels of a mask
+ *
+ * Inputs:
+ *  mask       the channel mask of the input frames
+ *
+ * Outputs:
+ *  pMatrix    the coefficients
+ *
+ * Returns: false if the channel mask is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_matrixInit(downmix_matrix_t *pMatrix, uint32_t mask) {
+    if (!Downmix_matrixValidChannelMask(mask)) {
+        ALOGE("Unsupported channel mask 0x%x for the downmix matrix", mask);
+        return false;
+    }
+    memset(pMatrix, 0, sizeof(downmix_matrix_t));
+    uint32_t channel = 0;
+    for (uint32_t position = 0; position < DOWNMIX_MATRIX_MAX_CHANNELS; position++) {
+        if ((mask & (1u << position)) == 0) {
+            continue;
+        }
+        // the right coefficients mirror the left ones: bits 0 and 1 are FL and FR,
+        // and so on for each left and right pair
+        uint32_t mirrored = position;
+        switch (1u << position) {
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_BACK_LEFT:
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+            mirrored = position + 1;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+            mirrored = position - 1;
+            break;
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+            mirrored = position + 2;
+            break;
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+            mirrored = position - 2;
+            break;
+        default: // centers and LFE
+            break;
+        }
+        const float left = DOWNMIX_MATRIX_GAIN * kLeft[position];
+        const float right = DOWNMIX_MATRIX_GAIN * kLeft[mirrored];
+        pMatrix->left[channel] = left;
+        pMatrix->right[channel] = right;
+        pMatrix->left_q12[channel] = (int32_t) lrintf(left * (1 << 12));
+        pMatrix->right_q12[channel] = (int32_t) lrintf(right * (1 << 12));
+        channel++;
+    }
+    pMatrix->channel_count = channel;
+    // a mono channel is the same signal in both front channels
+    if (mask == AUDIO_CHANNEL_OUT_MONO) {
+        pMatrix->right[0] = pMatrix->left[0];
+        pMatrix->right_q12[0] = pMatrix->left_q12[0];
+    }
+    return true;
+}
+
+/*----------------------------------------------------------------------------
+ * Matrix-vector kernels
+ *----------------------------------------------------------------------------
+ * Each output frame is the product of the 2 x channelCount matrix with the input frame.
+ * The kernels are instantiated for each channel count up to 7.1.4, so that the channel loop
+ * is unrolled and the frame loop is vectorized by the compiler: the samples of a channel in
+ * consecutive frames are loaded by interleaved loads (vld2/vld3/vld4 on NEON), and several
+ * output frames are computed per instruction. Per frame sums are in the same order as in the
+ * scalar loop, so the results do not depend on the vectorization.
+ * The input and output may be the same buffer if the input has at least 2 channels: an output
+ * frame then never overlaps an input frame that is not yet read. A mono output frame overlaps
+ * the next input frame, so mono must not be processed in place.
+ *----------------------------------------------------------------------------
+ */
+static inline __attribute__((always_inline)) void matrix16(
+        const int32_t *left, const int32_t *right, const int16_t *pSrc, int16_t *pDst,
+        size_t numFrames, bool accumulate, const uint32_t channelCount) {
+    // local copies of the coefficients, which pDst cannot alias
+    int32_t l[DOWNMIX_MATRIX_MAX_CHANNELS], r[DOWNMIX_MATRIX_MAX_CHANNELS];
+    for (uint32_t c = 0; c < channelCount; c++) {
+        l[c] = left[c];
+        r[c] = right[c];
+    }
+    // the samples are widened to 32 bit by blocks, as interleaved loads do not widen
+    int32_t widened[DOWNMIX_MATRIX_BLOCK_FRAMES * DOWNMIX_MATRIX_MAX_CHANNELS];
+    while (numFrames) {
+        const size_t blockFrames = numFrames < DOWNMIX_MATRIX_BLOCK_FRAMES
+                ? numFrames : DOWNMIX_MATRIX_BLOCK_FRAMES;
+        for (size_t i = 0; i < blockFrames * channelCount; i++) {
+            widened[i] = pSrc[i];
+        }
+        for (size_t i = 0; i < blockFrames; i++) {
+            const int32_t *frame = widened + i * channelCount;
+            int32_t lt = 0, rt = 0; // samples in Q19.12 format
+            for (uint32_t c = 0; c < channelCount; c++) {
+                lt += l[c] * frame[c];
+                rt += r[c] * frame[c];
+            }
+            if (accumulate) {
+                pDst[2 * i] = clamp16(pDst[2 * i] + (lt >> 12));
+                pDst[2 * i + 1] = clamp16(pDst[2 * i + 1] + (rt >> 12));
+            } else {
+                pDst[2 * i] = clamp16(lt >> 12);
+                pDst[2 * i + 1] = clamp16(rt >> 12);
+            }
+        }
+        pSrc += blockFrames * channelCount;
+        pDst += blockFrames * 2;
+        numFrames -= blockFrames;
+    }
+}
+
+static inline __attribute__((always_inline)) void matrixFloat(
+        const float *left, const float *right, const float *pSrc, float *pDst,
+        size_t numFrames, bool accumulate, const uint32_t channelCount) {
+    // local copies of the coefficients, which pDst cannot alias
+    float l[DOWNMIX_MATRIX_MAX_CHANNELS], r[DOWNMIX_MATRIX_MAX_CHANNELS];
+    for (uint32_t c = 0; c < channelCount; c++) {
+        l[c] = left[c];
+        r[c] = right[c];
+    }
+    for (size_t i = 0; i < numFrames; i++) {
+        const float *frame = pSrc + i * channelCount;
+        float lt = 0.0f, rt = 0.0f;
+        for (uint32_t c = 0; c < channelCount; c++) {
+            lt += l[c] * frame[c];
+            rt += r[c] * frame[c];
+        }
+        if (accumulate) {
+            pDst[2 * i] = clamp_float(pDst[2 * i] + lt);
+            pDst[2 * i + 1] = clamp_float(pDst[2 * i + 1] + rt);
+        } else {
+            pDst[2 * i] = clamp_float(lt);
+            pDst[2 * i + 1] = clamp_float(rt);
+        }
+    }
+}
+
+// instantiates KERNEL for the channel counts up to 7.1.4, and falls back to a loop over
+// the channels otherwise
+#define DOWNMIX_MATRIX_DISPATCH(KERNEL, left, right, pSrc, pDst, numFrames, accumulate, \
+        channelCount) \
+    do { \
+        switch (channelCount) { \
+        case 1:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 1);  break; \
+        case 2:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 2);  break; \
+        case 3:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 3);  break; \
+        case 4:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 4);  break; \
+        case 5:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 5);  break; \
+        case 6:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 6);  break; \
+        case 7:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 7);  break; \
+        case 8:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 8);  break; \
+        case 9:  KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 9);  break; \
+        case 10: KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 10); break; \
+        case 11: KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 11); break; \
+        case 12: KERNEL(left, right, pSrc, pDst, numFrames, accumulate, 12); break; \
+        default: \
+            KERNEL(left, right, pSrc, pDst, numFrames, accumulate, channelCount); \
+            break; \
+        } \
+    } while (0)
+
+/*----------------------------------------------------------------------------
+ * Downmix_matrix16()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * downmix to stereo 16 bit samples with the coefficients of a matrix, bit exact with the
+ * fold functions for the channel masks they support
+ *
+ * Inputs:
+ *  pMatrix    the coefficients initialized by Downmix_matrixInit() with the mask of pSrc
+ *  pSrc       multichannel audio buffer to downmix, may be pDst if it has at least 2 channels
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_matrix16(const downmix_matrix_t *pMatrix,
+        const int16_t *pSrc, int16_t *pDst, size_t numFrames, bool accumulate) {
+    // code is duplicated between the two values of accumulate to avoid testing every frame
+    if (accumulate) {
+        DOWNMIX_MATRIX_DISPATCH(matrix16, pMatrix->left_q12, pMatrix->right_q12,
+                pSrc, pDst, numFrames, true, pMatrix->channel_count);
+    } else {
+        DOWNMIX_MATRIX_DISPATCH(matrix16, pMatrix->left_q12, pMatrix->right_q12,
+                pSrc, pDst, numFrames, false, pMatrix->channel_count);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Downmix_matrixFloat()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * downmix to stereo float samples with the coefficients of a matrix
+ *
+ * Inputs:
+ *  pMatrix    the coefficients initialized by Downmix_matrixInit() with the mask of pSrc
+ *  pSrc       multichannel audio buffer to downmix, may be pDst if it has at least 2 channels
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples, clamped to [-1.0, 1.0]
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_matrixFloat(const downmix_matrix_t *pMatrix,
+        const float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    // code is duplicated between the two values of accumulate to avoid testing every frame
+    if (accumulate) {
+        DOWNMIX_MATRIX_DISPATCH(matrixFloat, pMatrix->left, pMatrix->right,
+                pSrc, pDst, numFrames, true, pMatrix->channel_count);
+    } else {
+        DOWNMIX_MATRIX_DISPATCH(matrixFloat, pMatrix->left, pMatrix->right,
+                pSrc, pDst, numFrames, false, pMatrix->channel_count);
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_DOWNMIX_MATRIX_H_
+#define ANDROID_DOWNMIX_MATRIX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <audio_effects/effect_downmix.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*------------------------------------
+ * definitions
+ *------------------------------------
+*/
+
+// Downmix type of this implementation, beyond the ones of downmix_type_t: folds any channel mask
+// up to 7.1.4, in 16 bit or float, with the coefficients of a downmix_matrix_t. The 16 bit
+// samples of the channel masks supported by DOWNMIX_TYPE_FOLD are folded as with it.
+#define DOWNMIX_TYPE_MATRIX ((downmix_type_t)(DOWNMIX_TYPE_LAST + 1))
+
+// one input channel per positional channel of an output channel mask, which covers 7.1.4
+#define DOWNMIX_MATRIX_MAX_CHANNELS 18
+
+/* stereo downmix coefficients of the channels of an input frame, in the order of the mask bits */
+typedef struct {
+    uint32_t channel_count;
+    float left[DOWNMIX_MATRIX_MAX_CHANNELS];
+    float right[DOWNMIX_MATRIX_MAX_CHANNELS];
+    // the same coefficients in Q19.12, for 16 bit samples
+    int32_t left_q12[DOWNMIX_MATRIX_MAX_CHANNELS];
+    int32_t right_q12[DOWNMIX_MATRIX_MAX_CHANNELS];
+} downmix_matrix_t;
+
+/*------------------------------------
+ * functions
+ *------------------------------------
+*/
+bool Downmix_matrixValidChannelMask(uint32_t mask);
+bool Downmix_matrixInit(downmix_matrix_t *pMatrix, uint32_t mask);
+void Downmix_matrix16(const downmix_matrix_t *pMatrix,
+        const int16_t *pSrc, int16_t *pDst, size_t numFrames, bool accumulate);
+void Downmix_matrixFloat(const downmix_matrix_t *pMatrix,
+        const float *pSrc, float *pDst, size_t numFrames, bool accumulate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*ANDROID_DOWNMIX_MATRIX_H_*/
@@ -86,8 +86,8 @@ static const effect_descriptor_t * const gDescriptors[] = {
 
 // number of effects in this library
 const int kNbEffects = sizeof(gDescriptors) / sizeof(const effect_descriptor_t *);
-#ifdef BUILD_FLOAT
-static LVM_FLOAT clamp_float(LVM_FLOAT a) {
+
+static float clamp_float(float a) {
     if (a > 1.0f) {
         return 1.0f;
     }
@@ -98,7 +98,6 @@ static LVM_FLOAT clamp_float(LVM_FLOAT a) {
         return a;
     }
 }
-#endif
 /*----------------------------------------------------------------------------
  * Test code
  *--------------------------------------------------------------------------*/
@@ -159,35 +158,42 @@ void Downmix_testIndexComputation(uint32_t mask) {
 }
 #endif
 
-static bool Downmix_validChannelMask(uint32_t mask)
+// returns why the fold functions do not support a channel mask, or NULL if they do
+static const char *Downmix_foldChannelMaskError(uint32_t mask)
 {
     if (!mask) {
-        return false;
+        return "Blank channel mask";
     }
     // check against unsupported channels
     if (mask & kUnsupported) {
-        ALOGE("Unsupported channels (top or front left/right of center)");
-        return false;
+        return "Unsupported channels (top or front left/right of center)";
     }
     // verify has FL/FR
     if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
-        ALOGE("Front channels must be present");
-        return false;
+        return "Front channels must be present";
     }
     // verify uses SIDE as a pair (ok if not using SIDE at all)
     if ((mask & kSides) != 0) {
         if ((mask & kSides) != kSides) {
-            ALOGE("Side channels must be used as a pair");
-            return false;
+            return "Side channels must be used as a pair";
         }
     }
     // verify uses BACK as a pair (ok if not using BACK at all)
     if ((mask & kBacks) != 0) {
         if ((mask & kBacks) != kBacks) {
-            ALOGE("Back channels must be used as a pair");
-            return false;
+            return "Back channels must be used as a pair";
         }
     }
+    return NULL;
+}
+
+static bool Downmix_validChannelMask(uint32_t mask)
+{
+    const char *error = Downmix_foldChannelMaskError(mask);
+    if (error != NULL) {
+        ALOGE("%s", error);
+        return false;
+    }
     return true;
 }
 
@@ -304,6 +310,43 @@ int32_t DownmixLib_GetDescriptor(const effect_uuid_t *uuid, effect_descriptor_t
 #ifndef BUILD_FLOAT
 /*--- Effect Control Interface Implementation ---*/
 
+// float samples are folded by the matrix, as the fold functions are built for 16 bit samples
+static int Downmix_ProcessFloat(downmix_object_t *pDownmixer,
+        const float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    switch (pDownmixer->type) {
+
+      case DOWNMIX_TYPE_STRIP:
+          if (accumulate) {
+              while (numFrames) {
+                  pDst[0] = clamp_float(pDst[0] + pSrc[0]);
+                  pDst[1] = clamp_float(pDst[1] + pSrc[1]);
+                  pSrc += pDownmixer->input_channel_count;
+                  pDst += 2;
+                  numFrames--;
+              }
+          } else {
+              while (numFrames) {
+                  pDst[0] = pSrc[0];
+                  pDst[1] = pSrc[1];
+                  pSrc += pDownmixer->input_channel_count;
+                  pDst += 2;
+                  numFrames--;
+              }
+          }
+          break;
+
+      case DOWNMIX_TYPE_FOLD:
+      case DOWNMIX_TYPE_MATRIX:
+          Downmix_matrixFloat(&pDownmixer->matrix, pSrc, pDst, numFrames, accumulate);
+          break;
+
+      default:
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
 static int Downmix_Process(effect_handle_t self,
         audio_buffer_t *inBuffer, audio_buffer_t *outBuffer) {
 
@@ -339,6 +382,11 @@ static int Downmix_Process(effect_handle_t self,
             (pDwmModule->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
     const uint32_t downmixInputChannelMask = pDwmModule->config.inputCfg.channels;
 
+    if (pDwmModule->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        return Downmix_ProcessFloat(pDownmixer, inBuffer->f32, outBuffer->f32, numFrames,
+                accumulate);
+    }
+
     switch(pDownmixer->type) {
 
       case DOWNMIX_TYPE_STRIP:
@@ -361,6 +409,13 @@ static int Downmix_Process(effect_handle_t self,
           }
           break;
 
+      case DOWNMIX_TYPE_MATRIX:
+        // the channel masks of the fold functions are still folded by them
+        if (!pDownmixer->fold_channel_mask) {
+            Downmix_matrix16(&pDownmixer->matrix, pSrc, pDst, numFrames, accumulate);
+            break;
+        }
+        // fall through
       case DOWNMIX_TYPE_FOLD:
 #ifdef DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER
           // bypass the optimized downmix routines for the common formats
@@ -495,6 +550,10 @@ static int Downmix_Process(effect_handle_t self,
         }
         break;
 
+      case DOWNMIX_TYPE_MATRIX:
+        Downmix_matrixFloat(&pDownmixer->matrix, pSrc, pDst, numFrames, accumulate);
+        break;
+
       default:
         return -EINVAL;
     }
@@ -762,8 +821,9 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
     // Check configuration compatibility with build options, and effect capabilities
     if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate
         || pConfig->outputCfg.channels != DOWNMIX_OUTPUT_CHANNELS
-        || pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
-        || pConfig->outputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        || pConfig->inputCfg.format != pConfig->outputCfg.format
+        || (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
+                && pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT)) {
         ALOGE("Downmix_Configure error: invalid config");
         return -EINVAL;
     }
@@ -777,8 +837,12 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->apply_volume_correction = false;
         pDownmixer->input_channel_count = 8; // matches default input of AUDIO_CHANNEL_OUT_7POINT1
     } else {
-        // when configuring the effect, do not allow a blank or unsupported channel mask
-        if (!Downmix_validChannelMask(pConfig->inputCfg.channels)) {
+        // when configuring the effect, do not allow a blank or unsupported channel mask,
+        // the matrix supports more channel masks than the fold functions
+        const bool validChannelMask = pDownmixer->type == DOWNMIX_TYPE_MATRIX
+                ? Downmix_matrixValidChannelMask(pConfig->inputCfg.channels)
+                : Downmix_validChannelMask(pConfig->inputCfg.channels);
+        if (!validChannelMask) {
             ALOGE("Downmix_Configure error: input channel mask(0x%x) not supported",
                                                         pConfig->inputCfg.channels);
             return -EINVAL;
@@ -786,6 +850,9 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->input_channel_count =
                 audio_channel_count_from_out_mask(pConfig->inputCfg.channels);
     }
+    Downmix_matrixInit(&pDownmixer->matrix, pConfig->inputCfg.channels);
+    pDownmixer->fold_channel_mask =
+            Downmix_foldChannelMaskError(pConfig->inputCfg.channels) == NULL;
 
     Downmix_Reset(pDownmixer, init);
 
@@ -856,7 +923,7 @@ int Downmix_setParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t s
         }
         value16 = *(int16_t *)pValue;
         ALOGV("set DOWNMIX_PARAM_TYPE, type %" PRId16, value16);
-        if (!((value16 > DOWNMIX_TYPE_INVALID) && (value16 <= DOWNMIX_TYPE_LAST))) {
+        if (!((value16 > DOWNMIX_TYPE_INVALID) && (value16 <= DOWNMIX_TYPE_MATRIX))) {
             ALOGE("Downmix_setParameter invalid DOWNMIX_PARAM_TYPE value %" PRId16, value16);
             return -EINVAL;
         } else {
@@ -21,6 +21,8 @@
 #include <audio_utils/primitives.h>
 #include <system/audio.h>
 
+#include "DownmixMatrix.h"
+
 /*------------------------------------
  * definitions
  *------------------------------------
@@ -42,6 +44,8 @@ typedef struct {
     downmix_type_t type;
     bool apply_volume_correction;
     uint8_t input_channel_count;
+    downmix_matrix_t matrix;
+    bool fold_channel_mask; // the fold functions support the input channel mask
 } downmix_object_t;
 
 
@@ -0,0 +1,17 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_VENDOR_MODULE := true
+LOCAL_SRC_FILES:= \
+	downmix_matrix_tests.cpp \
+	../EffectDownmix.c \
+	../DownmixMatrix.c
+LOCAL_CFLAGS += -Wall -Werror
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/.. \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils)
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+LOCAL_HEADER_LIBRARIES += libhardware_headers
+LOCAL_MODULE := downmix_matrix_tests
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the matrix downmix, against the fold functions of the downmix effect.
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <hardware/audio_effect.h>
+
+#include "DownmixMatrix.h"
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+namespace {
+
+constexpr uint32_t k7Point1Point4 = AUDIO_CHANNEL_OUT_7POINT1 |
+        AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT | AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT |
+        AUDIO_CHANNEL_OUT_TOP_BACK_LEFT | AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT;
+
+// the channel masks of the fold functions: the optimized ones, then the generic fold
+constexpr uint32_t kFoldChannelMasks[] = {
+    AUDIO_CHANNEL_OUT_QUAD_BACK,
+    AUDIO_CHANNEL_OUT_QUAD_SIDE,
+    AUDIO_CHANNEL_OUT_5POINT1_BACK,
+    AUDIO_CHANNEL_OUT_5POINT1_SIDE,
+    AUDIO_CHANNEL_OUT_7POINT1,
+    AUDIO_CHANNEL_OUT_STEREO | AUDIO_CHANNEL_OUT_LOW_FREQUENCY | AUDIO_CHANNEL_OUT_BACK_CENTER,
+    AUDIO_CHANNEL_OUT_QUAD_SIDE | AUDIO_CHANNEL_OUT_QUAD_BACK,
+    AUDIO_CHANNEL_OUT_5POINT1_SIDE | AUDIO_CHANNEL_OUT_BACK_CENTER,
+    AUDIO_CHANNEL_OUT_7POINT1 | AUDIO_CHANNEL_OUT_BACK_CENTER,
+};
+
+std::vector<int16_t> noise16(size_t sampleCount) {
+    std::minstd_rand generator(42);
+    std::uniform_int_distribution<int> distribution(INT16_MIN, INT16_MAX);
+    std::vector<int16_t> samples(sampleCount);
+    for (auto &sample : samples) {
+        sample = distribution(generator);
+    }
+    return samples;
+}
+
+std::vector<float> noiseFloat(size_t sampleCount, float amplitude) {
+    std::minstd_rand generator(7);
+    std::uniform_real_distribution<float> distribution(-amplitude, amplitude);
+    std::vector<float> samples(sampleCount);
+    for (auto &sample : samples) {
+        sample = distribution(generator);
+    }
+    return samples;
+}
+
+// The downmix effect as AudioMixer uses it, through the effect interface.
+class DownmixEffect {
+public:
+    DownmixEffect() {
+        const effect_uuid_t uuid =
+                {0x93f04452, 0xe4fe, 0x41cc, 0x91f9, {0xe4, 0x75, 0xb6, 0xd1, 0xd6, 0x9f}};
+        EXPECT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&uuid, 0, 0, &mHandle));
+    }
+    ~DownmixEffect() {
+        AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(mHandle);
+    }
+
+    int setType(downmix_type_t type) {
+        uint32_t param[sizeof(effect_param_t) / sizeof(uint32_t) + 2];
+        effect_param_t *p = (effect_param_t *)param;
+        p->psize = sizeof(int32_t);
+        p->vsize = sizeof(downmix_type_t);
+        *(int32_t *)p->data = DOWNMIX_PARAM_TYPE;
+        *(downmix_type_t *)(p->data + sizeof(int32_t)) = type;
+        return command(EFFECT_CMD_SET_PARAM, sizeof(param), param);
+    }
+
+    int configure(uint32_t channelMask, audio_format_t format, bool accumulate) {
+        effect_config_t config = {};
+        config.inputCfg.samplingRate = config.outputCfg.samplingRate = 48000;
+        config.inputCfg.channels = channelMask;
+        config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+        config.inputCfg.format = config.outputCfg.format = format;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.outputCfg.accessMode =
+                accumulate ? EFFECT_BUFFER_ACCESS_ACCUMULATE : EFFECT_BUFFER_ACCESS_WRITE;
+        config.inputCfg.mask = config.outputCfg.mask = EFFECT_CONFIG_ALL;
+        const int status = command(EFFECT_CMD_SET_CONFIG, sizeof(config), &config);
+        if (status == 0) {
+            command(EFFECT_CMD_ENABLE, 0, nullptr);
+        }
+        return status;
+    }
+
+    int process(const void *in, void *out, size_t frameCount) {
+        audio_buffer_t inBuffer = {}, outBuffer = {};
+        inBuffer.frameCount = outBuffer.frameCount = frameCount;
+        inBuffer.raw = const_cast<void *>(in);
+        outBuffer.raw = out;
+        return (*mHandle)->process(mHandle, &inBuffer, &outBuffer);
+    }
+
+private:
+    int command(uint32_t code, uint32_t size, void *data) {
+        int reply = 0;
+        uint32_t replySize = sizeof(reply);
+        const int status = (*mHandle)->command(mHandle, code, size, data, &replySize, &reply);
+        return status != 0 ? status : reply;
+    }
+
+    effect_handle_t mHandle = nullptr;
+};
+
+template <typename T>
+std::vector<T> downmix(downmix_type_t type, uint32_t channelMask, audio_format_t format,
+                       const std::vector<T> &in, const std::vector<T> &accumulated) {
+    const size_t frameCount = in.size() / audio_channel_count_from_out_mask(channelMask);
+    DownmixEffect effect;
+    EXPECT_EQ(0, effect.setType(type));
+    EXPECT_EQ(0, effect.configure(channelMask, format, !accumulated.empty()));
+    std::vector<T> out = accumulated;
+    out.resize(frameCount * 2);
+    EXPECT_EQ(0, effect.process(in.data(), out.data(), frameCount));
+    return out;
+}
+
+} // namespace
+
+// The matrix is bit exact with the fold functions in 16 bit, with and without accumulation.
+TEST(downmix_matrix_tests, matches_fold_16_bit) {
+    constexpr size_t kFrameCount = 1000;
+    for (uint32_t channelMask : kFoldChannelMasks) {
+        SCOPED_TRACE(testing::Message() << "channel mask " << std::hex << channelMask);
+        const size_t channelCount = audio_channel_count_from_out_mask(channelMask);
+        const std::vector<int16_t> in = noise16(kFrameCount * channelCount);
+        // the effect folds these channel masks with the fold functions, even as DOWNMIX_TYPE_MATRIX
+        downmix_matrix_t matrix;
+        ASSERT_TRUE(Downmix_matrixInit(&matrix, channelMask));
+        for (const auto &accumulated : {std::vector<int16_t>(), noise16(kFrameCount * 2)}) {
+            std::vector<int16_t> out = accumulated;
+            out.resize(kFrameCount * 2);
+            Downmix_matrix16(&matrix, in.data(), out.data(), kFrameCount, !accumulated.empty());
+            EXPECT_EQ(downmix(DOWNMIX_TYPE_FOLD, channelMask, AUDIO_FORMAT_PCM_16_BIT, in,
+                              accumulated),
+                      out);
+        }
+    }
+}
+
+// Float samples are folded as the fold functions do in 16 bit, within their truncation and
+// the precision of their Q19.12 coefficients.
+TEST(downmix_matrix_tests, float_matches_fold_16_bit) {
+    constexpr size_t kFrameCount = 1000;
+    constexpr float kTolerance = 5.f / 32768;
+    for (uint32_t channelMask : kFoldChannelMasks) {
+        SCOPED_TRACE(testing::Message() << "channel mask " << std::hex << channelMask);
+        const size_t channelCount = audio_channel_count_from_out_mask(channelMask);
+        const std::vector<int16_t> in16 = noise16(kFrameCount * channelCount);
+        std::vector<float> in(in16.size());
+        for (size_t i = 0; i < in16.size(); i++) {
+            in[i] = in16[i] / 32768.f;
+        }
+        const std::vector<int16_t> fold =
+                downmix(DOWNMIX_TYPE_FOLD, channelMask, AUDIO_FORMAT_PCM_16_BIT, in16, {});
+        for (downmix_type_t type : {DOWNMIX_TYPE_FOLD, DOWNMIX_TYPE_MATRIX}) {
+            const std::vector<float> out =
+                    downmix(type, channelMask, AUDIO_FORMAT_PCM_FLOAT, in, {});
+            for (size_t i = 0; i < out.size(); i++) {
+                ASSERT_NEAR(fold[i] / 32768.f, out[i], kTolerance) << "sample " << i;
+            }
+        }
+    }
+}
+
+// Compares the matrix to a double precision downmix of the layouts beyond the fold functions.
+TEST(downmix_matrix_tests, matches_reference) {
+    struct Coefficients {
+        uint32_t channel;
+        double left, right;
+    };
+    const double kCenter = sqrt(0.5);
+    const Coefficients coefficients[] = {
+        {AUDIO_CHANNEL_OUT_FRONT_LEFT, 1, 0},
+        {AUDIO_CHANNEL_OUT_FRONT_RIGHT, 0, 1},
+        {AUDIO_CHANNEL_OUT_FRONT_CENTER, kCenter, kCenter},
+        {AUDIO_CHANNEL_OUT_LOW_FREQUENCY, kCenter, kCenter},
+        {AUDIO_CHANNEL_OUT_BACK_LEFT, 1, 0},
+        {AUDIO_CHANNEL_OUT_BACK_RIGHT, 0, 1},
+        {AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER, cos(M_PI / 8), sin(M_PI / 8)},
+        {AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER, sin(M_PI / 8), cos(M_PI / 8)},
+        {AUDIO_CHANNEL_OUT_BACK_CENTER, kCenter, kCenter},
+        {AUDIO_CHANNEL_OUT_SIDE_LEFT, 1, 0},
+        {AUDIO_CHANNEL_OUT_SIDE_RIGHT, 0, 1},
+        {AUDIO_CHANNEL_OUT_TOP_CENTER, kCenter, kCenter},
+        {AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT, 1, 0},
+        {AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER, kCenter, kCenter},
+        {AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT, 0, 1},
+        {AUDIO_CHANNEL_OUT_TOP_BACK_LEFT, 1, 0},
+        {AUDIO_CHANNEL_OUT_TOP_BACK_CENTER, kCenter, kCenter},
+        {AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT, 0, 1},
+    };
+    const uint32_t channelMasks[] = {
+        AUDIO_CHANNEL_OUT_MONO,
+        AUDIO_CHANNEL_OUT_FRONT_CENTER,
+        AUDIO_CHANNEL_OUT_STEREO,
+        AUDIO_CHANNEL_OUT_5POINT1 | AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT |
+                AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT,                         // 5.1.2
+        AUDIO_CHANNEL_OUT_7POINT1 | AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER |
+                AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER,                   // 9.1
+        k7Point1Point4,
+        AUDIO_CHANNEL_OUT_ALL,
+    };
+    constexpr size_t kFrameCount = 1000;
+    for (uint32_t channelMask : channelMasks) {
+        SCOPED_TRACE(testing::Message() << "channel mask " << std::hex << channelMask);
+        downmix_matrix_t matrix;
+        ASSERT_TRUE(Downmix_matrixInit(&matrix, channelMask));
+        const size_t channelCount = audio_channel_count_from_out_mask(channelMask);
+        ASSERT_EQ(channelCount, matrix.channel_count);
+        // small enough not to clamp
+        const std::vector<float> in = noiseFloat(kFrameCount * channelCount, 0.1f);
+        const std::vector<float> accumulated = noiseFloat(kFrameCount * 2, 0.1f);
+        for (bool accumulate : {false, true}) {
+            std::vector<float> out = accumulated;
+            Downmix_matrixFloat(&matrix, in.data(), out.data(), kFrameCount, accumulate);
+            for (size_t frame = 0; frame < kFrameCount; frame++) {
+                double left = accumulate ? accumulated[2 * frame] : 0;
+                double right = accumulate ? accumulated[2 * frame + 1] : 0;
+                size_t channel = 0;
+                for (const auto &c : coefficients) {
+                    if (channelMask & c.channel) {
+                        // a mono channel is both front channels
+                        const double cRight =
+                                channelMask == AUDIO_CHANNEL_OUT_MONO ? c.left : c.right;
+                        left += 0.5 * c.left * in[frame * channelCount + channel];
+                        right += 0.5 * cRight * in[frame * channelCount + channel];
+                        channel++;
+                    }
+                }
+                ASSERT_NEAR(left, out[2 * frame], 1e-6) << "frame " << frame;
+                ASSERT_NEAR(right, out[2 * frame + 1], 1e-6) << "frame " << frame;
+            }
+        }
+    }
+}
+
+// Mono is output on both channels, in 16 bit and float.
+TEST(downmix_matrix_tests, mono) {
+    constexpr size_t kFrameCount = 100;
+    const std::vector<int16_t> in16 = noise16(kFrameCount);
+    const std::vector<int16_t> out16 = downmix(DOWNMIX_TYPE_MATRIX,
+            AUDIO_CHANNEL_OUT_MONO, AUDIO_FORMAT_PCM_16_BIT, in16, {});
+    const std::vector<float> in = noiseFloat(kFrameCount, 1.f);
+    const std::vector<float> out = downmix(DOWNMIX_TYPE_MATRIX,
+            AUDIO_CHANNEL_OUT_MONO, AUDIO_FORMAT_PCM_FLOAT, in, {});
+    for (size_t frame = 0; frame < kFrameCount; frame++) {
+        ASSERT_EQ(in16[frame] >> 1, out16[2 * frame]) << "frame " << frame;
+        ASSERT_EQ(in16[frame] >> 1, out16[2 * frame + 1]) << "frame " << frame;
+        ASSERT_EQ(0.5f * in[frame], out[2 * frame]) << "frame " << frame;
+        ASSERT_EQ(0.5f * in[frame], out[2 * frame + 1]) << "frame " << frame;
+    }
+}
+
+// AudioMixer downmixes in place.
+TEST(downmix_matrix_tests, in_place) {
+    constexpr size_t kFrameCount = 1001;
+    for (uint32_t channelMask : {(uint32_t)AUDIO_CHANNEL_OUT_QUAD, (uint32_t)k7Point1Point4}) {
+        downmix_matrix_t matrix;
+        ASSERT_TRUE(Downmix_matrixInit(&matrix, channelMask));
+        const size_t channelCount = matrix.channel_count;
+        const std::vector<int16_t> in16 = noise16(kFrameCount * channelCount);
+        std::vector<int16_t> out16(kFrameCount * 2), inPlace16 = in16;
+        Downmix_matrix16(&matrix, in16.data(), out16.data(), kFrameCount, false);
+        Downmix_matrix16(&matrix, inPlace16.data(), inPlace16.data(), kFrameCount, false);
+        inPlace16.resize(out16.size());
+        EXPECT_EQ(out16, inPlace16);
+
+        const std::vector<float> in = noiseFloat(kFrameCount * channelCount, 1.f);
+        std::vector<float> out(kFrameCount * 2), inPlace = in;
+        Downmix_matrixFloat(&matrix, in.data(), out.data(), kFrameCount, false);
+        Downmix_matrixFloat(&matrix, inPlace.data(), inPlace.data(), kFrameCount, false);
+        inPlace.resize(out.size());
+        EXPECT_EQ(out, inPlace);
+    }
+}
+
+TEST(downmix_matrix_tests, channel_masks) {
+    downmix_matrix_t matrix;
+    EXPECT_FALSE(Downmix_matrixInit(&matrix, 0));
+    EXPECT_FALSE(Downmix_matrixInit(&matrix, AUDIO_CHANNEL_OUT_ALL + 1));
+    EXPECT_TRUE(Downmix_matrixInit(&matrix, AUDIO_CHANNEL_OUT_ALL));
+
+    // the fold functions do not support the top channels
+    DownmixEffect effect;
+    EXPECT_EQ(0, effect.setType(DOWNMIX_TYPE_FOLD));
+    EXPECT_NE(0, effect.configure(k7Point1Point4, AUDIO_FORMAT_PCM_16_BIT, false));
+    EXPECT_EQ(0, effect.setType(DOWNMIX_TYPE_MATRIX));
+    EXPECT_EQ(0, effect.configure(k7Point1Point4, AUDIO_FORMAT_PCM_16_BIT, false));
+    EXPECT_EQ(0, effect.configure(k7Point1Point4, AUDIO_FORMAT_PCM_FLOAT, false));
+    EXPECT_NE(0, effect.setType((downmix_type_t)(DOWNMIX_TYPE_MATRIX + 1)));
+}
+
+TEST(downmix_matrix_tests, benchmark) {
+    constexpr size_t kFrameCount = 256;
+    constexpr size_t kTotalFrames = 1 << 22;
+    const struct {
+        const char *name;
+        uint32_t channelMask;
+    } layouts[] = {
+        {"5.1", AUDIO_CHANNEL_OUT_5POINT1},
+        {"7.1", AUDIO_CHANNEL_OUT_7POINT1},
+        {"7.1 + BC", AUDIO_CHANNEL_OUT_7POINT1 | AUDIO_CHANNEL_OUT_BACK_CENTER},
+        {"7.1.4", k7Point1Point4},
+    };
+    for (const auto &layout : layouts) {
+        const size_t channelCount = audio_channel_count_from_out_mask(layout.channelMask);
+        const std::vector<int16_t> in16 = noise16(kFrameCount * channelCount);
+        const std::vector<float> in = noiseFloat(kFrameCount * channelCount, 1.f);
+        std::vector<int16_t> out16(kFrameCount * 2);
+        std::vector<float> out(kFrameCount * 2);
+        for (downmix_type_t type : {DOWNMIX_TYPE_FOLD, DOWNMIX_TYPE_MATRIX}) {
+            for (audio_format_t format : {AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT}) {
+                DownmixEffect effect;
+                ASSERT_EQ(0, effect.setType(type));
+                if (effect.configure(layout.channelMask, format, false) != 0) {
+                    continue; // the fold functions do not support 7.1.4
+                }
+                const bool isFloat = format == AUDIO_FORMAT_PCM_FLOAT;
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t frames = 0; frames < kTotalFrames; frames += kFrameCount) {
+                    if (isFloat) {
+                        effect.process(in.data(), out.data(), kFrameCount);
+                    } else {
+                        effect.process(in16.data(), out16.data(), kFrameCount);
+                    }
+                }
+                const std::chrono::duration<double, std::nano> elapsed =
+                        std::chrono::steady_clock::now() - start;
+                printf("%-8s %-6s %-5s: %5.2f ns/frame\n", layout.name,
+                       type == DOWNMIX_TYPE_FOLD ? "fold" : "matrix",
+                       isFloat ? "float" : "16bit", elapsed.count() / kTotalFrames);
+            }
+        }
+    }
+}
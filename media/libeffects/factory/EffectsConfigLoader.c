@@ -156,6 +156,7 @@ int loadLibrary(cnode *root, const char *name)
     list_elem_t *e;
     lib_entry_t *l;
     char path[PATH_MAX];
+    int64_t startNs;
 
     node = config_find(root, PATH_TAG);
     if (node == NULL) {
@@ -167,6 +168,7 @@ int loadLibrary(cnode *root, const char *name)
         goto error;
     }
 
+    startNs = getMonotonicTimeNs();
     hdl = dlopen(path, RTLD_NOW);
     if (hdl == NULL) {
         ALOGW("loadLibrary() failed to open %s", path);
@@ -197,6 +199,9 @@ int loadLibrary(cnode *root, const char *name)
     l->handle = hdl;
     l->desc = desc;
     l->effects = NULL;
+    l->loadTimeNs = getMonotonicTimeNs() - startNs;
+    l->initTimeNs = l->loadTimeNs;
+    l->cachedDescriptors = 0;
     pthread_mutex_init(&l->lock, NULL);
 
     e = malloc(sizeof(list_elem_t));
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectsFactoryDescriptorCache"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <log/log.h>
+
+#include "EffectsDescriptorCache.h"
+
+namespace android {
+
+constexpr uint32_t DescriptorCache::kMagic;
+constexpr uint32_t DescriptorCache::kVersion;
+
+std::string DescriptorCache::getBuildFingerprint() {
+    char fingerprint[PROPERTY_VALUE_MAX];
+    if (property_get("ro.vendor.build.fingerprint", fingerprint, "") == 0) {
+        property_get("ro.build.fingerprint", fingerprint, "");
+    }
+    return fingerprint;
+}
+
+void DescriptorCache::read(const char* cacheFile) {
+    FILE* file = fopen(cacheFile, "re");
+    if (file == nullptr) {
+        ALOGV("No effect descriptor cache %s", cacheFile);
+        return;
+    }
+    uint32_t header[4];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != kMagic ||
+            header[1] != kVersion || header[2] != sizeof(effect_descriptor_t)) {
+        ALOGW("Ignoring effect descriptor cache %s of another version", cacheFile);
+        fclose(file);
+        return;
+    }
+    // The libraries of another build may have the same size and modification time, for
+    // instance when the build sets them.
+    std::string fingerprint(header[3] <= PROPERTY_VALUE_MAX ? header[3] : 0, '\0');
+    if (header[3] > PROPERTY_VALUE_MAX ||
+            (header[3] > 0 && fread(&fingerprint[0], header[3], 1, file) != 1) ||
+            fingerprint != mFingerprint) {
+        ALOGI("Ignoring effect descriptor cache %s of another build", cacheFile);
+        fclose(file);
+        return;
+    }
+    std::map<std::string, Library> libraries;
+    uint32_t pathLength;
+    while (fread(&pathLength, sizeof(pathLength), 1, file) == 1) {
+        std::string path(pathLength <= PATH_MAX ? pathLength : 0, '\0');
+        Library library;
+        uint32_t count;
+        if (pathLength == 0 || pathLength > PATH_MAX ||
+                fread(&path[0], pathLength, 1, file) != 1 ||
+                fread(&library.size, sizeof(library.size), 1, file) != 1 ||
+                fread(&library.mtimeNs, sizeof(library.mtimeNs), 1, file) != 1 ||
+                fread(&count, sizeof(count), 1, file) != 1 || count > 1024) {
+            ALOGE("Corrupted effect descriptor cache %s", cacheFile);
+            fclose(file);
+            return;
+        }
+        library.descriptors.resize(count);
+        if (count > 0 &&
+                fread(library.descriptors.data(), sizeof(Descriptor), count, file) != count) {
+            ALOGE("Corrupted effect descriptor cache %s", cacheFile);
+            fclose(file);
+            return;
+        }
+        libraries[path] = std::move(library);
+    }
+    fclose(file);
+    mLibraries = std::move(libraries);
+}
+
+void DescriptorCache::write(const char* cacheFile) const {
+    bool modified = mModified;
+    for (auto& library : mLibraries) {
+        modified = modified || !library.second.used;
+    }
+    if (!modified) {
+        return;
+    }
+    // Written aside and renamed so that a partially written cache is never read.
+    std::string tmpFile = std::string(cacheFile) + ".tmp";
+    FILE* file = fopen(tmpFile.c_str(), "we");
+    if (file == nullptr) {
+        ALOGW("Could not write the effect descriptor cache %s: %s", cacheFile, strerror(errno));
+        return;
+    }
+    const uint32_t header[4] = {kMagic, kVersion, sizeof(effect_descriptor_t),
+                                (uint32_t)mFingerprint.size()};
+    bool written = fwrite(header, sizeof(header), 1, file) == 1 &&
+            (mFingerprint.empty() ||
+             fwrite(mFingerprint.data(), mFingerprint.size(), 1, file) == 1);
+    for (auto& entry : mLibraries) {
+        const Library& library = entry.second;
+        if (!library.used) {
+            continue;
+        }
+        uint32_t pathLength = entry.first.size();
+        uint32_t count = library.descriptors.size();
+        written = written &&
+                fwrite(&pathLength, sizeof(pathLength), 1, file) == 1 &&
+                fwrite(entry.first.data(), pathLength, 1, file) == 1 &&
+                fwrite(&library.size, sizeof(library.size), 1, file) == 1 &&
+                fwrite(&library.mtimeNs, sizeof(library.mtimeNs), 1, file) == 1 &&
+                fwrite(&count, sizeof(count), 1, file) == 1 &&
+                fwrite(library.descriptors.data(), sizeof(Descriptor), count, file) == count;
+    }
+    written = fclose(file) == 0 && written;
+    if (!written || rename(tmpFile.c_str(), cacheFile) != 0) {
+        ALOGW("Could not write the effect descriptor cache %s: %s", cacheFile, strerror(errno));
+        unlink(tmpFile.c_str());
+        return;
+    }
+    ALOGV("Wrote the effect descriptor cache %s", cacheFile);
+}
+
+bool DescriptorCache::checkLibrary(const char* libraryPath) {
+    struct stat st;
+    if (stat(libraryPath, &st) != 0) {
+        return false;
+    }
+    int64_t mtimeNs = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    Library& library = mLibraries[libraryPath];
+    library.used = true;
+    if (library.size != st.st_size || library.mtimeNs != mtimeNs) {
+        library = Library{};
+        library.size = st.st_size;
+        library.mtimeNs = mtimeNs;
+        library.used = true;
+        mModified = true;
+        return false;
+    }
+    library.valid = true;
+    return true;
+}
+
+bool DescriptorCache::find(const char* libraryPath, const effect_uuid_t& uuid,
+                           effect_descriptor_t* desc) {
+    auto library = mLibraries.find(libraryPath);
+    if (library == mLibraries.end() || !library->second.valid) {
+        return false;
+    }
+    for (auto& descriptor : library->second.descriptors) {
+        if (memcmp(&descriptor.uuid, &uuid, sizeof(effect_uuid_t)) == 0) {
+            *desc = descriptor.desc;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DescriptorCache::add(const char* libraryPath, const effect_uuid_t& uuid,
+                          const effect_descriptor_t& desc) {
+    auto library = mLibraries.find(libraryPath);
+    if (library == mLibraries.end() || library->second.size < 0) {
+        return;
+    }
+    library->second.descriptors.push_back({uuid, desc});
+    mModified = true;
+}
+
+} // namespace android
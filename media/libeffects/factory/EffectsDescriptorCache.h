@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECTSDESCRIPTORCACHE_H
+#define ANDROID_EFFECTSDESCRIPTORCACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <hardware/audio_effect.h>
+
+namespace android {
+
+/** Descriptors of the effects of each library, persisted so that a library is only opened
+ * when one of its effects is created. The descriptors of a library are valid as long as the
+ * build does not change, and the size and modification time of its file do not change.
+ */
+class DescriptorCache {
+public:
+    /** @param fingerprint of the build, the cache of another build is ignored. */
+    explicit DescriptorCache(const std::string& fingerprint) : mFingerprint(fingerprint) {}
+
+    /** @return the fingerprint of the vendor build, or of the build if not set. */
+    static std::string getBuildFingerprint();
+
+    /** Reads the cache file. A missing, corrupted or outdated file is an empty cache. */
+    void read(const char* cacheFile);
+
+    /** Writes the descriptors of the libraries of this configuration, if they changed. */
+    void write(const char* cacheFile) const;
+
+    /** Must be called for each library of the configuration before the other methods.
+     * @return true if the descriptors of the library can be read from the cache.
+     */
+    bool checkLibrary(const char* libraryPath);
+
+    bool find(const char* libraryPath, const effect_uuid_t& uuid, effect_descriptor_t* desc);
+    void add(const char* libraryPath, const effect_uuid_t& uuid, const effect_descriptor_t& desc);
+
+private:
+    static constexpr uint32_t kMagic = 0x43444645; // "EFDC"
+    static constexpr uint32_t kVersion = 2;
+
+    struct Descriptor {
+        effect_uuid_t uuid; /**< uuid queried, different from desc.uuid for proxies. */
+        effect_descriptor_t desc;
+    };
+    struct Library {
+        int64_t size = -1;
+        int64_t mtimeNs = -1;
+        bool valid = false; /**< read from the cache, and the file did not change. */
+        bool used = false; /**< library of the current configuration. */
+        std::vector<Descriptor> descriptors;
+    };
+
+    const std::string mFingerprint;
+    std::map<std::string, Library> mLibraries;
+    bool mModified = false;
+};
+
+} // namespace android
+
+#endif // ANDROID_EFFECTSDESCRIPTORCACHE_H
@@ -17,6 +17,9 @@
 #define LOG_TAG "EffectsFactory"
 //#define LOG_NDEBUG 0
 
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -44,6 +47,7 @@ static uint32_t gCurEffectIdx;       // current effect index in enumeration proc
 static ssize_t gConfigNbElemSkipped = -2;
 
 static int gInitDone; // true is global initialization has been preformed
+static list_elem_t *gPreloadLib; // next library to open in the background, protected by gLibLock
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
                           // was not modified since last call to EffectQueryNumberEffects()
 /////////////////////////////////////////////////
@@ -57,6 +61,9 @@ static uint32_t updateNumEffects();
 static int findSubEffect(const effect_uuid_t *uuid,
                lib_entry_t **lib,
                effect_descriptor_t **desc);
+static int loadSubEffectLibraries(const effect_uuid_t *uuid);
+static void startPreloadThreads();
+static void *preloadLibraries(void *arg);
 
 /////////////////////////////////////////////////
 //      Effect Control Interface functions
@@ -292,6 +299,17 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    // the library of a lazily loaded effect, and the libraries of the sub effects of a proxy,
+    // are opened on first creation
+    ret = loadEffectLibrary(l);
+    if (ret == 0) {
+        ret = loadSubEffectLibraries(uuid);
+    }
+    if (ret != 0) {
+        ALOGW("EffectCreate() could not open library %s for fx %s", l->name, d->name);
+        goto exit;
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -442,7 +460,9 @@ int init() {
     if (ignoreFxConfFiles) {
         ALOGI("Audio effects in configuration files will be ignored");
     } else {
-        gConfigNbElemSkipped = EffectLoadXmlEffectConfig(NULL);
+        const bool lazyEffects = property_get_bool(PROPERTY_LAZY_EFFECTS, true);
+        gConfigNbElemSkipped = EffectLoadXmlEffectConfigWithCache(
+                NULL, lazyEffects ? EFFECTS_DESCRIPTOR_CACHE_FILE : NULL);
         if (gConfigNbElemSkipped < 0) {
             ALOGW("Failed to load XML effect configuration, fallback to .conf");
             EffectLoadEffectConfig();
@@ -454,9 +474,103 @@ int init() {
     updateNumEffects();
     gInitDone = 1;
     ALOGV("init() done");
+    startPreloadThreads();
     return 0;
 }
 
+// Opens the libraries of the sub effects of the proxy with the specified uuid, if any.
+// Must be called with gLibLock held.
+int loadSubEffectLibraries(const effect_uuid_t *uuid)
+{
+    list_sub_elem_t *e;
+    list_elem_t *subefx;
+
+    for (e = gSubEffectList; e != NULL; e = e->next) {
+        if (memcmp(uuid, &((effect_descriptor_t *)e->object)->uuid, sizeof(effect_uuid_t)) != 0) {
+            continue;
+        }
+        for (subefx = e->sub_elem; subefx != NULL; subefx = subefx->next) {
+            lib_entry_t *l = (lib_entry_t *)((sub_effect_entry_t *)subefx->object)->lib;
+            if (loadEffectLibrary(l) != 0) {
+                return -ENODEV;
+            }
+        }
+        break;
+    }
+    return 0;
+}
+
+// Libraries not opened during init() because their descriptors were cached are opened by
+// background threads, so that the first creation of an effect does not pay for it.
+void startPreloadThreads()
+{
+    int32_t nbThreads = property_get_int32(PROPERTY_PRELOAD_EFFECTS_THREADS,
+                                           DEFAULT_PRELOAD_EFFECTS_THREADS);
+    pthread_attr_t attr;
+    pthread_t thread;
+    int32_t i;
+
+    pthread_mutex_lock(&gLibLock);
+    gPreloadLib = gLibraryList;
+    pthread_mutex_unlock(&gLibLock);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < nbThreads; i++) {
+        if (pthread_create(&thread, &attr, preloadLibraries, NULL) != 0) {
+            ALOGW("startPreloadThreads() could not start preload thread %d", i);
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void *preloadLibraries(void *arg __unused)
+{
+    for (;;) {
+        lib_entry_t *l = NULL;
+
+        pthread_mutex_lock(&gLibLock);
+        while (gPreloadLib != NULL && l == NULL) {
+            l = (lib_entry_t *)gPreloadLib->object;
+            gPreloadLib = gPreloadLib->next;
+            if (l->handle != NULL) {
+                l = NULL;
+            }
+        }
+        pthread_mutex_unlock(&gLibLock);
+        if (l == NULL) {
+            break;
+        }
+
+        // dlopen() can be long and must not block the effect creations
+        void *handle;
+        audio_effect_library_t *desc;
+        int64_t startNs = getMonotonicTimeNs();
+        if (openEffectLibrary(l->path, &handle, &desc) != 0) {
+            continue;
+        }
+        int64_t loadTimeNs = getMonotonicTimeNs() - startNs;
+
+        pthread_mutex_lock(&gLibLock);
+        if (l->handle == NULL) {
+            l->handle = handle;
+            l->desc = desc;
+            l->loadTimeNs = loadTimeNs;
+            handle = NULL;
+        }
+        pthread_mutex_unlock(&gLibLock);
+        if (handle != NULL) {
+            // opened meanwhile by EffectCreate(), only drop our reference
+            dlclose(handle);
+        } else {
+            ALOGV("preloadLibraries() opened library %s in %" PRId64 " us",
+                  l->name, loadTimeNs / 1000);
+        }
+    }
+    return NULL;
+}
+
 // Searches the sub effect matching to the specified uuid
 // in the gSubEffectList. It gets the lib_entry_t for
 // the matched sub_effect . Used in EffectCreate of sub effects
@@ -559,8 +673,21 @@ int EffectDumpEffects(int fd) {
     while (e) {
         l = (lib_entry_t *)e->object;
         list_elem_t *efx = l->effects;
+        // the library may be opened meanwhile by a preload thread or EffectCreate(), and the
+        // lock is not held while writing to fd
+        pthread_mutex_lock(&gLibLock);
+        const bool opened = l->handle != NULL;
+        const int64_t loadTimeNs = l->loadTimeNs;
+        pthread_mutex_unlock(&gLibLock);
         dprintf(fd, " Library %s\n", l->name);
         dprintf(fd, "  path: %s\n", l->path);
+        dprintf(fd, "  init time: %" PRId64 " us%s\n", l->initTimeNs / 1000,
+                l->cachedDescriptors > 0 ? " (descriptors from cache)" : "");
+        if (opened) {
+            dprintf(fd, "  load time: %" PRId64 " us\n", loadTimeNs / 1000);
+        } else {
+            dprintf(fd, "  (not opened yet)\n");
+        }
         if (!efx) {
             dprintf(fd, "  (no effects)\n");
         }
@@ -28,6 +28,21 @@ extern "C" {
 #endif
 
 #define PROPERTY_IGNORE_EFFECTS "ro.audio.ignore_effects"
+// Open the libraries of the XML configuration only when one of their effects is created,
+// their effect descriptors being read from EFFECTS_DESCRIPTOR_CACHE_FILE. Defaults to true.
+#define PROPERTY_LAZY_EFFECTS "ro.audio.lazy_effects"
+// Number of threads opening the libraries not opened at init, 0 to wait for their first use.
+#define PROPERTY_PRELOAD_EFFECTS_THREADS "ro.audio.preload_effects_threads"
+#define DEFAULT_PRELOAD_EFFECTS_THREADS 2
+
+// The cache is invalidated when the build fingerprint changes. Its directory is not created by
+// the factory: devices enabling PROPERTY_LAZY_EFFECTS must create it in the init.rc of the
+// process hosting the effects, for instance the audio HAL service:
+//     on post-fs-data
+//         mkdir /data/vendor/audio 0770 audioserver audio
+// with a sepolicy label letting that process create, write and rename files in it.
+// Without it, all the libraries are opened at init as if the cache was disabled.
+#define EFFECTS_DESCRIPTOR_CACHE_FILE "/data/vendor/audio/effects_descriptors.cache"
 
 typedef struct list_elem_s {
     void *object;
@@ -43,6 +58,7 @@ typedef struct list_sub_elem_s {
     struct list_sub_elem_s *next;
 } list_sub_elem_t;
 
+// handle and desc are NULL until the library is opened, see loadEffectLibrary().
 typedef struct lib_entry_s {
     audio_effect_library_t *desc;
     char *name;
@@ -50,6 +66,9 @@ typedef struct lib_entry_s {
     void *handle;
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
+    int64_t initTimeNs; // time spent on the library by the factory initialization
+    int64_t loadTimeNs; // time spent opening the library, whenever it was opened
+    int cachedDescriptors; // number of descriptors read from the cache instead of the library
 } lib_entry_t;
 
 typedef struct effect_entry_s {
@@ -16,6 +16,10 @@
 
 #define LOG_TAG "EffectsFactoryState"
 
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <time.h>
+
 #include "EffectsFactoryState.h"
 
 #include "log/log.h"
@@ -136,3 +140,62 @@ void dumpEffectDescriptor(effect_descriptor_t *desc, char *str, size_t len, int
             desc->apiVersion, idt, desc->flags);
     strlcat(str, s, len);
 }
+
+int64_t getMonotonicTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int openEffectLibrary(const char *path, void **handle, audio_effect_library_t **desc)
+{
+    void *hdl = dlopen(path, RTLD_NOW);
+    if (hdl == NULL) {
+        ALOGE("Could not dlopen library %s: %s", path, dlerror());
+        return -EINVAL;
+    }
+
+    audio_effect_library_t *description =
+            (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+    if (description == NULL) {
+        ALOGE("Invalid effect library, failed not find symbol '%s' in %s: %s",
+              AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR, path, dlerror());
+        dlclose(hdl);
+        return -EINVAL;
+    }
+
+    if (description->tag != AUDIO_EFFECT_LIBRARY_TAG) {
+        ALOGE("Bad tag %#08x in description structure, expected %#08x for library %s",
+              description->tag, AUDIO_EFFECT_LIBRARY_TAG, path);
+        dlclose(hdl);
+        return -EINVAL;
+    }
+
+    uint32_t majorVersion = EFFECT_API_VERSION_MAJOR(description->version);
+    uint32_t expectedMajorVersion = EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION);
+    if (majorVersion != expectedMajorVersion) {
+        ALOGE("Unsupported major version %#08x, expected %#08x for library %s",
+              majorVersion, expectedMajorVersion, path);
+        dlclose(hdl);
+        return -EINVAL;
+    }
+
+    *handle = hdl;
+    *desc = description;
+    return 0;
+}
+
+int loadEffectLibrary(lib_entry_t *lib)
+{
+    if (lib->handle != NULL) {
+        return 0;
+    }
+    int64_t startNs = getMonotonicTimeNs();
+    if (openEffectLibrary(lib->path, &lib->handle, &lib->desc) != 0) {
+        return -ENODEV;
+    }
+    lib->loadTimeNs = getMonotonicTimeNs() - startNs;
+    ALOGV("loadEffectLibrary() opened %s on first use in %" PRId64 " ns",
+          lib->name, lib->loadTimeNs);
+    return 0;
+}
@@ -53,6 +53,20 @@ int uuidToString(const effect_uuid_t *uuid, char *str, size_t maxLen);
 /** Used for debuging. */
 void dumpEffectDescriptor(effect_descriptor_t *desc, char *str, size_t len, int indent);
 
+/** @return the time of CLOCK_MONOTONIC in nanoseconds, to measure the loading of libraries. */
+int64_t getMonotonicTimeNs();
+
+/** Opens an effect library and checks its version.
+ * @return 0 with handle and desc set on success, -EINVAL if the library is not usable.
+ */
+int openEffectLibrary(const char *path, void **handle, audio_effect_library_t **desc);
+
+/** Opens a library whose effect descriptors were read from the cache, if not already done.
+ *  Must be called with gLibLock held.
+ * @return 0 if the library is open, -ENODEV if it could not be opened.
+ */
+int loadEffectLibrary(lib_entry_t *lib);
+
 #if __cplusplus
 } // extern "C"
 #endif
@@ -18,15 +18,19 @@
 //#define LOG_NDEBUG 0
 
 #include <dlfcn.h>
+#include <memory>
 #include <set>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <unistd.h>
 
 #include <log/log.h>
 
 #include <media/EffectsConfig.h>
 
 #include "EffectsConfigLoader.h"
+#include "EffectsDescriptorCache.h"
 #include "EffectsFactoryState.h"
 #include "EffectsXmlConfigLoader.h"
 
@@ -56,11 +60,13 @@ bool resolveLibrary(const std::string& path, std::string* resolvedPath) {
 }
 
 /** Loads a library given its relative path and stores the result in libEntry.
- * @return true on success with libEntry's path, handle and desc filled
+ * The library is not opened if the descriptors of its effects are cached.
+ * @return true on success with libEntry's path filled, and handle and desc if it was opened
  *         false on success with libEntry's path filled with the path of the failed lib
  * The caller MUST free the resources path (free) and handle (dlclose) if filled.
  */
-bool loadLibrary(const char* relativePath, lib_entry_t* libEntry) noexcept {
+bool loadLibrary(const char* relativePath, lib_entry_t* libEntry,
+                 DescriptorCache* cache) noexcept {
 
     std::string absolutePath;
     if (!resolveLibrary(relativePath, &absolutePath)) {
@@ -71,38 +77,15 @@ bool loadLibrary(const char* relativePath, lib_entry_t* libEntry) noexcept {
     const char* path = absolutePath.c_str();
     libEntry->path = strdup(path);
 
-    // Make sure the lib is closed on early return
-    std::unique_ptr<void, decltype(dlclose)*> libHandle(dlopen(path, RTLD_NOW),
-                                                       dlclose);
-    if (libHandle == nullptr) {
-        ALOGE("Could not dlopen library %s: %s", path, dlerror());
-        return false;
-    }
-
-    auto* description = static_cast<audio_effect_library_t*>(
-          dlsym(libHandle.get(), AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR));
-    if (description == nullptr) {
-        ALOGE("Invalid effect library, failed not find symbol '%s' in %s: %s",
-              AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR, path, dlerror());
-        return false;
-    }
-
-    if (description->tag != AUDIO_EFFECT_LIBRARY_TAG) {
-        ALOGE("Bad tag %#08x in description structure, expected %#08x for library %s",
-              description->tag, AUDIO_EFFECT_LIBRARY_TAG, path);
-        return false;
+    if (cache != nullptr && cache->checkLibrary(path)) {
+        ALOGV("Library %s will be opened on first use", path);
+        return true;
     }
-
-    uint32_t majorVersion = EFFECT_API_VERSION_MAJOR(description->version);
-    uint32_t expectedMajorVersion = EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION);
-    if (majorVersion != expectedMajorVersion) {
-        ALOGE("Unsupported major version %#08x, expected %#08x for library %s",
-              majorVersion, expectedMajorVersion, path);
+    int64_t startNs = getMonotonicTimeNs();
+    if (openEffectLibrary(path, &libEntry->handle, &libEntry->desc) != 0) {
         return false;
     }
-
-    libEntry->handle = libHandle.release();
-    libEntry->desc = description;
+    libEntry->loadTimeNs = getMonotonicTimeNs() - startNs;
     return true;
 }
 
@@ -151,10 +134,11 @@ void listPush(UniqueCPtr<T>&& object, ListElem** list, pthread_mutex_t* mutex =
 
 size_t loadLibraries(const effectsConfig::Libraries& libs,
                      list_elem_t** libList, pthread_mutex_t* libListLock,
-                     list_elem_t** libFailedList)
+                     list_elem_t** libFailedList, DescriptorCache* cache)
 {
     size_t nbSkippedElement = 0;
     for (auto& library : libs) {
+        int64_t startNs = getMonotonicTimeNs();
 
         // Construct a lib entry
         auto libEntry = makeUniqueC<lib_entry_t>();
@@ -162,7 +146,9 @@ size_t loadLibraries(const effectsConfig::Libraries& libs,
         libEntry->effects = nullptr;
         pthread_mutex_init(&libEntry->lock, nullptr);
 
-        if (!loadLibrary(library.path.c_str(), libEntry.get())) {
+        bool loaded = loadLibrary(library.path.c_str(), libEntry.get(), cache);
+        libEntry->initTimeNs = getMonotonicTimeNs() - startNs;
+        if (!loaded) {
             // Register library load failure
             listPush(std::move(libEntry), libFailedList);
             ++nbSkippedElement;
@@ -210,8 +196,9 @@ struct LoadEffectResult {
 };
 
 LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
-                            list_elem_t* libList) {
+                            list_elem_t* libList, DescriptorCache* cache) {
     LoadEffectResult result;
+    int64_t startNs = getMonotonicTimeNs();
 
     // Find the effect library
     result.lib = findLibrary(effect.library->name.c_str(), libList);
@@ -223,13 +210,28 @@ LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
 
     result.effectDesc = makeUniqueC<effect_descriptor_t>();
 
-    // Get the effect descriptor
-    if (result.lib->desc->get_descriptor(&effect.uuid, result.effectDesc.get()) != 0) {
-        ALOGE("Error querying effect %s on lib %s",
-              uuidToString(effect.uuid), result.lib->name);
-        result.effectDesc.reset();
-        return result;
+    // Get the effect descriptor, from the cache as long as the library is not opened
+    if (cache != nullptr && result.lib->handle == nullptr &&
+            cache->find(result.lib->path, effect.uuid, result.effectDesc.get())) {
+        result.lib->cachedDescriptors++;
+    } else {
+        if (loadEffectLibrary(result.lib) != 0) {
+            ALOGE("Could not open lib %s to query effect %s",
+                  result.lib->name, uuidToString(effect.uuid));
+            result.effectDesc.reset();
+            return result;
+        }
+        if (result.lib->desc->get_descriptor(&effect.uuid, result.effectDesc.get()) != 0) {
+            ALOGE("Error querying effect %s on lib %s",
+                  uuidToString(effect.uuid), result.lib->name);
+            result.effectDesc.reset();
+            return result;
+        }
+        if (cache != nullptr) {
+            cache->add(result.lib->path, effect.uuid, *result.effectDesc);
+        }
     }
+    result.lib->initTimeNs += getMonotonicTimeNs() - startNs;
 
     // Dump effect for debug
 #if (LOG_NDEBUG==0)
@@ -257,12 +259,12 @@ LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
 }
 
 size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** skippedEffects,
-                   list_sub_elem_t** subEffectList) {
+                   list_sub_elem_t** subEffectList, DescriptorCache* cache) {
     size_t nbSkippedElement = 0;
 
     for (auto& effect : effects) {
 
-        auto effectLoadResult = loadEffect(effect, effect.name, libList);
+        auto effectLoadResult = loadEffect(effect, effect.name, libList, cache);
         if (!effectLoadResult.success) {
             if (effectLoadResult.effectDesc != nullptr) {
                 listPush(std::move(effectLoadResult.effectDesc), skippedEffects);
@@ -272,8 +274,10 @@ size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** s
         }
 
         if (effect.isProxy) {
-            auto swEffectLoadResult = loadEffect(effect.libSw, effect.name + " libsw", libList);
-            auto hwEffectLoadResult = loadEffect(effect.libHw, effect.name + " libhw", libList);
+            auto swEffectLoadResult = loadEffect(effect.libSw, effect.name + " libsw", libList,
+                                                 cache);
+            auto hwEffectLoadResult = loadEffect(effect.libHw, effect.name + " libhw", libList,
+                                                 cache);
             if (!swEffectLoadResult.success || !hwEffectLoadResult.success) {
                 // Push the main effect in the skipped list even if only a subeffect is invalid
                 // as the main effect is not usable without its subeffects.
@@ -314,21 +318,45 @@ size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** s
 /////////////////////////////////////////////////
 
 extern "C" ssize_t EffectLoadXmlEffectConfig(const char* path)
+{
+    return EffectLoadXmlEffectConfigWithCache(path, nullptr);
+}
+
+extern "C" ssize_t EffectLoadXmlEffectConfigWithCache(const char* path, const char* cacheFile)
 {
     using effectsConfig::parse;
+    int64_t startNs = getMonotonicTimeNs();
     auto result = path ? parse(path) : parse();
     if (result.parsedConfig == nullptr) {
         ALOGE("Failed to parse XML configuration file");
         return -1;
     }
+    std::unique_ptr<DescriptorCache> cache;
+    if (cacheFile != nullptr) {
+        cache.reset(new DescriptorCache(DescriptorCache::getBuildFingerprint()));
+        cache->read(cacheFile);
+    }
     result.nbSkippedElement += loadLibraries(result.parsedConfig->libraries,
-                                             &gLibraryList, &gLibLock, &gLibraryFailedList) +
+                                             &gLibraryList, &gLibLock, &gLibraryFailedList,
+                                             cache.get()) +
                                loadEffects(result.parsedConfig->effects, gLibraryList,
-                                           &gSkippedEffects, &gSubEffectList);
+                                           &gSkippedEffects, &gSubEffectList, cache.get());
+    if (cache != nullptr) {
+        cache->write(cacheFile);
+    }
 
     ALOGE_IF(result.nbSkippedElement != 0, "%zu errors during loading of configuration: %s",
              result.nbSkippedElement, path ?: effectsConfig::DEFAULT_PATH);
 
+    size_t nbLibraries = 0;
+    size_t nbOpenedLibraries = 0;
+    for (list_elem_t* e = gLibraryList; e != nullptr; e = e->next) {
+        nbLibraries++;
+        nbOpenedLibraries += static_cast<lib_entry_t*>(e->object)->handle != nullptr;
+    }
+    ALOGI("Loaded effect configuration in %.3f ms, opened %zu of %zu libraries",
+          (getMonotonicTimeNs() - startNs) / 1e6, nbOpenedLibraries, nbLibraries);
+
     return result.nbSkippedElement;
 }
 
@@ -37,6 +37,13 @@ extern "C" {
 ANDROID_API
 ssize_t EffectLoadXmlEffectConfig(const char* path);
 
+/** Same as EffectLoadXmlEffectConfig, but with the effect descriptors persisted in cacheFile.
+ * Libraries whose descriptors are all in the cache are not opened, see loadEffectLibrary.
+ * @param[in] cacheFile path of the descriptor cache or NULL to open all libraries
+ */
+ANDROID_API
+ssize_t EffectLoadXmlEffectConfigWithCache(const char* path, const char* cacheFile);
+
 #if __cplusplus
 } // extern "C"
 #endif
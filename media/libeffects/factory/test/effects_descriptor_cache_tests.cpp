@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <media/EffectsConfig.h>
+
+#include "EffectsDescriptorCache.h"
+#include "EffectsFactoryState.h"
+#include "EffectsXmlConfigLoader.h"
+
+using namespace android;
+
+namespace {
+
+// uuid of the downmix effect, in libdownmix.so
+const effect_uuid_t kDownmixUuid =
+        {0x93f04452, 0xe4fe, 0x41cc, 0x91f9, {0xe4, 0x75, 0xb6, 0xd1, 0xd6, 0x9f}};
+
+const char* kFingerprint = "vendor/device/device:O/OPR1.170623.001/1:userdebug/test-keys";
+
+bool writeFile(const std::string& path, const std::string& content) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = content.empty() || fwrite(content.data(), content.size(), 1, file) == 1;
+    return fclose(file) == 0 && written;
+}
+
+std::string readFile(const std::string& path) {
+    std::string content;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file != nullptr) {
+        char buffer[256];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            content.append(buffer, size);
+        }
+        fclose(file);
+    }
+    return content;
+}
+
+class TemporaryDirectoryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const char* tmpDir = getenv("TMPDIR");
+        std::string pattern = std::string(tmpDir != nullptr ? tmpDir : "/data/local/tmp") +
+                "/effects_cache_XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(&pattern[0]));
+        mDirectory = pattern;
+    }
+
+    void TearDown() override {
+        for (auto& file : mFiles) {
+            unlink(file.c_str());
+        }
+        rmdir(mDirectory.c_str());
+    }
+
+    std::string getPath(const char* name) {
+        mFiles.push_back(mDirectory + '/' + name);
+        return mFiles.back();
+    }
+
+    std::string mDirectory;
+    std::vector<std::string> mFiles;
+};
+
+class DescriptorCacheTest : public TemporaryDirectoryTest {
+protected:
+    void SetUp() override {
+        TemporaryDirectoryTest::SetUp();
+        mLibrary = getPath("libeffect.so");
+        mCacheFile = getPath("effects_descriptors.cache");
+        getPath("effects_descriptors.cache.tmp");
+        ASSERT_TRUE(writeFile(mLibrary, "not an actual library"));
+
+        memset(&mDescriptor, 0, sizeof(mDescriptor));
+        mDescriptor.uuid = kDownmixUuid;
+        strcpy(mDescriptor.name, "Multichannel Downmix To Stereo");
+
+        // a first boot: nothing cached, the descriptors are read from the library
+        DescriptorCache cache(kFingerprint);
+        cache.read(mCacheFile.c_str());
+        ASSERT_FALSE(cache.checkLibrary(mLibrary.c_str()));
+        effect_descriptor_t desc;
+        ASSERT_FALSE(cache.find(mLibrary.c_str(), kDownmixUuid, &desc));
+        cache.add(mLibrary.c_str(), kDownmixUuid, mDescriptor);
+        cache.write(mCacheFile.c_str());
+    }
+
+    // Reads the cache of the first boot, as the next boot of the build with fingerprint does.
+    bool isCached(const char* fingerprint = kFingerprint) {
+        DescriptorCache cache(fingerprint);
+        cache.read(mCacheFile.c_str());
+        effect_descriptor_t desc;
+        if (!cache.checkLibrary(mLibrary.c_str()) ||
+                !cache.find(mLibrary.c_str(), kDownmixUuid, &desc)) {
+            return false;
+        }
+        EXPECT_EQ(0, memcmp(&mDescriptor, &desc, sizeof(desc)));
+        return true;
+    }
+
+    std::string mLibrary;
+    std::string mCacheFile;
+    effect_descriptor_t mDescriptor;
+};
+
+TEST_F(DescriptorCacheTest, hit) {
+    EXPECT_TRUE(isCached());
+    // and still after a boot that only read it
+    EXPECT_TRUE(isCached());
+}
+
+TEST_F(DescriptorCacheTest, missWhenLibraryChanges) {
+    ASSERT_TRUE(writeFile(mLibrary, "another library"));
+    EXPECT_FALSE(isCached());
+}
+
+TEST_F(DescriptorCacheTest, missOnAnotherBuild) {
+    EXPECT_FALSE(isCached("vendor/device/device:O/OPR1.170623.002/2:userdebug/test-keys"));
+    EXPECT_FALSE(isCached(""));
+}
+
+TEST_F(DescriptorCacheTest, missWhenCorrupted) {
+    const std::string content = readFile(mCacheFile);
+    ASSERT_FALSE(content.empty());
+
+    // a cache truncated anywhere, even in the header, is ignored
+    for (size_t size = 0; size < content.size(); size++) {
+        ASSERT_TRUE(writeFile(mCacheFile, content.substr(0, size)));
+        EXPECT_FALSE(isCached()) << "truncated to " << size << " bytes";
+    }
+
+    // as well as lengths out of range, which must not be allocated
+    const size_t pathLengthOffset = 4 * sizeof(uint32_t) + strlen(kFingerprint);
+    for (uint32_t length : {0u, 0x10000u, 0xffffffffu}) {
+        std::string corrupted = content;
+        memcpy(&corrupted[pathLengthOffset], &length, sizeof(length));
+        ASSERT_TRUE(writeFile(mCacheFile, corrupted));
+        EXPECT_FALSE(isCached()) << "path length " << length;
+    }
+    const uint32_t fingerprintLength = 0xffffffff;
+    std::string corrupted = content;
+    memcpy(&corrupted[3 * sizeof(uint32_t)], &fingerprintLength, sizeof(fingerprintLength));
+    ASSERT_TRUE(writeFile(mCacheFile, corrupted));
+    EXPECT_FALSE(isCached());
+
+    // and is replaced by the next boot
+    DescriptorCache cache(kFingerprint);
+    cache.read(mCacheFile.c_str());
+    ASSERT_FALSE(cache.checkLibrary(mLibrary.c_str()));
+    cache.add(mLibrary.c_str(), kDownmixUuid, mDescriptor);
+    cache.write(mCacheFile.c_str());
+    EXPECT_TRUE(isCached());
+}
+
+// Loads a configuration of the downmix library with the factory loader.
+class LazyLoadingTest : public TemporaryDirectoryTest {
+protected:
+    void SetUp() override {
+        TemporaryDirectoryTest::SetUp();
+        mConfigFile = getPath("audio_effects.xml");
+        mCacheFile = getPath("effects_descriptors.cache");
+        getPath("effects_descriptors.cache.tmp");
+        ASSERT_TRUE(writeFile(mConfigFile,
+                "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<audio_effects_conf version=\"2.0\" "
+                        "xmlns=\"http://schemas.android.com/audio/audio_effects_conf/v2_0\">\n"
+                "    <libraries>\n"
+                "        <library name=\"downmix\" path=\"libdownmix.so\"/>\n"
+                "    </libraries>\n"
+                "    <effects>\n"
+                "        <effect name=\"downmix\" library=\"downmix\" "
+                                "uuid=\"93f04452-e4fe-41cc-91f9-e475b6d1d69f\"/>\n"
+                "    </effects>\n"
+                "</audio_effects_conf>\n"));
+    }
+
+    // As at boot: the lists of the previous load are dropped, and their libraries leaked.
+    lib_entry_t* load() {
+        gLibraryList = nullptr;
+        gLibraryFailedList = nullptr;
+        gSkippedEffects = nullptr;
+        gSubEffectList = nullptr;
+        EXPECT_EQ(0, EffectLoadXmlEffectConfigWithCache(mConfigFile.c_str(),
+                                                        mCacheFile.c_str()));
+        if (gLibraryList == nullptr) {
+            return nullptr;
+        }
+        return static_cast<lib_entry_t*>(gLibraryList->object);
+    }
+
+    static bool hasDownmixLibrary() {
+        for (auto* libraryDirectory : effectsConfig::LD_EFFECT_LIBRARY_PATH) {
+            std::string path = std::string(libraryDirectory) + "/libdownmix.so";
+            if (access(path.c_str(), R_OK) == 0) {
+                return true;
+            }
+        }
+        printf("libdownmix.so not installed, skipping\n");
+        return false;
+    }
+
+    std::string mConfigFile;
+    std::string mCacheFile;
+};
+
+TEST_F(LazyLoadingTest, openedOnFirstCreate) {
+    if (!hasDownmixLibrary()) {
+        return;
+    }
+
+    // cache miss: the library is opened at init, and its descriptors cached
+    lib_entry_t* lib = load();
+    ASSERT_NE(nullptr, lib);
+    EXPECT_NE(nullptr, lib->handle);
+    EXPECT_EQ(0, lib->cachedDescriptors);
+    struct stat st;
+    EXPECT_EQ(0, stat(mCacheFile.c_str(), &st));
+
+    // cache hit: the library is not opened at init
+    lib = load();
+    ASSERT_NE(nullptr, lib);
+    EXPECT_EQ(nullptr, lib->handle);
+    EXPECT_EQ(1, lib->cachedDescriptors);
+
+    // but when the effect is created, as by EffectCreate()
+    lib_entry_t* effectLib;
+    effect_descriptor_t* desc;
+    pthread_mutex_lock(&gLibLock);
+    ASSERT_EQ(0, findEffect(nullptr, &kDownmixUuid, &effectLib, &desc));
+    EXPECT_EQ(lib, effectLib);
+    EXPECT_EQ(0, memcmp(&kDownmixUuid, &desc->uuid, sizeof(effect_uuid_t)));
+    EXPECT_EQ(0, loadEffectLibrary(effectLib));
+    pthread_mutex_unlock(&gLibLock);
+    ASSERT_NE(nullptr, lib->handle);
+    ASSERT_NE(nullptr, lib->desc);
+
+    effect_handle_t handle;
+    ASSERT_EQ(0, lib->desc->create_effect(&kDownmixUuid, 0, 0, &handle));
+    EXPECT_EQ(0, lib->desc->release_effect(handle));
+}
+
+} // namespace
@@ -6,7 +6,8 @@ include $(CLEAR_VARS)
 LOCAL_VENDOR_MODULE := true
 LOCAL_SRC_FILES:= \
     EffectLoudnessEnhancer.cpp \
-    dsp/core/dynamic_range_compression.cpp
+    dsp/core/dynamic_range_compression.cpp \
+    dsp/core/lookahead_limiter.cpp
 
 LOCAL_CFLAGS+= -O2 -fvisibility=hidden
 LOCAL_CFLAGS += -Wall -Werror
@@ -22,3 +23,5 @@ LOCAL_HEADER_LIBRARIES := \
     libaudioeffects
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -23,12 +23,27 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
 #include <new>
+#include <vector>
 
 #include <log/log.h>
 
 #include <audio_effects/effect_loudnessenhancer.h>
 #include "dsp/core/dynamic_range_compression.h"
+#include "dsp/core/lookahead_limiter.h"
+
+// Parameters beyond those of effect_loudnessenhancer.h, as int32_t:
+// lookahead of the output limiter in microseconds, 0 (default) clips the output instead
+#define LOUDNESS_ENHANCER_PARAM_LOOKAHEAD_US    0x10000
+// delay of the output in frames, read only
+#define LOUDNESS_ENHANCER_PARAM_LATENCY_FRAMES  0x10001
+
+// The samples are processed on the scale of 16 bit samples, which the compressor is tuned for
+#define LE_SAMPLE_SCALE     32768.0f
+#define LE_FULL_SCALE       32767.0f
+// frames processed at once when the buffer size is not part of the configuration
+#define LE_WORK_FRAMES      512
 
 extern "C" {
 
@@ -61,6 +76,15 @@ struct LoudnessEnhancerContext {
     // in this implementation, there is no coupling between the compression on the left and right
     // channels
     le_fx::AdaptiveDynamicRangeCompression* mCompressor;
+    int32_t mLookaheadUs;
+    // keeps the output of the compressor below full scale, when mLookaheadUs is not 0
+    le_fx::LookaheadLimiter* mLimiter;
+    // lookahead, channel count and sampling rate the limiter was initialized with, 0 if none
+    int32_t mLimiterLookaheadUs;
+    uint32_t mLimiterChannelCount;
+    uint32_t mLimiterSamplingRate;
+    // sized by LE_setConfig(), process() works in chunks that fit
+    std::vector<float> mWorkBuffer;
 };
 
 //
@@ -78,6 +102,30 @@ void LE_reset(LoudnessEnhancerContext *pContext)
     } else {
         ALOGE("LE_reset(%p): null compressors, can't apply target gain", pContext);
     }
+
+    // the limiter is only initialized, which allocates its buffers and clears its history,
+    // when its configuration changes, or when it is enabled again after being disabled
+    if (pContext->mLookaheadUs == 0) {
+        pContext->mLimiterLookaheadUs = 0;
+    }
+    const uint32_t channelCount =
+            audio_channel_count_from_out_mask(pContext->mConfig.inputCfg.channels);
+    const uint32_t samplingRate = pContext->mConfig.inputCfg.samplingRate;
+    if (pContext->mLimiter != NULL && pContext->mLookaheadUs > 0 &&
+            (pContext->mLookaheadUs != pContext->mLimiterLookaheadUs ||
+             channelCount != pContext->mLimiterChannelCount ||
+             samplingRate != pContext->mLimiterSamplingRate)) {
+        if (pContext->mLimiter->Initialize(channelCount, samplingRate,
+                pContext->mLookaheadUs / 1000000.0f, LE_FULL_SCALE)) {
+            pContext->mLimiterLookaheadUs = pContext->mLookaheadUs;
+            pContext->mLimiterChannelCount = channelCount;
+            pContext->mLimiterSamplingRate = samplingRate;
+        } else {
+            ALOGE("LE_reset(%p): invalid limiter lookahead %dus", pContext,
+                    pContext->mLookaheadUs);
+            pContext->mLookaheadUs = 0;
+        }
+    }
 }
 
 static inline int16_t clamp16(int32_t sample)
@@ -108,13 +156,26 @@ int LE_setConfig(LoudnessEnhancerContext *pContext, effect_config_t *pConfig)
     if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate) return -EINVAL;
     if (pConfig->inputCfg.channels != pConfig->outputCfg.channels) return -EINVAL;
     if (pConfig->inputCfg.format != pConfig->outputCfg.format) return -EINVAL;
-    if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) return -EINVAL;
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
             pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE) return -EINVAL;
-    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) return -EINVAL;
+    if (pConfig->inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        const uint32_t channelCount =
+                audio_channel_count_from_out_mask(pConfig->inputCfg.channels);
+        if (channelCount < 1 || channelCount > le_fx::LookaheadLimiter::kMaxChannels) {
+            return -EINVAL;
+        }
+    } else {
+        if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) return -EINVAL;
+        if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) return -EINVAL;
+    }
 
     pContext->mConfig = *pConfig;
 
+    const size_t workFrames = pConfig->inputCfg.buffer.frameCount > 0 ?
+            pConfig->inputCfg.buffer.frameCount : LE_WORK_FRAMES;
+    pContext->mWorkBuffer.resize(
+            workFrames * audio_channel_count_from_out_mask(pConfig->inputCfg.channels));
+
     LE_reset(pContext);
 
     return 0;
@@ -164,6 +225,7 @@ int LE_init(LoudnessEnhancerContext *pContext)
     pContext->mConfig.inputCfg.bufferProvider.getBuffer = NULL;
     pContext->mConfig.inputCfg.bufferProvider.releaseBuffer = NULL;
     pContext->mConfig.inputCfg.bufferProvider.cookie = NULL;
+    pContext->mConfig.inputCfg.buffer.frameCount = 0;
     pContext->mConfig.inputCfg.mask = EFFECT_CONFIG_ALL;
     pContext->mConfig.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_ACCUMULATE;
     pContext->mConfig.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
@@ -182,6 +244,13 @@ int LE_init(LoudnessEnhancerContext *pContext)
         pContext->mCompressor = new le_fx::AdaptiveDynamicRangeCompression();
         pContext->mCompressor->Initialize(targetAmp, pContext->mConfig.inputCfg.samplingRate);
     }
+    pContext->mLookaheadUs = 0;
+    if (pContext->mLimiter == NULL) {
+        pContext->mLimiter = new le_fx::LookaheadLimiter();
+        pContext->mLimiterLookaheadUs = 0;
+        pContext->mLimiterChannelCount = 0;
+        pContext->mLimiterSamplingRate = 0;
+    }
 
     LE_setConfig(pContext, &pContext->mConfig);
 
@@ -213,9 +282,12 @@ int LELib_Create(const effect_uuid_t *uuid,
     pContext->mState = LOUDNESS_ENHANCER_STATE_UNINITIALIZED;
 
     pContext->mCompressor = NULL;
+    pContext->mLimiter = NULL;
     ret = LE_init(pContext);
     if (ret < 0) {
         ALOGW("LELib_Create() init failed");
+        delete pContext->mCompressor;
+        delete pContext->mLimiter;
         delete pContext;
         return ret;
     }
@@ -242,6 +314,10 @@ int LELib_Release(effect_handle_t handle) {
         delete pContext->mCompressor;
         pContext->mCompressor = NULL;
     }
+    if (pContext->mLimiter != NULL) {
+        delete pContext->mLimiter;
+        pContext->mLimiter = NULL;
+    }
     delete pContext;
 
     return 0;
@@ -283,25 +359,55 @@ int LE_process(
     }
 
     //ALOGV("LE about to process %d samples", inBuffer->frameCount);
-    uint16_t inIdx;
+    const size_t frameCount = inBuffer->frameCount;
+    const int channelCount = audio_channel_count_from_out_mask(
+            pContext->mConfig.inputCfg.channels);
+    const bool isFloat = pContext->mConfig.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    // the output is the input when processing in place
+    const bool accumulate = inBuffer->raw != outBuffer->raw &&
+            pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE;
+    float *work = pContext->mWorkBuffer.data();
+    const size_t workFrames = pContext->mWorkBuffer.size() / channelCount;
+
+    // makeup gain is applied on the input of the compressor
     float inputAmp = pow(10, pContext->mTargetGainmB/2000.0f);
-    float leftSample, rightSample;
-    for (inIdx = 0 ; inIdx < inBuffer->frameCount ; inIdx++) {
-        // makeup gain is applied on the input of the compressor
-        leftSample  = inputAmp * (float)inBuffer->s16[2*inIdx];
-        rightSample = inputAmp * (float)inBuffer->s16[2*inIdx +1];
-        pContext->mCompressor->Compress(&leftSample, &rightSample);
-        inBuffer->s16[2*inIdx]    = (int16_t) leftSample;
-        inBuffer->s16[2*inIdx +1] = (int16_t) rightSample;
-    }
-
-    if (inBuffer->raw != outBuffer->raw) {
-        if (pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
-            for (size_t i = 0; i < outBuffer->frameCount*2; i++) {
-                outBuffer->s16[i] = clamp16(outBuffer->s16[i] + inBuffer->s16[i]);
+    for (size_t offset = 0; offset < frameCount; offset += workFrames) {
+        const size_t chunkFrames = std::min(frameCount - offset, workFrames);
+        const size_t first = offset * channelCount;
+        const size_t sampleCount = chunkFrames * channelCount;
+        if (isFloat) {
+            const float scale = inputAmp * LE_SAMPLE_SCALE;
+            for (size_t i = 0; i < sampleCount; i++) {
+                work[i] = scale * inBuffer->f32[first + i];
             }
         } else {
-            memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount * 2 * sizeof(int16_t));
+            for (size_t i = 0; i < sampleCount; i++) {
+                work[i] = inputAmp * (float)inBuffer->s16[first + i];
+            }
+        }
+        for (size_t frame = 0; frame < chunkFrames; frame++) {
+            pContext->mCompressor->Compress(&work[frame * channelCount], channelCount);
+        }
+        if (pContext->mLookaheadUs > 0) {
+            pContext->mLimiter->Process(work, work, chunkFrames);
+        }
+
+        for (size_t i = 0; i < sampleCount; i++) {
+            const float sample = fminf(fmaxf(work[i], -LE_FULL_SCALE), LE_FULL_SCALE);
+            if (isFloat) {
+                if (accumulate) {
+                    outBuffer->f32[first + i] += sample / LE_SAMPLE_SCALE;
+                } else {
+                    outBuffer->f32[first + i] = sample / LE_SAMPLE_SCALE;
+                }
+            } else {
+                if (accumulate) {
+                    outBuffer->s16[first + i] =
+                            clamp16(outBuffer->s16[first + i] + (int16_t) sample);
+                } else {
+                    outBuffer->s16[first + i] = (int16_t) sample;
+                }
+            }
         }
     }
     if (pContext->mState != LOUDNESS_ENHANCER_STATE_ACTIVE) {
@@ -344,6 +450,9 @@ int LE_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         break;
     case EFFECT_CMD_RESET:
         LE_reset(pContext);
+        if (pContext->mLookaheadUs > 0) {
+            pContext->mLimiter->Reset();
+        }
         break;
     case EFFECT_CMD_ENABLE:
         if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int)) {
@@ -389,6 +498,17 @@ int LE_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             p->vsize = sizeof(int32_t);
             *replySize += sizeof(int32_t);
             break;
+        case LOUDNESS_ENHANCER_PARAM_LOOKAHEAD_US:
+            *((int32_t *)p->data + 1) = pContext->mLookaheadUs;
+            p->vsize = sizeof(int32_t);
+            *replySize += sizeof(int32_t);
+            break;
+        case LOUDNESS_ENHANCER_PARAM_LATENCY_FRAMES:
+            *((int32_t *)p->data + 1) =
+                    pContext->mLookaheadUs > 0 ? pContext->mLimiter->latency_frames() : 0;
+            p->vsize = sizeof(int32_t);
+            *replySize += sizeof(int32_t);
+            break;
         default:
             p->status = -EINVAL;
         }
@@ -411,6 +531,17 @@ int LE_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             ALOGV("set target gain(mB) = %d", pContext->mTargetGainmB);
             LE_reset(pContext); // apply parameter update
             break;
+        case LOUDNESS_ENHANCER_PARAM_LOOKAHEAD_US: {
+            const int32_t lookaheadUs = *((int32_t *)p->data + 1);
+            if (lookaheadUs < 0 ||
+                    lookaheadUs > le_fx::LookaheadLimiter::kMaxLookaheadSeconds * 1000000) {
+                *(int32_t *)pReplyData = -EINVAL;
+                break;
+            }
+            pContext->mLookaheadUs = lookaheadUs;
+            ALOGV("set limiter lookahead(us) = %d", pContext->mLookaheadUs);
+            LE_reset(pContext); // apply parameter update
+            } break;
         default:
             *(int32_t *)pReplyData = -EINVAL;
         }
@@ -136,5 +136,31 @@ void AdaptiveDynamicRangeCompression::Compress(float *x1, float *x2) {
   }
 }
 
+void AdaptiveDynamicRangeCompression::Compress(float *x, int channel_count) {
+  // Taking the maximum amplitude of all channels
+  float max_abs_x = kMinLogAbsValue;
+  for (int i = 0; i < channel_count; i++) {
+    max_abs_x = std::max(max_abs_x, std::fabs(x[i]));
+  }
+  const float max_abs_x_dB = math::fast_log(max_abs_x);
+  // Subtract Threshold from log-encoded input to get the amount of overshoot
+  const float overshoot = max_abs_x_dB - knee_threshold_;
+  // Hard half-wave rectifier
+  const float rect = std::max(overshoot, 0.0f);
+  // Multiply rectified overshoot with slope
+  const float cv = rect * slope_;
+  const float prev_state = state_;
+  if (cv <= state_) {
+    state_ = alpha_attack_ * state_ + (1.0f - alpha_attack_) * cv;
+  } else {
+    state_ = alpha_release_ * state_ + (1.0f - alpha_release_) * cv;
+  }
+  compressor_gain_ *=
+      math::ExpApproximationViaTaylorExpansionOrder5(state_ - prev_state);
+  for (int i = 0; i < channel_count; i++) {
+    x[i] *= compressor_gain_;
+  }
+}
+
 }  // namespace le_fx
 
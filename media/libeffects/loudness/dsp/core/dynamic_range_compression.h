@@ -58,6 +58,11 @@ class AdaptiveDynamicRangeCompression {
   // Stereo channel version of the compressor
   void Compress(float *x1, float *x2);
 
+  // Multichannel version of the compressor, for a frame of channel_count
+  // interleaved samples sharing the gain of the loudest one. Unlike the other
+  // versions, the output is not clipped: the caller limits it.
+  void Compress(float *x, int channel_count);
+
   // This version is slower than Compress(.) but faster than CompressSlow(.)
   float CompressNormalSpeed(float x);
 
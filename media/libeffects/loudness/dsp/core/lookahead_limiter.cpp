@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsp/core/lookahead_limiter.h"
+
+namespace le_fx {
+
+// Definitions for static const class members declared in lookahead_limiter.h.
+const int LookaheadLimiter::kMaxChannels;
+const int LookaheadLimiter::kBlockFrames;
+const float LookaheadLimiter::kMaxLookaheadSeconds = 0.02f;
+const float LookaheadLimiter::kTauRelease = 0.05f;
+
+LookaheadLimiter::LookaheadLimiter()
+    : channel_count_(0),
+      lookahead_(0),
+      threshold_(1.0f),
+      alpha_release_(0.0f),
+      release_state_(1.0f),
+      released_index_(0),
+      released_sum_(0.0),
+      segment_minimum_(1.0f),
+      segment_position_(0) {
+}
+
+bool LookaheadLimiter::Initialize(int channel_count, float sampling_rate,
+                                  float lookahead_seconds, float threshold) {
+  if (channel_count < 1 || channel_count > kMaxChannels ||
+      !(sampling_rate > 0.0f) || !(threshold > 0.0f) ||
+      !(lookahead_seconds >= 0.0f) ||
+      lookahead_seconds > kMaxLookaheadSeconds) {
+    return false;
+  }
+  channel_count_ = channel_count;
+  lookahead_ = static_cast<int>(lookahead_seconds * sampling_rate + 0.5f);
+  threshold_ = threshold;
+  alpha_release_ = std::exp(-1.0f / (kTauRelease * sampling_rate));
+
+  released_.resize(lookahead_ + 1);
+  gains_.resize(kBlockFrames);
+  segment_.resize(lookahead_ + 1);
+  suffix_minimum_.resize(lookahead_ + 2);
+  smoothed_.resize(kBlockFrames);
+  delay_.resize((lookahead_ + kBlockFrames) * channel_count_);
+  Reset();
+  return true;
+}
+
+void LookaheadLimiter::Reset() {
+  release_state_ = 1.0f;
+  std::fill(released_.begin(), released_.end(), 1.0f);
+  released_index_ = 0;
+  released_sum_ = released_.size();
+  // as if the gains before the start were 1
+  segment_minimum_ = 1.0f;
+  segment_position_ = 0;
+  std::fill(suffix_minimum_.begin(), suffix_minimum_.end(), 1.0f);
+  std::fill(delay_.begin(), delay_.end(), 0.0f);
+}
+
+void LookaheadLimiter::Process(const float *in, float *out, int frame_count) {
+  while (frame_count > 0) {
+    const int block_frames = std::min(frame_count, kBlockFrames);
+    ProcessBlock(in, out, block_frames);
+    in += block_frames * channel_count_;
+    out += block_frames * channel_count_;
+    frame_count -= block_frames;
+  }
+}
+
+void LookaheadLimiter::ProcessBlock(const float *in, float *out,
+                                    int frame_count) {
+  const int channel_count = channel_count_;
+  const int lookahead = lookahead_;
+  const int window = lookahead + 1;
+
+  // Peak of the channels, then the gain bringing it to the threshold.
+  float * __restrict gains = gains_.data();
+  std::fill(gains, gains + frame_count, 0.0f);
+  for (int c = 0; c < channel_count; c++) {
+    for (int i = 0; i < frame_count; i++) {
+      gains[i] = std::max(gains[i], std::fabs(in[i * channel_count + c]));
+    }
+  }
+  const float threshold = threshold_;
+  for (int i = 0; i < frame_count; i++) {
+    gains[i] = threshold / std::max(gains[i], threshold);
+  }
+  // the input is copied before the output is written, which may be the input
+  memcpy(&delay_[lookahead * channel_count], in,
+         frame_count * channel_count * sizeof(float));
+
+  // Minimum of the gains over the window ending at each frame of the block,
+  // from the running minimums within segments of the window size (van Herk):
+  // the minimum from the start of the segment of the frame, and the minimum
+  // from the start of the window to the end of the previous segment. The
+  // latter are computed once per segment, when it is complete, so the cost
+  // does not depend on the lookahead.
+  float * __restrict smoothed = smoothed_.data();
+  for (int i = 0; i < frame_count;) {
+    const int position = segment_position_;
+    const int count = std::min(frame_count - i, window - position);
+    memcpy(&segment_[position], &gains[i], count * sizeof(float));
+    const float * __restrict suffix = suffix_minimum_.data() + position + 1;
+    float minimum = segment_minimum_;
+    for (int j = i; j < i + count; j++) {
+      minimum = std::min(minimum, gains[j]);
+      smoothed[j] = std::min(minimum, suffix[j - i]);
+    }
+    i += count;
+
+    if (position + count < window) {
+      segment_minimum_ = minimum;
+      segment_position_ = position + count;
+    } else {
+      const float * __restrict segment = segment_.data();
+      float * __restrict next_suffix = suffix_minimum_.data();
+      next_suffix[lookahead] = segment[lookahead];
+      for (int j = lookahead - 1; j >= 0; j--) {
+        next_suffix[j] = std::min(next_suffix[j + 1], segment[j]);
+      }
+      segment_minimum_ = 1.0f;
+      segment_position_ = 0;
+    }
+  }
+
+  // Exponential release, then the average over the window, which stays below
+  // the minimum gain of a peak at the frame output.
+  const float alpha_release = alpha_release_;
+  float state = release_state_;
+  for (int i = 0; i < frame_count; i++) {
+    const float held = smoothed[i];
+    state = std::min(held, held + alpha_release * (state - held));
+    released_sum_ += state - released_[released_index_];
+    released_[released_index_] = state;
+    if (++released_index_ == window) {
+      released_index_ = 0;
+    }
+    smoothed[i] = std::min(static_cast<float>(released_sum_ / window), 1.0f);
+  }
+  release_state_ = state;
+
+  const float *delayed = delay_.data();
+  for (int i = 0; i < frame_count; i++) {
+    const float gain = smoothed[i];
+    for (int c = 0; c < channel_count; c++) {
+      out[i * channel_count + c] = delayed[i * channel_count + c] * gain;
+    }
+  }
+
+  // keeps the last lookahead frames for the next block
+  memmove(delay_.data(), &delay_[frame_count * channel_count],
+          lookahead * channel_count * sizeof(float));
+}
+
+}  // namespace le_fx
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef LE_FX_ENGINE_DSP_CORE_LOOKAHEAD_LIMITER_H_
+#define LE_FX_ENGINE_DSP_CORE_LOOKAHEAD_LIMITER_H_
+
+#include <vector>
+
+#include "common/core/types.h"
+
+namespace le_fx {
+
+// A block-based peak limiter for interleaved multichannel signals. The input is
+// delayed by the lookahead, so that the gain reaches the level required by a
+// peak before the peak is output: no output sample exceeds the threshold.
+//
+// The channels share the gain of the loudest one. The required gain is held
+// for the lookahead by a running minimum, released exponentially, and smoothed
+// by a moving average over the lookahead. The running minimum is kept across
+// blocks, so that the cost per frame does not depend on the lookahead. The
+// envelope is computed on blocks with loops that the compiler vectorizes,
+// except for the running minimum, the release and the moving average which are
+// recursive.
+class LookaheadLimiter {
+ public:
+  LookaheadLimiter();
+
+  // Initializes the limiter and clears its history.
+  //  channel_count: number of interleaved channels, between 1 and kMaxChannels
+  //  lookahead_seconds: latency, and time for the gain to reach a peak, up to
+  //      kMaxLookaheadSeconds
+  //  threshold: maximum absolute value of the output samples
+  // returns `true` if everything is ok, `false`, otherwise
+  bool Initialize(int channel_count, float sampling_rate,
+                  float lookahead_seconds, float threshold);
+
+  // Clears the history, as at the start of a stream.
+  void Reset();
+
+  // Limits frame_count frames of the input, delayed by latency_frames().
+  // The input and output may be the same buffer.
+  void Process(const float *in, float *out, int frame_count);
+
+  // The delay of the output, in frames.
+  int latency_frames() const {
+    return lookahead_;
+  }
+
+  static const int kMaxChannels = 8;
+  static const float kMaxLookaheadSeconds;
+
+ private:
+  void ProcessBlock(const float *in, float *out, int frame_count);
+
+  // Frames processed at once
+  static const int kBlockFrames = 256;
+  // The release time of the gain
+  static const float kTauRelease;
+
+  int channel_count_;
+  // lookahead in frames, the running minimum is over lookahead_ + 1 gains
+  int lookahead_;
+  float threshold_;
+  // release constant for exponential dumping
+  float alpha_release_;
+  // the latest released gain
+  float release_state_;
+  // the last lookahead_ + 1 released gains, and their sum
+  std::vector<float> released_;
+  int released_index_;
+  double released_sum_;
+  // the required gains of the block
+  std::vector<float> gains_;
+  // The running minimum is computed within consecutive segments of
+  // lookahead_ + 1 frames: the gains of the current segment received so far,
+  // their minimum, and the position of the next frame in the segment.
+  std::vector<float> segment_;
+  float segment_minimum_;
+  int segment_position_;
+  // the minimums from each frame to the end of the previous segment, followed
+  // by 1 for an empty range
+  std::vector<float> suffix_minimum_;
+  // the smoothed gains of the block
+  std::vector<float> smoothed_;
+  // the last lookahead_ input frames, followed by the block
+  std::vector<float> delay_;
+
+  LE_FX_DISALLOW_COPY_AND_ASSIGN(LookaheadLimiter);
+};
+
+}  // namespace le_fx
+
+#endif  // LE_FX_ENGINE_DSP_CORE_LOOKAHEAD_LIMITER_H_
@@ -0,0 +1,12 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_VENDOR_MODULE := true
+LOCAL_SRC_FILES:= \
+	lookahead_limiter_tests.cpp \
+	../dsp/core/lookahead_limiter.cpp
+LOCAL_CFLAGS += -O2 -Wall -Werror
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/..
+LOCAL_MODULE := lookahead_limiter_tests
+include $(BUILD_NATIVE_TEST)
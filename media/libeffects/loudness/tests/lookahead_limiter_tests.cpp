@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the lookahead limiter of the loudness enhancer.
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dsp/core/lookahead_limiter.h"
+
+using le_fx::LookaheadLimiter;
+
+namespace {
+
+constexpr float kSampleRate = 48000.f;
+constexpr float kThreshold = 0.5f;
+
+// Noise with bursts up to 8 times the threshold, and full scale square waves.
+std::vector<float> loudSignal(int frameCount, int channelCount) {
+    std::minstd_rand generator(42);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<float> samples(frameCount * channelCount);
+    for (int frame = 0; frame < frameCount; frame++) {
+        const int segment = frame / 1000;
+        float level = 0.25f * kThreshold * (1 + segment % 8);
+        if (segment % 5 == 4) {
+            // square wave, the worst case for the attack
+            level *= (frame / 37) % 2 ? 1.f : -1.f;
+        }
+        for (int channel = 0; channel < channelCount; channel++) {
+            const float noise = segment % 5 == 4 ? 1.f : distribution(generator);
+            samples[frame * channelCount + channel] = level * noise;
+        }
+    }
+    return samples;
+}
+
+void process(LookaheadLimiter &limiter, const std::vector<float> &in,
+             std::vector<float> &out, int channelCount, bool varyingBlocks) {
+    const int frameCount = in.size() / channelCount;
+    out.resize(in.size());
+    for (int frame = 0, count = 1; frame < frameCount; frame += count) {
+        count = std::min(varyingBlocks ? count + 13 : 192, frameCount - frame);
+        limiter.Process(&in[frame * channelCount], &out[frame * channelCount], count);
+    }
+}
+
+} // namespace
+
+TEST(lookahead_limiter_tests, no_overshoot) {
+    constexpr int kFrameCount = 40000;
+    for (int channelCount : {1, 2, 6, 8}) {
+        for (float lookahead : {0.f, 0.001f, 0.005f, LookaheadLimiter::kMaxLookaheadSeconds}) {
+            SCOPED_TRACE(testing::Message() << channelCount << " channels, "
+                    << lookahead << " s lookahead");
+            LookaheadLimiter limiter;
+            ASSERT_TRUE(limiter.Initialize(channelCount, kSampleRate, lookahead, kThreshold));
+            const std::vector<float> in = loudSignal(kFrameCount, channelCount);
+            std::vector<float> out;
+            process(limiter, in, out, channelCount, true /* varyingBlocks */);
+
+            float peak = 0;
+            for (float sample : out) {
+                peak = std::max(peak, std::fabs(sample));
+            }
+            EXPECT_LE(peak, kThreshold * (1 + 1e-6f));
+            // the loud segments are limited, not muted
+            EXPECT_GT(peak, 0.9f * kThreshold);
+        }
+    }
+}
+
+TEST(lookahead_limiter_tests, transparent_below_threshold) {
+    constexpr int kChannelCount = 2;
+    constexpr int kFrameCount = 10000;
+    LookaheadLimiter limiter;
+    ASSERT_TRUE(limiter.Initialize(kChannelCount, kSampleRate, 0.005f, kThreshold));
+    const int latency = limiter.latency_frames();
+    EXPECT_EQ(240, latency);
+
+    std::minstd_rand generator(7);
+    std::uniform_real_distribution<float> distribution(-kThreshold, kThreshold);
+    std::vector<float> in(kFrameCount * kChannelCount), out;
+    for (auto &sample : in) {
+        sample = distribution(generator);
+    }
+    process(limiter, in, out, kChannelCount, true /* varyingBlocks */);
+    for (int i = 0; i < kFrameCount * kChannelCount; i++) {
+        const float expected = i < latency * kChannelCount ? 0.f :
+                in[i - latency * kChannelCount];
+        ASSERT_NEAR(expected, out[i], 1e-6f) << "sample " << i;
+    }
+}
+
+// The gain reaches the level of a peak when the peak is output, and moves by at most
+// 1 / (latency + 1) per frame.
+TEST(lookahead_limiter_tests, gain_ramps_to_peak) {
+    constexpr int kFrameCount = 4000;
+    constexpr int kPeakFrame = 2000;
+    constexpr float kPeak = 4.f * kThreshold;
+    LookaheadLimiter limiter;
+    ASSERT_TRUE(limiter.Initialize(1, kSampleRate, 0.002f, kThreshold));
+    const int latency = limiter.latency_frames();
+
+    // a constant input below the threshold shows the gain
+    std::vector<float> in(kFrameCount, 0.1f), out;
+    in[kPeakFrame] = kPeak;
+    process(limiter, in, out, 1, false /* varyingBlocks */);
+
+    EXPECT_NEAR(kThreshold, out[kPeakFrame + latency], 1e-5f);
+    for (int frame = latency + 1; frame < kFrameCount; frame++) {
+        if (frame == kPeakFrame + latency) {
+            continue;
+        }
+        const float gain = out[frame] / in[frame - latency];
+        const float previousGain = out[frame - 1] / in[frame - 1 - latency];
+        EXPECT_LE(std::fabs(gain - previousGain), 1.f / (latency + 1) + 1e-5f)
+                << "frame " << frame;
+    }
+}
+
+TEST(lookahead_limiter_tests, block_size_independent) {
+    constexpr int kChannelCount = 6;
+    constexpr int kFrameCount = 10000;
+    const std::vector<float> in = loudSignal(kFrameCount, kChannelCount);
+    std::vector<float> varying, constant;
+    LookaheadLimiter limiter;
+    ASSERT_TRUE(limiter.Initialize(kChannelCount, kSampleRate, 0.003f, kThreshold));
+    process(limiter, in, varying, kChannelCount, true /* varyingBlocks */);
+    limiter.Reset();
+    process(limiter, in, constant, kChannelCount, false /* varyingBlocks */);
+    EXPECT_EQ(varying, constant);
+
+    // in place
+    std::vector<float> inPlace = in;
+    limiter.Reset();
+    limiter.Process(inPlace.data(), inPlace.data(), kFrameCount);
+    EXPECT_EQ(constant, inPlace);
+}
+
+TEST(lookahead_limiter_tests, invalid_arguments) {
+    LookaheadLimiter limiter;
+    EXPECT_FALSE(limiter.Initialize(0, kSampleRate, 0.f, kThreshold));
+    EXPECT_FALSE(limiter.Initialize(LookaheadLimiter::kMaxChannels + 1, kSampleRate, 0.f,
+                                    kThreshold));
+    EXPECT_FALSE(limiter.Initialize(2, kSampleRate, -0.001f, kThreshold));
+    EXPECT_FALSE(limiter.Initialize(2, kSampleRate, 1.f, kThreshold));
+    EXPECT_FALSE(limiter.Initialize(2, kSampleRate, 0.f, 0.f));
+    EXPECT_TRUE(limiter.Initialize(2, kSampleRate, 0.f, kThreshold));
+    EXPECT_EQ(0, limiter.latency_frames());
+}
+
+TEST(lookahead_limiter_tests, benchmark) {
+    constexpr int kTotalFrames = 1 << 21;
+    for (int channelCount : {2, 8}) {
+        for (float lookahead : {0.001f, 0.005f, LookaheadLimiter::kMaxLookaheadSeconds}) {
+            for (int frameCount : {64, 256, 1024}) {
+                LookaheadLimiter limiter;
+                ASSERT_TRUE(limiter.Initialize(channelCount, kSampleRate, lookahead,
+                                               kThreshold));
+                const std::vector<float> in = loudSignal(frameCount, channelCount);
+                std::vector<float> out(in.size());
+                const auto start = std::chrono::steady_clock::now();
+                for (int frames = 0; frames < kTotalFrames; frames += frameCount) {
+                    limiter.Process(in.data(), out.data(), frameCount);
+                }
+                const std::chrono::duration<double, std::nano> elapsed =
+                        std::chrono::steady_clock::now() - start;
+                const double nanosPerFrame = elapsed.count() / kTotalFrames;
+                printf("%d channels, %4.1f ms lookahead, %4d frames: %6.2f ns/frame, "
+                       "%5.0fx real time\n", channelCount, lookahead * 1000, frameCount,
+                       nanosPerFrame, 1e9 / kSampleRate / nanosPerFrame);
+            }
+        }
+    }
+}
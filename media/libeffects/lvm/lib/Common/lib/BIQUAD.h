@@ -30,7 +30,8 @@ extern "C" {
 #ifdef BUILD_FLOAT
 typedef struct
 {
-    LVM_FLOAT Storage[6];
+    /* A pointer to the taps and up to 5 coefficients, which needs 8 words on 64-bit targets */
+    LVM_FLOAT Storage[8];
 
 } Biquad_FLOAT_Instance_t;
 #else
@@ -366,6 +367,13 @@ void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_FLOAT_Instance_t  *pInstance,
                                             LVM_FLOAT                    *pDataIn,
                                             LVM_FLOAT                    *pDataOut,
                                             LVM_INT16                 NrSamples);
+/* Multichannel version, initialised by BQ_2I_D32F32Cll_TRC_WRA_01_Init() with taps of
+   4 * NrChannels samples. Up to four channels are filtered at once. */
+void BQ_Mc_D32F32C30_TRC_WRA_01 (           Biquad_FLOAT_Instance_t  *pInstance,
+                                            LVM_FLOAT                    *pDataIn,
+                                            LVM_FLOAT                    *pDataOut,
+                                            LVM_INT16                 NrFrames,
+                                            LVM_INT16                 NrChannels);
 #else
 void BQ_2I_D32F32Cll_TRC_WRA_01_Init (      Biquad_Instance_t       *pInstance,
                                             Biquad_2I_Order2_Taps_t *pTaps,
@@ -527,6 +535,13 @@ void PK_2I_D32F32C14G11_TRC_WRA_01( Biquad_FLOAT_Instance_t       *pInstance,
                                     LVM_FLOAT               *pDataIn,
                                     LVM_FLOAT               *pDataOut,
                                     LVM_INT16               NrSamples);
+/* Multichannel version, initialised by PK_2I_D32F32CssGss_TRC_WRA_01_Init() with taps of
+   4 * NrChannels samples. Up to four channels are filtered at once. */
+void PK_Mc_D32F32C14G11_TRC_WRA_01( Biquad_FLOAT_Instance_t       *pInstance,
+                                    LVM_FLOAT               *pDataIn,
+                                    LVM_FLOAT               *pDataOut,
+                                    LVM_INT16               NrFrames,
+                                    LVM_INT16               NrChannels);
 #else
 void PK_2I_D32F32C14G11_TRC_WRA_01 (        Biquad_Instance_t       *pInstance,
                                             LVM_INT32                    *pDataIn,
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BIQUAD.h"
+#include "BQ_2I_D32F32Cll_TRC_WRA_01_Private.h"
+#include "BQ_Mc_Float_Private.h"
+
+#ifdef BUILD_FLOAT
+/**************************************************************************
+ ASSUMPTIONS:
+ COEFS-
+ pBiquadState->coefs[0] is A2, pBiquadState->coefs[1] is A1
+ pBiquadState->coefs[2] is A0, pBiquadState->coefs[3] is -B2
+ pBiquadState->coefs[4] is -B1
+
+ DELAYS-
+ pBiquadState->pDelays[0 * NrChannels + ch] is x(n-1) of channel ch
+ pBiquadState->pDelays[1 * NrChannels + ch] is x(n-2) of channel ch
+ pBiquadState->pDelays[2 * NrChannels + ch] is y(n-1) of channel ch
+ pBiquadState->pDelays[3 * NrChannels + ch] is y(n-2) of channel ch
+ For NrChannels = 2 this is the layout of BQ_2I_D32F32C30_TRC_WRA_01.
+***************************************************************************/
+
+/* Filters Width (1 to 4) channels starting at Channel, the state stays in registers */
+static LVM_ALWAYS_INLINE void BQ_Mc_Lanes(PFilter_State_FLOAT pBiquadState,
+                                          const LVM_FLOAT     *pDataIn,
+                                          LVM_FLOAT           *pDataOut,
+                                          LVM_INT16           NrFrames,
+                                          LVM_INT16           NrChannels,
+                                          LVM_INT16           Channel,
+                                          LVM_INT16           Width)
+{
+    LVM_FLOAT *pDelays = pBiquadState->pDelays + Channel;
+    const LVM_FLOAT_x4 A2 = LVM_Splat_x4(pBiquadState->coefs[0]);
+    const LVM_FLOAT_x4 A1 = LVM_Splat_x4(pBiquadState->coefs[1]);
+    const LVM_FLOAT_x4 A0 = LVM_Splat_x4(pBiquadState->coefs[2]);
+    const LVM_FLOAT_x4 B2 = LVM_Splat_x4(pBiquadState->coefs[3]);
+    const LVM_FLOAT_x4 B1 = LVM_Splat_x4(pBiquadState->coefs[4]);
+    LVM_FLOAT_x4 x1 = LVM_Load_x4(pDelays, Width);
+    LVM_FLOAT_x4 x2 = LVM_Load_x4(pDelays + NrChannels, Width);
+    LVM_FLOAT_x4 y1 = LVM_Load_x4(pDelays + 2 * NrChannels, Width);
+    LVM_FLOAT_x4 y2 = LVM_Load_x4(pDelays + 3 * NrChannels, Width);
+    LVM_INT16 ii;
+
+    pDataIn += Channel;
+    pDataOut += Channel;
+    for (ii = NrFrames; ii != 0; ii--)
+    {
+        LVM_FLOAT_x4 x = LVM_Load_x4(pDataIn, Width);
+
+        /* yn = A2 * x(n-2) + A1 * x(n-1) + A0 * x(n) - B2 * y(n-2) - B1 * y(n-1) */
+        LVM_FLOAT_x4 yn = A2 * x2 + A1 * x1 + A0 * x + B2 * y2 + B1 * y1;
+        LVM_Store_x4(pDataOut, yn, Width);
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = yn;
+        pDataIn += NrChannels;
+        pDataOut += NrChannels;
+    }
+
+    LVM_Store_x4(pDelays, x1, Width);
+    LVM_Store_x4(pDelays + NrChannels, x2, Width);
+    LVM_Store_x4(pDelays + 2 * NrChannels, y1, Width);
+    LVM_Store_x4(pDelays + 3 * NrChannels, y2, Width);
+}
+
+void BQ_Mc_D32F32C30_TRC_WRA_01 ( Biquad_FLOAT_Instance_t       *pInstance,
+                                     LVM_FLOAT               *pDataIn,
+                                     LVM_FLOAT               *pDataOut,
+                                     LVM_INT16               NrFrames,
+                                     LVM_INT16               NrChannels)
+    {
+        PFilter_State_FLOAT pBiquadState = (PFilter_State_FLOAT) pInstance;
+        LVM_INT16 ch;
+
+        /* The width is a constant in each call so that the loads and stores are inlined */
+        for (ch = 0; ch < NrChannels; ch += LVM_VECTOR_LANES)
+        {
+            switch (NrChannels - ch)
+            {
+                case 1:
+                    BQ_Mc_Lanes(pBiquadState, pDataIn, pDataOut, NrFrames, NrChannels, ch, 1);
+                    break;
+                case 2:
+                    BQ_Mc_Lanes(pBiquadState, pDataIn, pDataOut, NrFrames, NrChannels, ch, 2);
+                    break;
+                case 3:
+                    BQ_Mc_Lanes(pBiquadState, pDataIn, pDataOut, NrFrames, NrChannels, ch, 3);
+                    break;
+                default:
+                    BQ_Mc_Lanes(pBiquadState, pDataIn, pDataOut, NrFrames, NrChannels, ch, 4);
+                    break;
+            }
+        }
+    }
+#endif /*BUILD_FLOAT*/
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BQ_MC_FLOAT_PRIVATE_H_
+#define _BQ_MC_FLOAT_PRIVATE_H_
+
+#include "LVM_Types.h"
+
+#ifdef BUILD_FLOAT
+
+/**********************************************************************************
+   VECTOR TYPE DEFINITIONS
+
+   The recursion of a biquad prevents processing several samples of a channel at
+   once, so the multichannel filters process up to four channels of a frame in the
+   lanes of a vector. The vector extension is lowered to NEON on ARM and to SSE on
+   x86, and to scalar code elsewhere.
+***********************************************************************************/
+
+#define LVM_VECTOR_LANES    4
+
+typedef LVM_FLOAT LVM_FLOAT_x4 __attribute__((vector_size(LVM_VECTOR_LANES * sizeof(LVM_FLOAT))));
+
+#define LVM_ALWAYS_INLINE   inline __attribute__((always_inline))
+
+/* Returns a vector with all lanes set to value */
+static LVM_ALWAYS_INLINE LVM_FLOAT_x4 LVM_Splat_x4(LVM_FLOAT value)
+{
+    LVM_FLOAT_x4 v = {value, value, value, value};
+    return v;
+}
+
+/* Loads Width (1 to 4) consecutive samples, the other lanes are zero */
+static LVM_ALWAYS_INLINE LVM_FLOAT_x4 LVM_Load_x4(const LVM_FLOAT *pData, LVM_INT16 Width)
+{
+    LVM_FLOAT_x4 v;
+    if (Width == LVM_VECTOR_LANES)
+    {
+        __builtin_memcpy(&v, pData, sizeof(v));
+    }
+    else
+    {
+        /* Built lane by lane, which compilers keep in registers unlike a partial copy */
+        v[0] = pData[0];
+        v[1] = Width > 1 ? pData[1] : 0.0f;
+        v[2] = Width > 2 ? pData[2] : 0.0f;
+        v[3] = 0.0f;
+    }
+    return v;
+}
+
+/* Stores the first Width (1 to 4) lanes */
+static LVM_ALWAYS_INLINE void LVM_Store_x4(LVM_FLOAT *pData, LVM_FLOAT_x4 v, LVM_INT16 Width)
+{
+    if (Width == LVM_VECTOR_LANES)
+    {
+        __builtin_memcpy(pData, &v, sizeof(v));
+    }
+    else
+    {
+        pData[0] = v[0];
+        if (Width > 1)
+        {
+            pData[1] = v[1];
+        }
+        if (Width > 2)
+        {
+            pData[2] = v[2];
+        }
+    }
+}
+
+#endif /* BUILD_FLOAT */
+
+#endif /* _BQ_MC_FLOAT_PRIVATE_H_ */
@@ -0,0 +1,43 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_VENDOR_MODULE := true
+LOCAL_SRC_FILES:= lvm_biquad_tests.cpp
+LOCAL_CFLAGS += -DBUILD_FLOAT -DHIGHER_FS
+LOCAL_CFLAGS += -Wall -Werror
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../lib/Common/lib
+LOCAL_STATIC_LIBRARIES := libmusicbundle
+LOCAL_MODULE := lvm_biquad_tests
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_VENDOR_MODULE := true
+LOCAL_SRC_FILES:= \
+	reverb_convolution_tests.cpp \
+	../wrapper/Reverb/ConvolutionReverb.cpp
+LOCAL_CFLAGS += -Wall -Werror
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../wrapper/Reverb
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_MODULE := reverb_convolution_tests
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_VENDOR_MODULE := true
+LOCAL_SRC_FILES:= \
+	reverb_wrapper_tests.cpp \
+	../wrapper/Reverb/EffectReverb.cpp \
+	../wrapper/Reverb/ConvolutionReverb.cpp
+LOCAL_CFLAGS += -DBUILD_FLOAT -DHIGHER_FS
+LOCAL_CFLAGS += -Wall -Werror
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../wrapper/Reverb \
+	$(LOCAL_PATH)/../lib/Common/lib \
+	$(LOCAL_PATH)/../lib/Reverb/lib \
+	$(call include-path-for, audio-effects)
+LOCAL_STATIC_LIBRARIES := libreverb
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_HEADER_LIBRARIES += libhardware_headers
+LOCAL_MODULE := reverb_wrapper_tests
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the float biquads of the LVM Bundle, which filter up to four channels at once.
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "BIQUAD.h"
+
+namespace {
+
+constexpr double kSampleRate = 48000.;
+
+// Peaking filter with the gain and quality factor of an equalizer band.
+PK_FLOAT_Coefs_t peakingCoefs(double frequency, double gaindB, double q) {
+    const double w0 = 2. * M_PI * frequency / kSampleRate;
+    const double alpha = sin(w0) / (2. * q);
+    const double a0 = 1. + alpha;
+    PK_FLOAT_Coefs_t coefs;
+    coefs.A0 = alpha / a0;
+    coefs.B1 = 2. * cos(w0) / a0;         // -b1
+    coefs.B2 = -(1. - alpha) / a0;        // -b2
+    coefs.G = pow(10., gaindB / 20.) - 1.;
+    return coefs;
+}
+
+// Second order low pass filter, of the form used by the bass enhancement.
+BQ_FLOAT_Coefs_t lowPassCoefs(double frequency, double q) {
+    const double w0 = 2. * M_PI * frequency / kSampleRate;
+    const double alpha = sin(w0) / (2. * q);
+    const double a0 = 1. + alpha;
+    BQ_FLOAT_Coefs_t coefs;
+    coefs.A0 = (1. - cos(w0)) / 2. / a0;
+    coefs.A1 = (1. - cos(w0)) / a0;
+    coefs.A2 = coefs.A0;
+    coefs.B1 = 2. * cos(w0) / a0;         // -b1
+    coefs.B2 = -(1. - alpha) / a0;        // -b2
+    return coefs;
+}
+
+double peakingMagnitude(const PK_FLOAT_Coefs_t &coefs, double frequency) {
+    const std::complex<double> z1 = std::polar(1., -2. * M_PI * frequency / kSampleRate);
+    const std::complex<double> z2 = z1 * z1;
+    const std::complex<double> bandPass =
+            (double)coefs.A0 * (1. - z2) / (1. - (double)coefs.B1 * z1 - (double)coefs.B2 * z2);
+    return std::abs(1. + (double)coefs.G * bandPass);
+}
+
+// A multichannel filter, its taps hold 4 samples per channel.
+template <typename Coefs>
+struct Filter {
+    Biquad_FLOAT_Instance_t instance;
+    std::vector<LVM_FLOAT> taps;
+
+    Filter(Coefs coefs, int channelCount) : taps(4 * channelCount) {
+        init(&coefs);
+    }
+    // the instance points to the taps, which a move keeps but a copy does not
+    Filter(Filter &&) = default;
+    Filter(const Filter &) = delete;
+
+    void init(PK_FLOAT_Coefs_t *coefs) {
+        PK_2I_D32F32CssGss_TRC_WRA_01_Init(&instance,
+                (Biquad_2I_Order2_FLOAT_Taps_t *)taps.data(), coefs);
+    }
+    void init(BQ_FLOAT_Coefs_t *coefs) {
+        BQ_2I_D32F32Cll_TRC_WRA_01_Init(&instance,
+                (Biquad_2I_Order2_FLOAT_Taps_t *)taps.data(), coefs);
+    }
+};
+
+void process(Filter<PK_FLOAT_Coefs_t> &filter, LVM_FLOAT *in, LVM_FLOAT *out,
+             int frameCount, int channelCount) {
+    PK_Mc_D32F32C14G11_TRC_WRA_01(&filter.instance, in, out, frameCount, channelCount);
+}
+
+void process(Filter<BQ_FLOAT_Coefs_t> &filter, LVM_FLOAT *in, LVM_FLOAT *out,
+             int frameCount, int channelCount) {
+    BQ_Mc_D32F32C30_TRC_WRA_01(&filter.instance, in, out, frameCount, channelCount);
+}
+
+// Double precision direct form I filter of one channel.
+struct Reference {
+    double a0, a1, a2, b1, b2, gain;
+    bool peaking;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    explicit Reference(const PK_FLOAT_Coefs_t &c)
+        : a0(c.A0), a1(0), a2(-c.A0), b1(c.B1), b2(c.B2), gain(c.G), peaking(true) {}
+    explicit Reference(const BQ_FLOAT_Coefs_t &c)
+        : a0(c.A0), a1(c.A1), a2(c.A2), b1(c.B1), b2(c.B2), gain(0), peaking(false) {}
+
+    double filter(double x) {
+        const double y = a0 * x + a1 * x1 + a2 * x2 + b1 * y1 + b2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return peaking ? gain * y + x : y;
+    }
+};
+
+std::vector<LVM_FLOAT> noise(size_t sampleCount) {
+    std::minstd_rand generator(42);
+    std::uniform_real_distribution<LVM_FLOAT> distribution(-1.f, 1.f);
+    std::vector<LVM_FLOAT> samples(sampleCount);
+    for (auto &sample : samples) {
+        sample = distribution(generator);
+    }
+    return samples;
+}
+
+// Compares the filter to the reference for all channel counts, for blocks of varying sizes
+// filtered in place or not.
+template <typename Coefs>
+void checkAgainstReference(const Coefs &coefs) {
+    constexpr int kFrameCount = 4096;
+    for (int channelCount = 1; channelCount <= 8; channelCount++) {
+        SCOPED_TRACE(channelCount);
+        const std::vector<LVM_FLOAT> in = noise(kFrameCount * channelCount);
+        std::vector<LVM_FLOAT> out(in.size());
+        Filter<Coefs> filter(coefs, channelCount);
+        std::vector<Reference> references(channelCount, Reference(coefs));
+
+        bool inPlace = false;
+        for (int frame = 0, blockSize = 1; frame < kFrameCount; frame += blockSize, blockSize++) {
+            blockSize = std::min(blockSize, kFrameCount - frame);
+            LVM_FLOAT *dst = &out[frame * channelCount];
+            LVM_FLOAT *src = const_cast<LVM_FLOAT *>(&in[frame * channelCount]);
+            if (inPlace) {
+                std::copy(src, src + blockSize * channelCount, dst);
+                src = dst;
+            }
+            process(filter, src, dst, blockSize, channelCount);
+            inPlace = !inPlace;
+        }
+
+        double maxError = 0;
+        for (int frame = 0; frame < kFrameCount; frame++) {
+            for (int channel = 0; channel < channelCount; channel++) {
+                const size_t i = frame * channelCount + channel;
+                maxError = std::max(maxError,
+                        std::abs(references[channel].filter(in[i]) - (double)out[i]));
+            }
+        }
+        EXPECT_LT(maxError, 1e-4);
+    }
+}
+
+} // namespace
+
+TEST(lvm_biquad_tests, peaking_frequency_response) {
+    const PK_FLOAT_Coefs_t coefs = peakingCoefs(1000., 12., 1.);
+    const double frequencies[] = {60., 230., 500., 910., 1000., 1100., 3600., 14000.};
+    const int frequencyCount = sizeof(frequencies) / sizeof(frequencies[0]);
+    constexpr int kFrameCount = 48000;
+    constexpr int kSettleFrames = 4800;
+
+    for (int channelCount = 1; channelCount <= 8; channelCount++) {
+        // Each channel gets its own frequency, which also checks that the lanes are independent.
+        std::vector<LVM_FLOAT> samples(kFrameCount * channelCount);
+        for (int frame = 0; frame < kFrameCount; frame++) {
+            for (int channel = 0; channel < channelCount; channel++) {
+                const double frequency = frequencies[channel % frequencyCount];
+                samples[frame * channelCount + channel] =
+                        0.25 * sin(2. * M_PI * frequency * frame / kSampleRate);
+            }
+        }
+        Filter<PK_FLOAT_Coefs_t> filter(coefs, channelCount);
+        process(filter, samples.data(), samples.data(), kFrameCount, channelCount);
+
+        for (int channel = 0; channel < channelCount; channel++) {
+            const double frequency = frequencies[channel % frequencyCount];
+            // amplitude of the output at the frequency of the input, once the filter settled
+            std::complex<double> sum = 0;
+            for (int frame = kSettleFrames; frame < kFrameCount; frame++) {
+                sum += (double)samples[frame * channelCount + channel] *
+                        std::polar(1., -2. * M_PI * frequency * frame / kSampleRate);
+            }
+            const double magnitude = 2. * std::abs(sum) / (kFrameCount - kSettleFrames) / 0.25;
+            EXPECT_NEAR(20. * log10(peakingMagnitude(coefs, frequency)),
+                        20. * log10(magnitude), 0.05)
+                    << channelCount << " channels, " << frequency << " Hz";
+        }
+    }
+}
+
+TEST(lvm_biquad_tests, peaking_matches_reference) {
+    checkAgainstReference(peakingCoefs(3000., -9., 2.));
+}
+
+TEST(lvm_biquad_tests, biquad_matches_reference) {
+    checkAgainstReference(lowPassCoefs(150., 0.7));
+}
+
+TEST(lvm_biquad_tests, stereo_interleaved_is_multichannel) {
+    constexpr int kFrameCount = 1000;
+    const PK_FLOAT_Coefs_t peaking = peakingCoefs(500., 6., 0.7);
+    const BQ_FLOAT_Coefs_t lowPass = lowPassCoefs(500., 0.7);
+    std::vector<LVM_FLOAT> in = noise(kFrameCount * 2);
+    std::vector<LVM_FLOAT> stereo(in.size());
+    std::vector<LVM_FLOAT> multichannel(in.size());
+
+    Filter<PK_FLOAT_Coefs_t> pk2I(peaking, 2), pkMc(peaking, 2);
+    PK_2I_D32F32C14G11_TRC_WRA_01(&pk2I.instance, in.data(), stereo.data(), kFrameCount);
+    process(pkMc, in.data(), multichannel.data(), kFrameCount, 2);
+    EXPECT_EQ(stereo, multichannel);
+    EXPECT_EQ(pk2I.taps, pkMc.taps);
+
+    Filter<BQ_FLOAT_Coefs_t> bq2I(lowPass, 2), bqMc(lowPass, 2);
+    BQ_2I_D32F32C30_TRC_WRA_01(&bq2I.instance, in.data(), stereo.data(), kFrameCount);
+    process(bqMc, in.data(), multichannel.data(), kFrameCount, 2);
+    EXPECT_EQ(stereo, multichannel);
+    EXPECT_EQ(bq2I.taps, bqMc.taps);
+}
+
+// The per channel loop the float equalizer used before, for comparison.
+static void scalarPeaking(LVM_FLOAT *pDelays, const PK_FLOAT_Coefs_t &coefs,
+                          const LVM_FLOAT *in, LVM_FLOAT *out, int frameCount, int channelCount) {
+    for (int frame = 0; frame < frameCount; frame++) {
+        for (int channel = 0; channel < channelCount; channel++) {
+            LVM_FLOAT *x1 = &pDelays[channel];
+            LVM_FLOAT *x2 = x1 + channelCount;
+            LVM_FLOAT *y1 = x2 + channelCount;
+            LVM_FLOAT *y2 = y1 + channelCount;
+            const LVM_FLOAT x = *in++;
+            const LVM_FLOAT y = coefs.A0 * (x - *x2) + coefs.B2 * *y2 + coefs.B1 * *y1;
+            *out++ = coefs.G * y + x;
+            *x2 = *x1;
+            *x1 = x;
+            *y2 = *y1;
+            *y1 = y;
+        }
+    }
+}
+
+TEST(lvm_biquad_tests, benchmark) {
+    constexpr int kBands = 5; // the equalizer of the LVM Bundle
+    constexpr int kTotalFrames = 1 << 20;
+    const PK_FLOAT_Coefs_t coefs = peakingCoefs(1000., 6., 1.);
+
+    for (int channelCount : {2, 8}) {
+        for (int frameCount : {16, 64, 256, 1024, 4096}) {
+            std::vector<LVM_FLOAT> in = noise(frameCount * channelCount);
+            std::vector<LVM_FLOAT> out(in.size());
+            double nanosPerFrame[2];
+            for (int vector = 0; vector < 2; vector++) {
+                std::vector<Filter<PK_FLOAT_Coefs_t>> filters;
+                for (int band = 0; band < kBands; band++) {
+                    filters.emplace_back(coefs, channelCount);
+                }
+                const auto start = std::chrono::steady_clock::now();
+                for (int frames = 0; frames < kTotalFrames; frames += frameCount) {
+                    // the bands are cascaded in place, as in the equalizer
+                    LVM_FLOAT *src = in.data();
+                    for (auto &filter : filters) {
+                        if (vector) {
+                            process(filter, src, out.data(), frameCount, channelCount);
+                        } else {
+                            scalarPeaking(filter.taps.data(), coefs, src, out.data(),
+                                          frameCount, channelCount);
+                        }
+                        src = out.data();
+                    }
+                }
+                const std::chrono::duration<double, std::nano> elapsed =
+                        std::chrono::steady_clock::now() - start;
+                nanosPerFrame[vector] = elapsed.count() / kTotalFrames;
+                // bounded output, the filters are stable
+                for (LVM_FLOAT sample : out) {
+                    ASSERT_TRUE(std::isfinite(sample));
+                }
+            }
+            printf("%d channels, %4d frames: scalar %6.2f ns/frame, vector %6.2f ns/frame, "
+                   "%4.1fx\n", channelCount, frameCount, nanosPerFrame[0], nanosPerFrame[1],
+                   nanosPerFrame[0] / nanosPerFrame[1]);
+        }
+    }
+}
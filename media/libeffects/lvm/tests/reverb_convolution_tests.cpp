@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the partitioned convolution of the convolution reverb preset.
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ConvolutionReverb.h"
+
+using android::ConvolutionReverb;
+using android::RealFft;
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+
+std::vector<float> noise(size_t sampleCount, unsigned seed = 42) {
+    std::minstd_rand generator(seed);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<float> samples(sampleCount);
+    for (auto &sample : samples) {
+        sample = distribution(generator);
+    }
+    return samples;
+}
+
+// Decaying noise, as the impulse response of a room.
+std::vector<float> impulseResponse(size_t frameCount, size_t channelCount) {
+    std::vector<float> samples = noise(frameCount * channelCount, 7);
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        const float decay = exp(-6.9 * frame / frameCount); // -60 dB at the end
+        for (size_t channel = 0; channel < channelCount; channel++) {
+            samples[frame * channelCount + channel] *= 0.1f * decay;
+        }
+    }
+    return samples;
+}
+
+// Double precision direct convolution of an output channel, delayed by the latency.
+double directConvolution(const std::vector<float> &in, size_t inputChannels,
+                         const std::vector<float> &ir, size_t irChannels,
+                         size_t frame, size_t outputChannel, size_t latency) {
+    if (frame < latency) {
+        return 0;
+    }
+    frame -= latency;
+    const size_t irFrames = ir.size() / irChannels;
+    double sum = 0;
+    for (size_t i = 0; i < irFrames && i <= frame; i++) {
+        sum += (double)ir[i * irChannels + outputChannel % irChannels] *
+                in[(frame - i) * inputChannels + outputChannel % inputChannels];
+    }
+    return sum;
+}
+
+// Writes a WAV file, whose data chunk claims claimedDataSize bytes if not 0.
+void writeWav(const char *path, const void *samples, size_t frameCount, uint16_t channelCount,
+              uint16_t format, uint16_t bitsPerSample, uint32_t claimedDataSize = 0) {
+    const uint32_t dataSize = frameCount * channelCount * bitsPerSample / 8;
+    const uint32_t riffSize = 4 + 8 + 16 + 8 + 8 + dataSize;
+    const uint32_t fmtSize = 16;
+    const uint32_t junkSize = 0;
+    const uint16_t blockAlign = channelCount * bitsPerSample / 8;
+    const uint32_t byteRate = kSampleRate * blockAlign;
+    FILE *file = fopen(path, "wb");
+    ASSERT_NE(nullptr, file);
+    fwrite("RIFF", 4, 1, file);
+    fwrite(&riffSize, 4, 1, file);
+    fwrite("WAVE", 4, 1, file);
+    fwrite("fmt ", 4, 1, file);
+    fwrite(&fmtSize, 4, 1, file);
+    fwrite(&format, 2, 1, file);
+    fwrite(&channelCount, 2, 1, file);
+    fwrite(&kSampleRate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bitsPerSample, 2, 1, file);
+    // chunks other than the format and the data are skipped
+    fwrite("JUNK", 4, 1, file);
+    fwrite(&junkSize, 4, 1, file);
+    fwrite("data", 4, 1, file);
+    fwrite(claimedDataSize != 0 ? &claimedDataSize : &dataSize, 4, 1, file);
+    fwrite(samples, dataSize, 1, file);
+    fclose(file);
+}
+
+} // namespace
+
+TEST(reverb_convolution_tests, fft_matches_dft) {
+    for (size_t size = 4; size <= 1024; size *= 2) {
+        SCOPED_TRACE(size);
+        RealFft fft(size);
+        ASSERT_EQ(size / 2 + 1, fft.bins());
+        const std::vector<float> in = noise(size);
+        std::vector<float> re(fft.bins()), im(fft.bins()), out(size);
+        fft.forward(in.data(), re.data(), im.data());
+
+        double maxError = 0;
+        for (size_t k = 0; k < fft.bins(); k++) {
+            std::complex<double> bin = 0;
+            for (size_t n = 0; n < size; n++) {
+                bin += (double)in[n] * std::polar(1., -2. * M_PI * k * n / size);
+            }
+            maxError = std::max(maxError, std::abs(bin - std::complex<double>(re[k], im[k])));
+        }
+        EXPECT_LT(maxError, 1e-5 * size);
+
+        fft.inverse(re.data(), im.data(), out.data());
+        for (size_t n = 0; n < size; n++) {
+            EXPECT_NEAR(in[n], out[n], 1e-5);
+        }
+    }
+}
+
+// Compares the convolution to the direct convolution for channel layouts and lengths of
+// impulse response, with the input split in blocks of varying sizes.
+TEST(reverb_convolution_tests, matches_direct_convolution) {
+    constexpr size_t kBlockFrames = 64;
+    constexpr size_t kFrameCount = 2000;
+    const struct {
+        size_t inputChannels, outputChannels, irChannels, irFrames;
+    } layouts[] = {
+        {1, 2, 2, 300},   // auxiliary
+        {2, 2, 1, 64},    // single partition
+        {2, 2, 2, 1000},
+        {6, 6, 2, 129},   // 5.1, stereo impulse response
+        {8, 8, 8, 200},
+    };
+    for (const auto &layout : layouts) {
+        SCOPED_TRACE(testing::Message() << layout.inputChannels << " to "
+                << layout.outputChannels << " channels, " << layout.irChannels
+                << " x " << layout.irFrames << " impulse response");
+        const std::vector<float> ir = impulseResponse(layout.irFrames, layout.irChannels);
+        const std::vector<float> in = noise(kFrameCount * layout.inputChannels);
+        std::vector<float> out(kFrameCount * layout.outputChannels);
+
+        ConvolutionReverb reverb(kBlockFrames);
+        ASSERT_EQ(0, reverb.setImpulseResponse(ir.data(), layout.irFrames, layout.irChannels,
+                                               kSampleRate));
+        ASSERT_EQ(0, reverb.configure(layout.inputChannels, layout.outputChannels));
+        ASSERT_EQ(kBlockFrames, reverb.getLatencyFrames());
+        for (size_t frame = 0, count = 1; frame < kFrameCount; frame += count, count += 7) {
+            count = std::min(count, kFrameCount - frame);
+            reverb.process(&in[frame * layout.inputChannels],
+                           &out[frame * layout.outputChannels], count);
+        }
+
+        double maxError = 0;
+        for (size_t frame = 0; frame < kFrameCount; frame++) {
+            for (size_t channel = 0; channel < layout.outputChannels; channel++) {
+                const double expected = directConvolution(in, layout.inputChannels,
+                        ir, layout.irChannels, frame, channel, kBlockFrames);
+                maxError = std::max(maxError,
+                        std::abs(expected - out[frame * layout.outputChannels + channel]));
+            }
+        }
+        EXPECT_LT(maxError, 1e-4);
+    }
+}
+
+TEST(reverb_convolution_tests, impulse_response_limits) {
+    ConvolutionReverb reverb;
+    ASSERT_EQ(0, reverb.configure(2, 2));
+    EXPECT_FALSE(reverb.hasImpulseResponse());
+
+    // no impulse response is silence
+    std::vector<float> in = noise(1000), out(in.size(), 1.f);
+    reverb.process(in.data(), out.data(), in.size() / 2);
+    EXPECT_EQ(std::vector<float>(out.size(), 0.f), out);
+
+    const std::vector<float> ir(9 * kSampleRate, 0.f);
+    EXPECT_EQ(-EINVAL, reverb.setImpulseResponse(ir.data(), 1, 9, kSampleRate));
+    EXPECT_EQ(0, reverb.setImpulseResponse(ir.data(), ir.size(), 1, kSampleRate));
+    EXPECT_EQ(ConvolutionReverb::kMaxImpulseResponseSeconds * kSampleRate,
+              reverb.getImpulseResponseFrames());
+    reverb.clearImpulseResponse();
+    EXPECT_FALSE(reverb.hasImpulseResponse());
+    EXPECT_EQ(-EINVAL, reverb.configure(9, 2));
+}
+
+// Impulse responses received in several parts are prepared by the worker thread, and used by
+// process() once ready.
+TEST(reverb_convolution_tests, write_impulse_response) {
+    constexpr size_t kBlockFrames = 64;
+    constexpr size_t kChannels = 2;
+    constexpr size_t kIrFrames = 1000;
+    constexpr size_t kFrameCount = 2000;
+    const std::vector<float> ir = impulseResponse(kIrFrames, kChannels);
+    const std::vector<float> in = noise(kFrameCount * kChannels);
+    std::vector<float> expected(in.size()), out(in.size());
+
+    ConvolutionReverb reference(kBlockFrames);
+    ASSERT_EQ(0, reference.configure(kChannels, kChannels));
+    ASSERT_EQ(0, reference.setImpulseResponse(ir.data(), kIrFrames, kChannels, kSampleRate));
+    reference.process(in.data(), expected.data(), kFrameCount);
+
+    ConvolutionReverb reverb(kBlockFrames);
+    ASSERT_EQ(0, reverb.configure(kChannels, kChannels));
+    for (size_t frame = 0, count = 300; frame < kIrFrames; frame += count) {
+        count = std::min(count, kIrFrames - frame);
+        ASSERT_EQ(0, reverb.writeImpulseResponse(&ir[frame * kChannels], frame, count,
+                                                 kIrFrames, kChannels, kSampleRate));
+        EXPECT_EQ(frame + count == kIrFrames, reverb.hasImpulseResponse());
+    }
+    EXPECT_EQ(kIrFrames, reverb.getImpulseResponseFrames());
+    reverb.waitForImpulseResponse();
+    reverb.process(in.data(), out.data(), kFrameCount);
+    EXPECT_EQ(expected, out);
+
+    // frames out of order, past the end or of another impulse response are refused
+    EXPECT_EQ(0, reverb.writeImpulseResponse(ir.data(), 0, 10, kIrFrames, kChannels,
+                                             kSampleRate));
+    EXPECT_EQ(-EINVAL, reverb.writeImpulseResponse(ir.data(), 20, 10, kIrFrames, kChannels,
+                                                   kSampleRate));
+    EXPECT_EQ(-EINVAL, reverb.writeImpulseResponse(ir.data(), 10, 10, kIrFrames, kChannels,
+                                                   kSampleRate));
+    EXPECT_EQ(0, reverb.writeImpulseResponse(ir.data(), 0, 10, 15, kChannels, kSampleRate));
+    EXPECT_EQ(-EINVAL, reverb.writeImpulseResponse(ir.data(), 10, 10, 15, kChannels,
+                                                   kSampleRate));
+    EXPECT_EQ(-EINVAL, reverb.writeImpulseResponse(ir.data(), 0, 10, 10, 9, kSampleRate));
+    EXPECT_EQ(-EINVAL, reverb.writeImpulseResponse(ir.data(), 0, 10,
+            ConvolutionReverb::kMaxImpulseResponseSeconds * kSampleRate + 1, kChannels,
+            kSampleRate));
+    // and the impulse response in use is kept
+    EXPECT_EQ(kIrFrames, reverb.getImpulseResponseFrames());
+
+    reverb.clearImpulseResponse();
+    EXPECT_FALSE(reverb.hasImpulseResponse());
+    reverb.waitForImpulseResponse();
+    reverb.process(in.data(), out.data(), kFrameCount);
+    EXPECT_EQ(std::vector<float>(out.size(), 0.f), out);
+}
+
+TEST(reverb_convolution_tests, read_wav) {
+    constexpr size_t kFrames = 1234;
+    const std::vector<float> ir = impulseResponse(kFrames, 2);
+    std::vector<int16_t> ir16(ir.size());
+    for (size_t i = 0; i < ir.size(); i++) {
+        ir16[i] = lrint(ir[i] * 32768.f);
+    }
+    char path[] = "/data/local/tmp/reverb_ir_XXXXXX";
+    char fallbackPath[] = "/tmp/reverb_ir_XXXXXX";
+    int fd = mkstemp(path);
+    const char *name = path;
+    if (fd < 0) {
+        fd = mkstemp(fallbackPath);
+        name = fallbackPath;
+    }
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    std::vector<float> samples;
+    size_t channelCount;
+    uint32_t sampleRate;
+    writeWav(name, ir.data(), kFrames, 2, 3 /* float */, 32);
+    EXPECT_EQ(0, ConvolutionReverb::readWav(name, &samples, &channelCount, &sampleRate));
+    EXPECT_EQ(ir, samples);
+    EXPECT_EQ(2u, channelCount);
+    EXPECT_EQ(kSampleRate, sampleRate);
+
+    writeWav(name, ir16.data(), kFrames / 2, 1, 1 /* PCM */, 16);
+    EXPECT_EQ(0, ConvolutionReverb::readWav(name, &samples, &channelCount, &sampleRate));
+    EXPECT_EQ(kFrames / 2, samples.size());
+    EXPECT_EQ(1u, channelCount);
+
+    writeWav(name, ir16.data(), kFrames, 2, 1 /* PCM */, 8);
+    EXPECT_EQ(-EINVAL, ConvolutionReverb::readWav(name, &samples, &channelCount, &sampleRate));
+
+    // a data chunk claiming more bytes than the file holds is refused, whatever its size
+    for (uint32_t dataSize : {uint32_t(kFrames * 4 + 2), 0x7ffffff0u, 0xffffffffu}) {
+        SCOPED_TRACE(dataSize);
+        writeWav(name, ir16.data(), kFrames, 2, 1 /* PCM */, 16, dataSize);
+        EXPECT_EQ(-EINVAL, ConvolutionReverb::readWav(name, &samples, &channelCount,
+                                                      &sampleRate));
+    }
+
+    unlink(name);
+    EXPECT_EQ(-EINVAL, ConvolutionReverb::readWav(name, &samples, &channelCount, &sampleRate));
+}
+
+// CPU time of a block relative to its duration, for impulse responses of 1 s and 3 s.
+TEST(reverb_convolution_tests, benchmark) {
+    constexpr size_t kChannels = 2;
+    for (size_t seconds : {1, 3}) {
+        const size_t irFrames = seconds * kSampleRate;
+        const std::vector<float> ir = impulseResponse(irFrames, kChannels);
+        for (size_t blockFrames : {128, 256, 512, 1024}) {
+            ConvolutionReverb reverb(blockFrames);
+            ASSERT_EQ(0, reverb.setImpulseResponse(ir.data(), irFrames, kChannels, kSampleRate));
+            ASSERT_EQ(0, reverb.configure(kChannels, kChannels));
+            const std::vector<float> in = noise(blockFrames * kChannels);
+            std::vector<float> out(in.size());
+
+            const size_t blockCount = 4 * kSampleRate / blockFrames;
+            double worstMicros = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t block = 0; block < blockCount; block++) {
+                const auto blockStart = std::chrono::steady_clock::now();
+                reverb.process(in.data(), out.data(), blockFrames);
+                const std::chrono::duration<double, std::micro> blockElapsed =
+                        std::chrono::steady_clock::now() - blockStart;
+                worstMicros = std::max(worstMicros, blockElapsed.count());
+            }
+            const std::chrono::duration<double, std::micro> elapsed =
+                    std::chrono::steady_clock::now() - start;
+            for (float sample : out) {
+                ASSERT_TRUE(std::isfinite(sample));
+            }
+            const double meanMicros = elapsed.count() / blockCount;
+            const double blockMicros = 1e6 * blockFrames / kSampleRate;
+            printf("%zu s impulse response, %4zu frames (%5.1f ms latency): "
+                   "%7.1f us/block mean, %7.1f us worst, %5.1f%% CPU\n",
+                   seconds, blockFrames, 1e3 * blockFrames / kSampleRate,
+                   meanMicros, worstMicros, 100. * meanMicros / blockMicros);
+        }
+    }
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test the float configurations of the reverb effects, and the impulse response parameter of
+// the preset reverbs, through the effect interface.
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <audio_effects/effect_presetreverb.h>
+#include <hardware/audio_effect.h>
+
+#include "EffectReverb.h"
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+namespace {
+
+const effect_uuid_t kInsertPresetReverbUuid =
+        {0x172cdf00, 0xa3bc, 0x11df, 0xa72f, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+const effect_uuid_t kAuxPresetReverbUuid =
+        {0xf29a1400, 0xa3bb, 0x11df, 0x8ddc, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr size_t kBlockFrames = 192;
+// of the input of an insert to the reverb, REVERB_SEND_LEVEL in EffectReverb.cpp
+constexpr float kSendLevel = 0.75f;
+
+std::vector<float> makeNoise(size_t count) {
+    std::vector<float> noise(count);
+    for (auto& sample : noise) {
+        sample = (float)rand() / RAND_MAX - 0.5f;
+    }
+    return noise;
+}
+
+class ReverbWrapperTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        if (mHandle != nullptr) {
+            EXPECT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(mHandle));
+        }
+    }
+
+    void create(const effect_uuid_t& uuid) {
+        ASSERT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&uuid, 0, 0, &mHandle));
+    }
+
+    // Returns the status of the command, or its reply if it succeeded.
+    int command(uint32_t cmdCode, uint32_t cmdSize, void* cmdData) {
+        int reply = 0;
+        uint32_t replySize = sizeof(reply);
+        const int status = (*mHandle)->command(mHandle, cmdCode, cmdSize, cmdData,
+                                               &replySize, &reply);
+        return status != 0 ? status : reply;
+    }
+
+    int setConfig(audio_format_t format, audio_channel_mask_t inputChannels,
+                  audio_channel_mask_t outputChannels) {
+        effect_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.inputCfg.samplingRate = config.outputCfg.samplingRate = kSampleRate;
+        config.inputCfg.format = config.outputCfg.format = format;
+        config.inputCfg.channels = inputChannels;
+        config.outputCfg.channels = outputChannels;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        config.inputCfg.mask = config.outputCfg.mask = EFFECT_CONFIG_ALL;
+        const int status = command(EFFECT_CMD_SET_CONFIG, sizeof(config), &config);
+        if (status == 0) {
+            mInputChannels = audio_channel_count_from_out_mask(inputChannels);
+            mOutputChannels = audio_channel_count_from_out_mask(outputChannels);
+        }
+        return status;
+    }
+
+    // A cmdSize other than 0 replaces the size of the command.
+    int setParameter(int32_t param, const void* value, uint32_t valueSize, uint32_t cmdSize = 0) {
+        std::vector<uint8_t> buffer(sizeof(effect_param_t) + sizeof(int32_t) + valueSize);
+        effect_param_t* p = (effect_param_t*)buffer.data();
+        p->psize = sizeof(int32_t);
+        p->vsize = valueSize;
+        memcpy(p->data, &param, sizeof(param));
+        memcpy(p->data + sizeof(int32_t), value, valueSize);
+        return command(EFFECT_CMD_SET_PARAM, cmdSize != 0 ? cmdSize : buffer.size(),
+                       buffer.data());
+    }
+
+    int setPreset(uint16_t preset) {
+        return setParameter(REVERB_PARAM_PRESET, &preset, sizeof(preset));
+    }
+
+    uint32_t getImpulseResponseFrames() {
+        uint32_t buffer[(sizeof(effect_param_t) + 2 * sizeof(uint32_t)) / sizeof(uint32_t)];
+        effect_param_t* p = (effect_param_t*)buffer;
+        const int32_t param = REVERB_PARAM_IMPULSE_RESPONSE;
+        p->psize = sizeof(param);
+        p->vsize = sizeof(uint32_t);
+        memcpy(p->data, &param, sizeof(param));
+        uint32_t replySize = sizeof(buffer);
+        EXPECT_EQ(0, (*mHandle)->command(mHandle, EFFECT_CMD_GET_PARAM,
+                                         sizeof(effect_param_t) + sizeof(param), buffer,
+                                         &replySize, buffer));
+        EXPECT_EQ(0, p->status);
+        uint32_t frames;
+        memcpy(&frames, p->data + sizeof(param), sizeof(frames));
+        return frames;
+    }
+
+    // Sends the interleaved samples of an impulse response, framesPerParameter at a time.
+    int sendImpulseResponse(const std::vector<float>& samples, uint32_t channelCount,
+                            uint32_t framesPerParameter) {
+        const uint32_t frameCount = samples.size() / channelCount;
+        for (uint32_t firstFrame = 0; firstFrame < frameCount; firstFrame += framesPerParameter) {
+            const uint32_t frames = std::min(framesPerParameter, frameCount - firstFrame);
+            const reverb_impulse_response_t header =
+                    {kSampleRate, channelCount, frameCount, firstFrame};
+            std::vector<uint8_t> value(sizeof(header) + frames * channelCount * sizeof(float));
+            memcpy(value.data(), &header, sizeof(header));
+            memcpy(value.data() + sizeof(header), &samples[firstFrame * channelCount],
+                   frames * channelCount * sizeof(float));
+            const int status = setParameter(REVERB_PARAM_IMPULSE_RESPONSE, value.data(),
+                                            value.size());
+            if (status != 0) {
+                return status;
+            }
+        }
+        return 0;
+    }
+
+    // Waits until the convolution preset uses the impulse response sent last.
+    bool waitForImpulseResponse(uint32_t frameCount) {
+        for (int i = 0; i < 1000; i++) {
+            if (getImpulseResponseFrames() == frameCount) {
+                return true;
+            }
+            usleep(1000);
+        }
+        return false;
+    }
+
+    // Processes the frames of the configuration in blocks of kBlockFrames.
+    std::vector<float> process(std::vector<float>& input) {
+        const size_t frameCount = input.size() / mInputChannels;
+        std::vector<float> output(frameCount * mOutputChannels);
+        for (size_t i = 0; i < frameCount; i += kBlockFrames) {
+            audio_buffer_t inBuffer, outBuffer;
+            inBuffer.frameCount = outBuffer.frameCount = std::min(kBlockFrames, frameCount - i);
+            inBuffer.f32 = &input[i * mInputChannels];
+            outBuffer.f32 = &output[i * mOutputChannels];
+            EXPECT_EQ(0, (*mHandle)->process(mHandle, &inBuffer, &outBuffer));
+        }
+        return output;
+    }
+
+    effect_handle_t mHandle = nullptr;
+    size_t mInputChannels = 0;
+    size_t mOutputChannels = 0;
+};
+
+TEST_F(ReverbWrapperTest, insertFloatConfig) {
+    create(kInsertPresetReverbUuid);
+    EXPECT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_STEREO,
+                           AUDIO_CHANNEL_OUT_STEREO));
+    EXPECT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_5POINT1,
+                           AUDIO_CHANNEL_OUT_5POINT1));
+    EXPECT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_7POINT1,
+                           AUDIO_CHANNEL_OUT_7POINT1));
+
+    // an insert keeps the channels of its input, from 2 to 8
+    EXPECT_EQ(-EINVAL, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_STEREO,
+                                 AUDIO_CHANNEL_OUT_5POINT1));
+    EXPECT_EQ(-EINVAL, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_MONO,
+                                 AUDIO_CHANNEL_OUT_MONO));
+    const audio_channel_mask_t nineChannels =
+            (audio_channel_mask_t)(AUDIO_CHANNEL_OUT_7POINT1 | AUDIO_CHANNEL_OUT_TOP_CENTER);
+    EXPECT_EQ(-EINVAL, setConfig(AUDIO_FORMAT_PCM_FLOAT, nineChannels, nineChannels));
+
+    // 16 bit stays stereo
+    EXPECT_EQ(0, setConfig(AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+                           AUDIO_CHANNEL_OUT_STEREO));
+    EXPECT_EQ(-EINVAL, setConfig(AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_5POINT1,
+                                 AUDIO_CHANNEL_OUT_5POINT1));
+}
+
+TEST_F(ReverbWrapperTest, auxiliaryFloatConfig) {
+    create(kAuxPresetReverbUuid);
+    EXPECT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_MONO,
+                           AUDIO_CHANNEL_OUT_STEREO));
+    EXPECT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_MONO,
+                           AUDIO_CHANNEL_OUT_5POINT1));
+
+    // an auxiliary effect has a mono input
+    EXPECT_EQ(-EINVAL, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_STEREO,
+                                 AUDIO_CHANNEL_OUT_STEREO));
+    EXPECT_EQ(-EINVAL, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_MONO,
+                                 AUDIO_CHANNEL_OUT_MONO));
+}
+
+// The multichannel insert reverberates the front pair and passes the other channels through.
+TEST_F(ReverbWrapperTest, insertFloatMultichannel) {
+    create(kInsertPresetReverbUuid);
+    ASSERT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_5POINT1,
+                           AUDIO_CHANNEL_OUT_5POINT1));
+    ASSERT_EQ(0, setPreset(REVERB_PRESET_LARGEHALL));
+    ASSERT_EQ(0, command(EFFECT_CMD_ENABLE, 0, nullptr));
+
+    std::vector<float> input = makeNoise(kSampleRate / 2 * mInputChannels);
+    const std::vector<float> output = process(input);
+
+    float reverbEnergy = 0;
+    for (size_t i = 0; i < output.size(); i++) {
+        const size_t channel = i % mOutputChannels;
+        ASSERT_TRUE(isfinite(output[i]));
+        if (channel < 2) {
+            reverbEnergy += (output[i] - input[i]) * (output[i] - input[i]);
+        } else {
+            ASSERT_FLOAT_EQ(input[i], output[i]) << "sample " << i;
+        }
+    }
+    EXPECT_GT(reverbEnergy, 0);
+}
+
+// The auxiliary reverb of a mono send is output on the front pair only.
+TEST_F(ReverbWrapperTest, auxiliaryFloatMonoToMultichannel) {
+    create(kAuxPresetReverbUuid);
+    ASSERT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_MONO,
+                           AUDIO_CHANNEL_OUT_5POINT1));
+    ASSERT_EQ(0, setPreset(REVERB_PRESET_LARGEHALL));
+    ASSERT_EQ(0, command(EFFECT_CMD_ENABLE, 0, nullptr));
+
+    std::vector<float> input = makeNoise(kSampleRate / 2);
+    const std::vector<float> output = process(input);
+
+    float frontEnergy[2] = {0, 0};
+    for (size_t i = 0; i < output.size(); i++) {
+        const size_t channel = i % mOutputChannels;
+        if (channel < 2) {
+            frontEnergy[channel] += output[i] * output[i];
+        } else {
+            ASSERT_EQ(0.0f, output[i]) << "sample " << i;
+        }
+    }
+    EXPECT_GT(frontEnergy[0], 0);
+    EXPECT_GT(frontEnergy[1], 0);
+}
+
+TEST_F(ReverbWrapperTest, impulseResponseParameter) {
+    create(kInsertPresetReverbUuid);
+    ASSERT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_STEREO,
+                           AUDIO_CHANNEL_OUT_STEREO));
+    EXPECT_EQ(0u, getImpulseResponseFrames());
+    // the convolution preset needs an impulse response
+    EXPECT_EQ(-EINVAL, setPreset(REVERB_PRESET_CONVOLUTION));
+
+    const uint32_t kFrames = 1000;
+    const std::vector<float> impulseResponse = makeNoise(kFrames * 2);
+    ASSERT_EQ(0, sendImpulseResponse(impulseResponse, 2, 300));
+    ASSERT_TRUE(waitForImpulseResponse(kFrames));
+    EXPECT_EQ(0, setPreset(REVERB_PRESET_CONVOLUTION));
+
+    // a header only, without samples, or with a partial frame
+    reverb_impulse_response_t header = {kSampleRate, 0, kFrames, 0};
+    EXPECT_EQ(-EINVAL, setParameter(REVERB_PARAM_IMPULSE_RESPONSE, &header, sizeof(header)));
+    header.channelCount = 9;
+    EXPECT_EQ(-EINVAL, setParameter(REVERB_PARAM_IMPULSE_RESPONSE, &header, sizeof(header)));
+    header.channelCount = 2;
+    std::vector<uint8_t> value(sizeof(header) + 3 * sizeof(float));
+    memcpy(value.data(), &header, sizeof(header));
+    EXPECT_EQ(-EINVAL, setParameter(REVERB_PARAM_IMPULSE_RESPONSE, value.data(), value.size()));
+    // a value beyond the command
+    value.resize(sizeof(header) + 2 * sizeof(float));
+    EXPECT_EQ(-EINVAL, setParameter(REVERB_PARAM_IMPULSE_RESPONSE, value.data(), value.size(),
+                                    sizeof(effect_param_t) + sizeof(int32_t) + sizeof(header)));
+
+    // a frameCount of 0 clears the impulse response
+    header.frameCount = 0;
+    EXPECT_EQ(0, setParameter(REVERB_PARAM_IMPULSE_RESPONSE, &header, sizeof(header)));
+    EXPECT_EQ(0u, getImpulseResponseFrames());
+    EXPECT_EQ(-EINVAL, setPreset(REVERB_PRESET_CONVOLUTION));
+}
+
+// An impulse response of a single frame of 1 adds the input delayed by the latency of the
+// convolution to each channel of the insert.
+TEST_F(ReverbWrapperTest, insertFloatConvolution) {
+    create(kInsertPresetReverbUuid);
+    ASSERT_EQ(0, setConfig(AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_5POINT1,
+                           AUDIO_CHANNEL_OUT_5POINT1));
+    ASSERT_EQ(0, sendImpulseResponse(std::vector<float>{1.0f}, 1, 1));
+    ASSERT_TRUE(waitForImpulseResponse(1));
+    ASSERT_EQ(0, setPreset(REVERB_PRESET_CONVOLUTION));
+    ASSERT_EQ(0, command(EFFECT_CMD_ENABLE, 0, nullptr));
+
+    std::vector<float> input = makeNoise(kSampleRate / 10 * mInputChannels);
+    const std::vector<float> output = process(input);
+
+    // the latency of the convolution, from the first wet sample
+    size_t latency = 0;
+    float wetEnergy = 0;
+    for (size_t i = 0; i < output.size(); i++) {
+        const float wet = output[i] - input[i];
+        wetEnergy += wet * wet;
+        if (latency == 0 && fabsf(wet) > 1e-6f) {
+            latency = i / mOutputChannels;
+        }
+    }
+    ASSERT_GT(wetEnergy, 0);
+    for (size_t i = latency * mOutputChannels; i < output.size(); i++) {
+        ASSERT_NEAR(input[i] + kSendLevel * input[i - latency * mOutputChannels], output[i],
+                    1e-5f) << "sample " << i << ", latency " << latency;
+    }
+}
+
+} // namespace
@@ -41,6 +41,7 @@ LOCAL_ARM_MODE := arm
 
 LOCAL_VENDOR_MODULE := true
 LOCAL_SRC_FILES:= \
+    Reverb/ConvolutionReverb.cpp \
     Reverb/EffectReverb.cpp
 
 LOCAL_CFLAGS += -fvisibility=hidden -DBUILD_FLOAT -DHIGHER_FS
@@ -302,6 +302,8 @@ extern "C" int EffectCreate(const effect_uuid_t *uuid,
 #ifdef BUILD_FLOAT
         pContext->pBundledContext->pInputBuffer             = NULL;
         pContext->pBundledContext->pOutputBuffer            = NULL;
+        pContext->pBundledContext->pAccumulateBuffer        = NULL;
+        pContext->pBundledContext->accumulateFrameCount     = 0;
 #endif
         for (int i = 0; i < FIVEBAND_NUMBANDS; i++) {
             pContext->pBundledContext->bandGaindB[i] = EQNB_5BandSoftPresets[i];
@@ -477,6 +479,9 @@ extern "C" int EffectRelease(effect_handle_t handle){
         if (pContext->pBundledContext->pOutputBuffer != NULL) {
             free(pContext->pBundledContext->pOutputBuffer);
         }
+        if (pContext->pBundledContext->pAccumulateBuffer != NULL) {
+            free(pContext->pBundledContext->pAccumulateBuffer);
+        }
 #endif
         delete pContext->pBundledContext;
         pContext->pBundledContext = LVM_NULL;
@@ -884,6 +889,69 @@ int LvmBundle_process(LVM_INT16        *pIn,
     }
     return 0;
 }    /* end LvmBundle_process */
+
+//----------------------------------------------------------------------------
+// LvmBundle_processFloat()
+//----------------------------------------------------------------------------
+// Purpose:
+// Apply LVM Bundle effects to float data, which the LVM Bundle processes natively
+//
+// Inputs:
+//  pIn:        pointer to stereo float input data
+//  pOut:       pointer to stereo float output data
+//  frameCount: Frames to process
+//  pContext:   effect engine context
+//
+//  Outputs:
+//  pOut:       pointer to updated stereo float output data
+//
+//----------------------------------------------------------------------------
+int LvmBundle_processFloat(LVM_FLOAT        *pIn,
+                           LVM_FLOAT        *pOut,
+                           int              frameCount,
+                           EffectContext    *pContext){
+
+    LVM_ReturnStatus_en     LvmStatus = LVM_SUCCESS;                /* Function call status */
+    LVM_FLOAT               *pOutTmp;
+
+    if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE){
+        pOutTmp = pOut;
+    } else if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
+        if (pContext->pBundledContext->accumulateFrameCount < frameCount) {
+            if (pContext->pBundledContext->pAccumulateBuffer != NULL) {
+                free(pContext->pBundledContext->pAccumulateBuffer);
+            }
+            pContext->pBundledContext->pAccumulateBuffer =
+                    (LVM_FLOAT *)malloc(frameCount * sizeof(LVM_FLOAT) * FCC_2);
+            if (pContext->pBundledContext->pAccumulateBuffer == NULL) {
+                pContext->pBundledContext->accumulateFrameCount = 0;
+                return -ENOMEM;
+            }
+            pContext->pBundledContext->accumulateFrameCount = frameCount;
+        }
+        pOutTmp = pContext->pBundledContext->pAccumulateBuffer;
+    } else {
+        ALOGV("LVM_ERROR : LvmBundle_processFloat invalid access mode");
+        return -EINVAL;
+    }
+
+    /* Process the samples */
+    LvmStatus = LVM_Process(pContext->pBundledContext->hInstance, /* Instance handle */
+                            pIn,                                  /* Input buffer */
+                            pOutTmp,                              /* Output buffer */
+                            (LVM_UINT16)frameCount,               /* Number of samples to read */
+                            0);                                   /* Audo Time */
+
+    LVM_ERROR_CHECK(LvmStatus, "LVM_Process", "LvmBundle_processFloat")
+    if(LvmStatus != LVM_SUCCESS) return -EINVAL;
+
+    if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
+        for (int i = 0; i < frameCount * FCC_2; i++){
+            pOut[i] += pOutTmp[i];
+        }
+    }
+    return 0;
+}    /* end LvmBundle_processFloat */
 #else
 int LvmBundle_process(LVM_INT16        *pIn,
                       LVM_INT16        *pOut,
@@ -1276,7 +1344,13 @@ int Effect_setConfig(EffectContext *pContext, effect_config_t *pConfig){
     CHECK_ARG(pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_STEREO);
     CHECK_ARG(pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE
               || pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
+#ifdef BUILD_FLOAT
+    // float buffers are processed without conversion
+    CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT
+              || pConfig->inputCfg.format == AUDIO_FORMAT_PCM_FLOAT);
+#else
     CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT);
+#endif
 
     pContext->config = *pConfig;
 
@@ -3349,6 +3423,14 @@ int Effect_process(effect_handle_t     self,
         pContext->pBundledContext->NumberEffectsCalled = 0;
         /* Process all the available frames, block processing is
            handled internalLY by the LVM bundle */
+#ifdef BUILD_FLOAT
+        if (pContext->config.outputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+            processStatus = android::LvmBundle_processFloat(inBuffer->f32,
+                                                            outBuffer->f32,
+                                                            outBuffer->frameCount,
+                                                            pContext);
+        } else
+#endif
         processStatus = android::LvmBundle_process(    (LVM_INT16 *)inBuffer->raw,
                                                 (LVM_INT16 *)outBuffer->raw,
                                                 outBuffer->frameCount,
@@ -3365,6 +3447,18 @@ int Effect_process(effect_handle_t     self,
         //pContext->pBundledContext->NumberEffectsEnabled,
         //pContext->pBundledContext->NumberEffectsCalled, pContext->EffectType);
         // 2 is for stereo input
+#ifdef BUILD_FLOAT
+        if (pContext->config.outputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+            if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+                for (size_t i=0; i < outBuffer->frameCount*2; i++){
+                    outBuffer->f32[i] += inBuffer->f32[i];
+                }
+            } else if (outBuffer->raw != inBuffer->raw) {
+                memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount*sizeof(LVM_FLOAT)*2);
+            }
+            return status;
+        }
+#endif
         if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
             for (size_t i=0; i < outBuffer->frameCount*2; i++){
                 outBuffer->s16[i] =
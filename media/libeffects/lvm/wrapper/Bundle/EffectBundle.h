@@ -106,6 +106,8 @@ struct BundledEffectContext{
     #ifdef BUILD_FLOAT
     LVM_FLOAT                       *pInputBuffer;
     LVM_FLOAT                       *pOutputBuffer;
+    LVM_FLOAT                       *pAccumulateBuffer; /* float output before accumulation */
+    int                             accumulateFrameCount;
     #endif
 };
 
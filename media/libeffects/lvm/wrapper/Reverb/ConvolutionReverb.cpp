@@ -0,0 +1,602 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ConvolutionReverb"
+//#define LOG_NDEBUG 0
+
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <log/log.h>
+
+#include "ConvolutionReverb.h"
+
+namespace android {
+
+//----------------------------------------------------------------------------
+// RealFft
+//----------------------------------------------------------------------------
+
+RealFft::RealFft(size_t size)
+    : mSize(size), mRe(size / 2), mIm(size / 2)
+{
+    const size_t half = size / 2;
+    int bits = 0;
+    while (((size_t)1 << bits) < half) {
+        bits++;
+    }
+    ALOG_ASSERT(((size_t)1 << bits) == half && half >= 2, "invalid FFT size %zu", size);
+
+    mBitReverse.resize(half);
+    for (size_t i = 0; i < half; i++) {
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < bits; bit++) {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        mBitReverse[i] = reversed;
+    }
+    mCos.resize(half / 2);
+    mSin.resize(half / 2);
+    for (size_t k = 0; k < half / 2; k++) {
+        mCos[k] = cos(2. * M_PI * k / half);
+        mSin[k] = sin(2. * M_PI * k / half);
+    }
+    mSplitCos.resize(half + 1);
+    mSplitSin.resize(half + 1);
+    for (size_t k = 0; k <= half; k++) {
+        mSplitCos[k] = cos(2. * M_PI * k / size);
+        mSplitSin[k] = sin(2. * M_PI * k / size);
+    }
+}
+
+void RealFft::complexFft(float *re, float *im, bool inverse)
+{
+    const size_t n = mSize / 2;
+    for (size_t i = 0; i < n; i++) {
+        const size_t j = mBitReverse[i];
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    const float sign = inverse ? 1.f : -1.f;
+    for (size_t length = 2; length <= n; length *= 2) {
+        const size_t half = length / 2;
+        const size_t step = n / length;
+        for (size_t start = 0; start < n; start += length) {
+            for (size_t j = 0; j < half; j++) {
+                const float wr = mCos[j * step];
+                const float wi = sign * mSin[j * step];
+                const size_t a = start + j;
+                const size_t b = a + half;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void RealFft::forward(const float *in, float *re, float *im)
+{
+    // the even samples are the real part, the odd samples the imaginary part
+    const size_t half = mSize / 2;
+    for (size_t n = 0; n < half; n++) {
+        mRe[n] = in[2 * n];
+        mIm[n] = in[2 * n + 1];
+    }
+    complexFft(mRe.data(), mIm.data(), false /* inverse */);
+
+    for (size_t k = 0; k <= half; k++) {
+        const size_t a = k % half;
+        const size_t b = (half - k) % half;
+        // spectra of the even and odd samples
+        const float evenRe = 0.5f * (mRe[a] + mRe[b]);
+        const float evenIm = 0.5f * (mIm[a] - mIm[b]);
+        const float oddRe = 0.5f * (mIm[a] + mIm[b]);
+        const float oddIm = -0.5f * (mRe[a] - mRe[b]);
+        const float c = mSplitCos[k];
+        const float s = mSplitSin[k];
+        re[k] = evenRe + c * oddRe + s * oddIm;
+        im[k] = evenIm + c * oddIm - s * oddRe;
+    }
+}
+
+void RealFft::inverse(const float *re, const float *im, float *out)
+{
+    const size_t half = mSize / 2;
+    for (size_t k = 0; k < half; k++) {
+        const size_t b = half - k;
+        const float evenRe = 0.5f * (re[k] + re[b]);
+        const float evenIm = 0.5f * (im[k] - im[b]);
+        const float diffRe = 0.5f * (re[k] - re[b]);
+        const float diffIm = 0.5f * (im[k] + im[b]);
+        const float c = mSplitCos[k];
+        const float s = mSplitSin[k];
+        const float oddRe = diffRe * c - diffIm * s;
+        const float oddIm = diffRe * s + diffIm * c;
+        mRe[k] = evenRe - oddIm;
+        mIm[k] = evenIm + oddRe;
+    }
+    complexFft(mRe.data(), mIm.data(), true /* inverse */);
+
+    const float scale = 1.f / half;
+    for (size_t n = 0; n < half; n++) {
+        out[2 * n] = mRe[n] * scale;
+        out[2 * n + 1] = mIm[n] * scale;
+    }
+}
+
+//----------------------------------------------------------------------------
+// ConvolutionReverb
+//----------------------------------------------------------------------------
+
+constexpr size_t ConvolutionReverb::kMaxChannels;
+constexpr size_t ConvolutionReverb::kDefaultBlockFrames;
+constexpr uint32_t ConvolutionReverb::kMaxImpulseResponseSeconds;
+constexpr uint32_t ConvolutionReverb::kMaxSampleRate;
+
+ConvolutionReverb::ConvolutionReverb(size_t blockFrames)
+    : mBlockFrames(blockFrames),
+      mBins(blockFrames + 1),
+      mFft(2 * blockFrames),
+      mSumRe(mBins),
+      mSumIm(mBins),
+      mTime(2 * blockFrames)
+{
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    delete mFilter;
+    delete mPending.load();
+    delete mRetired.load();
+}
+
+namespace {
+
+struct WavFormat {
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint32_t byteRate;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+};
+
+constexpr uint16_t kWavFormatPcm = 1;
+constexpr uint16_t kWavFormatFloat = 3;
+constexpr uint16_t kWavFormatExtensible = 0xFFFE;
+
+} // namespace
+
+int ConvolutionReverb::readWav(const char *path, std::vector<float> *samples,
+                               size_t *channelCount, uint32_t *sampleRate)
+{
+    // WAV files are little endian, as all the supported targets.
+    FILE *file = fopen(path, "rbe");
+    if (file == NULL) {
+        ALOGE("%s: cannot open %s: %s", __func__, path, strerror(errno));
+        return -EINVAL;
+    }
+    struct stat st;
+    char riff[12];
+    if (fstat(fileno(file), &st) != 0 || fread(riff, sizeof(riff), 1, file) != 1 ||
+            memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        ALOGE("%s: %s is not a WAV file", __func__, path);
+        fclose(file);
+        return -EINVAL;
+    }
+    const uint64_t fileSize = st.st_size;
+
+    WavFormat format = {};
+    bool hasFormat = false;
+    std::vector<uint8_t> data;
+    char chunkId[4];
+    uint32_t chunkSize;
+    while (fread(chunkId, sizeof(chunkId), 1, file) == 1 &&
+            fread(&chunkSize, sizeof(chunkSize), 1, file) == 1) {
+        // the size of a chunk is not trusted beyond the end of the file
+        const long position = ftell(file);
+        if (position < 0 || chunkSize > fileSize - (uint64_t)position) {
+            ALOGE("%s: %s has a chunk of %u bytes past its end", __func__, path, chunkSize);
+            break;
+        }
+        const uint64_t next = (uint64_t)position + chunkSize + (chunkSize & 1);
+        if (memcmp(chunkId, "fmt ", 4) == 0 && chunkSize >= sizeof(WavFormat)) {
+            if (fread(&format, sizeof(format), 1, file) != 1) {
+                break;
+            }
+            if (format.format == kWavFormatExtensible && chunkSize >= sizeof(format) + 10) {
+                // cbSize, valid bits and channel mask precede the format of the sub format GUID
+                uint8_t extension[10];
+                if (fread(extension, sizeof(extension), 1, file) != 1) {
+                    break;
+                }
+                memcpy(&format.format, extension + 8, sizeof(format.format));
+            }
+            const bool pcm16 = format.format == kWavFormatPcm && format.bitsPerSample == 16;
+            const bool pcmFloat = format.format == kWavFormatFloat && format.bitsPerSample == 32;
+            hasFormat = (pcm16 || pcmFloat) &&
+                    format.channels != 0 && format.channels <= kMaxChannels &&
+                    format.sampleRate != 0 && format.sampleRate <= kMaxSampleRate &&
+                    format.blockAlign == format.channels * format.bitsPerSample / 8;
+            if (!hasFormat) {
+                break;
+            }
+        } else if (memcmp(chunkId, "data", 4) == 0 && hasFormat) {
+            // at most kMaxImpulseResponseSeconds of whole frames
+            const uint64_t maxSize = (uint64_t)format.sampleRate * kMaxImpulseResponseSeconds *
+                    format.blockAlign;
+            const uint64_t size = std::min((uint64_t)chunkSize, maxSize);
+            data.resize(size - size % format.blockAlign);
+            if (!data.empty() && fread(data.data(), data.size(), 1, file) != 1) {
+                data.clear();
+            }
+            break;
+        }
+        if (next > fileSize || fseek(file, (long)next, SEEK_SET) != 0) {
+            break;
+        }
+    }
+    fclose(file);
+
+    if (!hasFormat || data.empty()) {
+        ALOGE("%s: %s has no 16 bit or float samples", __func__, path);
+        return -EINVAL;
+    }
+
+    const size_t frameCount = data.size() / format.blockAlign;
+    samples->resize(frameCount * format.channels);
+    for (size_t i = 0; i < samples->size(); i++) {
+        if (format.bitsPerSample == 16) {
+            int16_t sample;
+            memcpy(&sample, &data[i * sizeof(sample)], sizeof(sample));
+            (*samples)[i] = sample / 32768.f;
+        } else {
+            memcpy(&(*samples)[i], &data[i * sizeof(float)], sizeof(float));
+        }
+    }
+    *channelCount = format.channels;
+    *sampleRate = format.sampleRate;
+    ALOGV("%s: read %zu frames of %u channels at %u Hz from %s",
+          __func__, frameCount, format.channels, format.sampleRate, path);
+    return 0;
+}
+
+int ConvolutionReverb::setImpulseResponse(const float *samples, size_t frameCount,
+                                          size_t channelCount, uint32_t sampleRate)
+{
+    if (channelCount == 0 || channelCount > kMaxChannels ||
+            sampleRate == 0 || sampleRate > kMaxSampleRate) {
+        ALOGE("%s: unsupported impulse response of %zu channels at %u Hz",
+              __func__, channelCount, sampleRate);
+        return -EINVAL;
+    }
+    const size_t maxFrames = (size_t)sampleRate * kMaxImpulseResponseSeconds;
+    if (frameCount > maxFrames) {
+        ALOGW("%s: impulse response truncated to %u s", __func__, kMaxImpulseResponseSeconds);
+        frameCount = maxFrames;
+    }
+    if (frameCount == 0) {
+        clearImpulseResponse();
+        return 0;
+    }
+
+    Filter *filter = prepare(samples, frameCount, channelCount);
+    std::lock_guard<std::mutex> lock(mLock);
+    // an impulse response received before is superseded
+    mGeneration++;
+    mPreparedGeneration = mGeneration;
+    mRequested = false;
+    mRequest.clear();
+    mReceived.clear();
+    mReceivedFrames = 0;
+    allocate(filter);
+    publish_l(filter);
+    mImpulseResponseFrames = frameCount;
+    mImpulseResponseSampleRate = sampleRate;
+    return 0;
+}
+
+int ConvolutionReverb::writeImpulseResponse(const float *samples, size_t firstFrame,
+                                            size_t count, size_t frameCount,
+                                            size_t channelCount, uint32_t sampleRate)
+{
+    if (firstFrame == 0) {
+        if (channelCount == 0 || channelCount > kMaxChannels || sampleRate == 0 ||
+                sampleRate > kMaxSampleRate || frameCount == 0 ||
+                frameCount > (size_t)sampleRate * kMaxImpulseResponseSeconds) {
+            ALOGE("%s: unsupported impulse response of %zu frames of %zu channels at %u Hz",
+                  __func__, frameCount, channelCount, sampleRate);
+            mReceived.clear();
+            mReceivedFrames = 0;
+            return -EINVAL;
+        }
+        mReceived.resize(frameCount * channelCount);
+        mReceivedFrames = 0;
+        mReceivedFrameCount = frameCount;
+        mReceivedChannels = channelCount;
+        mReceivedSampleRate = sampleRate;
+    } else if (mReceivedFrames == 0 || firstFrame != mReceivedFrames ||
+            frameCount != mReceivedFrameCount || channelCount != mReceivedChannels ||
+            sampleRate != mReceivedSampleRate) {
+        ALOGE("%s: frame %zu is not the next frame of the impulse response", __func__, firstFrame);
+        mReceived.clear();
+        mReceivedFrames = 0;
+        return -EINVAL;
+    }
+    if (count == 0 || count > frameCount - firstFrame) {
+        ALOGE("%s: %zu frames past the end of the impulse response", __func__, count);
+        mReceived.clear();
+        mReceivedFrames = 0;
+        return -EINVAL;
+    }
+    std::copy(samples, samples + count * channelCount, &mReceived[firstFrame * channelCount]);
+    mReceivedFrames += count;
+    if (mReceivedFrames < frameCount) {
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mGeneration++;
+        mRequest = std::move(mReceived);
+        mRequested = true;
+        mRequestFrames = frameCount;
+        mRequestChannels = channelCount;
+    }
+    mReceived.clear();
+    mReceivedFrames = 0;
+    mImpulseResponseFrames = frameCount;
+    mImpulseResponseSampleRate = sampleRate;
+    if (!mThread.joinable()) {
+        mThread = std::thread(&ConvolutionReverb::threadLoop, this);
+    }
+    mCondition.notify_all();
+    return 0;
+}
+
+void ConvolutionReverb::clearImpulseResponse()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mGeneration++;
+    mPreparedGeneration = mGeneration;
+    mRequested = false;
+    mRequest.clear();
+    mReceived.clear();
+    mReceivedFrames = 0;
+    publish_l(new Filter());
+    mImpulseResponseFrames = 0;
+    mImpulseResponseSampleRate = 0;
+}
+
+bool ConvolutionReverb::isImpulseResponseReady()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mPreparedGeneration == mGeneration;
+}
+
+void ConvolutionReverb::waitForImpulseResponse()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    mCondition.wait(lock, [this] { return mPreparedGeneration == mGeneration; });
+}
+
+void ConvolutionReverb::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mExit) {
+        if (!mRequested) {
+            mCondition.wait(lock);
+            continue;
+        }
+        const uint32_t generation = mGeneration;
+        const std::vector<float> samples = std::move(mRequest);
+        const size_t frameCount = mRequestFrames;
+        const size_t channelCount = mRequestChannels;
+        mRequest.clear();
+        mRequested = false;
+
+        lock.unlock();
+        Filter *filter = prepare(samples.data(), frameCount, channelCount);
+        lock.lock();
+
+        // dropped if superseded meanwhile
+        if (filter != nullptr && generation == mGeneration) {
+            allocate(filter);
+            publish_l(filter);
+            mPreparedGeneration = generation;
+        } else {
+            delete filter;
+        }
+        mCondition.notify_all();
+    }
+}
+
+ConvolutionReverb::Filter *ConvolutionReverb::prepare(const float *samples, size_t frameCount,
+                                                      size_t channelCount) const
+{
+    Filter *filter = new Filter();
+    filter->channels = channelCount;
+    filter->partitions = (frameCount + mBlockFrames - 1) / mBlockFrames;
+    filter->re.resize(channelCount * filter->partitions * mBins);
+    filter->im.resize(channelCount * filter->partitions * mBins);
+
+    // each partition is zero padded to the size of the FFT
+    RealFft fft(2 * mBlockFrames);
+    std::vector<float> time(2 * mBlockFrames);
+    for (size_t channel = 0; channel < channelCount; channel++) {
+        for (size_t partition = 0; partition < filter->partitions; partition++) {
+            if (mExit) {
+                delete filter;
+                return nullptr;
+            }
+            std::fill(time.begin(), time.end(), 0.f);
+            const size_t first = partition * mBlockFrames;
+            const size_t count = std::min(mBlockFrames, frameCount - first);
+            for (size_t i = 0; i < count; i++) {
+                time[i] = samples[(first + i) * channelCount + channel];
+            }
+            const size_t offset = (channel * filter->partitions + partition) * mBins;
+            fft.forward(time.data(), &filter->re[offset], &filter->im[offset]);
+        }
+    }
+    return filter;
+}
+
+void ConvolutionReverb::allocate(Filter *filter) const
+{
+    // the tail of the previous impulse response or channels is dropped
+    filter->inputRe.assign(mInputChannels * filter->partitions * mBins, 0.f);
+    filter->inputIm.assign(mInputChannels * filter->partitions * mBins, 0.f);
+    filter->inputHistory.assign(mInputChannels * 2 * mBlockFrames, 0.f);
+    filter->outputBlock.assign(mOutputChannels * mBlockFrames, 0.f);
+    filter->newest = 0;
+    filter->blockPosition = 0;
+}
+
+void ConvolutionReverb::publish_l(Filter *filter)
+{
+    // A pending filter replaced here was never taken by process(). The retired slot is freed
+    // after publishing, so that process() can take the new filter even if it retired the
+    // previous one in between.
+    delete mPending.exchange(filter);
+    delete mRetired.exchange(nullptr);
+}
+
+int ConvolutionReverb::configure(size_t inputChannels, size_t outputChannels)
+{
+    if (inputChannels == 0 || inputChannels > kMaxChannels ||
+            outputChannels == 0 || outputChannels > kMaxChannels) {
+        ALOGE("%s: unsupported channel counts %zu and %zu", __func__,
+              inputChannels, outputChannels);
+        return -EINVAL;
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    mInputChannels = inputChannels;
+    mOutputChannels = outputChannels;
+    // process() is not running, and the worker thread publishes with the lock held
+    Filter *pending = mPending.load();
+    if (pending != nullptr) {
+        allocate(pending);
+    }
+    if (mFilter != nullptr) {
+        allocate(mFilter);
+    }
+    delete mRetired.exchange(nullptr);
+    return 0;
+}
+
+void ConvolutionReverb::process(const float *in, float *out, size_t frameCount)
+{
+    // Only process() fills the retired slot. While the control thread has not deleted the
+    // filter retired last, keep the current filter and take the pending one at a later block.
+    if (mRetired.load() == nullptr) {
+        Filter *pending = mPending.exchange(nullptr);
+        if (pending != nullptr) {
+            mRetired.store(mFilter);
+            mFilter = pending;
+        }
+    }
+    Filter *filter = mFilter;
+    if (filter == nullptr || filter->partitions == 0 || mInputChannels == 0) {
+        memset(out, 0, frameCount * mOutputChannels * sizeof(float));
+        return;
+    }
+    while (frameCount > 0) {
+        const size_t count = std::min(frameCount, mBlockFrames - filter->blockPosition);
+        for (size_t channel = 0; channel < mInputChannels; channel++) {
+            float *history = &filter->inputHistory[channel * 2 * mBlockFrames + mBlockFrames];
+            for (size_t i = 0; i < count; i++) {
+                history[filter->blockPosition + i] = in[i * mInputChannels + channel];
+            }
+        }
+        for (size_t channel = 0; channel < mOutputChannels; channel++) {
+            const float *block = &filter->outputBlock[channel * mBlockFrames];
+            for (size_t i = 0; i < count; i++) {
+                out[i * mOutputChannels + channel] = block[filter->blockPosition + i];
+            }
+        }
+        in += count * mInputChannels;
+        out += count * mOutputChannels;
+        frameCount -= count;
+        filter->blockPosition += count;
+        if (filter->blockPosition == mBlockFrames) {
+            processBlock();
+            filter->blockPosition = 0;
+        }
+    }
+}
+
+void ConvolutionReverb::processBlock()
+{
+    Filter *filter = mFilter;
+    const size_t partitions = filter->partitions;
+
+    // spectrum of the last two blocks of each input channel
+    for (size_t channel = 0; channel < mInputChannels; channel++) {
+        float *history = &filter->inputHistory[channel * 2 * mBlockFrames];
+        const size_t offset = (channel * partitions + filter->newest) * mBins;
+        mFft.forward(history, &filter->inputRe[offset], &filter->inputIm[offset]);
+        memcpy(history, history + mBlockFrames, mBlockFrames * sizeof(float));
+    }
+
+    // sum of the products of the input blocks with the partitions of the impulse response
+    for (size_t channel = 0; channel < mOutputChannels; channel++) {
+        const size_t inputChannel = channel % mInputChannels;
+        const size_t filterChannel = channel % filter->channels;
+        float * __restrict sumRe = mSumRe.data();
+        float * __restrict sumIm = mSumIm.data();
+        std::fill(mSumRe.begin(), mSumRe.end(), 0.f);
+        std::fill(mSumIm.begin(), mSumIm.end(), 0.f);
+        for (size_t partition = 0; partition < partitions; partition++) {
+            const size_t block = (filter->newest + partitions - partition) % partitions;
+            const size_t inputOffset = (inputChannel * partitions + block) * mBins;
+            const size_t filterOffset = (filterChannel * partitions + partition) * mBins;
+            const float * __restrict xRe = &filter->inputRe[inputOffset];
+            const float * __restrict xIm = &filter->inputIm[inputOffset];
+            const float * __restrict hRe = &filter->re[filterOffset];
+            const float * __restrict hIm = &filter->im[filterOffset];
+            for (size_t k = 0; k < mBins; k++) {
+                sumRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+                sumIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+            }
+        }
+        // overlap-save: the second half is the linear convolution of the last block
+        mFft.inverse(sumRe, sumIm, mTime.data());
+        memcpy(&filter->outputBlock[channel * mBlockFrames], &mTime[mBlockFrames],
+               mBlockFrames * sizeof(float));
+    }
+    filter->newest = (filter->newest + 1) % partitions;
+}
+
+} // namespace android
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_CONVOLUTIONREVERB_H_
+#define ANDROID_CONVOLUTIONREVERB_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+// FFT of real signals, computed with a complex FFT of half the size.
+// Spectra are stored as separate real and imaginary parts of size / 2 + 1 bins.
+class RealFft {
+public:
+    explicit RealFft(size_t size); // size is a power of 2, at least 4
+
+    size_t size() const { return mSize; }
+    size_t bins() const { return mSize / 2 + 1; }
+
+    void forward(const float *in, float *re, float *im);
+    // Scaled by 1 / size, so that inverse(forward(x)) == x.
+    void inverse(const float *re, const float *im, float *out);
+
+private:
+    void complexFft(float *re, float *im, bool inverse);
+
+    const size_t mSize;
+    std::vector<uint32_t> mBitReverse;       // of the half size complex FFT
+    std::vector<float> mCos, mSin;           // twiddles of the half size complex FFT
+    std::vector<float> mSplitCos, mSplitSin; // twiddles separating the even and odd samples
+    std::vector<float> mRe, mIm;
+};
+
+// Convolution of the input with an impulse response, by uniformly partitioned overlap-save
+// with a frequency domain delay line.
+// The input is filtered by blocks, so the output is delayed by getLatencyFrames(). The cost of
+// a block grows linearly with the number of partitions of the impulse response, whose length
+// is bounded by kMaxImpulseResponseSeconds.
+//
+// process() is called by the audio thread, the other methods by a single control thread, and
+// configure() is not called concurrently with process(). The spectra of an impulse response are
+// computed outside of process(), and handed to it with a pointer exchange: process() never
+// waits, and only switches to the new impulse response at its next call.
+class ConvolutionReverb {
+public:
+    static constexpr size_t kMaxChannels = 8;
+    static constexpr size_t kDefaultBlockFrames = 256;
+    static constexpr uint32_t kMaxImpulseResponseSeconds = 4;
+    static constexpr uint32_t kMaxSampleRate = 192000;
+
+    explicit ConvolutionReverb(size_t blockFrames = kDefaultBlockFrames);
+    ~ConvolutionReverb();
+
+    // Reads the interleaved samples of a WAV file of 16 bit or float samples, truncated to
+    // kMaxImpulseResponseSeconds. For the tools and tests feeding an impulse response to the
+    // effect, which does not open files.
+    // Returns 0, or -EINVAL if the file is not a supported WAV file.
+    static int readWav(const char *path, std::vector<float> *samples, size_t *channelCount,
+                       uint32_t *sampleRate);
+
+    // Sets the impulse response from interleaved samples, truncated to
+    // kMaxImpulseResponseSeconds, and computes its spectra on the calling thread.
+    // Output channel c is the convolution of input channel c % inputChannels with impulse
+    // response channel c % channelCount.
+    // Returns 0, or -EINVAL if the number of channels or the sample rate is not supported.
+    int setImpulseResponse(const float *samples, size_t frameCount, size_t channelCount,
+                           uint32_t sampleRate);
+
+    // Receives the interleaved samples of frames [firstFrame, firstFrame + count) of an
+    // impulse response of frameCount frames, sent in order in as many calls as needed. Once
+    // all the frames are received, the spectra are computed by a worker thread.
+    // Returns 0, or -EINVAL if the impulse response is not supported or the frames are not
+    // the next ones, in which case the frames received are dropped.
+    int writeImpulseResponse(const float *samples, size_t firstFrame, size_t count,
+                             size_t frameCount, size_t channelCount, uint32_t sampleRate);
+
+    void clearImpulseResponse();
+
+    // True if the impulse response set or received last is ready for process(), which then
+    // uses it from its next call.
+    bool isImpulseResponseReady();
+
+    // Waits until the impulse response received last is ready for process().
+    void waitForImpulseResponse();
+
+    // Of the impulse response set or received last, ready for process() or not.
+    bool hasImpulseResponse() const { return mImpulseResponseFrames != 0; }
+    size_t getImpulseResponseFrames() const { return mImpulseResponseFrames; }
+    uint32_t getImpulseResponseSampleRate() const { return mImpulseResponseSampleRate; }
+    size_t getLatencyFrames() const { return mBlockFrames; }
+
+    // Sets the channel counts of the interleaved input and output and clears the tail.
+    // Returns 0, or -EINVAL if the number of channels is not supported.
+    int configure(size_t inputChannels, size_t outputChannels);
+
+    // Replaces the output with the convolution of the input.
+    void process(const float *in, float *out, size_t frameCount);
+
+private:
+    // An impulse response ready for process(), with the state of its convolution.
+    struct Filter {
+        size_t channels = 0;
+        size_t partitions = 0;
+        // spectra of the partitions of each impulse response channel
+        std::vector<float> re, im;
+        // spectra of the last partitions input blocks of each input channel, newest is the
+        // latest
+        std::vector<float> inputRe, inputIm;
+        size_t newest = 0;
+        // last two input blocks of each input channel, the second one being filled
+        std::vector<float> inputHistory;
+        // convolution of the last block of each output channel, being output
+        std::vector<float> outputBlock;
+        size_t blockPosition = 0;
+    };
+
+    Filter *prepare(const float *samples, size_t frameCount, size_t channelCount) const;
+    void allocate(Filter *filter) const;
+    void publish_l(Filter *filter);
+    void threadLoop();
+    void processBlock();
+
+    const size_t mBlockFrames;
+    const size_t mBins;
+    RealFft mFft; // of process()
+
+    // control thread
+    size_t mInputChannels = 0;
+    size_t mOutputChannels = 0;
+    size_t mImpulseResponseFrames = 0;
+    uint32_t mImpulseResponseSampleRate = 0;
+    std::vector<float> mReceived;   // frames received by writeImpulseResponse()
+    size_t mReceivedFrames = 0;
+    size_t mReceivedFrameCount = 0;
+    size_t mReceivedChannels = 0;
+    uint32_t mReceivedSampleRate = 0;
+    std::thread mThread;
+
+    // impulse response waiting for the worker thread, and the filters exchanged with process()
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::vector<float> mRequest;
+    bool mRequested = false;
+    size_t mRequestFrames = 0;
+    size_t mRequestChannels = 0;
+    uint32_t mGeneration = 0;       // of the impulse response set or received last
+    uint32_t mPreparedGeneration = 0;
+    std::atomic<bool> mExit{false};
+    std::atomic<Filter *> mPending{nullptr};  // for process()
+    std::atomic<Filter *> mRetired{nullptr};  // by process(), deleted by the control thread
+
+    // audio thread
+    Filter *mFilter = nullptr;
+    std::vector<float> mSumRe, mSumIm, mTime;
+};
+
+} // namespace android
+
+#endif // ANDROID_CONVOLUTIONREVERB_H_
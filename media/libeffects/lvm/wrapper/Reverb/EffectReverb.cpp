@@ -29,6 +29,7 @@ typedef float LVM_FLOAT;
 
 #include <log/log.h>
 
+#include "ConvolutionReverb.h"
 #include "EffectReverb.h"
 // from Reverb/lib
 #include "LVREV.h"
@@ -160,6 +161,7 @@ struct ReverbContext{
     bool                            preset;
     uint16_t                        curPreset;
     uint16_t                        nextPreset;
+    ConvolutionReverb               *convolution;   // of the preset reverbs
     int                             SamplesToExitCount;
     LVM_INT16                       leftVolume;
     LVM_INT16                       rightVolume;
@@ -194,6 +196,7 @@ int  Reverb_getParameter    (ReverbContext *pContext,
                              uint32_t      *pValueSize,
                              void          *pValue);
 int Reverb_LoadPreset       (ReverbContext   *pContext);
+int Reverb_setImpulseResponse(ReverbContext *pContext, const void *pValue, int size);
 int Reverb_paramValueSize   (int32_t param);
 
 /* Effect Library Interface Implementation */
@@ -241,11 +244,13 @@ extern "C" int EffectCreate(const effect_uuid_t *uuid,
     }
 
     pContext->preset = false;
+    pContext->convolution = NULL;
     if (memcmp(&desc->type, SL_IID_PRESETREVERB, sizeof(effect_uuid_t)) == 0) {
         pContext->preset = true;
         // force reloading preset at first call to process()
-        pContext->curPreset = REVERB_PRESET_LAST + 1;
+        pContext->curPreset = REVERB_PRESET_CONVOLUTION + 1;
         pContext->nextPreset = REVERB_DEFAULT_PRESET;
+        pContext->convolution = new ConvolutionReverb();
         ALOGV("\tEffectCreate - PRESET");
     }else{
         ALOGV("\tEffectCreate - ENVIRONMENTAL");
@@ -256,6 +261,7 @@ extern "C" int EffectCreate(const effect_uuid_t *uuid,
 
     if (ret < 0){
         ALOGV("\tLVM_ERROR : EffectCreate() init failed");
+        delete pContext->convolution;
         delete pContext;
         return ret;
     }
@@ -310,6 +316,7 @@ extern "C" int EffectRelease(effect_handle_t handle){
     pContext->bufferSizeIn = 0;
     pContext->bufferSizeOut = 0;
     Reverb_free(pContext);
+    delete pContext->convolution;
     delete pContext;
     return 0;
 } /* end EffectRelease */
@@ -568,10 +575,14 @@ int process( LVM_INT16     *pIn,
 
         /* Process the samples, producing a stereo output */
 #ifdef BUILD_FLOAT
-        LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
-                                  pInputBuff,     /* Input buffer */
-                                  pOutputBuff,    /* Output buffer */
-                                  frameCount);              /* Number of samples to read */
+        if (pContext->preset && pContext->curPreset == REVERB_PRESET_CONVOLUTION) {
+            pContext->convolution->process(pInputBuff, pOutputBuff, frameCount);
+        } else {
+            LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
+                                      pInputBuff,     /* Input buffer */
+                                      pOutputBuff,    /* Output buffer */
+                                      frameCount);              /* Number of samples to read */
+        }
 #else
         LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
                                   pContext->InFrames32,     /* Input buffer */
@@ -662,6 +673,178 @@ int process( LVM_INT16     *pIn,
     return 0;
 }    /* end process */
 
+#ifdef BUILD_FLOAT
+//----------------------------------------------------------------------------
+// Reverb_reserveBuffers()
+//----------------------------------------------------------------------------
+// Purpose:
+// Grow the temporary buffers to hold at least size bytes each
+//
+//----------------------------------------------------------------------------
+
+static int Reverb_reserveBuffers(ReverbContext *pContext, size_t size)
+{
+    if (pContext->InFrames32 == NULL || pContext->bufferSizeIn < size) {
+        free(pContext->InFrames32);
+        pContext->bufferSizeIn = size;
+        pContext->InFrames32 = (LVM_INT32 *)malloc(pContext->bufferSizeIn);
+    }
+    if (pContext->OutFrames32 == NULL || pContext->bufferSizeOut < size) {
+        free(pContext->OutFrames32);
+        pContext->bufferSizeOut = size;
+        pContext->OutFrames32 = (LVM_INT32 *)malloc(pContext->bufferSizeOut);
+    }
+    if (pContext->InFrames32 == NULL || pContext->OutFrames32 == NULL) {
+        ALOGV("\tLVREV_ERROR : process failed to allocate memory for temporary buffers ");
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// Reverb_applyVolumeFloat()
+//----------------------------------------------------------------------------
+// Purpose:
+// Apply the volume of an insert reverb to float samples, with a ramp if needed.
+// The left volume applies to the first channel, the right volume to the second one
+// and their average to the other channels.
+//
+//----------------------------------------------------------------------------
+
+static void Reverb_applyVolumeFloat(ReverbContext *pContext, LVM_FLOAT *buffer,
+                                    int frameCount, int channelCount)
+{
+    if (pContext->volumeMode == REVERB_VOLUME_OFF) {
+        return;
+    }
+    const bool ramp = pContext->volumeMode == REVERB_VOLUME_RAMP &&
+            (pContext->leftVolume != pContext->prevLeftVolume ||
+             pContext->rightVolume != pContext->prevRightVolume);
+    if (ramp || pContext->leftVolume != REVERB_UNIT_VOLUME ||
+            pContext->rightVolume != REVERB_UNIT_VOLUME) {
+        const LVM_FLOAT unit = REVERB_UNIT_VOLUME;
+        LVM_FLOAT vl = (ramp ? pContext->prevLeftVolume : pContext->leftVolume) / unit;
+        LVM_FLOAT vr = (ramp ? pContext->prevRightVolume : pContext->rightVolume) / unit;
+        const LVM_FLOAT incl = (pContext->leftVolume / unit - vl) / frameCount;
+        const LVM_FLOAT incr = (pContext->rightVolume / unit - vr) / frameCount;
+
+        for (int i = 0; i < frameCount; i++) {
+            buffer[0] *= vl;
+            if (channelCount > 1) {
+                buffer[1] *= vr;
+            }
+            for (int c = 2; c < channelCount; c++) {
+                buffer[c] *= 0.5f * (vl + vr);
+            }
+            buffer += channelCount;
+            vl += incl;
+            vr += incr;
+        }
+    }
+    pContext->prevLeftVolume = pContext->leftVolume;
+    pContext->prevRightVolume = pContext->rightVolume;
+    pContext->volumeMode = REVERB_VOLUME_RAMP;
+}
+
+//----------------------------------------------------------------------------
+// processFloat()
+//----------------------------------------------------------------------------
+// Purpose:
+// Apply the Reverb to float samples
+//
+// Inputs:
+//  pIn:        pointer to mono (auxiliary) or multichannel (insert) float input data
+//  pOut:       pointer to multichannel float output data
+//  frameCount: Frames to process
+//  pContext:   effect engine context
+//
+//  Outputs:
+//  pOut:       pointer to updated multichannel float output data
+//
+// The convolution reverb processes all the channels, the algorithmic reverb
+// processes the front pair and the other channels get the dry input of an insert.
+//----------------------------------------------------------------------------
+
+int processFloat(LVM_FLOAT     *pIn,
+                 LVM_FLOAT     *pOut,
+                 int           frameCount,
+                 ReverbContext *pContext){
+
+    const int inputChannels = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+    const int outputChannels =
+            audio_channel_count_from_out_mask(pContext->config.outputCfg.channels);
+    LVREV_ReturnStatus_en   LvmStatus = LVREV_SUCCESS;              /* Function call status */
+
+    if (Reverb_reserveBuffers(pContext, frameCount * sizeof(LVM_FLOAT) * outputChannels) != 0) {
+        return -EINVAL;
+    }
+    LVM_FLOAT *pInputBuff = (LVM_FLOAT *)pContext->InFrames32;
+    LVM_FLOAT *pOutputBuff = (LVM_FLOAT *)pContext->OutFrames32;
+
+    if (pContext->preset && pContext->nextPreset != pContext->curPreset) {
+        Reverb_LoadPreset(pContext);
+    }
+
+    const bool convolution = pContext->preset &&
+            pContext->curPreset == REVERB_PRESET_CONVOLUTION;
+    const int reverbInputChannels = convolution ? inputChannels :
+            pContext->auxiliary ? 1 : FCC_2;
+    const int reverbOutputChannels = convolution ? outputChannels : FCC_2;
+
+    if (pContext->bEnabled == LVM_FALSE && pContext->SamplesToExitCount > 0) {
+        memset(pInputBuff, 0, frameCount * sizeof(LVM_FLOAT) * reverbInputChannels);
+    } else {
+        const LVM_FLOAT sendLevel = pContext->auxiliary ? 1.0f : REVERB_SEND_LEVEL;
+        for (int i = 0; i < frameCount; i++) {
+            for (int c = 0; c < reverbInputChannels; c++) {
+                pInputBuff[i * reverbInputChannels + c] = pIn[i * inputChannels + c] * sendLevel;
+            }
+        }
+    }
+
+    if (pContext->preset && pContext->curPreset == REVERB_PRESET_NONE) {
+        memset(pOutputBuff, 0, frameCount * sizeof(LVM_FLOAT) * reverbOutputChannels);
+    } else if (convolution) {
+        pContext->convolution->process(pInputBuff, pOutputBuff, frameCount);
+    } else {
+        LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
+                                  pInputBuff,               /* Input buffer */
+                                  pOutputBuff,              /* Output buffer */
+                                  frameCount);              /* Number of samples to read */
+    }
+
+    LVM_ERROR_CHECK(LvmStatus, "LVREV_Process", "processFloat")
+    if(LvmStatus != LVREV_SUCCESS) return -EINVAL;
+
+    // Spread the reverb on the output channels, mixed with the input of an insert.
+    // pInputBuff is not used anymore and holds the result.
+    for (int i = 0; i < frameCount; i++) {
+        for (int c = 0; c < outputChannels; c++) {
+            LVM_FLOAT sample = c < reverbOutputChannels ?
+                    pOutputBuff[i * reverbOutputChannels + c] : 0.0f;
+            if (!pContext->auxiliary) {
+                sample += pIn[i * inputChannels + c];
+            }
+            pInputBuff[i * outputChannels + c] = sample;
+        }
+    }
+    if (!pContext->auxiliary) {
+        Reverb_applyVolumeFloat(pContext, pInputBuff, frameCount, outputChannels);
+    }
+
+    // Accumulate if required
+    if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
+        for (int i = 0; i < frameCount * outputChannels; i++){
+            pOut[i] += pInputBuff[i];
+        }
+    }else{
+        memcpy(pOut, pInputBuff, frameCount * sizeof(LVM_FLOAT) * outputChannels);
+    }
+
+    return 0;
+}    /* end processFloat */
+#endif
+
 //----------------------------------------------------------------------------
 // Reverb_free()
 //----------------------------------------------------------------------------
@@ -728,15 +911,34 @@ int Reverb_setConfig(ReverbContext *pContext, effect_config_t *pConfig){
 
     CHECK_ARG(pConfig->inputCfg.samplingRate == pConfig->outputCfg.samplingRate);
     CHECK_ARG(pConfig->inputCfg.format == pConfig->outputCfg.format);
-    CHECK_ARG((pContext->auxiliary && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_MONO) ||
-              ((!pContext->auxiliary) && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_STEREO));
-    CHECK_ARG(pConfig->outputCfg.channels == AUDIO_CHANNEL_OUT_STEREO);
     CHECK_ARG(pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE
               || pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
-    CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT);
+#ifdef BUILD_FLOAT
+    if (pConfig->inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        // float inserts keep the channels of the input, up to 7.1
+        const uint32_t outputChannels =
+                audio_channel_count_from_out_mask(pConfig->outputCfg.channels);
+        CHECK_ARG(outputChannels >= FCC_2 && outputChannels <= FCC_8);
+        CHECK_ARG((pContext->auxiliary && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_MONO) ||
+                  ((!pContext->auxiliary) &&
+                   pConfig->inputCfg.channels == pConfig->outputCfg.channels));
+    } else
+#endif
+    {
+        CHECK_ARG((pContext->auxiliary && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_MONO) ||
+                  ((!pContext->auxiliary) &&
+                   pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_STEREO));
+        CHECK_ARG(pConfig->outputCfg.channels == AUDIO_CHANNEL_OUT_STEREO);
+        CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT);
+    }
 
     //ALOGV("\tReverb_setConfig calling memcpy");
     pContext->config = *pConfig;
+    if (pContext->convolution != NULL) {
+        pContext->convolution->configure(
+                audio_channel_count_from_out_mask(pConfig->inputCfg.channels),
+                audio_channel_count_from_out_mask(pConfig->outputCfg.channels));
+    }
 
 
     switch (pConfig->inputCfg.samplingRate) {
@@ -862,6 +1064,9 @@ int Reverb_init(ReverbContext *pContext){
     pContext->config.outputCfg.bufferProvider.releaseBuffer = NULL;
     pContext->config.outputCfg.bufferProvider.cookie        = NULL;
     pContext->config.outputCfg.mask                         = EFFECT_CONFIG_ALL;
+    if (pContext->convolution != NULL) {
+        pContext->convolution->configure(pContext->auxiliary ? 1 : FCC_2, FCC_2);
+    }
 
     pContext->leftVolume = REVERB_UNIT_VOLUME;
     pContext->rightVolume = REVERB_UNIT_VOLUME;
@@ -1619,7 +1824,11 @@ int Reverb_LoadPreset(ReverbContext   *pContext)
     // implemented
     pContext->curPreset = pContext->nextPreset;
 
-    if (pContext->curPreset != REVERB_PRESET_NONE) {
+    if (pContext->curPreset == REVERB_PRESET_CONVOLUTION) {
+        // the tail is the impulse response, delayed by the latency
+        pContext->SamplesToExitCount = pContext->convolution->getImpulseResponseFrames() +
+                pContext->convolution->getLatencyFrames();
+    } else if (pContext->curPreset != REVERB_PRESET_NONE) {
         const t_reverb_settings *preset = &sReverbPresets[pContext->curPreset];
         ReverbSetRoomLevel(pContext, preset->roomLevel);
         ReverbSetRoomHfLevel(pContext, preset->roomHFLevel);
@@ -1636,6 +1845,66 @@ int Reverb_LoadPreset(ReverbContext   *pContext)
     return 0;
 }
 
+//----------------------------------------------------------------------------
+// Reverb_setImpulseResponse()
+//----------------------------------------------------------------------------
+// Purpose:
+// Receive frames of the impulse response of the convolution preset
+//
+// Inputs:
+//  pContext         - handle to instance data
+//  pValue           - reverb_impulse_response_t followed by float samples
+//  size             - size of the value
+//
+// Outputs:
+//
+// Side Effects:
+//  The spectra of the impulse response are computed by a worker thread once all its frames
+//  are received, not while holding the lock of the effect.
+//  A frameCount of 0 clears the impulse response and falls back to REVERB_PRESET_NONE
+//  if the convolution preset is selected.
+//
+//----------------------------------------------------------------------------
+int Reverb_setImpulseResponse(ReverbContext *pContext, const void *pValue, int size)
+{
+    reverb_impulse_response_t header;
+    if (size < (int)sizeof(header)) {
+        return -EINVAL;
+    }
+    memcpy(&header, pValue, sizeof(header));
+    if (header.frameCount == 0) {
+        pContext->convolution->clearImpulseResponse();
+        if (pContext->nextPreset == REVERB_PRESET_CONVOLUTION) {
+            pContext->nextPreset = REVERB_PRESET_NONE;
+        }
+        return 0;
+    }
+
+    const size_t frameSize = header.channelCount * sizeof(float);
+    const size_t samplesSize = size - sizeof(header);
+    if (header.channelCount == 0 || header.channelCount > ConvolutionReverb::kMaxChannels ||
+            samplesSize % frameSize != 0) {
+        ALOGV("\tLVM_ERROR : Reverb_setImpulseResponse() invalid size %d for %u channels",
+              size, header.channelCount);
+        return -EINVAL;
+    }
+    const int status = pContext->convolution->writeImpulseResponse(
+            (const float *)((const uint8_t *)pValue + sizeof(header)), header.firstFrame,
+            samplesSize / frameSize, header.frameCount, header.channelCount, header.sampleRate);
+    if (status != 0 || header.firstFrame + samplesSize / frameSize < header.frameCount) {
+        return status;
+    }
+
+    if (header.sampleRate != pContext->config.inputCfg.samplingRate) {
+        ALOGW("impulse response sampled at %u Hz, not %u Hz", header.sampleRate,
+              pContext->config.inputCfg.samplingRate);
+    }
+    if (pContext->curPreset == REVERB_PRESET_CONVOLUTION) {
+        pContext->SamplesToExitCount = pContext->convolution->getImpulseResponseFrames() +
+                pContext->convolution->getLatencyFrames();
+    }
+    return 0;
+}
 
 //----------------------------------------------------------------------------
 // Reverb_getParameter()
@@ -1669,6 +1938,15 @@ int Reverb_getParameter(ReverbContext *pContext,
 
     //ALOGV("\tReverb_getParameter start");
     if (pContext->preset) {
+        if (param == REVERB_PARAM_IMPULSE_RESPONSE) {
+            if (*pValueSize < sizeof(uint32_t)) {
+                return -EINVAL;
+            }
+            *(uint32_t *)pValue = pContext->convolution->isImpulseResponseReady() ?
+                    pContext->convolution->getImpulseResponseFrames() : 0;
+            *pValueSize = sizeof(uint32_t);
+            return 0;
+        }
         if (param != REVERB_PARAM_PRESET || *pValueSize < sizeof(uint16_t)) {
             return -EINVAL;
         }
@@ -1886,6 +2164,9 @@ int Reverb_setParameter (ReverbContext *pContext, void *pParam, void *pValue, in
 
     //ALOGV("\tReverb_setParameter start");
     if (pContext->preset) {
+        if (param == REVERB_PARAM_IMPULSE_RESPONSE) {
+            return Reverb_setImpulseResponse(pContext, pValue, vsize);
+        }
         if (param != REVERB_PARAM_PRESET) {
             return -EINVAL;
         }
@@ -1896,7 +2177,16 @@ int Reverb_setParameter (ReverbContext *pContext, void *pParam, void *pValue, in
 
         uint16_t preset = *(uint16_t *)pValue;
         ALOGV("set REVERB_PARAM_PRESET, preset %d", preset);
-        if (preset > REVERB_PRESET_LAST) {
+        if (preset == REVERB_PRESET_CONVOLUTION) {
+#ifdef BUILD_FLOAT
+            if (!pContext->convolution->hasImpulseResponse()) {
+                ALOGV("\tLVM_ERROR : Reverb_setParameter() no impulse response loaded");
+                return -EINVAL;
+            }
+#else
+            return -EINVAL;
+#endif
+        } else if (preset > REVERB_PRESET_LAST) {
             return -EINVAL;
         }
         pContext->nextPreset = preset;
@@ -2031,10 +2321,17 @@ int Reverb_process(effect_handle_t   self,
     }
     //ALOGV("\tReverb_process() Calling process with %d frames", outBuffer->frameCount);
     /* Process all the available frames, block processing is handled internalLY by the LVM bundle */
-    status = process(    (LVM_INT16 *)inBuffer->raw,
-                         (LVM_INT16 *)outBuffer->raw,
-                                      outBuffer->frameCount,
-                                      pContext);
+#ifdef BUILD_FLOAT
+    if (pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        status = processFloat(inBuffer->f32, outBuffer->f32, outBuffer->frameCount, pContext);
+    } else
+#endif
+    {
+        status = process(    (LVM_INT16 *)inBuffer->raw,
+                             (LVM_INT16 *)outBuffer->raw,
+                                          outBuffer->frameCount,
+                                          pContext);
+    }
 
     if (pContext->bEnabled == LVM_FALSE) {
         if (pContext->SamplesToExitCount > 0) {
@@ -2168,6 +2465,12 @@ int Reverb_command(effect_handle_t  self,
                         "EFFECT_CMD_SET_PARAM: ERROR, psize is not sizeof(int32_t)");
                 return -EINVAL;
             }
+            // the impulse response is the first parameter of a variable size
+            if (p->vsize > cmdSize - sizeof(effect_param_t) - sizeof(int32_t)) {
+                ALOGV("\tLVM_ERROR : Reverb_command cmdCode Case: "
+                        "EFFECT_CMD_SET_PARAM: ERROR, vsize %u past the command", p->vsize);
+                return -EINVAL;
+            }
 
             //ALOGV("\tn5Reverb_command cmdSize is %d\n"
             //        "\tsizeof(effect_param_t) is  %d\n"
@@ -2203,6 +2506,11 @@ int Reverb_command(effect_handle_t  self,
             LVM_ERROR_CHECK(LvmStatus, "LVREV_GetControlParameters", "EFFECT_CMD_ENABLE")
             pContext->SamplesToExitCount =
                     (ActiveParams.T60 * pContext->config.inputCfg.samplingRate)/1000;
+            if (pContext->preset && pContext->nextPreset == REVERB_PRESET_CONVOLUTION) {
+                pContext->SamplesToExitCount =
+                        pContext->convolution->getImpulseResponseFrames() +
+                        pContext->convolution->getLatencyFrames();
+            }
             // force no volume ramp for first buffer processed after enabling the effect
             pContext->volumeMode = android::REVERB_VOLUME_FLAT;
             //ALOGV("\tEFFECT_CMD_ENABLE SamplesToExitCount = %d", pContext->SamplesToExitCount);
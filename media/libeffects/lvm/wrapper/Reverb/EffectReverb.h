@@ -33,6 +33,26 @@ extern "C" {
 #define LVREV_MEM_USAGE         (71+(LVREV_MAX_FRAME_SIZE>>7))     // Expressed in kB
 //#define LVM_PCM
 
+// Preset of the preset reverbs convolving the input with the loaded impulse response.
+#define REVERB_PRESET_CONVOLUTION       (REVERB_PRESET_LAST + 1)
+
+// Parameter of the preset reverbs, beyond the OpenSL ES parameters.
+// Set: a reverb_impulse_response_t followed by the interleaved float samples of frames
+// [firstFrame, firstFrame + n), n following from the size of the value. An impulse response
+// larger than a parameter is sent in order in several ones. Once complete, it is prepared in
+// the background and used by the convolution preset as soon as ready. A frameCount of 0
+// clears the impulse response.
+// Get: uint32_t number of frames of the impulse response used by the convolution preset, 0 if
+// none or while it is prepared.
+#define REVERB_PARAM_IMPULSE_RESPONSE   0x10000
+
+typedef struct reverb_impulse_response_s {
+    uint32_t sampleRate;
+    uint32_t channelCount;      // at most 8
+    uint32_t frameCount;        // of the whole impulse response, at most 4 s
+    uint32_t firstFrame;        // of the samples of this parameter
+} reverb_impulse_response_t;
+
 typedef struct _LPFPair_t
 {
     int16_t Room_HF;
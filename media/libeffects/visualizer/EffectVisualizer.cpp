@@ -24,11 +24,18 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <new>
 
 #include <log/log.h>
 
-#include <audio_effects/effect_visualizer.h>
+#include "EffectVisualizer.h"
+#include "VisualizerFft.h"
+
+using android::VisualizerFft;
 
 extern "C" {
 
@@ -66,6 +73,11 @@ enum visualizer_state_e {
 // maximum number of buffers for which we keep track of the measurements
 #define MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS 25 // note: buffer index is stored in uint8_t
 
+static_assert(VISUALIZER_WINDOW_RECTANGULAR == VisualizerFft::WINDOW_RECTANGULAR &&
+        VISUALIZER_WINDOW_HANN == VisualizerFft::WINDOW_HANN, "window mismatch");
+static_assert(VISUALIZER_FFT_SIZE_MIN == VisualizerFft::kMinSize &&
+        VISUALIZER_FFT_SIZE_MAX == VisualizerFft::kMaxSize, "FFT size mismatch");
+
 
 struct BufferStats {
     bool mIsValid;
@@ -73,17 +85,37 @@ struct BufferStats {
     float mRmsSquared; // the average square of the samples in a buffer
 };
 
+// Magnitudes of the latest spectrum computed, shared by the clients asking for the same one.
+// mSequence is odd while the snapshot is written, and validates the reads of the other fields.
+struct SpectrumSnapshot {
+    std::atomic<uint32_t> mSequence{0};
+    uint32_t mGeneration;
+    uint32_t mCapturePoint;
+    uint32_t mFftSize;
+    uint32_t mWindow;
+    float mMagnitude[VisualizerFft::kMaxSize / 2 + 1];
+};
+
+// The capture buffers are only written by the process thread, which publishes mCaptureIdx and
+// mBufferUpdateTimeNs after writing, and read without locking by the command threads.
 struct VisualizerContext {
     const struct effect_interface_s *mItfe;
     effect_config_t mConfig;
-    uint32_t mCaptureIdx;
+    std::atomic<uint32_t> mCaptureIdx;
     uint32_t mCaptureSize;
     uint32_t mScalingMode;
     uint8_t mState;
-    uint32_t mLastCaptureIdx;
+    std::atomic<uint32_t> mLastCaptureIdx;
     uint32_t mLatency;
-    struct timespec mBufferUpdateTime;
+    std::atomic<int64_t> mBufferUpdateTimeNs; // CLOCK_MONOTONIC, 0 if not updated since reset
+    std::atomic<uint32_t> mCaptureGeneration{0}; // incremented by resets of the capture buffers
     uint8_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    int16_t mCaptureBuf16[CAPTURE_BUF_SIZE]; // (left + right) / 2, for the spectrum
+    // double buffered spectrum: readers use mSpectrum[mSpectrumFront], while the one client
+    // holding mSpectrumBusy writes the other snapshot
+    SpectrumSnapshot mSpectrum[2];
+    std::atomic<uint32_t> mSpectrumFront{0};
+    std::atomic<bool> mSpectrumBusy{false};
     // for measurements
     uint8_t mChannelCount; // to avoid recomputing it every time a buffer is processed
     uint32_t mMeasurementMode;
@@ -95,18 +127,22 @@ struct VisualizerContext {
 //
 //--- Local functions
 //
+// returns the CLOCK_MONOTONIC time in ns, or 0 on error
+static int64_t Visualizer_getTimeNs() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        return 0;
+    }
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext* pContext) {
     uint32_t deltaMs = 0;
-    if (pContext->mBufferUpdateTime.tv_sec != 0) {
-        struct timespec ts;
-        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
-            time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
-            long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
-            if (nsec < 0) {
-                --secs;
-                nsec += 1000000000;
-            }
-            deltaMs = secs * 1000 + nsec / 1000000;
+    const int64_t updateTimeNs = pContext->mBufferUpdateTimeNs.load(std::memory_order_relaxed);
+    if (updateTimeNs != 0) {
+        const int64_t nowNs = Visualizer_getTimeNs();
+        if (nowNs != 0) {
+            deltaMs = (nowNs - updateTimeNs) / 1000000;
         }
     }
     return deltaMs;
@@ -117,9 +153,155 @@ void Visualizer_reset(VisualizerContext *pContext)
 {
     pContext->mCaptureIdx = 0;
     pContext->mLastCaptureIdx = 0;
-    pContext->mBufferUpdateTime.tv_sec = 0;
+    pContext->mBufferUpdateTimeNs = 0;
+    pContext->mCaptureGeneration++;
     pContext->mLatency = 0;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    memset(pContext->mCaptureBuf16, 0, sizeof(pContext->mCaptureBuf16));
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_getCapturePoint()
+//----------------------------------------------------------------------------
+// Purpose: Locate the capture of the audio being played, given the latency.
+//
+// Inputs:
+//  pContext:       effect engine context
+//  captureSize:    number of frames of the capture
+//
+// Outputs:
+//  returns the index of the first frame of the capture in the capture buffers, or -1 if the
+//  audio framework has stopped playing audio and the capture must be silent.
+//
+//----------------------------------------------------------------------------
+
+static int32_t Visualizer_getCapturePoint(VisualizerContext *pContext, uint32_t captureSize)
+{
+    const uint32_t captureIdx = pContext->mCaptureIdx.load(std::memory_order_acquire);
+    const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+    const uint32_t lastCaptureIdx = pContext->mLastCaptureIdx.exchange(captureIdx);
+
+    // if audio framework has stopped playing audio although the effect is still
+    // active we must clear the capture buffer to return silence
+    if ((lastCaptureIdx == captureIdx) &&
+            (pContext->mBufferUpdateTimeNs.load(std::memory_order_relaxed) != 0) &&
+            (deltaMs > MAX_STALL_TIME_MS)) {
+        ALOGV("capture going to idle");
+        pContext->mBufferUpdateTimeNs = 0;
+        return -1;
+    }
+
+    int32_t latencyMs = pContext->mLatency;
+    latencyMs -= deltaMs;
+    if (latencyMs < 0) {
+        latencyMs = 0;
+    }
+    uint32_t deltaSmpl = captureSize
+            + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+
+    // large sample rate, latency, or capture size, could cause overflow.
+    // do not offset more than the size of buffer.
+    if (deltaSmpl > CAPTURE_BUF_SIZE) {
+        android_errorWriteLog(0x534e4554, "31781965");
+        deltaSmpl = CAPTURE_BUF_SIZE;
+    }
+
+    int32_t capturePoint = captureIdx - deltaSmpl;
+    // a negative capturePoint means we wrap the buffer.
+    if (capturePoint < 0) {
+        capturePoint += CAPTURE_BUF_SIZE;
+    }
+    return capturePoint;
+}
+
+// FFT of each size and window, created when first used and shared by all visualizers
+static const VisualizerFft *Visualizer_getFft(uint32_t size, VisualizerFft::Window window)
+{
+    static constexpr size_t kSizeCount = __builtin_ctz(VisualizerFft::kMaxSize)
+            - __builtin_ctz(VisualizerFft::kMinSize) + 1;
+    static std::once_flag sOnce[kSizeCount][VisualizerFft::WINDOW_CNT];
+    static std::unique_ptr<VisualizerFft> sFft[kSizeCount][VisualizerFft::WINDOW_CNT];
+
+    const size_t index = __builtin_ctz(size) - __builtin_ctz(VisualizerFft::kMinSize);
+    std::call_once(sOnce[index][window], [=]() {
+        sFft[index][window].reset(new VisualizerFft(size, window));
+    });
+    return sFft[index][window].get();
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_getMagnitude()
+//----------------------------------------------------------------------------
+// Purpose: Compute the decimated magnitude spectrum of the latest capture.
+//  Clients asking for the spectrum of the same capture, FFT size and window, read the one
+//  computed by the first of them. The spectrum is double buffered without locking: a reader
+//  computes it itself if it finds another one or is overtaken while reading, and only publishes
+//  it if no other reader is publishing one.
+//
+// Inputs:
+//  pContext:   effect engine context
+//  pCmd:       validated VISUALIZER_CMD_MAGNITUDE command
+//
+// Outputs:
+//  magnitude:  pCmd->binCount magnitudes
+//
+//----------------------------------------------------------------------------
+
+static void Visualizer_getMagnitude(VisualizerContext *pContext,
+        const visualizer_magnitude_cmd_t *pCmd, float *magnitude)
+{
+    const uint32_t fftSize = pCmd->fftSize;
+    const int32_t capturePoint = pContext->mState == VISUALIZER_STATE_ACTIVE
+            ? Visualizer_getCapturePoint(pContext, fftSize) : -1;
+    if (capturePoint < 0) {
+        memset(magnitude, 0, pCmd->binCount * sizeof(float));
+        return;
+    }
+    const uint32_t generation = pContext->mCaptureGeneration.load(std::memory_order_relaxed);
+    const VisualizerFft *fft = Visualizer_getFft(fftSize, (VisualizerFft::Window)pCmd->window);
+
+    SpectrumSnapshot *snapshot =
+            &pContext->mSpectrum[pContext->mSpectrumFront.load(std::memory_order_acquire)];
+    const uint32_t sequence = snapshot->mSequence.load(std::memory_order_acquire);
+    if ((sequence & 1) == 0 && snapshot->mGeneration == generation
+            && snapshot->mCapturePoint == (uint32_t)capturePoint
+            && snapshot->mFftSize == fftSize && snapshot->mWindow == pCmd->window) {
+        VisualizerFft::decimate(snapshot->mMagnitude, fft->bins(), magnitude, pCmd->binCount);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (snapshot->mSequence.load(std::memory_order_relaxed) == sequence) {
+            return;
+        }
+    }
+
+    float samples[VisualizerFft::kMaxSize];
+    float bins[VisualizerFft::kMaxSize / 2 + 1];
+    const uint32_t firstCount = std::min(fftSize, (uint32_t)(CAPTURE_BUF_SIZE - capturePoint));
+    const int16_t *buf16 = pContext->mCaptureBuf16;
+    for (uint32_t i = 0; i < firstCount; i++) {
+        samples[i] = buf16[capturePoint + i] * (1.0f / 32768);
+    }
+    for (uint32_t i = firstCount; i < fftSize; i++) {
+        samples[i] = buf16[i - firstCount] * (1.0f / 32768);
+    }
+    fft->magnitude(samples, bins);
+    VisualizerFft::decimate(bins, fft->bins(), magnitude, pCmd->binCount);
+
+    if (pContext->mSpectrumBusy.exchange(true, std::memory_order_acquire)) {
+        return; // another client is publishing its spectrum
+    }
+    const uint32_t back = 1 - pContext->mSpectrumFront.load(std::memory_order_relaxed);
+    snapshot = &pContext->mSpectrum[back];
+    const uint32_t backSequence = snapshot->mSequence.load(std::memory_order_relaxed);
+    snapshot->mSequence.store(backSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    snapshot->mGeneration = generation;
+    snapshot->mCapturePoint = capturePoint;
+    snapshot->mFftSize = fftSize;
+    snapshot->mWindow = pCmd->window;
+    memcpy(snapshot->mMagnitude, bins, fft->bins() * sizeof(float));
+    snapshot->mSequence.store(backSequence + 2, std::memory_order_release);
+    pContext->mSpectrumFront.store(back, std::memory_order_release);
+    pContext->mSpectrumBusy.store(false, std::memory_order_release);
 }
 
 //----------------------------------------------------------------------------
@@ -324,24 +506,25 @@ int Visualizer_process(
         return -EINVAL;
     }
 
+    const size_t frameCount = inBuffer->frameCount;
+    const int16_t *in = inBuffer->s16;
+
     // perform measurements if needed
     if (pContext->mMeasurementMode & MEASUREMENT_MODE_PEAK_RMS) {
-        // find the peak and RMS squared for the new buffer
-        uint32_t inIdx;
-        int16_t maxSample = 0;
-        float rmsSqAcc = 0;
-        for (inIdx = 0 ; inIdx < inBuffer->frameCount * pContext->mChannelCount ; inIdx++) {
-            if (inBuffer->s16[inIdx] > maxSample) {
-                maxSample = inBuffer->s16[inIdx];
-            } else if (-inBuffer->s16[inIdx] > maxSample) {
-                maxSample = -inBuffer->s16[inIdx];
-            }
-            rmsSqAcc += (inBuffer->s16[inIdx] * inBuffer->s16[inIdx]);
+        // find the peak and RMS squared for the new buffer,
+        // the sum of squares is exact in 64 bits, and both loops vectorize
+        const size_t sampleCount = frameCount * pContext->mChannelCount;
+        int32_t maxSample = 0;
+        int64_t sumSquares = 0;
+        for (size_t i = 0; i < sampleCount; i++) {
+            const int32_t smp = in[i];
+            maxSample = std::max(maxSample, smp < 0 ? -smp : smp);
+            sumSquares += smp * smp;
         }
         // store the measurement
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mPeakU16 = (uint16_t)maxSample;
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mRmsSquared =
-                rmsSqAcc / (inBuffer->frameCount * pContext->mChannelCount);
+                (float)sumSquares / sampleCount;
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mIsValid = true;
         if (++pContext->mMeasurementBufferIdx >= pContext->mMeasurementWindowSizeInBuffers) {
             pContext->mMeasurementBufferIdx = 0;
@@ -354,14 +537,15 @@ int Visualizer_process(
     if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
         // derive capture scaling factor from peak value in current buffer
         // this gives more interesting captures for display.
-        shift = 32;
-        int len = inBuffer->frameCount * 2;
-        for (int i = 0; i < len; i++) {
-            int32_t smp = inBuffer->s16[i];
-            if (smp < 0) smp = -smp - 1; // take care to keep the max negative in range
-            int32_t clz = __builtin_clz(smp);
-            if (shift > clz) shift = clz;
+        // The fewest leading zeros of the samples are those of their bitwise or.
+        const size_t len = frameCount * 2;
+        int32_t bits = 0;
+        for (size_t i = 0; i < len; i++) {
+            const int32_t smp = in[i];
+            // -smp - 1 for negative samples, to keep the max negative in range
+            bits |= smp ^ (smp >> 31);
         }
+        shift = bits == 0 ? 32 : __builtin_clz(bits);
         // A maximum amplitude signal will have 17 leading zeros, which we want to
         // translate to a shift of 8 (for converting 16 bit to 8 bit)
         shift = 25 - shift;
@@ -376,28 +560,29 @@ int Visualizer_process(
         shift = 9;
     }
 
-    uint32_t captIdx;
-    uint32_t inIdx;
-    uint8_t *buf = pContext->mCaptureBuf;
-    for (inIdx = 0, captIdx = pContext->mCaptureIdx;
-         inIdx < inBuffer->frameCount;
-         inIdx++, captIdx++) {
+    // the capture is written in contiguous parts, up to the wrap around
+    uint32_t captIdx = pContext->mCaptureIdx.load(std::memory_order_relaxed);
+    for (size_t inIdx = 0; inIdx < frameCount; ) {
+        const size_t count = std::min(frameCount - inIdx, (size_t)(CAPTURE_BUF_SIZE - captIdx));
+        const int16_t * __restrict src = in + 2 * inIdx;
+        uint8_t * __restrict buf = pContext->mCaptureBuf + captIdx;
+        int16_t * __restrict buf16 = pContext->mCaptureBuf16 + captIdx;
+        for (size_t i = 0; i < count; i++) {
+            const int32_t smp = src[2 * i] + src[2 * i + 1];
+            buf[i] = ((uint8_t)(smp >> shift)) ^ 0x80;
+            buf16[i] = smp >> 1;
+        }
+        inIdx += count;
+        captIdx += count;
         if (captIdx >= CAPTURE_BUF_SIZE) {
             // wrap around
             captIdx = 0;
         }
-        int32_t smp = inBuffer->s16[2 * inIdx] + inBuffer->s16[2 * inIdx + 1];
-        smp = smp >> shift;
-        buf[captIdx] = ((uint8_t)smp)^0x80;
     }
 
-    // XXX the following two should really be atomic, though it probably doesn't
-    // matter much for visualization purposes
-    pContext->mCaptureIdx = captIdx;
-    // update last buffer update time stamp
-    if (clock_gettime(CLOCK_MONOTONIC, &pContext->mBufferUpdateTime) < 0) {
-        pContext->mBufferUpdateTime.tv_sec = 0;
-    }
+    // publish the capture, then update last buffer update time stamp
+    pContext->mCaptureIdx.store(captIdx, std::memory_order_release);
+    pContext->mBufferUpdateTimeNs.store(Visualizer_getTimeNs(), std::memory_order_relaxed);
 
     if (inBuffer->raw != outBuffer->raw) {
         if (pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
@@ -567,55 +752,16 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                     *replySize, captureSize);
             return -EINVAL;
         }
-        if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0) &&
-                    (deltaMs > MAX_STALL_TIME_MS)) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, captureSize);
-            } else {
-                int32_t latencyMs = pContext->mLatency;
-                latencyMs -= deltaMs;
-                if (latencyMs < 0) {
-                    latencyMs = 0;
-                }
-                uint32_t deltaSmpl = captureSize
-                        + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-                // large sample rate, latency, or capture size, could cause overflow.
-                // do not offset more than the size of buffer.
-                if (deltaSmpl > CAPTURE_BUF_SIZE) {
-                    android_errorWriteLog(0x534e4554, "31781965");
-                    deltaSmpl = CAPTURE_BUF_SIZE;
-                }
-
-                int32_t capturePoint = pContext->mCaptureIdx - deltaSmpl;
-                // a negative capturePoint means we wrap the buffer.
-                if (capturePoint < 0) {
-                    uint32_t size = -capturePoint;
-                    if (size > captureSize) {
-                        size = captureSize;
-                    }
-                    memcpy(pReplyData,
-                           pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                           size);
-                    pReplyData = (char *)pReplyData + size;
-                    captureSize -= size;
-                    capturePoint = 0;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + capturePoint,
-                       captureSize);
-            }
-
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
-        } else {
+        const int32_t capturePoint = pContext->mState == VISUALIZER_STATE_ACTIVE
+                ? Visualizer_getCapturePoint(pContext, captureSize) : -1;
+        if (capturePoint < 0) {
             memset(pReplyData, 0x80, captureSize);
+        } else {
+            // a capture beyond the end of the buffer wraps around
+            const uint32_t size = std::min(captureSize,
+                    (uint32_t)(CAPTURE_BUF_SIZE - capturePoint));
+            memcpy(pReplyData, pContext->mCaptureBuf + capturePoint, size);
+            memcpy((char *)pReplyData + size, pContext->mCaptureBuf, captureSize - size);
         }
 
         } break;
@@ -681,6 +827,26 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         }
         break;
 
+    case VISUALIZER_CMD_MAGNITUDE: {
+        const visualizer_magnitude_cmd_t *pCmd = (const visualizer_magnitude_cmd_t *)pCmdData;
+        if (pCmd == NULL || cmdSize != sizeof(visualizer_magnitude_cmd_t)
+                || pReplyData == NULL || replySize == NULL) {
+            return -EINVAL;
+        }
+        const uint32_t binCount = pCmd->binCount;
+        if (!VisualizerFft::isValidSize(pCmd->fftSize)
+                || pCmd->window >= VisualizerFft::WINDOW_CNT
+                || binCount == 0 || binCount > pCmd->fftSize / 2
+                || (binCount & (binCount - 1)) != 0
+                || *replySize != binCount * sizeof(float)) {
+            ALOGV("VISUALIZER_CMD_MAGNITUDE() error fftSize %" PRIu32 " window %" PRIu32
+                    " binCount %" PRIu32 " *replySize %" PRIu32,
+                    pCmd->fftSize, pCmd->window, binCount, *replySize);
+            return -EINVAL;
+        }
+        Visualizer_getMagnitude(pContext, pCmd, (float *)pReplyData);
+        } break;
+
     default:
         ALOGW("Visualizer_command invalid command %" PRIu32, cmdCode);
         return -EINVAL;
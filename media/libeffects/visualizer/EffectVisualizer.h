@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECTVISUALIZER_H_
+#define ANDROID_EFFECTVISUALIZER_H_
+
+#include <stdint.h>
+
+#include <audio_effects/effect_visualizer.h>
+
+// Vendor extensions of the visualizer, beyond effect_visualizer.h
+
+// Vendor command computing the magnitude spectrum of the latest capture in the effect.
+// The command data is a visualizer_magnitude_cmd_t, and the reply holds binCount floats, each
+// the peak magnitude of a band of fftSize / 2 / binCount bins, 1.0 being a full scale sine.
+// The spectrum is computed on 16 bit samples, whatever the scaling mode.
+#define VISUALIZER_CMD_MAGNITUDE (EFFECT_CMD_FIRST_PROPRIETARY + 0x100)
+
+// windows of VISUALIZER_CMD_MAGNITUDE
+#define VISUALIZER_WINDOW_RECTANGULAR 0
+#define VISUALIZER_WINDOW_HANN 1
+
+// FFT sizes of VISUALIZER_CMD_MAGNITUDE
+#define VISUALIZER_FFT_SIZE_MIN 128
+#define VISUALIZER_FFT_SIZE_MAX 4096
+
+typedef struct {
+    uint32_t fftSize;  // power of 2 in [VISUALIZER_FFT_SIZE_MIN, VISUALIZER_FFT_SIZE_MAX]
+    uint32_t window;   // VISUALIZER_WINDOW_xxx
+    uint32_t binCount; // power of 2, at most fftSize / 2
+} visualizer_magnitude_cmd_t;
+
+#endif /*ANDROID_EFFECTVISUALIZER_H_*/
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VisualizerFft"
+//#define LOG_NDEBUG 0
+
+#include <algorithm>
+#include <math.h>
+
+#include <log/log.h>
+
+#include "VisualizerFft.h"
+
+namespace android {
+
+constexpr size_t VisualizerFft::kMinSize;
+constexpr size_t VisualizerFft::kMaxSize;
+
+VisualizerFft::VisualizerFft(size_t size, Window window)
+    : mSize(size), mWindow(size)
+{
+    ALOG_ASSERT(isValidSize(size), "invalid FFT size %zu", size);
+
+    double windowSum = 0;
+    for (size_t i = 0; i < size; i++) {
+        // periodic Hann window, the best of both worlds for visualization: sidelobes decrease
+        // quickly, and the main lobe stays 4 bins wide
+        mWindow[i] = window == WINDOW_HANN ? 0.5 - 0.5 * cos(2. * M_PI * i / size) : 1.;
+        windowSum += mWindow[i];
+    }
+    mScale = 2. / windowSum;
+
+    // the stage of length n multiplies by exp(-2 i pi p / n), for p < n / 2
+    const size_t half = size / 2;
+    for (size_t n = half; n > 1; n /= 2) {
+        for (size_t p = 0; p < n / 2; p++) {
+            mStageCos.push_back(cos(2. * M_PI * p / n));
+            mStageSin.push_back(-sin(2. * M_PI * p / n));
+        }
+    }
+    mSplitCos.resize(half);
+    mSplitSin.resize(half);
+    for (size_t k = 0; k < half; k++) {
+        mSplitCos[k] = cos(2. * M_PI * k / size);
+        mSplitSin[k] = sin(2. * M_PI * k / size);
+    }
+}
+
+// Butterflies of a stage on s interleaved sequences of stride s, for p < m:
+//   b[s * 2p + q] = a[s * p + q] + a[s * (p + m) + q]
+//   b[s * (2p + 1) + q] = (a[s * p + q] - a[s * (p + m) + q]) * w[p]
+// The sequences are long in the first stages, so the inner loop of kStride runs across them and
+// the loop over p is vectorized; afterwards each butterfly is a vectorized loop over q.
+template <size_t kStride>
+static inline void stage(const float * __restrict ar, const float * __restrict ai,
+        float * __restrict br, float * __restrict bi,
+        const float * __restrict wr, const float * __restrict wi, size_t m, size_t s)
+{
+    const size_t stride = kStride != 0 ? kStride : s;
+    for (size_t p = 0; p < m; p++) {
+        const float cr = wr[p], ci = wi[p];
+        for (size_t q = 0; q < stride; q++) {
+            const float r0 = ar[stride * p + q], i0 = ai[stride * p + q];
+            const float r1 = ar[stride * (p + m) + q], i1 = ai[stride * (p + m) + q];
+            const float dr = r0 - r1, di = i0 - i1;
+            br[stride * 2 * p + q] = r0 + r1;
+            bi[stride * 2 * p + q] = i0 + i1;
+            br[stride * (2 * p + 1) + q] = dr * cr - di * ci;
+            bi[stride * (2 * p + 1) + q] = dr * ci + di * cr;
+        }
+    }
+}
+
+float *VisualizerFft::complexFft(float *re, float *im, float *scratchRe, float *scratchIm) const
+{
+    const float *stageCos = mStageCos.data();
+    const float *stageSin = mStageSin.data();
+    float *xRe = re, *xIm = im, *yRe = scratchRe, *yIm = scratchIm;
+
+    for (size_t n = mSize / 2, s = 1; n > 1; n /= 2, s *= 2) {
+        const size_t m = n / 2;
+        switch (s) {
+        case 1:
+            stage<1>(xRe, xIm, yRe, yIm, stageCos, stageSin, m, s);
+            break;
+        case 2:
+            stage<2>(xRe, xIm, yRe, yIm, stageCos, stageSin, m, s);
+            break;
+        default:
+            stage<0>(xRe, xIm, yRe, yIm, stageCos, stageSin, m, s);
+            break;
+        }
+        stageCos += m;
+        stageSin += m;
+        std::swap(xRe, yRe);
+        std::swap(xIm, yIm);
+    }
+    return xRe;
+}
+
+void VisualizerFft::magnitude(const float *in, float *magnitude) const
+{
+    const size_t half = mSize / 2;
+    float re[kMaxSize / 2], im[kMaxSize / 2], scratchRe[kMaxSize / 2], scratchIm[kMaxSize / 2];
+
+    // the even samples are the real part, the odd samples the imaginary part
+    const float *window = mWindow.data();
+    for (size_t n = 0; n < half; n++) {
+        re[n] = in[2 * n] * window[2 * n];
+        im[n] = in[2 * n + 1] * window[2 * n + 1];
+    }
+    const float *zRe = re, *zIm = im;
+    if (complexFft(re, im, scratchRe, scratchIm) != re) {
+        zRe = scratchRe;
+        zIm = scratchIm;
+    }
+
+    // the spectra of the even and odd samples give the bins below Nyquist
+    const float scale = mScale;
+    const float * __restrict c = mSplitCos.data();
+    const float * __restrict s = mSplitSin.data();
+    float * __restrict out = magnitude;
+    for (size_t k = 1; k < half; k++) {
+        const size_t b = half - k;
+        const float evenRe = 0.5f * (zRe[k] + zRe[b]);
+        const float evenIm = 0.5f * (zIm[k] - zIm[b]);
+        const float oddRe = 0.5f * (zIm[k] + zIm[b]);
+        const float oddIm = -0.5f * (zRe[k] - zRe[b]);
+        const float binRe = evenRe + c[k] * oddRe + s[k] * oddIm;
+        const float binIm = evenIm + c[k] * oddIm - s[k] * oddRe;
+        out[k] = sqrtf(binRe * binRe + binIm * binIm) * scale;
+    }
+    out[0] = fabsf(zRe[0] + zIm[0]) * 0.5f * scale;
+    out[half] = fabsf(zRe[0] - zIm[0]) * 0.5f * scale;
+}
+
+void VisualizerFft::decimate(const float *magnitude, size_t bins, float *out, size_t count)
+{
+    const size_t width = (bins - 1) / count;
+    for (size_t i = 0; i < count; i++) {
+        float peak = 0;
+        for (size_t j = 0; j < width; j++) {
+            peak = std::max(peak, magnitude[i * width + j]);
+        }
+        out[i] = peak;
+    }
+}
+
+} // namespace android
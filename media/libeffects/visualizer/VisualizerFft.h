@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VISUALIZER_FFT_H_
+#define ANDROID_VISUALIZER_FFT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+// Magnitude spectrum of windowed real signals, computed with a complex FFT of half the size.
+// The complex FFT is a radix-2 Stockham FFT on separate real and imaginary parts: it needs no
+// bit reversal, and every stage is a loop of contiguous loads and stores that the compiler
+// vectorizes.
+// The tables are only read after construction, so a VisualizerFft can be shared by threads.
+class VisualizerFft {
+public:
+    static constexpr size_t kMinSize = 128;
+    static constexpr size_t kMaxSize = 4096;
+
+    enum Window {
+        WINDOW_RECTANGULAR,
+        WINDOW_HANN,
+        WINDOW_CNT,
+    };
+
+    // size is a power of 2 in [kMinSize, kMaxSize]
+    VisualizerFft(size_t size, Window window);
+
+    static bool isValidSize(size_t size) {
+        return size >= kMinSize && size <= kMaxSize && (size & (size - 1)) == 0;
+    }
+
+    size_t size() const { return mSize; }
+    size_t bins() const { return mSize / 2 + 1; }
+
+    // Computes the bins() magnitudes of size() samples, scaled so that a full scale sine at
+    // the frequency of a bin has a magnitude of 1.
+    void magnitude(const float *in, float *magnitude) const;
+
+    // Reduces the first bins - 1 magnitudes (all but the Nyquist bin) to count bands of equal
+    // width, keeping the maximum of each band so that peaks are not averaged out.
+    // count is a power of 2, at most bins - 1.
+    static void decimate(const float *magnitude, size_t bins, float *out, size_t count);
+
+private:
+    // returns the array holding the result, re or scratchRe
+    float *complexFft(float *re, float *im, float *scratchRe, float *scratchIm) const;
+
+    const size_t mSize;
+    std::vector<float> mWindow;
+    std::vector<float> mStageCos, mStageSin; // twiddles of each stage of the complex FFT
+    std::vector<float> mSplitCos, mSplitSin; // twiddles separating the even and odd samples
+    float mScale;                            // of the bins but DC and Nyquist
+};
+
+} // namespace android
+
+#endif // ANDROID_VISUALIZER_FFT_H_
@@ -0,0 +1,16 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_VENDOR_MODULE := true
+LOCAL_SRC_FILES:= \
+	visualizer_tests.cpp \
+	../EffectVisualizer.cpp \
+	../VisualizerFft.cpp
+LOCAL_CFLAGS += -O2 -Wall -Werror
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/.. \
+	$(call include-path-for, audio-effects)
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+LOCAL_HEADER_LIBRARIES += libhardware_headers
+LOCAL_MODULE := visualizer_tests
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the capture and the magnitude spectrum of the visualizer effect.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <hardware/audio_effect.h>
+
+#include "EffectVisualizer.h"
+#include "VisualizerFft.h"
+
+using android::VisualizerFft;
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+namespace {
+
+// The visualizer effect as AudioFlinger uses it, through the effect interface.
+class VisualizerEffect {
+public:
+    explicit VisualizerEffect(uint32_t sampleRate = 48000) {
+        const effect_uuid_t uuid =
+                {0xd069d9e0, 0x8329, 0x11df, 0x9168, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+        EXPECT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&uuid, 0, 0, &mHandle));
+        effect_config_t config = {};
+        config.inputCfg.samplingRate = config.outputCfg.samplingRate = sampleRate;
+        config.inputCfg.channels = config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+        config.inputCfg.format = config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        config.inputCfg.mask = config.outputCfg.mask = EFFECT_CONFIG_ALL;
+        EXPECT_EQ(0, command(EFFECT_CMD_SET_CONFIG, sizeof(config), &config));
+        EXPECT_EQ(0, command(EFFECT_CMD_ENABLE, 0, nullptr));
+    }
+    ~VisualizerEffect() {
+        AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(mHandle);
+    }
+
+    int setParameter(uint32_t param, uint32_t value) {
+        uint32_t buf[sizeof(effect_param_t) / sizeof(uint32_t) + 2];
+        effect_param_t *p = (effect_param_t *)buf;
+        p->psize = sizeof(uint32_t);
+        p->vsize = sizeof(uint32_t);
+        *(uint32_t *)p->data = param;
+        *((uint32_t *)p->data + 1) = value;
+        return command(EFFECT_CMD_SET_PARAM, sizeof(buf), buf);
+    }
+
+    int process(const int16_t *in, size_t frameCount) {
+        mOut.resize(frameCount * 2);
+        audio_buffer_t inBuffer = {}, outBuffer = {};
+        inBuffer.frameCount = outBuffer.frameCount = frameCount;
+        inBuffer.raw = const_cast<int16_t *>(in);
+        outBuffer.raw = mOut.data();
+        return (*mHandle)->process(mHandle, &inBuffer, &outBuffer);
+    }
+
+    int capture(uint8_t *waveform, uint32_t captureSize) {
+        return (*mHandle)->command(mHandle, VISUALIZER_CMD_CAPTURE, 0, nullptr, &captureSize,
+                                   waveform);
+    }
+
+    int magnitude(uint32_t fftSize, uint32_t window, float *magnitude, uint32_t binCount) {
+        visualizer_magnitude_cmd_t cmd = {fftSize, window, binCount};
+        uint32_t replySize = binCount * sizeof(float);
+        return (*mHandle)->command(mHandle, VISUALIZER_CMD_MAGNITUDE, sizeof(cmd), &cmd,
+                                   &replySize, magnitude);
+    }
+
+private:
+    int command(uint32_t code, uint32_t size, void *data) {
+        int reply = 0;
+        uint32_t replySize = sizeof(reply);
+        const int status = (*mHandle)->command(mHandle, code, size, data, &replySize, &reply);
+        return status != 0 ? status : reply;
+    }
+
+    effect_handle_t mHandle = nullptr;
+    std::vector<int16_t> mOut;
+};
+
+// Stereo sine of the same amplitude on both channels, frequency in cycles per frame.
+std::vector<int16_t> sine(size_t frameCount, double frequency, double amplitude,
+                          size_t firstFrame = 0) {
+    std::vector<int16_t> samples(frameCount * 2);
+    for (size_t i = 0; i < frameCount; i++) {
+        samples[2 * i] = samples[2 * i + 1] =
+                lrint(32768 * amplitude * sin(2 * M_PI * frequency * (firstFrame + i)));
+    }
+    return samples;
+}
+
+// The capture of a buffer, as the effect has always computed it.
+void referenceCapture(const std::vector<int16_t> &in, uint32_t scalingMode,
+                      std::vector<uint8_t> &capture) {
+    int32_t shift;
+    if (scalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
+        shift = 32;
+        for (int32_t smp : in) {
+            if (smp < 0) smp = -smp - 1;
+            const int32_t clz = smp == 0 ? 32 : __builtin_clz(smp);
+            shift = std::min(shift, clz);
+        }
+        shift = std::max(25 - shift, 3) + 1;
+    } else {
+        shift = 9;
+    }
+    for (size_t i = 0; i < in.size(); i += 2) {
+        capture.push_back(((uint8_t)((in[i] + in[i + 1]) >> shift)) ^ 0x80);
+    }
+}
+
+} // namespace
+
+TEST(visualizer_tests, fft_matches_dft) {
+    std::minstd_rand generator(42);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    for (size_t size = VisualizerFft::kMinSize; size <= VisualizerFft::kMaxSize; size *= 2) {
+        for (int window : {VisualizerFft::WINDOW_RECTANGULAR, VisualizerFft::WINDOW_HANN}) {
+            SCOPED_TRACE(testing::Message() << "size " << size << " window " << window);
+            VisualizerFft fft(size, (VisualizerFft::Window)window);
+            std::vector<float> in(size), magnitude(fft.bins());
+            for (auto &sample : in) {
+                sample = distribution(generator);
+            }
+            fft.magnitude(in.data(), magnitude.data());
+
+            std::vector<double> weights(size);
+            double weightSum = 0;
+            for (size_t i = 0; i < size; i++) {
+                weights[i] = window == VisualizerFft::WINDOW_HANN ?
+                        0.5 - 0.5 * cos(2 * M_PI * i / size) : 1.;
+                weightSum += weights[i];
+            }
+            for (size_t k = 0; k < fft.bins(); k++) {
+                double re = 0, im = 0;
+                for (size_t i = 0; i < size; i++) {
+                    re += in[i] * weights[i] * cos(2 * M_PI * k * i / size);
+                    im -= in[i] * weights[i] * sin(2 * M_PI * k * i / size);
+                }
+                const double scale = (k == 0 || k == size / 2 ? 1. : 2.) / weightSum;
+                ASSERT_NEAR(sqrt(re * re + im * im) * scale, magnitude[k], 1e-6) << "bin " << k;
+            }
+        }
+    }
+}
+
+TEST(visualizer_tests, decimate_keeps_peaks) {
+    std::vector<float> magnitude(VisualizerFft::kMinSize / 2 + 1, 0.f);
+    magnitude[5] = 0.25f;
+    magnitude[17] = 0.5f;
+    magnitude[63] = 1.f;
+    magnitude[64] = 2.f; // Nyquist, dropped
+    std::vector<float> out(8);
+    VisualizerFft::decimate(magnitude.data(), magnitude.size(), out.data(), out.size());
+    EXPECT_EQ(std::vector<float>({0.25f, 0.f, 0.5f, 0.f, 0.f, 0.f, 0.f, 1.f}), out);
+}
+
+TEST(visualizer_tests, capture_matches_reference) {
+    constexpr uint32_t kCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
+    std::minstd_rand generator(7);
+    std::uniform_int_distribution<int> frames(1, 4000);
+    std::uniform_int_distribution<int> bits(0, 16);
+    for (uint32_t scalingMode :
+            {VISUALIZER_SCALING_MODE_NORMALIZED, VISUALIZER_SCALING_MODE_AS_PLAYED}) {
+        SCOPED_TRACE(testing::Message() << "scaling mode " << scalingMode);
+        VisualizerEffect effect;
+        ASSERT_EQ(0, effect.setParameter(VISUALIZER_PARAM_SCALING_MODE, scalingMode));
+        std::vector<uint8_t> expected(kCaptureSize, 0x80), waveform(kCaptureSize);
+        // more than the capture buffer, so that it wraps around
+        for (size_t total = 0; total < 3 * 65536; ) {
+            // buffers of varying amplitudes, including silence and the max negative sample
+            const int32_t amplitude = (1 << bits(generator)) - 1;
+            std::uniform_int_distribution<int> sample(-amplitude - 1, amplitude);
+            std::vector<int16_t> in(frames(generator) * 2);
+            for (auto &smp : in) {
+                smp = sample(generator);
+            }
+            ASSERT_EQ(0, effect.process(in.data(), in.size() / 2));
+            referenceCapture(in, scalingMode, expected);
+            ASSERT_EQ(0, effect.capture(waveform.data(), kCaptureSize));
+            ASSERT_TRUE(std::equal(waveform.begin(), waveform.end(),
+                                   expected.end() - kCaptureSize)) << "after " << total;
+            total += in.size() / 2;
+        }
+    }
+}
+
+TEST(visualizer_tests, magnitude_of_sine) {
+    constexpr double kAmplitude = 0.5;
+    constexpr uint32_t kFftSize = 1024;
+    constexpr uint32_t kBin = 37;
+    VisualizerEffect effect;
+    const std::vector<int16_t> in = sine(4800, (double)kBin / kFftSize, kAmplitude);
+    ASSERT_EQ(0, effect.process(in.data(), in.size() / 2));
+
+    for (uint32_t window : {VISUALIZER_WINDOW_RECTANGULAR, VISUALIZER_WINDOW_HANN}) {
+        SCOPED_TRACE(testing::Message() << "window " << window);
+        std::vector<float> magnitude(kFftSize / 2);
+        ASSERT_EQ(0, effect.magnitude(kFftSize, window, magnitude.data(), magnitude.size()));
+        // the Hann window spreads the sine on the adjacent bins
+        const uint32_t spread = window == VISUALIZER_WINDOW_HANN ? 1 : 0;
+        for (uint32_t k = 0; k < magnitude.size(); k++) {
+            if (k == kBin) {
+                EXPECT_NEAR(kAmplitude, magnitude[k], 1e-3);
+            } else if (k + spread < kBin || k > kBin + spread) {
+                EXPECT_NEAR(0., magnitude[k], 1e-3) << "bin " << k;
+            }
+        }
+
+        // decimated by 8, and the same again from the shared spectrum
+        std::vector<float> decimated(kFftSize / 16), again(kFftSize / 16);
+        ASSERT_EQ(0, effect.magnitude(kFftSize, window, decimated.data(), decimated.size()));
+        ASSERT_EQ(0, effect.magnitude(kFftSize, window, again.data(), again.size()));
+        EXPECT_EQ(decimated, again);
+        const auto peak = std::max_element(decimated.begin(), decimated.end());
+        EXPECT_EQ(kBin / 8, peak - decimated.begin());
+        EXPECT_EQ(magnitude[kBin], *peak);
+    }
+}
+
+TEST(visualizer_tests, magnitude_arguments) {
+    VisualizerEffect effect;
+    std::vector<float> magnitude(VisualizerFft::kMaxSize);
+    EXPECT_EQ(-EINVAL, effect.magnitude(VisualizerFft::kMinSize / 2, 0, magnitude.data(), 16));
+    EXPECT_EQ(-EINVAL, effect.magnitude(VisualizerFft::kMaxSize * 2, 0, magnitude.data(), 16));
+    EXPECT_EQ(-EINVAL, effect.magnitude(1000, 0, magnitude.data(), 16));
+    EXPECT_EQ(-EINVAL, effect.magnitude(1024, 2, magnitude.data(), 16));
+    EXPECT_EQ(-EINVAL, effect.magnitude(1024, 0, magnitude.data(), 0));
+    EXPECT_EQ(-EINVAL, effect.magnitude(1024, 0, magnitude.data(), 24));
+    EXPECT_EQ(-EINVAL, effect.magnitude(1024, 0, magnitude.data(), 1024));
+
+    // silence before any audio is played
+    std::fill(magnitude.begin(), magnitude.end(), 1.f);
+    EXPECT_EQ(0, effect.magnitude(VisualizerFft::kMaxSize, 0, magnitude.data(),
+                                  VisualizerFft::kMaxSize / 2));
+    EXPECT_TRUE(std::all_of(magnitude.begin(), magnitude.begin() + VisualizerFft::kMaxSize / 2,
+                            [](float m) { return m == 0.f; }));
+}
+
+// Clients asking for different spectra while audio is played.
+TEST(visualizer_tests, concurrent_clients) {
+    constexpr double kAmplitude = 0.25;
+    constexpr size_t kFrameCount = 480;
+    // a bin of every FFT size
+    constexpr double kFrequency = 10. / VisualizerFft::kMinSize;
+    VisualizerEffect effect;
+    std::vector<int16_t> in = sine(VisualizerFft::kMaxSize, kFrequency, kAmplitude);
+    ASSERT_EQ(0, effect.process(in.data(), in.size() / 2));
+
+    std::atomic<bool> done{false};
+    std::thread player([&]() {
+        for (size_t frame = VisualizerFft::kMaxSize; !done; frame += kFrameCount) {
+            const std::vector<int16_t> buffer = sine(kFrameCount, kFrequency, kAmplitude, frame);
+            effect.process(buffer.data(), kFrameCount);
+        }
+    });
+    std::vector<std::thread> clients;
+    std::atomic<int> failures{0};
+    for (uint32_t client = 0; client < 4; client++) {
+        clients.emplace_back([&, client]() {
+            std::vector<float> magnitude(VisualizerFft::kMaxSize / 2);
+            for (int i = 0; i < 2000; i++) {
+                // two clients for each size, alternating between two sizes
+                const uint32_t fftSize = VisualizerFft::kMinSize << ((client + i) % 2 + client / 2);
+                const uint32_t binCount = fftSize / 2;
+                if (effect.magnitude(fftSize, VISUALIZER_WINDOW_HANN, magnitude.data(),
+                                     binCount) != 0) {
+                    failures++;
+                    continue;
+                }
+                const auto peak = std::max_element(magnitude.begin(),
+                                                   magnitude.begin() + binCount);
+                if ((uint32_t)(peak - magnitude.begin()) != 10 * fftSize / VisualizerFft::kMinSize
+                        || std::fabs(*peak - kAmplitude) > 1e-3) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    done = true;
+    player.join();
+    EXPECT_EQ(0, failures);
+}
+
+TEST(visualizer_tests, benchmark) {
+    constexpr double kBufferSeconds = 0.01;
+    for (uint32_t sampleRate : {48000, 192000}) {
+        for (bool measure : {false, true}) {
+            const size_t frameCount = sampleRate * kBufferSeconds;
+            VisualizerEffect effect(sampleRate);
+            ASSERT_EQ(0, effect.setParameter(VISUALIZER_PARAM_MEASUREMENT_MODE,
+                    measure ? MEASUREMENT_MODE_PEAK_RMS : MEASUREMENT_MODE_NONE));
+            const std::vector<int16_t> in = sine(frameCount, 1000. / sampleRate, 0.5);
+            constexpr int kBuffers = 20000;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kBuffers; i++) {
+                effect.process(in.data(), frameCount);
+            }
+            const std::chrono::duration<double, std::micro> elapsed =
+                    std::chrono::steady_clock::now() - start;
+            const double microsPerBuffer = elapsed.count() / kBuffers;
+            printf("capture %6u Hz, %4zu frames%s: %6.2f us/buffer, %5.3f%% of real time\n",
+                   sampleRate, frameCount, measure ? ", measured" : "         ",
+                   microsPerBuffer, microsPerBuffer * 1e-4 / kBufferSeconds);
+        }
+    }
+
+    // the spectrum of a new capture, then the shared one
+    VisualizerEffect effect;
+    const std::vector<int16_t> in = sine(480, 1000. / 48000, 0.5);
+    for (uint32_t fftSize = VisualizerFft::kMinSize; fftSize <= VisualizerFft::kMaxSize;
+            fftSize *= 4) {
+        std::vector<float> magnitude(fftSize / 2);
+        constexpr int kRequests = 2000;
+        std::chrono::duration<double, std::micro> computed{0}, shared{0};
+        for (int i = 0; i < kRequests; i++) {
+            effect.process(in.data(), 480);
+            const auto start = std::chrono::steady_clock::now();
+            effect.magnitude(fftSize, VISUALIZER_WINDOW_HANN, magnitude.data(), fftSize / 2);
+            const auto middle = std::chrono::steady_clock::now();
+            effect.magnitude(fftSize, VISUALIZER_WINDOW_HANN, magnitude.data(), fftSize / 2);
+            computed += middle - start;
+            shared += std::chrono::steady_clock::now() - middle;
+        }
+        printf("magnitude %4u: %7.2f us computed, %6.2f us shared\n", fftSize,
+               computed.count() / kRequests, shared.count() / kRequests);
+    }
+}
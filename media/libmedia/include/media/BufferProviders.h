@@ -24,6 +24,7 @@
 #include <media/AudioResamplerPublic.h>
 #include <system/audio.h>
 #include <system/audio_effect.h>
+#include <system/audio_effects/effect_downmix.h>
 #include <utils/StrongPointer.h>
 
 // external forward declaration from external/sonic/sonic.h
@@ -53,6 +54,10 @@ public:
         mTrackBufferProvider = p;
     }
 
+    // returns the number of bytes this provider has written into its own buffers
+    // (or in-place into the upstream buffers) since construction.
+    virtual uint64_t getBytesCopied() const { return 0; }
+
 protected:
     AudioBufferProvider *mTrackBufferProvider;
 };
@@ -78,6 +83,7 @@ public:
 
     // Overrides PassthruBufferProvider
     virtual void reset();
+    virtual uint64_t getBytesCopied() const { return mBytesCopied; }
 
     // this function should be supplied by the derived class.  It converts
     // #frames in the *src pointer to the *dst pointer.  It is public because
@@ -93,6 +99,7 @@ private:
     const size_t         mLocalBufferFrameCount;
     void                *mLocalBufferData;
     size_t               mConsumed;
+    uint64_t             mBytesCopied;
 };
 
 // DownmixerBufferProvider derives from CopyBufferProvider to provide
@@ -101,7 +108,8 @@ class DownmixerBufferProvider : public CopyBufferProvider {
 public:
     DownmixerBufferProvider(audio_channel_mask_t inputChannelMask,
             audio_channel_mask_t outputChannelMask, audio_format_t format,
-            uint32_t sampleRate, int32_t sessionId, size_t bufferFrameCount);
+            uint32_t sampleRate, int32_t sessionId, size_t bufferFrameCount,
+            downmix_type_t downmixType = DOWNMIX_TYPE_FOLD);
     virtual ~DownmixerBufferProvider();
     //Overrides
     virtual void copyFrames(void *dst, const void *src, size_t frames);
@@ -110,6 +118,11 @@ public:
     static status_t init();
     static bool isMultichannelCapable() { return sIsMultichannelCapable; }
 
+    // Downmix type of the AOSP downmix effect which folds any channel mask up to 7.1.4,
+    // in 16 bit or float, with a coefficient matrix. Matches DOWNMIX_TYPE_MATRIX of
+    // media/libeffects/downmix/DownmixMatrix.h.
+    static const downmix_type_t kDownmixTypeMatrix = (downmix_type_t)(DOWNMIX_TYPE_LAST + 1);
+
 protected:
     sp<EffectsFactoryHalInterface> mEffectsFactory;
     sp<EffectHalInterface> mDownmixInterface;
@@ -130,16 +143,21 @@ protected:
 
 // RemixBufferProvider derives from CopyBufferProvider to perform an
 // upmix or downmix to the proper channel count and mask.
+// If inputFormat differs from outputFormat, the format conversion is done in the
+// same pass as the channel remix, so no separate ReformatBufferProvider is needed.
 class RemixBufferProvider : public CopyBufferProvider {
 public:
     RemixBufferProvider(audio_channel_mask_t inputChannelMask,
-            audio_channel_mask_t outputChannelMask, audio_format_t format,
-            size_t bufferFrameCount);
+            audio_channel_mask_t outputChannelMask, audio_format_t inputFormat,
+            audio_format_t outputFormat, size_t bufferFrameCount);
     //Overrides
     virtual void copyFrames(void *dst, const void *src, size_t frames);
 
+    audio_format_t getInputFormat() const { return mInputFormat; }
+
 protected:
-    const audio_format_t mFormat;
+    const audio_format_t mInputFormat;
+    const audio_format_t mOutputFormat;
     const size_t         mSampleSize;
     const size_t         mInputChannels;
     const size_t         mOutputChannels;
@@ -175,6 +193,7 @@ public:
 
     // Overrides PassthruBufferProvider
     virtual void reset();
+    virtual uint64_t getBytesCopied() const { return mBytesCopied; }
 
     virtual status_t setPlaybackRate(const AudioPlaybackRate &playbackRate);
 
@@ -203,6 +222,9 @@ private:
     //FIXME: this dependency should be abstracted out
     bool                 mFallbackFailErrorShown; // log fallback error only once
     bool                 mAudioPlaybackRateValid; // flag for current parameters validity
+    bool                 mPassthru;               // mBuffer is bypassed, upstream buffer
+                                                  // is returned to the caller as is
+    uint64_t             mBytesCopied;            // bytes written into mLocalBufferData
 };
 
 // ----------------------------------------------------------------------------
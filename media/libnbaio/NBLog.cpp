@@ -98,15 +98,18 @@
 #include <math.h>
 #include <numeric>
 #include <vector>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/prctl.h>
 #include <time.h>
+#include <unistd.h>
 #include <new>
 #include <audio_utils/roundup.h>
 #include <media/nbaio/NBLog.h>
+#include <media/nbaio/NBLogExport.h>
 #include <media/nbaio/PerformanceAnalysis.h>
 #include <media/nbaio/ReportPerformance.h>
 // #include <utils/CallStack.h> // used to print callstack
@@ -950,6 +953,103 @@ bool NBLog::Reader::isIMemory(const sp<IMemory>& iMemory) const
     return iMemory != 0 && mIMemory != 0 && iMemory->pointer() == mIMemory->pointer();
 }
 
+// ---------------------------------------------------------------------------
+// Binary export, see NBLogExport.h
+
+static_assert(NBLogExport::EVENT_STRING == NBLog::EVENT_STRING &&
+        NBLogExport::EVENT_TIMESTAMP == NBLog::EVENT_TIMESTAMP &&
+        NBLogExport::EVENT_INTEGER == NBLog::EVENT_INTEGER &&
+        NBLogExport::EVENT_FLOAT == NBLog::EVENT_FLOAT &&
+        NBLogExport::EVENT_PID == NBLog::EVENT_PID &&
+        NBLogExport::EVENT_AUTHOR == NBLog::EVENT_AUTHOR &&
+        NBLogExport::EVENT_START_FMT == NBLog::EVENT_START_FMT &&
+        NBLogExport::EVENT_HASH == NBLog::EVENT_HASH &&
+        NBLogExport::EVENT_HISTOGRAM_ENTRY_TS == NBLog::EVENT_HISTOGRAM_ENTRY_TS &&
+        NBLogExport::EVENT_AUDIO_STATE == NBLog::EVENT_AUDIO_STATE &&
+        NBLogExport::EVENT_END_FMT == NBLog::EVENT_END_FMT,
+        "NBLogExport::Event must match NBLog::Event");
+static_assert(NBLogExport::kEntryOverhead == NBLog::Entry::kOverhead,
+        "NBLogExport::kEntryOverhead must match NBLog::Entry::kOverhead");
+
+static bool writeFully(int fd, const void *buffer, size_t size)
+{
+    const uint8_t *p = (const uint8_t *) buffer;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGW("NBLog export write failed: %s", strerror(errno));
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool exportRecord(int fd, NBLogExport::RecordType type,
+        const void *header, size_t headerSize, const void *payload, size_t payloadSize)
+{
+    NBLogExport::RecordHeader record;
+    record.mType = type;
+    record.mLength = headerSize + payloadSize;
+    return writeFully(fd, &record, sizeof(record)) &&
+            writeFully(fd, header, headerSize) &&
+            writeFully(fd, payload, payloadSize);
+}
+
+static bool exportFileHeader(int fd)
+{
+    NBLogExport::FileHeader header;
+    header.mMagic = NBLogExport::kMagic;
+    header.mVersion = NBLogExport::kVersion;
+    header.mReserved = 0;
+    header.mStartNs = get_monotonic_ns();
+    return writeFully(fd, &header, sizeof(header));
+}
+
+static bool exportAuthors(int fd, const std::vector<NBLog::NamedReader> &namedReaders,
+        size_t first)
+{
+    if (first >= namedReaders.size()) {
+        return true;
+    }
+    std::vector<uint8_t> payload;
+    for (size_t i = first; i < namedReaders.size(); ++i) {
+        const int32_t author = i;
+        const char *name = namedReaders[i].name();
+        const uint8_t length = strnlen(name, UINT8_MAX);
+        const uint8_t *authorBytes = (const uint8_t *) &author;
+        payload.insert(payload.end(), authorBytes, authorBytes + sizeof(author));
+        payload.push_back(length);
+        payload.insert(payload.end(), name, name + length);
+    }
+    return exportRecord(fd, NBLogExport::RECORD_AUTHORS, NULL, 0, payload.data(), payload.size());
+}
+
+bool NBLog::Reader::exportEntries(int fd, int author, Snapshot &snapshot)
+{
+    const size_t size = snapshot.end() - snapshot.begin();
+    if (size == 0 && snapshot.lost() == 0) {
+        return true;
+    }
+    NBLogExport::EntriesHeader header;
+    header.mAuthor = author;
+    header.mLost = snapshot.lost() + (snapshot.begin() - EntryIterator(snapshot.data()));
+    return exportRecord(fd, NBLogExport::RECORD_ENTRIES, &header, sizeof(header),
+            (const uint8_t *) snapshot.begin(), size);
+}
+
+void NBLog::Reader::exportBinary(int fd)
+{
+    std::unique_ptr<Snapshot> snapshot = getSnapshot();
+    if (exportFileHeader(fd)) {
+        exportEntries(fd, NBLogExport::kAuthorMerged, *snapshot);
+    }
+}
+
 // ---------------------------------------------------------------------------
 
 void NBLog::appendTimestamp(String8 *body, const void *data) {
@@ -1085,6 +1185,8 @@ NBLog::EntryIterator NBLog::Reader::handleFormat(const FormatEntry &fmtEntry,
 }
 
 NBLog::Merger::Merger(const void *shared, size_t size):
+      mExportFd(-1),
+      mExportedAuthors(0),
       mShared((Shared *) shared),
       mFifo(mShared != NULL ?
         new audio_utils_fifo(size, sizeof(uint8_t),
@@ -1096,6 +1198,37 @@ void NBLog::Merger::addReader(const NBLog::NamedReader &reader) {
     // FIXME This is called by binder thread in MediaLogService::registerWriter
     //       but the access to shared variable mNamedReaders is not yet protected by a lock.
     mNamedReaders.push_back(reader);
+    AutoMutex _l(mExportLock);
+    exportAuthors_l(mExportedAuthors);
+}
+
+void NBLog::Merger::setExportFd(int fd) {
+    AutoMutex _l(mExportLock);
+    mExportFd = fd;
+    mExportedAuthors = 0;
+    if (mExportFd >= 0) {
+        if (exportFileHeader(mExportFd)) {
+            exportAuthors_l(0);
+        } else {
+            mExportFd = -1;
+        }
+    }
+}
+
+bool NBLog::Merger::isExporting() const {
+    AutoMutex _l(mExportLock);
+    return mExportFd >= 0;
+}
+
+void NBLog::Merger::exportAuthors_l(size_t first) {
+    if (mExportFd < 0) {
+        return;
+    }
+    if (!exportAuthors(mExportFd, mNamedReaders, first)) {
+        mExportFd = -1;
+        return;
+    }
+    mExportedAuthors = mNamedReaders.size();
 }
 
 // items placed in priority queue during merge
@@ -1127,6 +1260,15 @@ void NBLog::Merger::merge() {
         snapshots[i] = mNamedReaders[i].reader()->getSnapshot();
         offsets[i] = snapshots[i]->begin();
     }
+    {
+        // export the raw entries of each reader before merging them
+        AutoMutex _l(mExportLock);
+        for (int i = 0; i < nLogs && mExportFd >= 0; ++i) {
+            if (!Reader::exportEntries(mExportFd, i, *snapshots[i])) {
+                mExportFd = -1;
+            }
+        }
+    }
     // initialize offsets
     // TODO custom heap implementation could allow to update top, improving performance
     // for bursty buffers
@@ -1164,6 +1306,14 @@ const std::vector<NBLog::NamedReader>& NBLog::Merger::getNamedReaders() const {
 NBLog::MergeReader::MergeReader(const void *shared, size_t size, Merger &merger)
     : Reader(shared, size), mNamedReaders(merger.getNamedReaders()) {}
 
+void NBLog::MergeReader::exportBinary(int fd) {
+    std::unique_ptr<Snapshot> snapshot = getSnapshot();
+    // FIXME Needs a lock, see handleAuthor()
+    if (exportFileHeader(fd) && exportAuthors(fd, mNamedReaders, 0)) {
+        exportEntries(fd, NBLogExport::kAuthorMerged, *snapshot);
+    }
+}
+
 void NBLog::MergeReader::handleAuthor(const NBLog::AbstractEntry &entry, String8 *body) {
     int author = entry.author();
     // FIXME Needs a lock
@@ -1190,9 +1340,12 @@ bool NBLog::MergeThread::threadLoop() {
         AutoMutex _l(mMutex);
         // If mTimeoutUs is negative, wait on the condition variable until it's positive.
         // If it's positive, wait kThreadSleepPeriodUs and then merge
-        nsecs_t waitTime = mTimeoutUs > 0 ? kThreadSleepPeriodUs * 1000 : LLONG_MAX;
+        // Keep merging while exporting, so that the writers' FIFOs do not overflow.
+        const bool exporting = mMerger.isExporting();
+        nsecs_t waitTime = mTimeoutUs > 0 || exporting ?
+                kThreadSleepPeriodUs * 1000 : LLONG_MAX;
         mCond.waitRelative(mMutex, waitTime);
-        doMerge = mTimeoutUs > 0;
+        doMerge = mTimeoutUs > 0 || exporting;
         mTimeoutUs -= kThreadSleepPeriodUs;
     }
     if (doMerge) {
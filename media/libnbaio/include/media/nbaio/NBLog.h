@@ -454,6 +454,12 @@ public:
     void     dump(int fd, size_t indent = 0);
     bool     isIMemory(const sp<IMemory>& iMemory) const;
 
+    // write the current content of the reader's buffer to fd in the binary format described
+    // in NBLogExport.h, consuming it as dump() does
+    virtual void exportBinary(int fd);
+    // write an entries record of the snapshot for the given author, returns false on error
+    static bool exportEntries(int fd, int author, Snapshot &snapshot);
+
 private:
 
     static const std::set<Event> startingTypes;
@@ -518,7 +524,19 @@ public:
     void merge();
     // FIXME This is returning a reference to a shared variable that needs a lock
     const std::vector<NamedReader>& getNamedReaders() const;
+
+    // Continuously export the raw entries of each reader to fd at each merge, in the binary
+    // format described in NBLogExport.h.  The caller keeps ownership of fd, -1 to stop.
+    void setExportFd(int fd);
+    bool isExporting() const;
 private:
+    // write an authors record for readers [first, mNamedReaders.size()), mExportLock held
+    void exportAuthors_l(size_t first);
+
+    mutable Mutex mExportLock;  // protects the following export fields
+    int mExportFd;              // -1 if not exporting
+    size_t mExportedAuthors;    // number of readers whose name has been exported
+
     // vector of the readers the merger is supposed to merge from.
     // every reader reads from a writer's buffer
     // FIXME Needs to be protected by a lock
@@ -533,6 +551,9 @@ private:
 class MergeReader : public Reader {
 public:
     MergeReader(const void *shared, size_t size, Merger &merger);
+
+    // exports the author names, followed by the merged entries
+    virtual void exportBinary(int fd) override;
 private:
     // FIXME Needs to be protected by a lock,
     //       because even though our use of it is read-only there may be asynchronous updates
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Binary export format of NBLog entries, for offline analysis on the host.
+// This header has no dependencies on the rest of NBLog so that host tools can include it.
+
+#ifndef ANDROID_MEDIA_NBLOG_EXPORT_H
+#define ANDROID_MEDIA_NBLOG_EXPORT_H
+
+#include <stdint.h>
+
+namespace android {
+namespace NBLogExport {
+
+// An export is a file header followed by a sequence of records, all little endian:
+//
+//  FileHeader
+//  RecordHeader, payload
+//  RecordHeader, payload
+//  ...
+//
+// RECORD_AUTHORS payload: a sequence of
+//      int32_t author index, uint8_t name length, name (not NUL-terminated)
+// RECORD_ENTRIES payload: EntriesHeader, followed by raw NBLog entries as stored in the FIFO:
+//      [type][length][data ...][length]
+//  The entries of a record come from one author, given in EntriesHeader, unless the author is
+//  kAuthorMerged, in which case each entry carries its author as in the merged log.
+//
+// A reader should skip records of unknown type, using RecordHeader::mLength.
+
+const uint32_t kMagic = 0x544c424e;     // "NBLT"
+const uint16_t kVersion = 1;
+
+struct FileHeader {
+    uint32_t mMagic;
+    uint16_t mVersion;
+    uint16_t mReserved;
+    int64_t  mStartNs;                  // CLOCK_MONOTONIC at start of export
+};
+
+enum RecordType : uint32_t {
+    RECORD_AUTHORS = 1,
+    RECORD_ENTRIES = 2,
+};
+
+struct RecordHeader {
+    uint32_t mType;                     // RecordType
+    uint32_t mLength;                   // payload length in bytes, excluding this header
+};
+
+const int32_t kAuthorMerged = -1;
+
+struct EntriesHeader {
+    int32_t  mAuthor;                   // author index, or kAuthorMerged
+    uint32_t mLost;                     // bytes lost by the FIFO reader before these entries
+};
+
+// Event types of the exported entries, equal to NBLog::Event (checked in NBLog.cpp)
+enum Event : uint8_t {
+    EVENT_STRING = 1,
+    EVENT_TIMESTAMP = 2,
+    EVENT_INTEGER = 3,
+    EVENT_FLOAT = 4,
+    EVENT_PID = 5,
+    EVENT_AUTHOR = 6,
+    EVENT_START_FMT = 7,
+    EVENT_HASH = 8,
+    EVENT_HISTOGRAM_ENTRY_TS = 9,
+    EVENT_AUDIO_STATE = 10,
+    EVENT_END_FMT = 11,
+};
+
+// Entry framing: type and length bytes before the data, length byte after the data
+const size_t kEntryOverhead = 3;
+
+}   // namespace NBLogExport
+}   // namespace android
+
+#endif  // ANDROID_MEDIA_NBLOG_EXPORT_H
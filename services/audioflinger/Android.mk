@@ -29,6 +29,7 @@ LOCAL_SRC_FILES:=               \
     SpdifStreamOut.cpp          \
     Effects.cpp                 \
     PatchPanel.cpp              \
+    PatchBridge.cpp             \
     StateQueue.cpp              \
     BufLog.cpp                  \
     TypedLogger.cpp
@@ -113,6 +113,9 @@ size_t AudioFlinger::mTeeSinkTrackFrames = kTeeSinkTrackFramesDefault;
 // we define a minimum time during which a global effect is considered enabled.
 static const nsecs_t kMinGlobalEffectEnabletimeNs = seconds(7200);
 
+// Number of tracks and effects listed by the CPU cost report in dump()
+static const size_t kCpuCostReportMaxEntries = 10;
+
 Mutex gLock;
 wp<AudioFlinger> gAudioFlinger;
 
@@ -510,6 +513,10 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
             mMmapThreads.valueAt(i)->dump(fd, args);
         }
 
+        if (mPatchPanel != 0) {
+            mPatchPanel->dump(fd);
+        }
+
         // dump orphan effect chains
         if (mOrphanEffectChains.size() != 0) {
             write(fd, "  Orphan Effect Chains\n", strlen("  Orphan Effect Chains\n"));
@@ -517,6 +524,21 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
                 mOrphanEffectChains.valueAt(i)->dump(fd, args);
             }
         }
+
+        // rank tracks and effects of all threads by CPU time
+        if (isCpuAccountingEnabled()) {
+            CpuCostReport report;
+            for (size_t i = 0; i < mPlaybackThreads.size(); i++) {
+                mPlaybackThreads.valueAt(i)->appendCpuCosts(report);
+            }
+            for (size_t i = 0; i < mRecordThreads.size(); i++) {
+                mRecordThreads.valueAt(i)->appendCpuCosts(report);
+            }
+            String8 result("\n");
+            report.appendDump(result, kCpuCostReportMaxEntries);
+            write(fd, result.string(), result.size());
+        }
+
         // dump all hardware devs
         for (size_t i = 0; i < mAudioHwDevs.size(); i++) {
             sp<DeviceHalInterface> dev = mAudioHwDevs.valueAt(i)->hwDevice();
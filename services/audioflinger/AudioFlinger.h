@@ -61,6 +61,7 @@
 #include <media/VolumeShaper.h>
 
 #include <audio_utils/SimpleLog.h>
+#include <cpustats/CentralTendencyStatistics.h>
 
 #include "FastCapture.h"
 #include "FastMixer.h"
@@ -69,6 +70,8 @@
 #include "AudioStreamOut.h"
 #include "SpdifStreamOut.h"
 #include "AudioHwDevice.h"
+#include "CpuCostStatistics.h"
+#include "PatchBridge.h"
 
 #include <powermanager/IPowerManager.h>
 
@@ -85,6 +88,8 @@ class DeviceHalInterface;
 class DevicesFactoryHalInterface;
 class EffectsFactoryHalInterface;
 class FastMixer;
+class MonoPipe;
+class MonoPipeReader;
 class PassthruBufferProvider;
 class RecordBufferConverter;
 class ServerProxy;
@@ -523,6 +528,7 @@ private:
     class EffectModule;
     class EffectHandle;
     class EffectChain;
+    class EffectChainWorkers;
 
     struct AudioStreamIn;
 
@@ -35,6 +35,10 @@
 // uncomment for debugging timing problems related to StateQueue::push()
 //#define STATE_QUEUE_DUMP
 
+// uncomment to let normal threads push state to fast threads without waiting, see
+// WaitFreeStateQueue in StateQueue.h
+//#define STATE_QUEUE_WAIT_FREE
+
 // uncomment to allow tee sink debugging to be enabled by property
 //#define TEE_SINK
 
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_CPU_COST_STATISTICS_H
+#define ANDROID_AUDIO_CPU_COST_STATISTICS_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include <cpustats/CentralTendencyStatistics.h>
+#include <cutils/properties.h>
+#include <utils/String8.h>
+
+namespace android {
+
+// CPU time accounting of the mixer and effects is enabled by setting the property
+// af.cpu_accounting to true.  The value is read once per process.
+static inline bool isCpuAccountingEnabled()
+{
+    static const bool enabled = property_get_bool("af.cpu_accounting", false /* default */);
+    return enabled;
+}
+
+// CPU time spent per cycle by one consumer (track or effect), as central tendency statistics
+// and a histogram with power of two buckets from 1 us.
+// CameraLatencyHistogram of libcameraservice is not reused: its bins are linear in whole
+// milliseconds, while mixer and effect costs range from a microsecond to a few milliseconds.
+// Not multithread safe: sampled by the owning thread, read racily by dump.
+class CpuCostStatistics {
+public:
+    static const size_t kBuckets = 16;  // last bucket holds everything >= 16 ms
+
+    CpuCostStatistics() : mTotalNs(0), mHistogram() { }
+
+    void sample(int64_t ns) {
+        if (ns < 0) {
+            return;
+        }
+        mStats.sample(ns);
+        mTotalNs += ns;
+        const uint64_t us = ns / 1000;
+        const size_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+        mHistogram[std::min(bucket, kBuckets - 1)]++;
+    }
+
+    void reset() {
+        mStats.reset();
+        mTotalNs = 0;
+        std::fill(mHistogram, mHistogram + kBuckets, 0);
+    }
+
+    unsigned n() const { return mStats.n(); }
+    int64_t totalNs() const { return mTotalNs; }
+    double meanNs() const { return mStats.mean(); }
+    double maxNs() const { return mStats.maximum(); }
+    double stddevNs() const { return mStats.stddev(); }
+
+    // Appends "mean/stddev/max in us" and the non-empty histogram buckets.
+    void appendDump(String8& result) const {
+        if (n() == 0) {
+            result.append("no samples");
+            return;
+        }
+        result.appendFormat("mean %.1f us, stddev %.1f us, max %.1f us, n %u |",
+                meanNs() * 1e-3, stddevNs() * 1e-3, maxNs() * 1e-3, n());
+        for (size_t i = 0; i < kBuckets; ++i) {
+            if (mHistogram[i] != 0) {
+                result.appendFormat(" <%uus:%u", 1u << i, mHistogram[i]);
+            }
+        }
+    }
+
+private:
+    CentralTendencyStatistics mStats;
+    int64_t mTotalNs;
+    uint32_t mHistogram[kBuckets];  // bucket i counts samples in [2^(i-1), 2^i) us
+};
+
+// Collects CPU costs across threads and prints the largest consumers by total time.
+class CpuCostReport {
+public:
+    void add(const String8& name, const CpuCostStatistics& stats) {
+        if (stats.n() != 0) {
+            mEntries.push_back(Entry{name, stats.totalNs(), stats.meanNs(), stats.maxNs()});
+        }
+    }
+
+    void appendDump(String8& result, size_t maxEntries) {
+        std::sort(mEntries.begin(), mEntries.end(),
+                [](const Entry& a, const Entry& b) { return a.totalNs > b.totalNs; });
+        result.appendFormat("Top CPU consumers (%zu of %zu):\n",
+                std::min(maxEntries, mEntries.size()), mEntries.size());
+        for (size_t i = 0; i < mEntries.size() && i < maxEntries; ++i) {
+            const Entry& e = mEntries[i];
+            result.appendFormat("  %10.3f ms total, mean %7.1f us, max %7.1f us  %s\n",
+                    e.totalNs * 1e-6, e.meanNs * 1e-3, e.maxNs * 1e-3, e.name.string());
+        }
+    }
+
+private:
+    struct Entry {
+        String8 name;
+        int64_t totalNs;
+        double meanNs;
+        double maxNs;
+    };
+    std::vector<Entry> mEntries;
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_CPU_COST_STATISTICS_H
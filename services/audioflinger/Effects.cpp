@@ -286,6 +286,7 @@ void AudioFlinger::EffectModule::process()
     }
 
     if (isProcessEnabled()) {
+        const nsecs_t startNs = isCpuAccountingEnabled() ? systemTime() : 0;
         // do 32 bit to 16 bit conversion for auxiliary effect input buffer
         if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
             ditherAndClamp(mConfig.inputCfg.buffer.s32,
@@ -323,6 +324,9 @@ void AudioFlinger::EffectModule::process()
             memset(mConfig.inputCfg.buffer.raw, 0,
                    mConfig.inputCfg.buffer.frameCount*sizeof(int32_t));
         }
+        if (startNs != 0) {
+            mCpuCost.sample(systemTime() - startNs);
+        }
     } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
                 mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
         // If an insert effect is idle and input buffer is different from output buffer,
@@ -1136,6 +1140,11 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args __unu
             result.append(buffer);
         }
     }
+    if (mCpuCost.n() != 0) {
+        result.append("\t\t- CPU time per process: ");
+        mCpuCost.appendDump(result);
+        result.append("\n");
+    }
 
     write(fd, result.string(), result.length());
 
@@ -1523,7 +1532,8 @@ void AudioFlinger::EffectHandle::dumpToBuffer(char* buffer, size_t size)
 
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         audio_session_t sessionId)
-    : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
+    : mThread(thread), mSessionId(sessionId), mAccumulateSampleCount(0), mAccumulatePending(false),
+      mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
       mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
       mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX)
 {
@@ -1610,6 +1620,12 @@ void AudioFlinger::EffectChain::clearInputBuffer_l(const sp<ThreadBase>& thread)
 
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::process_l()
+{
+    processEffects_l();
+    accumulateOutput_l();
+}
+
+void AudioFlinger::EffectChain::processEffects_l()
 {
     sp<ThreadBase> thread = mThread.promote();
     if (thread == 0) {
@@ -1647,13 +1663,20 @@ void AudioFlinger::EffectChain::process_l()
         // Only the input and output buffers of the chain can be external,
         // and 'update' / 'commit' do nothing for allocated buffers, thus
         // it's not needed to consider any other buffers here.
+        const nsecs_t startNs = systemTime();
         mInBuffer->update();
         if (mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw) {
             mOutBuffer->update();
         }
+        if (mAccumulateBuffer != 0) {
+            // the last effect accumulates into the private output buffer
+            memset(mOutBuffer->ptr(), 0, mAccumulateSampleCount * sizeof(int16_t));
+            mAccumulatePending = true;
+        }
         for (size_t i = 0; i < size; i++) {
             mEffects[i]->process();
         }
+        mProcessNs.sample(systemTime() - startNs);
         mInBuffer->commit();
         if (mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw) {
             mOutBuffer->commit();
@@ -1668,6 +1691,19 @@ void AudioFlinger::EffectChain::process_l()
     }
 }
 
+void AudioFlinger::EffectChain::accumulateOutput_l()
+{
+    if (!mAccumulatePending) {
+        return;
+    }
+    mAccumulatePending = false;
+    int16_t *dst = reinterpret_cast<int16_t *>(mAccumulateBuffer->ptr());
+    const int16_t *src = reinterpret_cast<const int16_t *>(mOutBuffer->ptr());
+    for (size_t i = 0; i < mAccumulateSampleCount; i++) {
+        dst[i] = clamp16((int32_t)dst[i] + (int32_t)src[i]);
+    }
+}
+
 // createEffect_l() must be called with ThreadBase::mLock held
 status_t AudioFlinger::EffectChain::createEffect_l(sp<EffectModule>& effect,
                                                    ThreadBase *thread,
@@ -1998,6 +2034,14 @@ void AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
         result.append(buffer);
         snprintf(buffer, SIZE, "\t%s   %s   %d\n", inBufferStr, outBufferStr, mActiveTrackCnt);
         result.append(buffer);
+        if (mProcessNs.n() > 0) {
+            snprintf(buffer, SIZE, "\tProcess time us: mean=%.1f min=%.1f max=%.1f stddev=%.1f"
+                    " (%u cycles)%s\n",
+                    mProcessNs.mean() * 1e-3, mProcessNs.minimum() * 1e-3,
+                    mProcessNs.maximum() * 1e-3, mProcessNs.stddev() * 1e-3, mProcessNs.n(),
+                    mAccumulateBuffer != 0 ? ", private output buffer" : "");
+            result.append(buffer);
+        }
         write(fd, result.string(), result.size());
 
         for (size_t i = 0; i < numEffects; ++i) {
@@ -2013,6 +2057,19 @@ void AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
     }
 }
 
+void AudioFlinger::EffectChain::appendCpuCosts(CpuCostReport& report, const char *prefix)
+{
+    if (!AudioFlinger::dumpTryLock(mLock)) {
+        return;
+    }
+    for (size_t i = 0; i < mEffects.size(); ++i) {
+        const sp<EffectModule>& effect = mEffects[i];
+        report.add(String8::format("%s session %d effect %d (%s)", prefix, mSessionId,
+                effect->id(), effect->desc().name), effect->cpuCost());
+    }
+    mLock.unlock();
+}
+
 // must be called with ThreadBase::mLock held
 void AudioFlinger::EffectChain::setEffectSuspended_l(
         const effect_uuid_t *type, bool suspend)
@@ -2286,4 +2343,108 @@ bool AudioFlinger::EffectChain::isCompatibleWithThread_l(const sp<ThreadBase>& t
     return true;
 }
 
+// ----------------------------------------------------------------------------
+//      EffectChainWorkers implementation
+// ----------------------------------------------------------------------------
+
+#undef LOG_TAG
+#define LOG_TAG "AudioFlinger::EffectChainWorkers"
+
+AudioFlinger::EffectChainWorkers::EffectChainWorkers(uint32_t numWorkers)
+    : mChains(NULL), mCount(0), mNext(0), mPending(0), mExit(false),
+      mCycles(0), mDeadlineMisses(0)
+{
+    if (numWorkers > kMaxWorkers) {
+        numWorkers = kMaxWorkers;
+    }
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        sp<Worker> worker = new Worker(*this);
+        status_t status = worker->run(String8::format("EffectWorker%u", i).string(),
+                ANDROID_PRIORITY_URGENT_AUDIO);
+        if (status != NO_ERROR) {
+            ALOGE("EffectChainWorkers() cannot start worker %u: %d", i, status);
+            break;
+        }
+        mWorkers.add(worker);
+    }
+}
+
+AudioFlinger::EffectChainWorkers::~EffectChainWorkers()
+{
+    {
+        Mutex::Autolock _l(mLock);
+        mExit = true;
+        mWorkCond.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+void AudioFlinger::EffectChainWorkers::processChains_l()
+{
+    while (mNext < mCount) {
+        sp<EffectChain> chain = (*mChains)[mNext++];
+        mLock.unlock();
+        chain->processEffects_l();
+        chain.clear();
+        mLock.lock();
+        if (--mPending == 0) {
+            mDoneCond.signal();
+        }
+    }
+}
+
+void AudioFlinger::EffectChainWorkers::process(
+        const Vector< sp<EffectChain> >& chains, size_t count, nsecs_t deadlineNs)
+{
+    Mutex::Autolock _l(mLock);
+    mChains = &chains;
+    mCount = count;
+    mNext = 0;
+    mPending = count;
+    if (!mWorkers.isEmpty()) {
+        mWorkCond.broadcast();
+    }
+    processChains_l();
+    const nsecs_t joinStartNs = systemTime();
+    while (mPending > 0) {
+        mDoneCond.wait(mLock);
+    }
+    const nsecs_t endNs = systemTime();
+    mJoinNs.sample(endNs - joinStartNs);
+    mCycles++;
+    if (endNs > deadlineNs) {
+        mDeadlineMisses++;
+    }
+    mChains = NULL;
+    mCount = 0;
+    mNext = 0;
+}
+
+void AudioFlinger::EffectChainWorkers::dump(int fd) const
+{
+    Mutex::Autolock _l(mLock);
+    dprintf(fd, "  Effect chain workers: %zu, cycles: %u, deadline misses: %u\n",
+            mWorkers.size(), mCycles, mDeadlineMisses);
+    if (mJoinNs.n() > 0) {
+        dprintf(fd, "  Effect chain join wait us: mean=%.1f min=%.1f max=%.1f stddev=%.1f\n",
+                mJoinNs.mean() * 1e-3, mJoinNs.minimum() * 1e-3, mJoinNs.maximum() * 1e-3,
+                mJoinNs.stddev() * 1e-3);
+    }
+}
+
+bool AudioFlinger::EffectChainWorkers::Worker::threadLoop()
+{
+    Mutex::Autolock _l(mWorkers.mLock);
+    while (!mWorkers.mExit) {
+        if (mWorkers.mNext < mWorkers.mCount) {
+            mWorkers.processChains_l();
+        } else {
+            mWorkers.mWorkCond.wait(mWorkers.mLock);
+        }
+    }
+    return false;
+}
+
 } // namespace android
@@ -135,6 +135,10 @@ public:
 
     void             dump(int fd, const Vector<String16>& args);
 
+    // CPU time per process() call, sampled when CPU accounting is enabled.
+    // Read without lock by dump.
+    const CpuCostStatistics& cpuCost() const { return mCpuCost; }
+
 private:
     friend class AudioFlinger;      // for mHandles
     bool                mPinned;
@@ -168,6 +172,7 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     bool     mSuspended;            // effect is suspended: temporarily disabled by framework
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
     wp<AudioFlinger>    mAudioFlinger;
+    CpuCostStatistics   mCpuCost;   // see cpuCost()
 };
 
 // The EffectHandle class implements the IEffect interface. It provides resources
@@ -274,6 +279,10 @@ public:
     static const int        kProcessTailDurationMs = 1000;
 
     void process_l();
+    // process_l() is processEffects_l() followed by accumulateOutput_l().  Only
+    // processEffects_l() may run concurrently for different chains, see EffectChainWorkers.
+    void processEffects_l();
+    void accumulateOutput_l();
 
     void lock() {
         mLock.lock();
@@ -317,6 +326,13 @@ public:
     int16_t *outBuffer() const {
         return mOutBuffer != 0 ? reinterpret_cast<int16_t*>(mOutBuffer->ptr()) : NULL;
     }
+    // When set, the output buffer is private to the chain and its content is added to
+    // this buffer by accumulateOutput_l() instead of being accumulated by the last effect.
+    void setAccumulateBuffer(const sp<EffectBufferHalInterface>& buffer, size_t sampleCount) {
+        mAccumulateBuffer = buffer;
+        mAccumulateSampleCount = sampleCount;
+        mAccumulatePending = false;
+    }
 
     void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
     void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
@@ -365,6 +381,9 @@ public:
 
     void dump(int fd, const Vector<String16>& args);
 
+    // Adds the CPU cost of each effect of the chain to report, names prefixed by prefix.
+    void appendCpuCosts(CpuCostReport& report, const char *prefix);
+
 private:
     friend class AudioFlinger;  // for mThread, mEffects
     DISALLOW_COPY_AND_ASSIGN(EffectChain);
@@ -401,6 +420,10 @@ private:
              audio_session_t mSessionId; // audio session ID
              sp<EffectBufferHalInterface> mInBuffer;  // chain input buffer
              sp<EffectBufferHalInterface> mOutBuffer; // chain output buffer
+             sp<EffectBufferHalInterface> mAccumulateBuffer; // see setAccumulateBuffer()
+             size_t mAccumulateSampleCount; // samples to accumulate into mAccumulateBuffer
+             bool mAccumulatePending;      // mOutBuffer was processed but not accumulated yet
+             CentralTendencyStatistics mProcessNs; // time spent in processEffects_l()
 
     // 'volatile' here means these are accessed with atomic operations instead of mutex
     volatile int32_t mActiveTrackCnt;    // number of active tracks connected
@@ -420,3 +443,53 @@ private:
              // Updated by setEffectSuspended_l() and setEffectSuspendedAll_l() only.
              KeyedVector< int, sp<SuspendedEffectDesc> > mSuspendedEffects;
 };
+
+// EffectChainWorkers processes the session effect chains of a PlaybackThread on a small
+// bounded pool of threads.  Session chains are independent of each other as long as each
+// one has a private output buffer (see EffectChain::setAccumulateBuffer()).
+// The calling thread also processes chains: it only waits for the chains already started
+// by a worker once no chain is left to start, so the join never waits for queued work.
+class EffectChainWorkers {
+public:
+    explicit EffectChainWorkers(uint32_t numWorkers);
+    ~EffectChainWorkers();
+
+    // Calls processEffects_l() on chains[0] to chains[count - 1] and returns when done.
+    // Must be called with all chains locked.  Cycles that complete after deadlineNs
+    // (systemTime() base) are counted as deadline misses.
+    void process(const Vector< sp<EffectChain> >& chains, size_t count, nsecs_t deadlineNs);
+
+    void dump(int fd) const;
+
+    // maximum number of worker threads
+    static const uint32_t kMaxWorkers = 4;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(EffectChainWorkers);
+
+    class Worker : public Thread {
+    public:
+        explicit Worker(EffectChainWorkers& workers) : Thread(false /*canCallJava*/),
+                mWorkers(workers) { }
+    private:
+        virtual bool threadLoop();
+        EffectChainWorkers& mWorkers;
+    };
+
+    // processes the chains not yet started, called with mLock held
+    void processChains_l();
+
+    mutable Mutex mLock;
+    Condition mWorkCond;                    // signaled when chains are available
+    Condition mDoneCond;                    // signaled when the last chain completes
+    const Vector< sp<EffectChain> > *mChains;   // chains of the current cycle
+    size_t mCount;                          // number of chains of the current cycle
+    size_t mNext;                           // index of the next chain to start
+    size_t mPending;                        // chains not yet completed
+    bool mExit;
+    Vector< sp<Worker> > mWorkers;
+
+    uint32_t mCycles;                       // number of process() calls
+    uint32_t mDeadlineMisses;               // number of process() calls ending after deadline
+    CentralTendencyStatistics mJoinNs;      // time waiting for workers in process()
+};
@@ -35,7 +35,7 @@ FastCapture::FastCapture() : FastThread("cycleC_ms", "loadC_us"),
     mInputSource(NULL), mInputSourceGen(0), mPipeSink(NULL), mPipeSinkGen(0),
     mReadBuffer(NULL), mReadBufferState(-1), mFormat(Format_Invalid), mSampleRate(0),
     // mDummyDumpState
-    mTotalNativeFramesRead(0)
+    mTotalNativeFramesRead(0), mClientOverrun()
 {
     mPrevious = &sInitial;
     mCurrent = &sInitial;
@@ -120,6 +120,13 @@ void FastCapture::onStateChange()
         eitherChanged = true;
     }
 
+    // a new client in a slot starts without overrun
+    for (unsigned i = 0; i < FastCaptureState::sMaxFastClients; i++) {
+        if (current->mCblks[i] != previous->mCblks[i]) {
+            mClientOverrun[i] = false;
+        }
+    }
+
     // input source and pipe sink must be compatible
     if (eitherChanged && mInputSource != NULL && mPipeSink != NULL) {
         ALOG_ASSERT(Format_isEqual(mFormat, mPipeSink->format()));
@@ -193,12 +200,23 @@ void FastCapture::onWork()
         }
         if (mReadBufferState > 0) {
             ssize_t framesWritten = mPipeSink->write(mReadBuffer, mReadBufferState);
-            // FIXME This supports at most one fast capture client.
-            //       To handle multiple clients this could be converted to an array,
-            //       or with a lot more work the control block could be shared by all clients.
-            audio_track_cblk_t* cblk = current->mCblk;
-            if (cblk != NULL && framesWritten > 0) {
+            // Each fast client reads the pipe buffer through its own control block.
+            // The pipe never blocks, so a client that falls more than a buffer behind is
+            // overrun; it syncs up to the rear by itself, see ClientProxy::obtainBuffer().
+            for (unsigned i = 0; framesWritten > 0 && i < FastCaptureState::sMaxFastClients;
+                    i++) {
+                audio_track_cblk_t* cblk = current->mCblks[i];
+                if (cblk == NULL) {
+                    continue;
+                }
                 int32_t rear = cblk->u.mStreaming.mRear;
+                int32_t front = android_atomic_acquire_load(&cblk->u.mStreaming.mFront);
+                bool overrun = (int32_t) (rear - front) + framesWritten >
+                        (ssize_t) current->mClientFrameCount;
+                if (overrun && !mClientOverrun[i]) {
+                    dumpState->mClientOverruns[i]++;
+                }
+                mClientOverrun[i] = overrun;
                 android_atomic_release_store(framesWritten + rear, &cblk->u.mStreaming.mRear);
                 cblk->mServer += framesWritten;
                 int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
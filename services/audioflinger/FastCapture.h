@@ -24,7 +24,11 @@
 
 namespace android {
 
+#ifdef STATE_QUEUE_WAIT_FREE
+typedef WaitFreeStateQueue<FastCaptureState> FastCaptureStateQueue;
+#else
 typedef StateQueue<FastCaptureState> FastCaptureStateQueue;
+#endif
 
 class FastCapture : public FastThread {
 
@@ -61,6 +65,8 @@ private:
     unsigned            mSampleRate;
     FastCaptureDumpState mDummyFastCaptureDumpState;
     uint32_t            mTotalNativeFramesRead; // copied to dumpState->mFramesRead
+    bool                mClientOverrun[FastCaptureState::sMaxFastClients];  // client was behind
+                                                                            // at latest write
 
 };  // class FastCapture
 
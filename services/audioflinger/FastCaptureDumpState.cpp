@@ -25,7 +25,8 @@
 namespace android {
 
 FastCaptureDumpState::FastCaptureDumpState() : FastThreadDumpState(),
-    mReadSequence(0), mFramesRead(0), mReadErrors(0), mSampleRate(0), mFrameCount(0)
+    mReadSequence(0), mFramesRead(0), mReadErrors(0), mSampleRate(0), mFrameCount(0),
+    mClientOverruns()
 {
 }
 
@@ -48,6 +49,11 @@ void FastCaptureDumpState::dump(int fd) const
                 FastCaptureState::commandToString(mCommand), mReadSequence, mFramesRead,
                 mReadErrors, mSampleRate, mFrameCount, measuredWarmupMs, mWarmupCycles,
                 periodSec * 1e3);
+    dprintf(fd, "              clientOverruns=");
+    for (unsigned i = 0; i < FastCaptureState::sMaxFastClients; i++) {
+        dprintf(fd, "%s%u", i > 0 ? "," : "", mClientOverruns[i]);
+    }
+    dprintf(fd, "\n");
 }
 
 }   // android
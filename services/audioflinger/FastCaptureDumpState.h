@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include "Configuration.h"
 #include "FastThreadDumpState.h"
+#include "FastCaptureState.h"
 
 namespace android {
 
@@ -35,6 +36,9 @@ struct FastCaptureDumpState : FastThreadDumpState {
     uint32_t mReadErrors;       // total number of read() errors
     uint32_t mSampleRate;
     size_t   mFrameCount;
+    uint32_t mClientOverruns[FastCaptureState::sMaxFastClients];    // times each fast client
+                                // fell more than a buffer behind; a client overrun is one
+                                // or more consecutive writes while it stays behind
 };
 
 }   // android
@@ -35,7 +35,12 @@ struct FastCaptureState : FastThreadState {
     NBAIO_Sink*     mPipeSink;          // after reading from input source, write to this pipe sink
     int             mPipeSinkGen;       // increment when mPipeSink is assigned
     size_t          mFrameCount;        // number of frames per fast capture buffer
-    audio_track_cblk_t* mCblk;          // control block for the single fast client, or NULL
+
+    static const unsigned sMaxFastClients = 4;
+    // Fast clients all read the pipe buffer directly, each at its own front index in its
+    // control block.  A slot is NULL if unused.
+    audio_track_cblk_t* mCblks[sMaxFastClients];
+    size_t          mClientFrameCount;  // frame count of each fast client buffer, the pipe depth
 
     // Extends FastThreadState::Command
     static const Command
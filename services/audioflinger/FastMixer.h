@@ -27,7 +27,11 @@ namespace android {
 
 class AudioMixer;
 
+#ifdef STATE_QUEUE_WAIT_FREE
+typedef WaitFreeStateQueue<FastMixerState> FastMixerStateQueue;
+#else
 typedef StateQueue<FastMixerState> FastMixerStateQueue;
+#endif
 
 class FastMixer : public FastThread {
 
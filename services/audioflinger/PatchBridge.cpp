@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PatchBridge"
+//#define LOG_NDEBUG 0
+
+#include <utils/Log.h>
+#include "PatchBridge.h"
+
+namespace android {
+
+const int PatchBridge::kMaxCorrectionPpm;
+
+PatchBridge::PatchBridge(uint32_t sampleRate, size_t recordFrameCount, size_t ringFrameCount)
+    : mSampleRate(sampleRate), mRecordFrameCount(recordFrameCount),
+      mTargetFrames(ringFrameCount / 2), mLastWriteNs(0), mOverruns(0), mFramesDropped(0),
+      mWindowStartNs(0), mWindowSum(0), mWindowSmoothedSum(0),
+      mWindowCount(0), mWindowMin(0), mWindowMax(0),
+      mIntegralPpm(0), mCorrectionPpm(0), mRateRemainder(0), mRate(sampleRate),
+      mLastMin(0), mLastMax(0), mLastMean(0), mUnderruns(0)
+{
+}
+
+uint32_t PatchBridge::update(size_t framesAvailable, int64_t nowNs)
+{
+    if (mWindowCount == 0) {
+        if (mWindowStartNs == 0) {
+            mWindowStartNs = nowNs;
+        }
+        mWindowMin = framesAvailable;
+        mWindowMax = framesAvailable;
+    } else if (framesAvailable < mWindowMin) {
+        mWindowMin = framesAvailable;
+    } else if (framesAvailable > mWindowMax) {
+        mWindowMax = framesAvailable;
+    }
+    mWindowSum += framesAvailable;
+    mWindowCount++;
+
+    // The fill level seen by the playback thread depends on when the last burst of the record
+    // thread arrived.  The phase between the two threads moves with the drift, so the fill
+    // level would change by a whole record burst each time the phase wraps around.  Instead,
+    // count the last burst as if it had been written continuously over the record period.
+    double smoothed = framesAvailable;
+    const int64_t lastWriteNs = mLastWriteNs.load(std::memory_order_relaxed);
+    if (lastWriteNs != 0) {
+        double earned = (nowNs - lastWriteNs) * 1e-9 * mSampleRate;
+        if (earned < 0) {
+            earned = 0;
+        } else if (earned > mRecordFrameCount) {
+            earned = mRecordFrameCount;
+        }
+        smoothed += earned - mRecordFrameCount;
+    }
+    mWindowSmoothedSum += smoothed;
+
+    const int64_t windowNs = nowNs - mWindowStartNs;
+    if (windowNs < kWindowNs) {
+        return mRate;
+    }
+
+    // Without the bursts, the mean fill level over a window only moves with the drift between
+    // the two clocks.  A PI controller converts its error into a correction of the rate at
+    // which the ring is read.  The target accounts for the last burst counted as partial.
+    const double mean = mWindowSum / mWindowCount;
+    const double error = mWindowSmoothedSum / mWindowCount -
+            ((double) mTargetFrames - mRecordFrameCount / 2.);
+    const double seconds = windowNs * 1e-9;
+    const double proportionalPpm = error / kProportionalSeconds / mSampleRate * 1e6;
+    mIntegralPpm += proportionalPpm * seconds / kIntegralSeconds;
+    if (mIntegralPpm > kMaxCorrectionPpm) {
+        mIntegralPpm = kMaxCorrectionPpm;
+    } else if (mIntegralPpm < -kMaxCorrectionPpm) {
+        mIntegralPpm = -kMaxCorrectionPpm;
+    }
+    mCorrectionPpm = proportionalPpm + mIntegralPpm;
+    if (mCorrectionPpm > kMaxCorrectionPpm) {
+        mCorrectionPpm = kMaxCorrectionPpm;
+    } else if (mCorrectionPpm < -kMaxCorrectionPpm) {
+        mCorrectionPpm = -kMaxCorrectionPpm;
+    }
+
+    // The sample rate is an integer, about 20 ppm at 48 kHz, so carry the rounding error over
+    // to the next window to get the exact correction on average.
+    const double rate = mSampleRate * (1. + mCorrectionPpm * 1e-6) + mRateRemainder;
+    mRate = (uint32_t) (rate + 0.5);
+    mRateRemainder = rate - mRate;
+    ALOGV("mean %.1f target %zu correction %.1f ppm rate %u",
+            mean, mTargetFrames, mCorrectionPpm, mRate);
+
+    mLastMin = mWindowMin;
+    mLastMax = mWindowMax;
+    mLastMean = mean;
+    mWindowStartNs = nowNs;
+    mWindowSum = 0;
+    mWindowSmoothedSum = 0;
+    mWindowCount = 0;
+    return mRate;
+}
+
+PatchBridge::Stats PatchBridge::stats() const
+{
+    Stats stats;
+    stats.mUnderruns = mUnderruns;
+    stats.mOverruns = mOverruns.load(std::memory_order_relaxed);
+    stats.mFramesDropped = mFramesDropped.load(std::memory_order_relaxed);
+    stats.mMinFrames = mLastMin;
+    stats.mMaxFrames = mLastMax;
+    stats.mMeanFrames = mLastMean;
+    stats.mCorrectionPpm = mCorrectionPpm;
+    return stats;
+}
+
+}   // namespace android
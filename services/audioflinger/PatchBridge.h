@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_PATCH_BRIDGE_H
+#define ANDROID_AUDIO_PATCH_BRIDGE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+
+#include <utils/RefBase.h>
+
+namespace android {
+
+// A software patch in bridge mode connects its record thread and playback thread through a
+// ring sized to their bursts instead of a multiple of their least common period.
+// The two devices usually run from different clocks, so the playback side reads the ring at a
+// sample rate adjusted to keep the ring around half full; see PatchBridge::update().
+//
+// The record thread is the only writer of the ring and the playback thread the only reader,
+// and neither blocks on the other: a full ring is an overrun, an empty ring is an underrun.
+// The bridge is shared by the PatchRecord and the PatchTrack of the patch.  Only onWrite() and
+// onOverrun() are called by the record thread, the rest by the playback thread and by dumpsys
+// for stats().
+
+class PatchBridge : public RefBase {
+public:
+    // Size of the ring: one burst of each thread, and as much again for scheduling jitter.
+    static size_t ringFrameCount(size_t recordFrameCount, size_t playbackFrameCount) {
+        return 2 * (recordFrameCount + playbackFrameCount);
+    }
+
+    // All counts in frames at the sample rate of the ring
+    PatchBridge(uint32_t sampleRate, size_t recordFrameCount, size_t ringFrameCount);
+
+    // Fill level targeted by the drift compensation, and required before starting playback.
+    size_t      targetFrames() const { return mTargetFrames; }
+
+    // Called by the record thread after each write into the ring.
+    void        onWrite(int64_t nowNs) { mLastWriteNs.store(nowNs, std::memory_order_relaxed); }
+
+    // Called by the playback thread each time it reads the ring, with the number of frames
+    // available before the read.  Returns the sample rate at which to read the ring.
+    uint32_t    update(size_t framesAvailable, int64_t nowNs);
+
+    // Called by the playback thread when the ring was empty while playing.
+    void        onUnderrun() { mUnderruns++; }
+
+    // Called by the record thread when the ring was full, with the number of captured frames
+    // dropped instead of being kept for later, which would only add to the latency.
+    void        onOverrun(size_t framesDropped) {
+        mOverruns.fetch_add(1, std::memory_order_relaxed);
+        mFramesDropped.fetch_add(framesDropped, std::memory_order_relaxed);
+    }
+
+    struct Stats {
+        uint32_t    mUnderruns;
+        uint32_t    mOverruns;
+        uint64_t    mFramesDropped;     // by the overruns
+        size_t      mMinFrames;         // min, mean and max fill level over the last window
+        size_t      mMaxFrames;
+        double      mMeanFrames;
+        double      mCorrectionPpm;     // current drift compensation
+    };
+    Stats       stats() const;
+
+    // Drift compensation is limited to 0.1%, an order of magnitude above crystal tolerances.
+    static const int kMaxCorrectionPpm = 1000;
+
+private:
+    // Fill level is averaged over windows of this duration, and compensation updated after each
+    static const int64_t kWindowNs = 100000000;
+    // Proportional term: corrects an error of the mean fill level in this many seconds
+    static const int kProportionalSeconds = 4;
+    // Integral term: integration time in seconds, 3 times the above for a damping of about 0.9
+    static const int kIntegralSeconds = 12;
+
+    const uint32_t  mSampleRate;
+    const size_t    mRecordFrameCount;
+    const size_t    mTargetFrames;
+
+    std::atomic_int_fast64_t mLastWriteNs;  // time of the last write, 0 before the first one
+    std::atomic_uint_fast32_t mOverruns;
+    std::atomic_uint_fast64_t mFramesDropped;
+
+    int64_t     mWindowStartNs;     // 0 before the first update
+    double      mWindowSum;         // of the fill levels seen by the playback thread
+    double      mWindowSmoothedSum; // of the same, without the bursts of the record thread
+    uint32_t    mWindowCount;
+    size_t      mWindowMin;
+    size_t      mWindowMax;
+
+    double      mIntegralPpm;
+    double      mCorrectionPpm;
+    double      mRateRemainder;     // fraction of Hz carried over between windows (dithering)
+    uint32_t    mRate;
+
+    // statistics of the last complete window, for dumpsys
+    size_t      mLastMin;
+    size_t      mLastMax;
+    double      mLastMean;
+    uint32_t    mUnderruns;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_PATCH_BRIDGE_H
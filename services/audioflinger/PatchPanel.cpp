@@ -44,6 +44,10 @@
 
 namespace android {
 
+// Priority of the record and playback threads of a software patch in bridge mode,
+// the same as for the callback threads of fast tracks
+static const int kPriorityPatchBridge = 2;
+
 /* List connected audio ports and their attributes */
 status_t AudioFlinger::listAudioPorts(unsigned int *num_ports,
                                 struct audio_port *ports)
@@ -448,18 +452,6 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
         patch->mPlaybackPatchHandle = AUDIO_PATCH_HANDLE_NONE;
     }
 
-    // use a pseudo LCM between input and output framecount
-    size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
-    int playbackShift = __builtin_ctz(playbackFrameCount);
-    size_t recordFramecount = patch->mRecordThread->frameCount();
-    int shift = __builtin_ctz(recordFramecount);
-    if (playbackShift < shift) {
-        shift = playbackShift;
-    }
-    size_t frameCount = (playbackFrameCount * recordFramecount) >> shift;
-    ALOGV("createPatchConnections() playframeCount %zu recordFramecount %zu frameCount %zu",
-          playbackFrameCount, recordFramecount, frameCount);
-
     // create a special record track to capture from record thread
     uint32_t channelCount = patch->mPlaybackThread->channelCount();
     audio_channel_mask_t inChannelMask = audio_channel_in_mask_from_count(channelCount);
@@ -467,6 +459,29 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     uint32_t sampleRate = patch->mPlaybackThread->sampleRate();
     audio_format_t format = patch->mPlaybackThread->format();
 
+    // In bridge mode the buffer between the threads is sized to their bursts, and the
+    // playback side compensates the drift between the two devices, see PatchBridge.h.
+    // Otherwise use a pseudo LCM between input and output framecount.
+    const bool bridge = property_get_bool("af.patch.bridge", false /* default_value */);
+    size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
+    size_t recordFramecount = patch->mRecordThread->frameCount();
+    // the record track buffer is at the playback sample rate
+    const size_t recordBurst = ((uint64_t)recordFramecount * sampleRate +
+            patch->mRecordThread->sampleRate() - 1) / patch->mRecordThread->sampleRate();
+    size_t frameCount;
+    if (bridge) {
+        frameCount = PatchBridge::ringFrameCount(recordBurst, playbackFrameCount);
+    } else {
+        int playbackShift = __builtin_ctz(playbackFrameCount);
+        int shift = __builtin_ctz(recordFramecount);
+        if (playbackShift < shift) {
+            shift = playbackShift;
+        }
+        frameCount = (playbackFrameCount * recordFramecount) >> shift;
+    }
+    ALOGV("createPatchConnections() playframeCount %zu recordFramecount %zu frameCount %zu%s",
+          playbackFrameCount, recordFramecount, frameCount, bridge ? " bridge" : "");
+
     patch->mPatchRecord = new RecordThread::PatchRecord(
                                              patch->mRecordThread.get(),
                                              sampleRate,
@@ -510,6 +525,21 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     patch->mPatchRecord->setPeerProxy(patch->mPatchTrack.get());
     patch->mPatchTrack->setPeerProxy(patch->mPatchRecord.get());
 
+    if (bridge) {
+        sp<PatchBridge> patchBridge = new PatchBridge(sampleRate, recordBurst, frameCount);
+        patch->mPatchRecord->enableBridge(patchBridge);
+        patch->mPatchTrack->enableBridge(patchBridge);
+        // with a ring of a few bursts, both threads must run as soon as their device is ready;
+        // do not change the priority of an existing playback thread used by the patch
+        const pid_t pid = getpid();
+        patch->mRecordThread->sendPrioConfigEvent(pid, patch->mRecordThread->getTid(),
+                kPriorityPatchBridge, false /*forApp*/);
+        if (audioPatch->num_sources != 2) {
+            patch->mPlaybackThread->sendPrioConfigEvent(pid, patch->mPlaybackThread->getTid(),
+                    kPriorityPatchBridge, false /*forApp*/);
+        }
+    }
+
     // start capture and playback
     patch->mPatchRecord->start(AudioSystem::SYNC_EVENT_NONE, AUDIO_SESSION_NONE);
     patch->mPatchTrack->start();
@@ -571,6 +601,44 @@ void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
 
 }
 
+void AudioFlinger::PatchPanel::dump(int fd) const
+{
+    String8 result;
+    for (size_t i = 0; i < mPatches.size(); i++) {
+        const Patch *patch = mPatches[i];
+        if (patch->mPatchTrack == 0 || patch->mPatchRecord == 0) {
+            continue;
+        }
+        if (result.isEmpty()) {
+            result.append("\nSoftware patches:\n");
+            result.append("  Handle Mode   Ring(ms) MinFill(ms) MeanFill(ms) MaxFill(ms) Drift(ppm)"
+                    " Underruns Overruns Dropped(ms) Latency(ms)\n");
+        }
+        const double msPerFrame = 1000. / patch->mPlaybackThread->sampleRate();
+        const size_t ringFrames = patch->mPatchTrack->frameCount();
+        PatchBridge::Stats stats;
+        if (patch->mPatchTrack->getBridgeStats(&stats)) {
+            // from capture to the playback device: one record burst, the mean fill level of
+            // the ring, and the latency of the playback thread including its HAL buffer.
+            // The overruns drop frames, so the fill level never exceeds the ring.
+            const double latencyMs = 1000. * patch->mRecordThread->frameCount() /
+                    patch->mRecordThread->sampleRate() + stats.mMeanFrames * msPerFrame +
+                    patch->mPlaybackThread->latency();
+            result.appendFormat("  %6d bridge %8.1f %11.1f %12.1f %11.1f %+10.1f %9u %8u %11.1f"
+                    " %11.1f\n",
+                    patch->mHandle, ringFrames * msPerFrame, stats.mMinFrames * msPerFrame,
+                    stats.mMeanFrames * msPerFrame, stats.mMaxFrames * msPerFrame,
+                    stats.mCorrectionPpm, stats.mUnderruns, stats.mOverruns,
+                    stats.mFramesDropped * msPerFrame, latencyMs);
+        } else {
+            result.appendFormat("  %6d legacy %8.1f %11s %12s %11s %10s %9s %8u %11s %11s\n",
+                    patch->mHandle, ringFrames * msPerFrame, "-", "-", "-", "-", "-",
+                    patch->mPatchRecord->overruns(), "-", "-");
+        }
+    }
+    write(fd, result.string(), result.size());
+}
+
 /* Disconnect a patch */
 status_t AudioFlinger::PatchPanel::releaseAudioPatch(audio_patch_handle_t handle)
 {
@@ -48,6 +48,9 @@ public:
     /* Set audio port configuration */
     status_t setAudioPortConfig(const struct audio_port_config *config);
 
+    /* Dump the software patches, must be called with AudioFlinger::mLock held */
+    void dump(int fd) const;
+
     status_t createPatchConnections(Patch *patch,
                                     const struct audio_patch *audioPatch);
     void clearPatchConnections(Patch *patch);
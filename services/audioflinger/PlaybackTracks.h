@@ -165,6 +165,11 @@ protected:
 
     sp<VolumeHandler>  mVolumeHandler; // handles multiple VolumeShaper configs and operations
 
+    // CPU time of this track in the normal mixer, see AudioMixer::getProcessNs().
+    // Only updated by the thread loop when CPU accounting is enabled.
+    int64_t            mMixerProcessNs;    // mixer total at the previous cycle
+    CpuCostStatistics  mCpuCost;           // mixer CPU time per cycle
+
 private:
     // The following fields are only for fast tracks, and should be in a subclass
     int                 mFastIndex; // index within FastMixerState::mFastTracks[];
@@ -200,7 +205,8 @@ public:
                                 audio_format_t format,
                                 audio_channel_mask_t channelMask,
                                 size_t frameCount,
-                                uid_t uid);
+                                uid_t uid,
+                                bool usePipe = false);
     virtual             ~OutputTrack();
 
     virtual status_t    start(AudioSystem::sync_event_t event =
@@ -212,8 +218,17 @@ public:
             bool        isActive() const { return mActive; }
     const wp<ThreadBase>& thread() const { return mThread; }
 
+            // In pipe mode the DuplicatingThread never blocks on the track buffer:
+            // write() queues into a non-blocking MonoPipe and the destination thread
+            // moves the queued frames to the track buffer with drainPipe() before mixing.
+            bool        usesPipe() const { return mPipe != 0; }
+            void        drainPipe();
+            void        dumpPipe(int fd) const;
+
 private:
 
+            bool        writeToPipe(void* data, uint32_t frames);
+
     status_t            obtainBuffer(AudioBufferProvider::Buffer* buffer,
                                      uint32_t waitTimeMs);
     void                clearBufferQueue();
@@ -228,6 +243,17 @@ private:
     bool                        mActive;
     DuplicatingThread* const    mSourceThread; // for waitTimeMs() in write()
     sp<AudioTrackClientProxy>   mClientProxy;
+
+    // pipe mode only, see usesPipe()
+    sp<MonoPipe>                mPipe;          // written by the DuplicatingThread
+    sp<MonoPipeReader>          mPipeReader;    // read by the destination thread
+    std::atomic_int_fast64_t    mPipeFramesDrained; // updated by the destination thread
+    // updated by the DuplicatingThread in writeToPipe(), read by dumpPipe() on a binder
+    // thread: both hold mPipeStatsLock, which is never held for longer than a copy
+    mutable Mutex               mPipeStatsLock;
+    int64_t                     mPipeFramesDropped; // frames not queued because the pipe was full
+    uint32_t                    mPipeOverruns;      // number of writes that dropped frames
+    CentralTendencyStatistics   mPipeLatenessMs;    // queued duration found at each write
 };  // end of OutputTrack
 
 // playback track, used by PatchPanel
@@ -260,10 +286,21 @@ public:
 
             void setPeerProxy(PatchProxyBufferProvider *proxy) { mPeerProxy = proxy; }
 
+            // Switches to bridge mode, see PatchBridge.h.  Must be called before start().
+            void enableBridge(const sp<PatchBridge>& bridge);
+            // Returns false if not in bridge mode
+            bool getBridgeStats(PatchBridge::Stats *stats) const;
+
 private:
             void restartIfDisabled();
 
     sp<ClientProxy>             mProxy;
     PatchProxyBufferProvider*   mPeerProxy;
     struct timespec             mPeerTimeout;
+    // drift compensation and statistics in bridge mode, 0 otherwise
+    sp<PatchBridge>             mBridge;
+    // in bridge mode, false until the ring is filled to the target level, and after an underrun
+    bool                        mBridgePrimed;
+    nsecs_t                     mBridgeUpdateNs;        // last update of the drift compensation
+    nsecs_t                     mBridgeUpdatePeriodNs;  // min time between two updates
 };  // end of PatchTrack
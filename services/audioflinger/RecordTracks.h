@@ -63,6 +63,8 @@ public:
 
     virtual bool        isFastTrack() const { return (mFlags & AUDIO_INPUT_FLAG_FAST) != 0; }
 
+            uint32_t    overruns() const { return mOverruns; }
+
 private:
     friend class AudioFlinger;  // for mState
 
@@ -85,12 +87,19 @@ private:
             // not received
             ssize_t                             mFramesToDrop;
 
-            // used by resampler to find source frames
-            ResamplerBufferProvider            *mResamplerBufferProvider;
+            // conversion from the record thread format shared with other tracks with the same
+            // format, and the index of the next frame to read from it;
+            // used only by RecordThread::threadLoop(), cleared when the track starts
+            sp<SharedConversion>                mSharedConversion;
+            int32_t                             mSharedConversionFront;
+
+            // number of times the client did not keep up and lost captured frames, for dumpsys
+            uint32_t                            mOverruns;
 
-            // used by the record thread to convert frames to proper destination format
-            RecordBufferConverter              *mRecordBufferConverter;
             audio_input_flags_t                mFlags;
+
+            // index within FastCaptureState::mCblks[], or -1 if not a fast track
+            int                                 mFastIndex;
 };
 
 // playback track, used by PatchPanel
@@ -118,8 +127,14 @@ public:
 
     void setPeerProxy(PatchProxyBufferProvider *proxy) { mPeerProxy = proxy; }
 
+    // Switches to bridge mode, see PatchBridge.h: never wait for the peer to free space,
+    // the captured frames that do not fit are dropped and counted as overruns of the bridge.
+    // Must be called before start().
+    void enableBridge(const sp<PatchBridge>& bridge);
+
 private:
     sp<ClientProxy>             mProxy;
     PatchProxyBufferProvider*   mPeerProxy;
     struct timespec             mPeerTimeout;
+    sp<PatchBridge>             mBridge;    // in bridge mode, 0 otherwise
 };  // end of PatchRecord
@@ -28,13 +28,14 @@ namespace android {
 #ifdef STATE_QUEUE_DUMP
 void StateQueueObserverDump::dump(int fd)
 {
-    dprintf(fd, "State queue observer: stateChanges=%u\n", mStateChanges);
+    dprintf(fd, "State queue observer: stateChanges=%u skippedStates=%u\n",
+            mStateChanges, mSkippedStates);
 }
 
 void StateQueueMutatorDump::dump(int fd)
 {
-    dprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u blockedSequence=%u\n",
-            mPushDirty, mPushAck, mBlockedSequence);
+    dprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u blockedSequence=%u"
+            " pushOverwrite=%u\n", mPushDirty, mPushAck, mBlockedSequence, mPushOverwrite);
 }
 #endif
 
@@ -185,6 +186,137 @@ template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
     return true;
 }
 
+// WaitFreeStateQueue
+
+template<typename T> WaitFreeStateQueue<T>::WaitFreeStateQueue() :
+    mCurrent(NULL), mCurrentIndex(3), mPreviousIndex(2), mObservedGeneration(0),
+    mMutatingIndex(0), mGeneration(0),
+    mInMutation(false), mIsDirty(false), mIsInitialized(false)
+#ifdef STATE_QUEUE_DUMP
+    , mObserverDump(&mObserverDummyDump), mMutatorDump(&mMutatorDummyDump)
+#endif
+{
+    for (unsigned i = 0; i < kN; ++i) {
+        mGenerations[i] = 0;
+    }
+    atomic_init(&mReady, static_cast<uint_fast32_t>(1));
+    atomic_init(&mAck, static_cast<uint_fast32_t>(0));
+}
+
+template<typename T> WaitFreeStateQueue<T>::~WaitFreeStateQueue()
+{
+}
+
+template<typename T> const T* WaitFreeStateQueue<T>::poll()
+{
+    // Only the observer clears kFresh, so the exchange below is sure to return a fresh state.
+    if (atomic_load_explicit(&mReady, memory_order_relaxed) & kFresh) {
+        const uint32_t ready = (uint32_t) atomic_exchange_explicit(&mReady,
+                (uint_fast32_t) mPreviousIndex, memory_order_acq_rel);
+        mPreviousIndex = mCurrentIndex;
+        mCurrentIndex = ready & ~kFresh;
+        mCurrent = &mStates[mCurrentIndex];
+        const uint32_t generation = mGenerations[mCurrentIndex];
+#ifdef STATE_QUEUE_DUMP
+        mObserverDump->mStateChanges++;
+        if (mObservedGeneration != 0) {
+            mObserverDump->mSkippedStates += generation - mObservedGeneration - 1;
+        }
+#endif
+        mObservedGeneration = generation;
+        atomic_store_explicit(&mAck, (uint_fast32_t) generation, memory_order_release);
+    }
+    return mCurrent;
+}
+
+template<typename T> T* WaitFreeStateQueue<T>::begin()
+{
+    ALOG_ASSERT(!mInMutation, "begin() called when in a mutation");
+    mInMutation = true;
+    return &mStates[mMutatingIndex];
+}
+
+template<typename T> void WaitFreeStateQueue<T>::end(bool didModify)
+{
+    ALOG_ASSERT(mInMutation, "end() called when not in a mutation");
+    ALOG_ASSERT(mIsInitialized || didModify, "first end() must modify for initialization");
+    if (didModify) {
+        mIsDirty = true;
+        mIsInitialized = true;
+    }
+    mInMutation = false;
+}
+
+template<typename T> bool WaitFreeStateQueue<T>::isAcked(uint32_t generation) const
+{
+    const uint32_t ack = (uint32_t) atomic_load_explicit(&mAck, memory_order_acquire);
+    return (int32_t) (ack - generation) >= 0;
+}
+
+template<typename T> bool WaitFreeStateQueue<T>::push(WaitFreeStateQueue<T>::block_t block)
+{
+    static const struct timespec req = {0, PUSH_BLOCK_ACK_NS};
+
+    ALOG_ASSERT(!mInMutation, "push() called when in a mutation");
+
+#ifdef STATE_QUEUE_DUMP
+    if (block == BLOCK_UNTIL_ACKED) {
+        mMutatorDump->mPushAck++;
+    }
+#endif
+
+    if (mIsDirty) {
+
+#ifdef STATE_QUEUE_DUMP
+        mMutatorDump->mPushDirty++;
+#endif
+
+        // publish, and take back either a state released by the observer,
+        // or the previously pushed state if the observer has not seen it yet
+        const uint32_t published = mMutatingIndex;
+        if (++mGeneration == 0) {
+            mGeneration = 1;    // 0 means none
+        }
+        mGenerations[published] = mGeneration;
+        const uint32_t ready = (uint32_t) atomic_exchange_explicit(&mReady,
+                (uint_fast32_t) (published | kFresh), memory_order_acq_rel);
+#ifdef STATE_QUEUE_DUMP
+        if (ready & kFresh) {
+            mMutatorDump->mPushOverwrite++;
+        }
+#endif
+        mMutatingIndex = ready & ~kFresh;
+
+        // The observer can only release the published state after two more pushes,
+        // so it is safe to read here even if the observer has already polled it.
+        mStates[mMutatingIndex] = mStates[published];
+        mIsDirty = false;
+    }
+
+    // optionally wait for this push or a prior push to be acknowledged
+    if (block == BLOCK_UNTIL_ACKED && mGeneration != 0) {
+#ifdef STATE_QUEUE_DUMP
+        unsigned count = 0;
+#endif
+        while (!isAcked(mGeneration)) {
+#ifdef STATE_QUEUE_DUMP
+            if (count == 1) {
+                mMutatorDump->mBlockedSequence++;
+            }
+            ++count;
+#endif
+            nanosleep(&req, NULL);
+        }
+#ifdef STATE_QUEUE_DUMP
+        if (count > 1) {
+            mMutatorDump->mBlockedSequence++;
+        }
+#endif
+    }
+
+    return true;
+}
+
 }   // namespace android
 
 // hack for gcc
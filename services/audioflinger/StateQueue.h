@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_STATE_QUEUE_H
 
 #include <stdatomic.h>
+#include <stdint.h>
 
 // The state queue template class was originally driven by this use case / requirements:
 //  There are two threads: a fast mixer, and a normal mixer, and they share state.
@@ -105,20 +106,24 @@ namespace android {
 // It has a different lifetime than the StateQueue, and so it can't be a member of StateQueue.
 
 struct StateQueueObserverDump {
-    StateQueueObserverDump() : mStateChanges(0) { }
+    StateQueueObserverDump() : mStateChanges(0), mSkippedStates(0) { }
     /*virtual*/ ~StateQueueObserverDump() { }
     unsigned    mStateChanges;    // incremented each time poll() detects a state change
+    unsigned    mSkippedStates;   // pushed states never seen by poll(), WaitFreeStateQueue only
     void        dump(int fd);
 };
 
 struct StateQueueMutatorDump {
-    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mBlockedSequence(0) { }
+    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mBlockedSequence(0),
+            mPushOverwrite(0) { }
     /*virtual*/ ~StateQueueMutatorDump() { }
     unsigned    mPushDirty;       // incremented each time push() is called with a dirty state
     unsigned    mPushAck;         // incremented each time push(BLOCK_UNTIL_ACKED) is called
     unsigned    mBlockedSequence; // incremented before and after each time that push()
                                   // blocks for more than one PUSH_BLOCK_ACK_NS;
                                   // if odd, then mutator is currently blocked inside push()
+    unsigned    mPushOverwrite;   // incremented each time push() replaces a pushed state
+                                  // that the observer had not yet seen, WaitFreeStateQueue only
     void        dump(int fd);
 };
 #endif
@@ -210,6 +215,100 @@ private:
 
 };  // class StateQueue
 
+// WaitFreeStateQueue has the same API and the same observer guarantees as StateQueue, except that
+// push() never waits for the observer, so BLOCK_NEVER and BLOCK_UNTIL_PUSHED always succeed
+// at once.  This implements the "future possibility" described above: a pushed state that the
+// observer has not yet seen is replaced by the newer one, and the observer skips it.
+//
+// There are exactly four states, each owned by one party at a time:
+//      mutating    owned by mutator
+//      ready       the most recently pushed state, owned by neither
+//      current     owned by observer, returned by poll()
+//      previous    owned by observer, still valid for diffing against current
+// The mutator pushes by exchanging its mutating state with the ready state, and the observer
+// polls by exchanging its previous state with the ready state, if the ready state is fresh.
+// Each is a single atomic exchange, so neither side ever waits for the other.
+// A deeper queue would not help, as the mutator only ever needs one free state to continue.
+//
+// Each pushed state is tagged with an increasing generation.  The observer acknowledges
+// the generation of its current state, so BLOCK_UNTIL_ACKED means the observer has seen this
+// push or a later one.  As the observer may skip states, it must diff the previous and current
+// states by content, e.g. the per-track generations of FastMixerState, and not assume that
+// current immediately follows previous; the generations tell how many states were skipped.
+template<typename T> class WaitFreeStateQueue {
+
+public:
+            WaitFreeStateQueue();
+    virtual ~WaitFreeStateQueue();
+
+    // Observer APIs, see StateQueue
+
+    const T* poll();
+
+    // Return the generation of the state most recently returned by poll(), or 0 if none.
+    uint32_t observedGeneration() const { return mObservedGeneration; }
+
+    // Mutator APIs, see StateQueue
+
+    T*      begin();
+    void    end(bool didModify = true);
+
+    enum block_t {
+        BLOCK_NEVER,        // do not block
+        BLOCK_UNTIL_PUSHED, // same as BLOCK_NEVER, as a push never waits for a free state
+        BLOCK_UNTIL_ACKED,  // block until the push is acknowledged by the observer
+    };
+    // Always returns true.
+    bool    push(block_t block = BLOCK_NEVER);
+
+    bool    isDirty() const { return mIsDirty; }
+
+    // Return the generation of the most recent push, or 0 if none.
+    uint32_t pushedGeneration() const { return mGeneration; }
+
+    // Return whether the observer has seen the push of the specified generation or a later one.
+    bool    isAcked(uint32_t generation) const;
+
+#ifdef STATE_QUEUE_DUMP
+    void    setObserverDump(StateQueueObserverDump *dump)
+            { mObserverDump = dump != NULL ? dump : &mObserverDummyDump; }
+    void    setMutatorDump(StateQueueMutatorDump *dump)
+            { mMutatorDump = dump != NULL ? dump : &mMutatorDummyDump; }
+#endif
+
+private:
+    static const unsigned kN = 4;           // mutating, ready, current, and previous
+    static const uint32_t kFresh = 1 << 31; // ready state has not been seen by observer
+
+    T                 mStates[kN];      // written by mutator, read by observer
+    uint32_t          mGenerations[kN]; // written by mutator on push, read by observer
+
+    atomic_uint_fast32_t mReady;        // index of ready state, ORed with kFresh if pushed
+                                        // but not yet polled; exchanged by both
+    atomic_uint_fast32_t mAck;          // written by observer to acknowledge a generation
+
+    // only used by observer
+    const T*          mCurrent;         // most recent value returned by poll()
+    uint32_t          mCurrentIndex;
+    uint32_t          mPreviousIndex;
+    uint32_t          mObservedGeneration;
+
+    // only used by mutator
+    uint32_t          mMutatingIndex;   // where updates by mutator are done in place
+    uint32_t          mGeneration;      // generation of the most recent push
+    bool              mInMutation;      // whether we're currently in the middle of a mutation
+    bool              mIsDirty;         // whether mutating state has been modified since last push
+    bool              mIsInitialized;   // whether mutating state has been initialized yet
+
+#ifdef STATE_QUEUE_DUMP
+    StateQueueObserverDump  mObserverDummyDump;
+    StateQueueObserverDump* mObserverDump;
+    StateQueueMutatorDump   mMutatorDummyDump;
+    StateQueueMutatorDump*  mMutatorDump;
+#endif
+
+};  // class WaitFreeStateQueue
+
 }   // namespace android
 
 #endif  // ANDROID_AUDIO_STATE_QUEUE_H
@@ -25,5 +25,7 @@ namespace android {
 
 template class StateQueue<FastMixerState>;      // typedef FastMixerStateQueue
 template class StateQueue<FastCaptureState>;    // typedef FastCaptureStateQueue
+template class WaitFreeStateQueue<FastMixerState>;
+template class WaitFreeStateQueue<FastCaptureState>;
 
 }
@@ -865,6 +865,19 @@ void AudioFlinger::ThreadBase::dumpEffectChains(int fd, const Vector<String16>&
     }
 }
 
+void AudioFlinger::ThreadBase::appendCpuCosts(CpuCostReport& report)
+{
+    bool locked = AudioFlinger::dumpTryLock(mLock);
+    if (!locked) {
+        return;
+    }
+    const String8 prefix = String8::format("thread %d", mId);
+    for (size_t i = 0; i < mEffectChains.size(); ++i) {
+        mEffectChains[i]->appendCpuCosts(report, prefix.string());
+    }
+    mLock.unlock();
+}
+
 void AudioFlinger::ThreadBase::acquireWakeLock()
 {
     Mutex::Autolock _l(mLock);
@@ -1669,11 +1682,20 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         // index 0 is reserved for normal mixer's submix
         mFastTrackAvailMask(((1 << FastMixerState::sMaxFastTracks) - 1) & ~1),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false),
-        mLeftVolFloat(-1.0), mRightVolFloat(-1.0)
+        mLeftVolFloat(-1.0), mRightVolFloat(-1.0),
+        mEffectChainWorkers(NULL)
 {
     snprintf(mThreadName, kThreadNameLength, "AudioOut_%X", id);
     mNBLogWriter = audioFlinger->newWriter_l(kLogSize, mThreadName);
 
+    // Session effect chains of mixer threads can be processed in parallel.
+    if (type == MIXER || type == DUPLICATING) {
+        const int32_t effectWorkers = property_get_int32("af.effect.workers", 0);
+        if (effectWorkers > 0) {
+            mEffectChainWorkers = new EffectChainWorkers(effectWorkers);
+        }
+    }
+
     // Assumes constructor is called by AudioFlinger with it's mLock held, but
     // it would be safer to explicitly pass initial masterVolume/masterMute as
     // parameter.
@@ -1706,6 +1728,7 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
 AudioFlinger::PlaybackThread::~PlaybackThread()
 {
     mAudioFlinger->unregisterWriter(mNBLogWriter);
+    delete mEffectChainWorkers;
     free(mSinkBuffer);
     free(mMixerBuffer);
     free(mEffectBuffer);
@@ -1720,6 +1743,21 @@ void AudioFlinger::PlaybackThread::dump(int fd, const Vector<String16>& args)
     mLocalLog.dump(fd, "   " /* prefix */, 40 /* lines */);
 }
 
+void AudioFlinger::PlaybackThread::appendCpuCosts(CpuCostReport& report)
+{
+    bool locked = AudioFlinger::dumpTryLock(mLock);
+    if (!locked) {
+        return;
+    }
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const sp<Track>& track = mTracks[i];
+        report.add(String8::format("thread %d track %d session %d", mId, track->name(),
+                track->sessionId()), track->mCpuCost);
+    }
+    mLock.unlock();
+    ThreadBase::appendCpuCosts(report);
+}
+
 void AudioFlinger::PlaybackThread::dumpTracks(int fd, const Vector<String16>& args __unused)
 {
     String8 result;
@@ -1810,6 +1848,9 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     if (mPipeSink.get() != nullptr) {
         dprintf(fd, "  PipeSink frames written: %lld\n", (long long)mPipeSink->framesWritten());
     }
+    if (mEffectChainWorkers != NULL) {
+        mEffectChainWorkers->dump(fd);
+    }
     if (output != nullptr) {
         dprintf(fd, "  Hal stream dump:\n");
         (void)output->stream->dump(fd);
@@ -2833,6 +2874,18 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     }
     chain->setThread(this);
     chain->setInBuffer(halInBuffer);
+    if (mEffectChainWorkers != NULL && session > AUDIO_SESSION_OUTPUT_MIX && mType != DIRECT) {
+        // Session chains processed in parallel cannot accumulate into the shared buffer:
+        // give the chain a private output buffer, added to the shared one after the join.
+        const size_t size = mEffectBufferEnabled ? mEffectBufferSize : mSinkBufferSize;
+        sp<EffectBufferHalInterface> halPrivateBuffer;
+        result = EffectBufferHalInterface::allocate(size, &halPrivateBuffer);
+        if (result != OK) return result;
+        chain->setAccumulateBuffer(halOutBuffer, mNormalFrameCount * mChannelCount);
+        halOutBuffer = halPrivateBuffer;
+    } else {
+        chain->setAccumulateBuffer(NULL, 0);
+    }
     chain->setOutBuffer(halOutBuffer);
     // Effect chain for session AUDIO_SESSION_OUTPUT_STAGE is inserted at end of effect
     // chains list in order to be processed last as it contains output stage effects.
@@ -3214,7 +3267,25 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
             // only process effects if we're going to write
             if (mSleepTimeUs == 0 && mType != OFFLOAD) {
-                for (size_t i = 0; i < effectChains.size(); i ++) {
+                size_t i = 0;
+                if (mEffectChainWorkers != NULL) {
+                    // session chains are sorted first, see addEffectChain_l()
+                    size_t sessionChains = 0;
+                    while (sessionChains < effectChains.size() &&
+                            effectChains[sessionChains]->sessionId() > AUDIO_SESSION_OUTPUT_MIX) {
+                        sessionChains++;
+                    }
+                    if (sessionChains > 1) {
+                        // allow the session chains half of a mix period
+                        const nsecs_t deadlineNs = systemTime() +
+                                (nsecs_t)mNormalFrameCount * 1000000000 / mSampleRate / 2;
+                        mEffectChainWorkers->process(effectChains, sessionChains, deadlineNs);
+                        for (; i < sessionChains; i++) {
+                            effectChains[i]->accumulateOutput_l();
+                        }
+                    }
+                }
+                for (; i < effectChains.size(); i ++) {
                     effectChains[i]->process_l();
                 }
             }
@@ -3602,6 +3673,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    mAudioMixer->setCpuAccounting(isCpuAccountingEnabled());
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -4215,6 +4287,21 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
         {   // local variable scope to avoid goto warning
 
+        // An OutputTrack in pipe mode is fed by its DuplicatingThread through a MonoPipe,
+        // which is moved to the track buffer here, on the destination thread.
+        if (track->isOutputTrack()) {
+            static_cast<OutputTrack *>(track)->drainPipe();
+        }
+
+        // Account the mixer CPU time of the previous cycle to the track.
+        if (isCpuAccountingEnabled()) {
+            const int64_t processNs = mAudioMixer->getProcessNs(track->name());
+            if (processNs != track->mMixerProcessNs) {
+                track->mCpuCost.sample(processNs - track->mMixerProcessNs);
+                track->mMixerProcessNs = processNs;
+            }
+        }
+
         audio_track_cblk_t* cblk = track->cblk();
 
         // The first time a track is added we wait
@@ -4742,6 +4829,7 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
             readOutputParameters_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            mAudioMixer->setCpuAccounting(isCpuAccountingEnabled());
             for (size_t i = 0; i < mTracks.size() ; i++) {
                 int name = getTrackName_l(mTracks[i]->mChannelMask,
                         mTracks[i]->mFormat, mTracks[i]->mSessionId, mTracks[i]->uid());
@@ -4749,6 +4837,7 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
                     break;
                 }
                 mTracks[i]->mName = name;
+                mTracks[i]->mMixerProcessNs = 0;
             }
             sendIoConfigEvent_l(AUDIO_OUTPUT_CONFIG_CHANGED);
         }
@@ -4764,6 +4853,19 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: 0x%08x\n", mAudioMixer->trackNames());
     dprintf(fd, "  Master mono: %s\n", mMasterMono ? "on" : "off");
+    if (isCpuAccountingEnabled()) {
+        String8 result("  Mixer CPU time per cycle:\n");
+        for (size_t i = 0; i < mTracks.size(); ++i) {
+            const sp<Track>& track = mTracks[i];
+            if (track->isFastTrack()) {
+                continue;
+            }
+            result.appendFormat("    name %d session %d: ", track->name(), track->sessionId());
+            track->mCpuCost.appendDump(result);
+            result.append("\n");
+        }
+        write(fd, result.string(), result.size());
+    }
 
     if (hasFastMixer()) {
         dprintf(fd, "  FastMixer thread %p tid=%d", mFastMixer.get(), mFastMixer->getTid());
@@ -5762,7 +5864,8 @@ AudioFlinger::DuplicatingThread::DuplicatingThread(const sp<AudioFlinger>& audio
         AudioFlinger::MixerThread* mainThread, audio_io_handle_t id, bool systemReady)
     :   MixerThread(audioFlinger, mainThread->getOutput(), id, mainThread->outDevice(),
                     systemReady, DUPLICATING),
-        mWaitTimeMs(UINT_MAX)
+        mWaitTimeMs(UINT_MAX),
+        mUsePipes(property_get_bool("af.duplicating.pipe", false /* default_value */))
 {
     addOutputTrack(mainThread);
 }
@@ -5857,7 +5960,8 @@ void AudioFlinger::DuplicatingThread::addOutputTrack(MixerThread *thread)
                                             mFormat,
                                             mChannelMask,
                                             frameCount,
-                                            IPCThreadState::self()->getCallingUid());
+                                            IPCThreadState::self()->getCallingUid(),
+                                            mUsePipes);
     status_t status = outputTrack != 0 ? outputTrack->initCheck() : (status_t) NO_MEMORY;
     if (status != NO_ERROR) {
         ALOGE("addOutputTrack() initCheck failed %d", status);
@@ -5923,6 +6027,19 @@ bool AudioFlinger::DuplicatingThread::outputsReady(
     return true;
 }
 
+void AudioFlinger::DuplicatingThread::dumpInternals(int fd, const Vector<String16>& args)
+{
+    MixerThread::dumpInternals(fd, args);
+    dprintf(fd, "  Output tracks: %zu (%s)\n", mOutputTracks.size(),
+            mUsePipes ? "pipe" : "blocking");
+    for (size_t i = 0; i < mOutputTracks.size(); i++) {
+        sp<ThreadBase> thread = mOutputTracks[i]->thread().promote();
+        dprintf(fd, "   Output track %p on thread %d\n", mOutputTracks[i].get(),
+                thread != 0 ? thread->id() : AUDIO_IO_HANDLE_NONE);
+        mOutputTracks[i]->dumpPipe(fd);
+    }
+}
+
 uint32_t AudioFlinger::DuplicatingThread::activeSleepTimeUs() const
 {
     return (mWaitTimeMs * 1000) / 2;
@@ -5970,7 +6087,9 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
     , mPipeFramesP2(0)
     // mPipeMemory
     // mFastCaptureNBLogWriter
-    , mFastTrackAvail(false)
+    , mFastTrackAvailMask(0)
+    , mSharedFramesConverted(0)
+    , mSharedFramesDelivered(0)
     , mBtNrecSuspended(false)
 {
     snprintf(mThreadName, kThreadNameLength, "AudioIn_%X", id);
@@ -6051,12 +6170,12 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
         // FIXME
 #endif
         FastCaptureState *state = sq->begin();
-        state->mCblk = NULL;
         state->mInputSource = mInputSource.get();
         state->mInputSourceGen++;
         state->mPipeSink = pipe;
         state->mPipeSinkGen++;
         state->mFrameCount = mFrameCount;
+        state->mClientFrameCount = pipeFramesP2;
         state->mCommand = FastCaptureState::COLD_IDLE;
         // already done in constructor initialization list
         //mFastCaptureFutex = 0;
@@ -6080,7 +6199,7 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
         // FIXME
 #endif
 
-        mFastTrackAvail = true;
+        mFastTrackAvailMask = (1 << FastCaptureState::sMaxFastClients) - 1;
     }
 failed: ;
 
@@ -6149,11 +6268,11 @@ reacquire_wakelock:
         // activeTracks accumulates a copy of a subset of mActiveTracks
         Vector< sp<RecordTrack> > activeTracks;
 
-        // reference to the (first and only) active fast track
-        sp<RecordTrack> fastTrack;
+        // references to the active fast tracks, indexed by fast client slot
+        sp<RecordTrack> fastTracks[FastCaptureState::sMaxFastClients];
 
-        // reference to a fast track which is about to be removed
-        sp<RecordTrack> fastTrackToRemove;
+        // references to fast tracks which are about to be removed
+        Vector< sp<RecordTrack> > fastTracksToRemove;
 
         { // scope for mLock
             Mutex::Autolock _l(mLock);
@@ -6195,8 +6314,7 @@ reacquire_wakelock:
                 activeTrack = mActiveTracks[i];
                 if (activeTrack->isTerminated()) {
                     if (activeTrack->isFastTrack()) {
-                        ALOG_ASSERT(fastTrackToRemove == 0);
-                        fastTrackToRemove = activeTrack;
+                        fastTracksToRemove.add(activeTrack);
                     }
                     removeTrack_l(activeTrack);
                     mActiveTracks.remove(activeTrack);
@@ -6223,6 +6341,8 @@ reacquire_wakelock:
                     doBroadcast = true;
                     mStandby = false;
                     activeTrack->mState = TrackBase::ACTIVE;
+                    // new data will be discontinuous, so join a conversion below
+                    activeTrack->mSharedConversion.clear();
                     allStopped = false;
                     break;
 
@@ -6242,9 +6362,11 @@ reacquire_wakelock:
                 i++;
 
                 if (activeTrack->isFastTrack()) {
-                    ALOG_ASSERT(!mFastTrackAvail);
-                    ALOG_ASSERT(fastTrack == 0);
-                    fastTrack = activeTrack;
+                    const int index = activeTrack->mFastIndex;
+                    ALOG_ASSERT(0 <= index && index < (int)FastCaptureState::sMaxFastClients);
+                    ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
+                    ALOG_ASSERT(fastTracks[index] == 0);
+                    fastTracks[index] = activeTrack;
                 }
             }
 
@@ -6299,15 +6421,17 @@ reacquire_wakelock:
 #endif
                 didModify = true;
             }
-            audio_track_cblk_t *cblkOld = state->mCblk;
-            audio_track_cblk_t *cblkNew = fastTrack != 0 ? fastTrack->cblk() : NULL;
-            if (cblkNew != cblkOld) {
-                state->mCblk = cblkNew;
-                // block until acked if removing a fast track
-                if (cblkOld != NULL) {
-                    block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+            for (unsigned i = 0; i < FastCaptureState::sMaxFastClients; i++) {
+                audio_track_cblk_t *cblkOld = state->mCblks[i];
+                audio_track_cblk_t *cblkNew = fastTracks[i] != 0 ? fastTracks[i]->cblk() : NULL;
+                if (cblkNew != cblkOld) {
+                    state->mCblks[i] = cblkNew;
+                    // block until acked if removing a fast track
+                    if (cblkOld != NULL) {
+                        block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+                    }
+                    didModify = true;
                 }
-                didModify = true;
             }
             sq->end(didModify);
             if (didModify) {
@@ -6320,8 +6444,55 @@ reacquire_wakelock:
             }
         }
 
-        // now run the fast track destructor with thread mutex unlocked
-        fastTrackToRemove.clear();
+        // now run the fast track destructors with thread mutex unlocked
+        fastTracksToRemove.clear();
+
+        // Each normal track reads from a conversion shared with the other active normal tracks
+        // that have the same format, channel mask and sample rate.  A track joins a conversion
+        // when it starts, or when the conversion no longer matches the input configuration.
+        // The conversions are referenced only by the tracks, so a conversion goes away with the
+        // last track using it.  Joining happens before the read, so no new data is skipped.
+        Vector< sp<SharedConversion> > conversions;
+        size = activeTracks.size();
+        for (size_t i = 0; i < size; i++) {
+            activeTrack = activeTracks[i];
+            const sp<SharedConversion>& conversion = activeTrack->mSharedConversion;
+            if (conversion == 0) {
+                continue;
+            }
+            if (!conversion->matches(this, activeTrack->mChannelMask, activeTrack->mFormat,
+                    activeTrack->mSampleRate)) {
+                activeTrack->mSharedConversion.clear();
+            } else if (conversions.indexOf(conversion) < 0) {
+                conversions.add(conversion);
+            }
+        }
+        for (size_t i = 0; i < size; i++) {
+            activeTrack = activeTracks[i];
+            if (activeTrack->isFastTrack() || activeTrack->mSharedConversion != 0) {
+                continue;
+            }
+            sp<SharedConversion> conversion;
+            for (size_t j = 0; j < conversions.size(); j++) {
+                if (conversions[j]->matches(this, activeTrack->mChannelMask,
+                        activeTrack->mFormat, activeTrack->mSampleRate)) {
+                    conversion = conversions[j];
+                    break;
+                }
+            }
+            if (conversion == 0) {
+                conversion = new SharedConversion(this, activeTrack->mChannelMask,
+                        activeTrack->mFormat, activeTrack->mSampleRate);
+                if (conversion->initCheck() != NO_ERROR) {
+                    ALOGE("RecordThread: unable to convert for track session %d",
+                            activeTrack->sessionId());
+                    continue;
+                }
+                conversions.add(conversion);
+            }
+            activeTrack->mSharedConversion = conversion;
+            activeTrack->mSharedConversionFront = conversion->rear();
+        }
 
         // Read from HAL to keep up with fastest client if multiple active tracks, not slowest one.
         // Only the client(s) that are too slow will overrun. But if even the fastest client is too
@@ -6421,6 +6592,13 @@ reacquire_wakelock:
         }
         rear = mRsmpInRear += framesRead;
 
+        // convert once for all tracks sharing each conversion
+        for (size_t i = 0; i < conversions.size(); i++) {
+            const size_t converted = conversions[i]->framesConverted();
+            conversions[i]->convert();
+            mSharedFramesConverted += conversions[i]->framesConverted() - converted;
+        }
+
         size = activeTracks.size();
         // loop over each active track
         for (size_t i = 0; i < size; i++) {
@@ -6431,8 +6609,12 @@ reacquire_wakelock:
                 continue;
             }
 
+            const sp<SharedConversion>& conversion = activeTrack->mSharedConversion;
+            if (conversion == 0) {
+                continue;
+            }
+
             // TODO: This code probably should be moved to RecordTrack.
-            // TODO: Update the activeTrack buffer converter in case of reconfigure.
 
             enum {
                 OVERRUN_UNKNOWN,
@@ -6451,8 +6633,8 @@ reacquire_wakelock:
                 // check available frames and handle overrun conditions
                 // if the record track isn't draining fast enough.
                 bool hasOverrun;
-                size_t framesIn;
-                activeTrack->mResamplerBufferProvider->sync(&framesIn, &hasOverrun);
+                size_t framesIn = conversion->sync(&activeTrack->mSharedConversionFront,
+                        &hasOverrun);
                 if (hasOverrun) {
                     overrun = OVERRUN_TRUE;
                 }
@@ -6460,16 +6642,11 @@ reacquire_wakelock:
                     break;
                 }
 
-                // Don't allow framesOut to be larger than what is possible with resampling
-                // from framesIn.
-                // This isn't strictly necessary but helps limit buffer resizing in
-                // RecordBufferConverter.  TODO: remove when no longer needed.
-                framesOut = min(framesOut,
-                        destinationFramesPossible(
-                                framesIn, mSampleRate, activeTrack->mSampleRate));
-                // process frames from the RecordThread buffer provider to the RecordTrack buffer
-                framesOut = activeTrack->mRecordBufferConverter->convert(
-                        activeTrack->mSink.raw, activeTrack->mResamplerBufferProvider, framesOut);
+                // copy converted frames to the RecordTrack buffer
+                framesOut = min(framesOut, framesIn);
+                conversion->read(&activeTrack->mSharedConversionFront, activeTrack->mSink.raw,
+                        framesOut);
+                mSharedFramesDelivered += framesOut;
 
                 if (framesOut > 0 && (overrun == OVERRUN_UNKNOWN)) {
                     overrun = OVERRUN_FALSE;
@@ -6511,6 +6688,7 @@ reacquire_wakelock:
             case OVERRUN_TRUE:
                 // client isn't retrieving buffers fast enough
                 if (!activeTrack->setOverflow()) {
+                    activeTrack->mOverruns++;
                     nsecs_t now = systemTime();
                     // FIXME should lastWarning per track?
                     if ((now - lastWarning) > kWarningThrottleNs) {
@@ -6657,7 +6835,7 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
             // record thread has an associated fast capture
             hasFastCapture() &&
             // there are sufficient fast track slots available
-            mFastTrackAvail
+            mFastTrackAvailMask != 0
         ) {
           // check compatibility with audio effects.
           Mutex::Autolock _l(mLock);
@@ -6677,10 +6855,10 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
       } else {
         ALOGV("%p AUDIO_INPUT_FLAG_FAST denied: frameCount=%zu mFrameCount=%zu mPipeFramesP2=%zu "
                 "format=%#x isLinear=%d mFormat=%#x channelMask=%#x sampleRate=%u mSampleRate=%u "
-                "hasFastCapture=%d tid=%d mFastTrackAvail=%d",
+                "hasFastCapture=%d tid=%d mFastTrackAvailMask=%#x",
                 this, frameCount, mFrameCount, mPipeFramesP2,
                 format, audio_is_linear_pcm(format), mFormat, channelMask, sampleRate, mSampleRate,
-                hasFastCapture(), tid, mFastTrackAvail);
+                hasFastCapture(), tid, mFastTrackAvailMask);
         *flags = (audio_input_flags_t)(*flags & ~AUDIO_INPUT_FLAG_FAST);
       }
     }
@@ -6810,14 +6988,9 @@ status_t AudioFlinger::RecordThread::start(RecordThread::RecordTrack* recordTrac
                 return status;
             }
         }
-        // Catch up with current buffer indices if thread is already running.
-        // This is what makes a new client discard all buffered data.  If the track's mRsmpInFront
-        // was initialized to some value closer to the thread's mRsmpInFront, then the track could
-        // see previously buffered data before it called start(), but with greater risk of overrun.
+        // The thread loop makes the track join a SharedConversion at the conversion's current
+        // rear, which is what makes a new client discard all buffered data.
 
-        recordTrack->mResamplerBufferProvider->reset();
-        // clear any converter state as new data will be discontinuous
-        recordTrack->mRecordBufferConverter->reset();
         recordTrack->mState = TrackBase::STARTING_2;
         // signal thread to start
         mWaitWorkCV.broadcast();
@@ -6925,8 +7098,10 @@ void AudioFlinger::RecordThread::removeTrack_l(const sp<RecordTrack>& track)
     mTracks.remove(track);
     // need anything related to effects here?
     if (track->isFastTrack()) {
-        ALOG_ASSERT(!mFastTrackAvail);
-        mFastTrackAvail = true;
+        const int index = track->mFastIndex;
+        ALOG_ASSERT(0 <= index && index < (int)FastCaptureState::sMaxFastClients);
+        ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
+        mFastTrackAvailMask |= 1 << index;
     }
 }
 
@@ -6957,7 +7132,12 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     }
 
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
-    dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
+    dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
+    const uint64_t converted = mSharedFramesConverted;
+    const uint64_t delivered = mSharedFramesDelivered;
+    dprintf(fd, "  Shared conversion: %llu frames converted, %llu frames delivered (%.2f x)\n",
+            (unsigned long long) converted, (unsigned long long) delivered,
+            converted != 0 ? (double) delivered / converted : 0.);
 
     // Make a non-atomic copy of fast capture dump state so it won't change underneath us
     // while we are dumping it.  It may be inconsistent, but it won't mutate!
@@ -7015,7 +7195,7 @@ void AudioFlinger::RecordThread::dumpTracks(int fd, const Vector<String16>& args
 
 void AudioFlinger::RecordThread::ResamplerBufferProvider::reset()
 {
-    sp<ThreadBase> threadBase = mRecordTrack->mThread.promote();
+    sp<ThreadBase> threadBase = mThread.promote();
     RecordThread *recordThread = (RecordThread *) threadBase.get();
     mRsmpInFront = recordThread->mRsmpInRear;
     mRsmpInUnrel = 0;
@@ -7024,7 +7204,7 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::reset()
 void AudioFlinger::RecordThread::ResamplerBufferProvider::sync(
         size_t *framesAvailable, bool *hasOverrun)
 {
-    sp<ThreadBase> threadBase = mRecordTrack->mThread.promote();
+    sp<ThreadBase> threadBase = mThread.promote();
     RecordThread *recordThread = (RecordThread *) threadBase.get();
     const int32_t rear = recordThread->mRsmpInRear;
     const int32_t front = mRsmpInFront;
@@ -7057,7 +7237,7 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::sync(
 status_t AudioFlinger::RecordThread::ResamplerBufferProvider::getNextBuffer(
         AudioBufferProvider::Buffer* buffer)
 {
-    sp<ThreadBase> threadBase = mRecordTrack->mThread.promote();
+    sp<ThreadBase> threadBase = mThread.promote();
     if (threadBase == 0) {
         buffer->frameCount = 0;
         buffer->raw = NULL;
@@ -7110,6 +7290,111 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::releaseBuffer(
     buffer->frameCount = 0;
 }
 
+AudioFlinger::RecordThread::SharedConversion::SharedConversion(RecordThread *recordThread,
+        audio_channel_mask_t channelMask, audio_format_t format, uint32_t sampleRate)
+    :   mProvider(recordThread),
+        mConverter(new RecordBufferConverter(
+                recordThread->mChannelMask, recordThread->mFormat, recordThread->mSampleRate,
+                channelMask, format, sampleRate)),
+        mSrcChannelMask(recordThread->mChannelMask),
+        mSrcFormat(recordThread->mFormat),
+        mSrcSampleRate(recordThread->mSampleRate),
+        mDstChannelMask(channelMask),
+        mDstFormat(format),
+        mDstSampleRate(sampleRate),
+        mFrameSize(audio_bytes_per_sample(format) *
+                audio_channel_count_from_in_mask(channelMask)),
+        mFramesP2(0),
+        mBuffer(NULL),
+        mRear(0),
+        mFramesConverted(0)
+{
+    // hold as much converted data as the RecordThread holds input data
+    mFramesP2 = roundup(destinationFramesPossible(recordThread->mRsmpInFrames,
+            mSrcSampleRate, mDstSampleRate) + 1);
+    (void)posix_memalign(&mBuffer, 32, mFramesP2 * mFrameSize);
+    // start at the current RecordThread data, skipping any previous data
+    mProvider.reset();
+}
+
+AudioFlinger::RecordThread::SharedConversion::~SharedConversion()
+{
+    free(mBuffer);
+    delete mConverter;
+}
+
+status_t AudioFlinger::RecordThread::SharedConversion::initCheck() const
+{
+    if (mBuffer == NULL || mFrameSize == 0) {
+        return NO_MEMORY;
+    }
+    return mConverter->initCheck();
+}
+
+bool AudioFlinger::RecordThread::SharedConversion::matches(const RecordThread *recordThread,
+        audio_channel_mask_t channelMask, audio_format_t format, uint32_t sampleRate) const
+{
+    return mSrcChannelMask == recordThread->mChannelMask &&
+            mSrcFormat == recordThread->mFormat &&
+            mSrcSampleRate == recordThread->mSampleRate &&
+            mDstChannelMask == channelMask &&
+            mDstFormat == format &&
+            mDstSampleRate == sampleRate;
+}
+
+void AudioFlinger::RecordThread::SharedConversion::convert()
+{
+    // The ring never blocks: the oldest converted frames are overwritten,
+    // and readers that are too far behind are overrun.
+    for (;;) {
+        size_t framesIn;
+        mProvider.sync(&framesIn);
+        const size_t rear = mRear & (mFramesP2 - 1);
+        size_t frames = min(mFramesP2 - rear,
+                destinationFramesPossible(framesIn, mSrcSampleRate, mDstSampleRate));
+        if (frames == 0) {
+            break;
+        }
+        frames = mConverter->convert((uint8_t *) mBuffer + rear * mFrameSize, &mProvider, frames);
+        if (frames == 0) {
+            break;
+        }
+        mRear += frames;
+        mFramesConverted += frames;
+    }
+}
+
+size_t AudioFlinger::RecordThread::SharedConversion::sync(int32_t *front, bool *hasOverrun)
+{
+    const ssize_t filled = (int32_t) (mRear - *front);
+    *hasOverrun = false;
+    if (filled < 0) {
+        // should not happen, but treat like a massive overrun and re-sync
+        *front = mRear;
+        *hasOverrun = true;
+        return 0;
+    }
+    if ((size_t) filled > mFramesP2) {
+        // reader is not keeping up, give it the oldest data still available
+        *front = mRear - (int32_t) mFramesP2;
+        *hasOverrun = true;
+        return mFramesP2;
+    }
+    return (size_t) filled;
+}
+
+void AudioFlinger::RecordThread::SharedConversion::read(int32_t *front, void *dst, size_t frames)
+{
+    ALOG_ASSERT(frames <= (size_t) (int32_t) (mRear - *front));
+    const size_t index = *front & (mFramesP2 - 1);
+    const size_t part1 = min(frames, mFramesP2 - index);
+    memcpy(dst, (const uint8_t *) mBuffer + index * mFrameSize, part1 * mFrameSize);
+    if (frames > part1) {
+        memcpy((uint8_t *) dst + part1 * mFrameSize, mBuffer, (frames - part1) * mFrameSize);
+    }
+    *front += frames;
+}
+
 void AudioFlinger::RecordThread::checkBtNrec()
 {
     Mutex::Autolock _l(mLock);
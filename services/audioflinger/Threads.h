@@ -46,6 +46,9 @@ public:
     void dumpBase(int fd, const Vector<String16>& args);
     void dumpEffectChains(int fd, const Vector<String16>& args);
 
+    // Adds the CPU costs accounted by this thread to report, see isCpuAccountingEnabled().
+    virtual void appendCpuCosts(CpuCostReport& report);
+
     void clearPowerManager();
 
     // base for record and playback
@@ -913,6 +916,7 @@ private:
 
     virtual void dumpInternals(int fd, const Vector<String16>& args);
     void        dumpTracks(int fd, const Vector<String16>& args);
+    virtual void appendCpuCosts(CpuCostReport& report);
 
     SortedVector< sp<Track> >       mTracks;
     stream_type_t                   mStreamTypes[AUDIO_STREAM_CNT];
@@ -1002,6 +1006,9 @@ protected:
                 // volumes last sent to audio HAL with stream->setVolume()
                 float mLeftVolFloat;
                 float mRightVolFloat;
+
+                // processes session effect chains in parallel when not NULL (af.effect.workers)
+                EffectChainWorkers *mEffectChainWorkers;
 };
 
 class MixerThread : public PlaybackThread {
@@ -1223,6 +1230,7 @@ protected:
     virtual     ssize_t     threadLoop_write();
     virtual     void        threadLoop_standby();
     virtual     void        cacheParameters_l();
+    virtual     void        dumpInternals(int fd, const Vector<String16>& args);
 
 private:
     // called from threadLoop, addOutputTrack, removeOutputTrack
@@ -1233,6 +1241,9 @@ protected:
 private:
 
                 uint32_t    mWaitTimeMs;
+    // when true, each OutputTrack is fed through its own non-blocking MonoPipe so that a
+    // slow output cannot delay the others (af.duplicating.pipe)
+    const       bool        mUsePipes;
     SortedVector < sp<OutputTrack> >  outputTracks;
     SortedVector < sp<OutputTrack> >  mOutputTracks;
 public:
@@ -1253,8 +1264,8 @@ public:
     class ResamplerBufferProvider : public AudioBufferProvider
     {
     public:
-        explicit ResamplerBufferProvider(RecordTrack* recordTrack) :
-            mRecordTrack(recordTrack),
+        explicit ResamplerBufferProvider(const wp<ThreadBase>& thread) :
+            mThread(thread),
             mRsmpInUnrel(0), mRsmpInFront(0) { }
         virtual ~ResamplerBufferProvider() { }
 
@@ -1279,7 +1290,7 @@ public:
         virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer);
         virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
     private:
-        RecordTrack * const mRecordTrack;
+        const wp<ThreadBase> mThread;
         size_t              mRsmpInUnrel;   // unreleased frames remaining from
                                             // most recent getNextBuffer
                                             // for debug only
@@ -1287,6 +1298,57 @@ public:
                                             // rolling counter that is never cleared
     };
 
+    /* The SharedConversion converts the RecordThread data once for all the normal RecordTracks
+     * that have the same format, channel mask and sample rate.  The converted frames go to a
+     * ring buffer that never blocks, and that each RecordTrack reads at its own front index.
+     * Only used by threadLoop(), no locks required.
+     */
+    class SharedConversion : public RefBase
+    {
+    public:
+        SharedConversion(RecordThread *recordThread,
+                audio_channel_mask_t channelMask, audio_format_t format, uint32_t sampleRate);
+        virtual ~SharedConversion();
+
+        status_t    initCheck() const;
+
+        // true if this converts the current RecordThread configuration to the given one
+        bool        matches(const RecordThread *recordThread, audio_channel_mask_t channelMask,
+                            audio_format_t format, uint32_t sampleRate) const;
+
+        // converts all RecordThread data not yet converted; call once per read
+        void        convert();
+
+        // front index for a new reader, which skips any previously converted frames
+        int32_t     rear() const { return mRear; }
+
+        /* Returns the number of converted frames available to the reader at *front.
+         * If the reader has fallen more than the ring size behind, *front skips ahead to
+         * the oldest frame still available, and *hasOverrun is set to true.
+         */
+        size_t      sync(int32_t *front, bool *hasOverrun);
+
+        // copies frames to dst from the reader at *front, and advances *front
+        void        read(int32_t *front, void *dst, size_t frames);
+
+        size_t      framesConverted() const { return mFramesConverted; }
+
+    private:
+        ResamplerBufferProvider mProvider;      // reads the RecordThread data
+        RecordBufferConverter * const mConverter;
+        const audio_channel_mask_t  mSrcChannelMask;
+        const audio_format_t        mSrcFormat;
+        const uint32_t              mSrcSampleRate;
+        const audio_channel_mask_t  mDstChannelMask;
+        const audio_format_t        mDstFormat;
+        const uint32_t              mDstSampleRate;
+        const size_t                mFrameSize;
+        size_t                      mFramesP2;  // ring size, a power of 2
+        void                       *mBuffer;
+        int32_t                     mRear;      // rolling index of the next frame to convert
+        size_t                      mFramesConverted;   // total, for dumpsys
+    };
+
 #include "RecordTracks.h"
 
             RecordThread(const sp<AudioFlinger>& audioFlinger,
@@ -1459,7 +1521,14 @@ private:
             static const size_t                 kFastCaptureLogSize = 4 * 1024;
             sp<NBLog::Writer>                   mFastCaptureNBLogWriter;
 
-            bool                                mFastTrackAvail;    // true if fast track available
+            // bit i set if fast client slot i in FastCaptureState::mCblks[] is available
+            unsigned                            mFastTrackAvailMask;
+
+            // For dumpsys, frames converted by SharedConversions and frames delivered to normal
+            // tracks; the ratio shows how much conversion is shared between tracks.
+            // Written by threadLoop() only, read racily by dump.
+            uint64_t                            mSharedFramesConverted;
+            uint64_t                            mSharedFramesDelivered;
             // common state to all record threads
             std::atomic_bool                    mBtNrecSuspended;
 };
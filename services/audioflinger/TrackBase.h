@@ -84,6 +84,7 @@ public:
             sp<IMemory> getBuffers() const { return mBufferMemory; }
             void*       buffer() const { return mBuffer; }
             size_t      bufferSize() const { return mBufferSize; }
+            size_t      frameCount() const { return mFrameCount; }
     virtual bool        isFastTrack() const = 0;
             bool        isOutputTrack() const { return (mType == TYPE_OUTPUT); }
             bool        isPatchTrack() const { return (mType == TYPE_PATCH); }
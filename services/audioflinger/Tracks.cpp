@@ -30,6 +30,8 @@
 #include "AudioFlinger.h"
 #include "ServiceUtilities.h"
 
+#include <media/nbaio/MonoPipe.h>
+#include <media/nbaio/MonoPipeReader.h>
 #include <media/nbaio/Pipe.h>
 #include <media/nbaio/PipeReader.h>
 #include <media/RecordBufferConverter.h>
@@ -401,6 +403,8 @@ AudioFlinger::PlaybackThread::Track::Track(
     mFrameMap(16 /* sink-frame-to-track-frame map memory */),
     mVolumeHandler(new VolumeHandler(sampleRate)),
     // mSinkTimestamp
+    mMixerProcessNs(0),
+    // mCpuCost
     mFastIndex(-1),
     mCachedVolume(1.0),
     mResumeToStopping(false),
@@ -1253,13 +1257,15 @@ AudioFlinger::PlaybackThread::OutputTrack::OutputTrack(
             audio_format_t format,
             audio_channel_mask_t channelMask,
             size_t frameCount,
-            uid_t uid)
+            uid_t uid,
+            bool usePipe)
     :   Track(playbackThread, NULL, AUDIO_STREAM_PATCH,
               sampleRate, format, channelMask, frameCount,
               nullptr /* buffer */, (size_t)0 /* bufferSize */, nullptr /* sharedBuffer */,
               AUDIO_SESSION_NONE, uid, AUDIO_OUTPUT_FLAG_NONE,
               TYPE_OUTPUT),
-    mActive(false), mSourceThread(sourceThread)
+    mActive(false), mSourceThread(sourceThread),
+    mPipeFramesDrained(0), mPipeFramesDropped(0), mPipeOverruns(0)
 {
 
     if (mCblk != NULL) {
@@ -1276,6 +1282,25 @@ AudioFlinger::PlaybackThread::OutputTrack::OutputTrack(
         mClientProxy->setVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY);
         mClientProxy->setSendLevel(0.0);
         mClientProxy->setSampleRate(sampleRate);
+
+        if (usePipe) {
+            // The pipe has the same depth as the track buffer, so the DuplicatingThread can
+            // run ahead of the destination thread by up to twice the track buffer.
+            const NBAIO_Format pipeFormat = Format_from_SR_C(sampleRate,
+                    audio_channel_count_from_out_mask(channelMask), format);
+            MonoPipe *monoPipe = new MonoPipe(frameCount, pipeFormat, false /*writeCanBlock*/);
+            const NBAIO_Format offers[1] = {pipeFormat};
+            size_t numCounterOffers = 0;
+            ssize_t index = monoPipe->negotiate(offers, 1, NULL, numCounterOffers);
+            ALOG_ASSERT(index == 0);
+            MonoPipeReader *monoPipeReader = new MonoPipeReader(monoPipe);
+            numCounterOffers = 0;
+            index = monoPipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+            ALOG_ASSERT(index == 0);
+            (void)index;
+            mPipe = monoPipe;
+            mPipeReader = monoPipeReader;
+        }
     } else {
         ALOGW("Error creating output track on thread %p", playbackThread);
     }
@@ -1310,6 +1335,10 @@ void AudioFlinger::PlaybackThread::OutputTrack::stop()
 
 bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frames)
 {
+    if (mPipe != 0) {
+        return writeToPipe(data, frames);
+    }
+
     Buffer *pInBuffer;
     Buffer inBuffer;
     bool outputBufferFull = false;
@@ -1413,6 +1442,111 @@ bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frame
     return outputBufferFull;
 }
 
+bool AudioFlinger::PlaybackThread::OutputTrack::writeToPipe(void* data, uint32_t frames)
+{
+    bool outputBufferFull = false;
+
+    if (!mActive && frames != 0) {
+        (void) start();
+    }
+
+    // frames still queued in the pipe are as late as the destination thread is.
+    const ssize_t availableToWrite = mPipe->availableToWrite();
+    if (availableToWrite >= 0) {
+        const size_t queuedFrames = mPipe->maxFrames() - availableToWrite;
+        Mutex::Autolock _l(mPipeStatsLock);
+        mPipeLatenessMs.sample((double)queuedFrames * 1000 / mSampleRate);
+    }
+
+    if (frames != 0) {
+        // Never wait for the destination thread: drop what does not fit.
+        ssize_t written = mPipe->write(data, frames);
+        if (written < 0) {
+            written = 0;
+        }
+        if ((size_t)written < frames) {
+            ALOGV("OutputTrack::writeToPipe() %p thread %p dropped %zu frames", this,
+                    mThread.unsafe_get(), frames - (size_t)written);
+            Mutex::Autolock _l(mPipeStatsLock);
+            mPipeFramesDropped += frames - written;
+            mPipeOverruns++;
+            outputBufferFull = true;
+        }
+        // The destination thread only drains the pipe of an active track: restart the
+        // track if it was disabled, for instance after a buffer timeout.
+        if (written > 0) {
+            restartIfDisabled();
+        }
+    }
+
+    // Calling write() with a 0 length buffer means that no more data will be written:
+    // stop once the destination thread has drained the pipe.
+    if (frames == 0 && mActive && mPipe->framesWritten() == mPipeFramesDrained) {
+        stop();
+    }
+
+    return outputBufferFull;
+}
+
+void AudioFlinger::PlaybackThread::OutputTrack::drainPipe()
+{
+    if (mPipeReader == 0) {
+        return;
+    }
+    bool drained = false;
+    for (;;) {
+        const ssize_t availableToRead = mPipeReader->availableToRead();
+        if (availableToRead <= 0) {
+            break;
+        }
+        Proxy::Buffer buf;
+        buf.mFrameCount = availableToRead;
+        status_t status = mClientProxy->obtainBuffer(&buf, &ClientProxy::kNonBlocking);
+        if (status != NO_ERROR || buf.mFrameCount == 0) {
+            break;
+        }
+        ssize_t framesRead = mPipeReader->read(buf.mRaw, buf.mFrameCount);
+        if (framesRead < 0) {
+            framesRead = 0;
+        }
+        buf.mFrameCount = framesRead;
+        mClientProxy->releaseBuffer(&buf);
+        if (framesRead == 0) {
+            break;
+        }
+        mPipeFramesDrained += framesRead;
+        drained = true;
+    }
+    if (drained) {
+        restartIfDisabled();
+    }
+}
+
+void AudioFlinger::PlaybackThread::OutputTrack::dumpPipe(int fd) const
+{
+    if (mPipe == 0) {
+        return;
+    }
+    int64_t framesDropped;
+    uint32_t overruns;
+    CentralTendencyStatistics latenessMs;
+    {
+        Mutex::Autolock _l(mPipeStatsLock);
+        framesDropped = mPipeFramesDropped;
+        overruns = mPipeOverruns;
+        latenessMs = mPipeLatenessMs;
+    }
+    dprintf(fd, "    pipe frames: %zu, written: %lld, drained: %lld, dropped: %lld,"
+            " overruns: %u\n",
+            mPipe->maxFrames(), (long long)mPipe->framesWritten(),
+            (long long)mPipeFramesDrained, (long long)framesDropped, overruns);
+    if (latenessMs.n() > 0) {
+        dprintf(fd, "    lateness ms: mean=%.2f min=%.2f max=%.2f stddev=%.2f (%u writes)\n",
+                latenessMs.mean(), latenessMs.minimum(), latenessMs.maximum(),
+                latenessMs.stddev(), latenessMs.n());
+    }
+}
+
 status_t AudioFlinger::PlaybackThread::OutputTrack::obtainBuffer(
         AudioBufferProvider::Buffer* buffer, uint32_t waitTimeMs)
 {
@@ -1460,10 +1594,13 @@ AudioFlinger::PlaybackThread::PatchTrack::PatchTrack(PlaybackThread *playbackThr
               sampleRate, format, channelMask, frameCount,
               buffer, bufferSize, nullptr /* sharedBuffer */,
               AUDIO_SESSION_NONE, getuid(), flags, TYPE_PATCH),
-              mProxy(new ClientProxy(mCblk, mBuffer, frameCount, mFrameSize, true, true))
+              mProxy(new ClientProxy(mCblk, mBuffer, frameCount, mFrameSize, true, true)),
+              mBridgePrimed(false), mBridgeUpdateNs(0)
 {
     uint64_t mixBufferNs = ((uint64_t)2 * playbackThread->frameCount() * 1000000000) /
                                                                     playbackThread->sampleRate();
+    // half a mix period, so that mixer cycles delayed by scheduling are not skipped
+    mBridgeUpdatePeriodNs = mixBufferNs / 4;
     mPeerTimeout.tv_sec = mixBufferNs / 1000000000;
     mPeerTimeout.tv_nsec = (int) (mixBufferNs % 1000000000);
 
@@ -1477,6 +1614,22 @@ AudioFlinger::PlaybackThread::PatchTrack::~PatchTrack()
 {
 }
 
+void AudioFlinger::PlaybackThread::PatchTrack::enableBridge(const sp<PatchBridge>& bridge)
+{
+    mBridge = bridge;
+    mPeerTimeout.tv_sec = 0;
+    mPeerTimeout.tv_nsec = 0;
+}
+
+bool AudioFlinger::PlaybackThread::PatchTrack::getBridgeStats(PatchBridge::Stats *stats) const
+{
+    if (mBridge == 0) {
+        return false;
+    }
+    *stats = mBridge->stats();
+    return true;
+}
+
 status_t AudioFlinger::PlaybackThread::PatchTrack::start(AudioSystem::sync_event_t event,
                                                           audio_session_t triggerSession)
 {
@@ -1493,12 +1646,37 @@ status_t AudioFlinger::PlaybackThread::PatchTrack::getNextBuffer(
         AudioBufferProvider::Buffer* buffer)
 {
     ALOG_ASSERT(mPeerProxy != 0, "PatchTrack::getNextBuffer() called without peer proxy");
+    if (mBridge != 0) {
+        if (!mBridgePrimed) {
+            if (framesReady() < mBridge->targetFrames()) {
+                buffer->frameCount = 0;
+                buffer->raw = NULL;
+                return WOULD_BLOCK;
+            }
+            mBridgePrimed = true;
+            mBridgeUpdateNs = 0;
+        }
+        // The resampler calls getNextBuffer() several times per mixer cycle: sample the fill
+        // level only at the first call of each cycle, before anything is read.
+        // The mixer reads the sample rate of the track from the control block at each cycle;
+        // no client writes it for a patch track.
+        const nsecs_t now = systemTime();
+        if (now - mBridgeUpdateNs >= mBridgeUpdatePeriodNs) {
+            mCblk->mSampleRate = mBridge->update(framesReady(), now);
+            mBridgeUpdateNs = now;
+        }
+    }
     Proxy::Buffer buf;
     buf.mFrameCount = buffer->frameCount;
     status_t status = mPeerProxy->obtainBuffer(&buf, &mPeerTimeout);
     ALOGV_IF(status != NO_ERROR, "PatchTrack() %p getNextBuffer status %d", this, status);
     buffer->frameCount = buf.mFrameCount;
     if (buf.mFrameCount == 0) {
+        if (mBridge != 0) {
+            // refill to the target level rather than underrun again at each cycle
+            mBridge->onUnderrun();
+            mBridgePrimed = false;
+        }
         return WOULD_BLOCK;
     }
     status = Track::getNextBuffer(buffer);
@@ -1607,24 +1785,24 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
                   type, portId),
         mOverflow(false),
         mFramesToDrop(0),
-        mResamplerBufferProvider(NULL), // initialize in case of early constructor exit
-        mRecordBufferConverter(NULL),
-        mFlags(flags)
+        mSharedConversionFront(0),
+        mOverruns(0),
+        mFlags(flags),
+        mFastIndex(-1)
 {
     if (mCblk == NULL) {
         return;
     }
 
-    mRecordBufferConverter = new RecordBufferConverter(
-            thread->mChannelMask, thread->mFormat, thread->mSampleRate,
-            channelMask, format, sampleRate);
-    // Check if the RecordBufferConverter construction was successful.
+    // The conversion is done by a RecordThread::SharedConversion, created by the thread loop
+    // when the track becomes active.  Check here that the conversion is supported.
     // If not, don't continue with construction.
     //
     // NOTE: It would be extremely rare that the record track cannot be created
     // for the current device, but a pending or future device change would make
     // the record track configuration valid.
-    if (mRecordBufferConverter->initCheck() != NO_ERROR) {
+    if (RecordBufferConverter(thread->mChannelMask, thread->mFormat, thread->mSampleRate,
+            channelMask, format, sampleRate).initCheck() != NO_ERROR) {
         ALOGE("RecordTrack unable to create record buffer converter");
         return;
     }
@@ -1632,19 +1810,18 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
     mServerProxy = new AudioRecordServerProxy(mCblk, mBuffer, frameCount,
             mFrameSize, !isExternalTrack());
 
-    mResamplerBufferProvider = new ResamplerBufferProvider(this);
-
     if (flags & AUDIO_INPUT_FLAG_FAST) {
-        ALOG_ASSERT(thread->mFastTrackAvail);
-        thread->mFastTrackAvail = false;
+        ALOG_ASSERT(thread->mFastTrackAvailMask != 0);
+        int i = __builtin_ctz(thread->mFastTrackAvailMask);
+        ALOG_ASSERT(i < (int)FastCaptureState::sMaxFastClients);
+        mFastIndex = i;
+        thread->mFastTrackAvailMask &= ~(1 << i);
     }
 }
 
 AudioFlinger::RecordThread::RecordTrack::~RecordTrack()
 {
     ALOGV("%s", __func__);
-    delete mRecordBufferConverter;
-    delete mResamplerBufferProvider;
 }
 
 status_t AudioFlinger::RecordThread::RecordTrack::initCheck() const
@@ -1728,14 +1905,15 @@ void AudioFlinger::RecordThread::RecordTrack::invalidate()
 
 /*static*/ void AudioFlinger::RecordThread::RecordTrack::appendDumpHeader(String8& result)
 {
-    result.append("Active Client Session S  Flags   Format Chn mask  SRate   Server FrmCnt\n");
+    result.append("Active Client Session S  Flags   Format Chn mask  SRate   Server FrmCnt"
+            " Overruns\n");
 }
 
 void AudioFlinger::RecordThread::RecordTrack::appendDump(String8& result, bool active)
 {
     result.appendFormat("%c%5s %6u %7u %2s 0x%03X "
             "%08X %08X %6u "
-            "%08X %6zu\n",
+            "%08X %6zu %8u\n",
             isFastTrack() ? 'F' : ' ',
             active ? "yes" : "no",
             (mClient == 0) ? getpid_cached : mClient->pid(),
@@ -1748,7 +1926,8 @@ void AudioFlinger::RecordThread::RecordTrack::appendDump(String8& result, bool a
             mSampleRate,
 
             mCblk->mServer,
-            mFrameCount
+            mFrameCount,
+            mOverruns
             );
 }
 
@@ -1821,6 +2000,13 @@ AudioFlinger::RecordThread::PatchRecord::~PatchRecord()
 {
 }
 
+void AudioFlinger::RecordThread::PatchRecord::enableBridge(const sp<PatchBridge>& bridge)
+{
+    mBridge = bridge;
+    mPeerTimeout.tv_sec = 0;
+    mPeerTimeout.tv_nsec = 0;
+}
+
 // AudioBufferProvider interface
 status_t AudioFlinger::RecordThread::PatchRecord::getNextBuffer(
                                                   AudioBufferProvider::Buffer* buffer)
@@ -1833,6 +2019,17 @@ status_t AudioFlinger::RecordThread::PatchRecord::getNextBuffer(
              "PatchRecord() %p mPeerProxy->obtainBuffer status %d", this, status);
     buffer->frameCount = buf.mFrameCount;
     if (buf.mFrameCount == 0) {
+        if (mBridge != 0 && mSharedConversion != 0) {
+            // The ring is full: drop the captured frames now.  Left in the shared conversion,
+            // they would be delayed by the whole conversion ring before the overrun is seen.
+            bool hasOverrun;
+            const size_t framesIn = mSharedConversion->sync(&mSharedConversionFront,
+                    &hasOverrun);
+            if (framesIn > 0) {
+                mSharedConversionFront += (int32_t) framesIn;
+                mBridge->onOverrun(framesIn);
+            }
+        }
         return WOULD_BLOCK;
     }
     status = RecordTrack::getNextBuffer(buffer);
@@ -1847,6 +2044,9 @@ void AudioFlinger::RecordThread::PatchRecord::releaseBuffer(AudioBufferProvider:
     buf.mRaw = buffer->raw;
     mPeerProxy->releaseBuffer(&buf);
     TrackBase::releaseBuffer(buffer);
+    if (mBridge != 0) {
+        mBridge->onWrite(systemTime());
+    }
 }
 
 status_t AudioFlinger::RecordThread::PatchRecord::obtainBuffer(Proxy::Buffer* buffer,
@@ -0,0 +1,56 @@
+# Build the unit tests for audioflinger
+
+LOCAL_PATH := $(call my-dir)
+
+#
+# state queue stress test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_SRC_FILES := \
+    ../StateQueue.cpp \
+    state_queue_tests.cpp \
+
+LOCAL_MODULE := state_queue_tests
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+LOCAL_CFLAGS += -DSTATE_QUEUE_DUMP
+
+LOCAL_CFLAGS += -DSTATE_QUEUE_INSTANTIATIONS='"tests/TestStateInstantiations.cpp"'
+
+include $(BUILD_NATIVE_TEST)
+
+#
+# patch bridge drift compensation test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_SRC_FILES := \
+    ../PatchBridge.cpp \
+    patch_bridge_tests.cpp \
+
+LOCAL_MODULE := patch_bridge_tests
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_TEST_STATE_H
+#define ANDROID_AUDIO_TEST_STATE_H
+
+#include <stdint.h>
+
+namespace android {
+
+// Reduced FastMixerState: a mask of active tracks with per-track generations,
+// and a checksum so that the observer can detect a state modified while it is reading it.
+struct TestState {
+    static const unsigned kMaxTracks = 32;
+
+    struct Track {
+        uint32_t mGeneration;   // incremented when the track is added or modified
+        uint32_t mValue;        // stands for the buffer provider and format of a fast track
+    };
+
+    uint32_t    mTrackMask;
+    uint32_t    mTracksGen;     // incremented when mTrackMask or any track changes
+    Track       mTracks[kMaxTracks];
+    uint32_t    mChecksum;
+
+    uint32_t computeChecksum() const {
+        uint32_t sum = mTrackMask * 31 + mTracksGen;
+        for (unsigned i = 0; i < kMaxTracks; ++i) {
+            sum = sum * 31 + mTracks[i].mGeneration;
+            sum = sum * 31 + mTracks[i].mValue;
+        }
+        return sum;
+    }
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_TEST_STATE_H
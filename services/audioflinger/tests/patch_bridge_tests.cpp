@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_patch_bridge_tests"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+
+#include "PatchBridge.h"
+
+using namespace android;
+
+// Simulates a software patch in bridge mode between two stub devices with independent clocks:
+// the record thread writes a burst into the ring each time the input device delivers one,
+// and the playback thread reads a burst each time the output device needs one, at the rate
+// given by PatchBridge, as PatchTrack::getNextBuffer() does.
+// Overruns and underruns are counted by the bridge, as for a real patch.
+class BridgeSimulation {
+public:
+    static const uint32_t kSampleRate = 48000;
+
+    BridgeSimulation(size_t recordBurst, size_t playbackBurst, double recordPpm,
+            double playbackPpm, int64_t jitterNs)
+        : mRecordBurst(recordBurst), mPlaybackBurst(playbackBurst),
+          mRecordPeriodNs(1e9 * recordBurst / (kSampleRate * (1. + recordPpm * 1e-6))),
+          mPlaybackPeriodNs(1e9 * playbackBurst / (kSampleRate * (1. + playbackPpm * 1e-6))),
+          mJitterNs(jitterNs),
+          mRingFrames(PatchBridge::ringFrameCount(recordBurst, playbackBurst)),
+          mBridge(new PatchBridge(kSampleRate, recordBurst, mRingFrames)),
+          mCompensate(true), mPrimed(false), mFill(0), mRate(kSampleRate),
+          mUnderrunsBase(0), mOverrunsBase(0), mSeed(1),
+          mNextRecordNs(0), mNextPlaybackNs(mPlaybackPeriodNs / 3) {}
+
+    void setCompensate(bool compensate) { mCompensate = compensate; }
+
+    // Runs until the given time.  Returns the mean fill level before each read and the mean
+    // correction of the read rate in ppm over that time.
+    void runUntil(int64_t endNs, double *meanFill = NULL, double *meanPpm = NULL) {
+        double fillSum = 0;
+        double rateSum = 0;
+        unsigned count = 0;
+        while (mNextRecordNs < endNs || mNextPlaybackNs < endNs) {
+            if (mNextRecordNs <= mNextPlaybackNs) {
+                record();
+                mNextRecordNs += mRecordPeriodNs;
+            } else {
+                fillSum += mFill;
+                play(mNextPlaybackNs + jitter());
+                rateSum += mRate;
+                count++;
+                mNextPlaybackNs += mPlaybackPeriodNs;
+            }
+        }
+        if (meanFill != NULL) {
+            *meanFill = count > 0 ? fillSum / count : 0;
+        }
+        if (meanPpm != NULL) {
+            *meanPpm = count > 0 ? (rateSum / count / kSampleRate - 1.) * 1e6 : 0;
+        }
+    }
+
+    PatchBridge &bridge() { return *mBridge; }
+    size_t ringFrames() const { return mRingFrames; }
+    uint32_t underruns() const { return mBridge->stats().mUnderruns - mUnderrunsBase; }
+    uint32_t overruns() const { return mBridge->stats().mOverruns - mOverrunsBase; }
+    uint32_t rate() const { return mRate; }
+    void resetCounts() {
+        const PatchBridge::Stats stats = mBridge->stats();
+        mUnderrunsBase = stats.mUnderruns;
+        mOverrunsBase = stats.mOverruns;
+    }
+
+private:
+    int64_t jitter() {
+        return mJitterNs == 0 ? 0 : rand_r(&mSeed) % mJitterNs;
+    }
+
+    // As RecordThread::threadLoop() with a PatchRecord: the frames that fit are written, then
+    // PatchRecord::getNextBuffer() finds the ring full and drops the rest of the burst.
+    void record() {
+        const double written = std::min((double) mRecordBurst, mRingFrames - mFill);
+        if (written > 0) {
+            mFill += written;
+            mBridge->onWrite(mNextRecordNs);
+        }
+        if (written < mRecordBurst) {
+            mBridge->onOverrun((size_t) (mRecordBurst - written));
+        }
+    }
+
+    void play(int64_t nowNs) {
+        if (!mPrimed) {
+            if (mFill < mBridge->targetFrames()) {
+                return;
+            }
+            mPrimed = true;
+        }
+        if (mCompensate) {
+            mRate = mBridge->update((size_t) mFill, nowNs);
+        }
+        // frames of the ring read by the resampler for a burst of the playback device
+        const double needed = (double) mPlaybackBurst * mRate / kSampleRate;
+        if (mFill < needed) {
+            mBridge->onUnderrun();
+            mPrimed = false;
+            mFill = 0;
+        } else {
+            mFill -= needed;
+        }
+    }
+
+    const size_t    mRecordBurst;
+    const size_t    mPlaybackBurst;
+    const int64_t   mRecordPeriodNs;
+    const int64_t   mPlaybackPeriodNs;
+    const int64_t   mJitterNs;
+    const size_t    mRingFrames;
+    sp<PatchBridge> mBridge;
+    bool            mCompensate;
+    bool            mPrimed;
+    double          mFill;
+    uint32_t        mRate;
+    uint32_t        mUnderrunsBase;     // counts of the bridge at the last resetCounts()
+    uint32_t        mOverrunsBase;
+    unsigned        mSeed;
+    int64_t         mNextRecordNs;
+    int64_t         mNextPlaybackNs;
+};
+
+static const int64_t kSecondNs = 1000000000LL;
+
+class PatchBridgeDriftTest : public ::testing::TestWithParam<double> {
+};
+
+// USB input at 5 ms bursts to speaker output at 20 ms bursts, with the input clock off by the
+// given amount relative to the output clock and 2 ms of scheduling jitter on playback.
+// After settling, the ring must neither underrun nor overrun and stay around its target.
+TEST_P(PatchBridgeDriftTest, compensates)
+{
+    const double driftPpm = GetParam();
+    BridgeSimulation sim(240, 960, driftPpm, 0., 2000000 /* jitterNs */);
+
+    sim.runUntil(60 * kSecondNs);
+    sim.resetCounts();
+    double meanFill;
+    double meanPpm;
+    sim.runUntil(600 * kSecondNs, &meanFill, &meanPpm);
+    const PatchBridge::Stats stats = sim.bridge().stats();
+    ALOGD("drift %.0f ppm: correction %.1f ppm, mean fill %.1f target %zu ring %zu",
+            driftPpm, meanPpm, meanFill, sim.bridge().targetFrames(), sim.ringFrames());
+
+    EXPECT_EQ(0u, sim.underruns());
+    EXPECT_EQ(0u, sim.overruns());
+    // the read rate follows the input clock
+    EXPECT_NEAR(driftPpm, meanPpm, 5.);
+    EXPECT_NEAR((double) sim.bridge().targetFrames(), meanFill, 240.);
+    EXPECT_LE(stats.mMinFrames, stats.mMaxFrames);
+    EXPECT_LE(stats.mMaxFrames, sim.ringFrames());
+}
+
+INSTANTIATE_TEST_CASE_P(PatchBridge, PatchBridgeDriftTest,
+        ::testing::Values(-300., -100., -20., 0., 20., 100., 300.));
+
+// Without compensation, the same drift makes the small ring overrun or underrun within minutes,
+// which is why bridge mode cannot simply shrink the buffer of a software patch.
+TEST(PatchBridge, uncompensatedDriftGlitches)
+{
+    BridgeSimulation fast(240, 960, 100., 0., 2000000 /* jitterNs */);
+    fast.setCompensate(false);
+    fast.runUntil(600 * kSecondNs);
+    EXPECT_GT(fast.overruns(), 0u);
+
+    BridgeSimulation slow(240, 960, -100., 0., 2000000 /* jitterNs */);
+    slow.setCompensate(false);
+    slow.runUntil(600 * kSecondNs);
+    EXPECT_GT(slow.underruns(), 0u);
+}
+
+// A record clock far above the bound of the compensation overruns the ring: the excess frames
+// are dropped, so the fill level and the latency stay bounded by the ring.
+TEST(PatchBridge, overrunsDropFrames)
+{
+    BridgeSimulation sim(240, 960, 5000., 0., 0 /* jitterNs */);
+    double meanFill;
+    sim.runUntil(60 * kSecondNs, &meanFill);
+    const PatchBridge::Stats stats = sim.bridge().stats();
+    EXPECT_GT(stats.mOverruns, 0u);
+    EXPECT_GT(stats.mFramesDropped, 0u);
+    EXPECT_LE(stats.mFramesDropped, (uint64_t) stats.mOverruns * 240);
+    EXPECT_LE(stats.mMaxFrames, sim.ringFrames());
+    EXPECT_LE(meanFill, (double) sim.ringFrames());
+}
+
+TEST(PatchBridge, correctionIsBounded)
+{
+    BridgeSimulation sim(240, 960, 5000., 0., 0 /* jitterNs */);
+    sim.runUntil(60 * kSecondNs);
+    const PatchBridge::Stats stats = sim.bridge().stats();
+    EXPECT_LE(stats.mCorrectionPpm, PatchBridge::kMaxCorrectionPpm);
+    EXPECT_LE(sim.rate(), BridgeSimulation::kSampleRate *
+            (1. + PatchBridge::kMaxCorrectionPpm * 1e-6) + 1);
+    EXPECT_GT(sim.overruns(), 0u);
+}
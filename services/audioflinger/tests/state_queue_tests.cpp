@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_state_queue_tests"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+
+#include "StateQueue.h"
+#include "TestState.h"
+
+using namespace android;
+
+// What the observer learned by diffing states the same way as FastMixer::onStateChange().
+struct ObserverView {
+    uint32_t mTrackMask = 0;
+    uint32_t mGenerations[TestState::kMaxTracks] = {};
+    uint32_t mValues[TestState::kMaxTracks] = {};
+    unsigned mStateChanges = 0;
+    unsigned mTornStates = 0;       // checksum mismatch of current or previous state
+    unsigned mBadDiffs = 0;         // added track with no value, or removed track not present
+};
+
+template <typename Q>
+static void observe(Q *q, std::atomic<bool> *done, ObserverView *view)
+{
+    const TestState *current = NULL;
+    const TestState *previous = NULL;
+    uint32_t tracksGen = 0;
+    for (;;) {
+        // read the flag before polling, so that the final poll sees the final state
+        const bool last = done->load();
+        const TestState *next = q->poll();
+        if (next != NULL && next != current) {
+            previous = current;
+            current = next;
+            ++view->mStateChanges;
+            if (current->mChecksum != current->computeChecksum()) {
+                ++view->mTornStates;
+            }
+            if (current->mTracksGen != tracksGen) {
+                const uint32_t currentMask = current->mTrackMask;
+                uint32_t removed = view->mTrackMask & ~currentMask;
+                uint32_t added = currentMask & ~view->mTrackMask;
+                uint32_t modified = currentMask & view->mTrackMask;
+                while (removed != 0) {
+                    const int i = __builtin_ctz(removed);
+                    removed &= ~(1u << i);
+                    if (view->mValues[i] == 0) {
+                        ++view->mBadDiffs;
+                    }
+                    view->mValues[i] = 0;
+                }
+                while (added != 0) {
+                    const int i = __builtin_ctz(added);
+                    added &= ~(1u << i);
+                    if (current->mTracks[i].mValue == 0) {
+                        ++view->mBadDiffs;
+                    }
+                    view->mValues[i] = current->mTracks[i].mValue;
+                    view->mGenerations[i] = current->mTracks[i].mGeneration;
+                }
+                while (modified != 0) {
+                    const int i = __builtin_ctz(modified);
+                    modified &= ~(1u << i);
+                    if (current->mTracks[i].mGeneration != view->mGenerations[i]) {
+                        view->mValues[i] = current->mTracks[i].mValue;
+                        view->mGenerations[i] = current->mTracks[i].mGeneration;
+                    }
+                }
+                view->mTrackMask = currentMask;
+                tracksGen = current->mTracksGen;
+            }
+        }
+        // the previous state must stay intact until the next state change
+        if (previous != NULL && previous->mChecksum != previous->computeChecksum()) {
+            ++view->mTornStates;
+            previous = NULL;
+        }
+        if (last) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// Randomly add, remove and modify tracks, pushing without blocking after each change.
+// Returns the number of pushes that did not complete because they would have blocked.
+template <typename Q>
+static unsigned mutate(Q *q, unsigned iterations, unsigned seed, TestState *last)
+{
+    unsigned notPushed = 0;
+    uint32_t value = 0;
+    TestState *state = q->begin();
+    memset(state, 0, sizeof(*state));
+    state->mChecksum = state->computeChecksum();
+    q->end();
+    q->push(Q::BLOCK_UNTIL_PUSHED);
+
+    for (unsigned n = 0; n < iterations; ++n) {
+        state = q->begin();
+        const unsigned i = rand_r(&seed) % TestState::kMaxTracks;
+        const uint32_t bit = 1u << i;
+        TestState::Track *track = &state->mTracks[i];
+        if (!(state->mTrackMask & bit)) {
+            state->mTrackMask |= bit;       // add
+            track->mValue = ++value;
+            track->mGeneration++;
+        } else if (rand_r(&seed) & 1) {
+            state->mTrackMask &= ~bit;      // remove
+            track->mValue = 0;
+        } else {
+            track->mValue = ++value;        // modify
+            track->mGeneration++;
+        }
+        state->mTracksGen++;
+        state->mChecksum = state->computeChecksum();
+        q->end();
+        if (!q->push(Q::BLOCK_NEVER)) {
+            ++notPushed;
+        }
+        // as the normal mixer does when it removes a fast track
+        if (n % 1000 == 999) {
+            q->push(Q::BLOCK_UNTIL_ACKED);
+        }
+    }
+
+    state = q->begin();
+    *last = *state;
+    q->end(false /*didModify*/);
+    q->push(Q::BLOCK_UNTIL_ACKED);
+    return notPushed;
+}
+
+template <typename Q>
+class StateQueueTest : public ::testing::Test {
+};
+
+typedef ::testing::Types<StateQueue<TestState>, WaitFreeStateQueue<TestState> > Queues;
+TYPED_TEST_CASE(StateQueueTest, Queues);
+
+// Rapid track add/remove with concurrent observer: the observer must never see a torn state,
+// and must end up with the same set of tracks as the mutator.
+TYPED_TEST(StateQueueTest, stress)
+{
+    static const unsigned kIterations = 200000;
+    TypeParam *q = new TypeParam();
+    StateQueueObserverDump observerDump;
+    StateQueueMutatorDump mutatorDump;
+    q->setObserverDump(&observerDump);
+    q->setMutatorDump(&mutatorDump);
+
+    std::atomic<bool> done(false);
+    ObserverView view;
+    std::thread observer(observe<TypeParam>, q, &done, &view);
+    TestState last;
+    const unsigned notPushed = mutate(q, kIterations, 42 /*seed*/, &last);
+    done.store(true);
+    observer.join();
+
+    ALOGD("state changes %u, pushes not done %u, skipped %u, overwritten %u",
+            view.mStateChanges, notPushed, observerDump.mSkippedStates,
+            mutatorDump.mPushOverwrite);
+    EXPECT_EQ(0u, view.mTornStates);
+    EXPECT_EQ(0u, view.mBadDiffs);
+    EXPECT_GT(view.mStateChanges, 0u);
+    EXPECT_EQ(last.mTrackMask, view.mTrackMask);
+    for (unsigned i = 0; i < TestState::kMaxTracks; ++i) {
+        EXPECT_EQ(last.mTracks[i].mValue, view.mValues[i]) << "track " << i;
+    }
+    delete q;
+}
+
+// Without an observer, the wait-free queue keeps accepting pushes,
+// and the next poll returns the latest one.
+TEST(WaitFreeStateQueueTest, pushNeverBlocks)
+{
+    static const unsigned kPushes = 100;
+    WaitFreeStateQueue<TestState> *q = new WaitFreeStateQueue<TestState>();
+    StateQueueObserverDump observerDump;
+    StateQueueMutatorDump mutatorDump;
+    q->setObserverDump(&observerDump);
+    q->setMutatorDump(&mutatorDump);
+
+    EXPECT_TRUE(q->poll() == NULL);
+    for (unsigned n = 1; n <= kPushes; ++n) {
+        TestState *state = q->begin();
+        state->mTracksGen = n;
+        q->end();
+        EXPECT_TRUE(q->push(WaitFreeStateQueue<TestState>::BLOCK_NEVER));
+        EXPECT_EQ(n, q->pushedGeneration());
+    }
+    EXPECT_EQ(kPushes - 1, mutatorDump.mPushOverwrite);
+    EXPECT_FALSE(q->isAcked(kPushes));
+
+    const TestState *state = q->poll();
+    ASSERT_TRUE(state != NULL);
+    EXPECT_EQ(kPushes, state->mTracksGen);
+    EXPECT_EQ(kPushes, q->observedGeneration());
+    EXPECT_TRUE(q->isAcked(kPushes));
+    EXPECT_EQ(state, q->poll());
+
+    // the previous state stays valid across the next change
+    TestState *mutating = q->begin();
+    mutating->mTracksGen = kPushes + 1;
+    q->end();
+    q->push();
+    const TestState *next = q->poll();
+    ASSERT_TRUE(next != NULL);
+    EXPECT_NE(state, next);
+    EXPECT_EQ(kPushes, state->mTracksGen);
+    EXPECT_EQ(kPushes + 1, next->mTracksGen);
+    EXPECT_EQ(0u, observerDump.mSkippedStates);
+    delete q;
+}
@@ -21,7 +21,8 @@ LOCAL_SRC_FILES:= \
     src/AudioSourceDescriptor.cpp \
     src/VolumeCurve.cpp \
     src/TypeConverter.cpp \
-    src/AudioSession.cpp
+    src/AudioSession.cpp \
+    src/OutputRoutingCache.cpp
 
 LOCAL_SHARED_LIBRARIES := \
     libcutils \
@@ -39,7 +40,9 @@ LOCAL_C_INCLUDES := \
 
 ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
 
-LOCAL_SRC_FILES += src/Serializer.cpp
+LOCAL_SRC_FILES += \
+    src/Serializer.cpp \
+    src/PolicyBlobSerializer.cpp
 
 LOCAL_SHARED_LIBRARIES += libicuuc libxml2
 
@@ -59,6 +59,8 @@ public:
     status_t checkConfig(const struct audio_gain_config *config);
 
     const struct audio_gain &getGain() const { return mGain; }
+    int getIndex() const { return mIndex; }
+    bool getUseInChannelMask() const { return mUseInChannelMask; }
 
 private:
     int               mIndex;
@@ -85,6 +85,10 @@ public:
         mIsSpeakerDrcEnabled = isSpeakerDrcEnabled;
     }
 
+    bool isSpeakerDrcEnabled() const { return mIsSpeakerDrcEnabled; }
+
+    const VolumeCurvesCollection *getVolumes() const { return mVolumeCurves; }
+
     const HwModuleCollection getHwModules() const { return mHwModules; }
 
     const DeviceVector &getAvailableInputDevices() const
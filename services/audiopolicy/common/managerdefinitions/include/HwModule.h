@@ -63,6 +63,7 @@ public:
     sp<DeviceDescriptor> getRouteSinkDevice(const sp<AudioRoute> &route) const;
     DeviceVector getRouteSourceDevices(const sp<AudioRoute> &route) const;
     void setRoutes(const AudioRouteVector &routes);
+    const AudioRouteVector &getRoutes() const { return mRoutes; }
 
     status_t addOutputProfile(const sp<IOProfile> &profile);
     status_t addInputProfile(const sp<IOProfile> &profile);
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <system/audio.h>
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+
+namespace android {
+
+/**
+ * Remembers the mixed output selected for a playback request, so that the next track
+ * with the same parameters skips the scan of the profiles and of the opened outputs.
+ *
+ * The key starts at the device chosen by the engine for the attributes of the track,
+ * because that choice also depends on the activity of the other streams.
+ * Mixed outputs are shared by all sessions, so the session is not part of the key.
+ *
+ * The entries belong to one generation of the routing configuration: the policy manager
+ * calls invalidate() whenever the available devices or the opened outputs change.
+ */
+class OutputRoutingCache
+{
+public:
+    struct Key {
+        audio_devices_t      device;
+        audio_stream_type_t  stream;
+        uint32_t             samplingRate;
+        audio_format_t       format;
+        audio_channel_mask_t channelMask;
+        audio_output_flags_t flags;
+
+        bool operator<(const Key& other) const;
+    };
+
+    OutputRoutingCache();
+
+    /**
+     * @return the output cached for this request or AUDIO_IO_HANDLE_NONE
+     */
+    audio_io_handle_t getOutput(const Key& key);
+
+    void putOutput(const Key& key, audio_io_handle_t output);
+
+    /**
+     * Forget all the entries and start a new generation.
+     */
+    void invalidate();
+
+    uint32_t getGeneration() const { return mGeneration; }
+    uint64_t getHits() const { return mHits; }
+    uint64_t getMisses() const { return mMisses; }
+    size_t size() const { return mOutputs.size(); }
+
+    status_t dump(int fd) const;
+
+private:
+    // Only a few combinations of parameters are used at the same time.
+    static const size_t kMaxEntries = 32;
+
+    KeyedVector<Key, audio_io_handle_t> mOutputs;
+    uint32_t mGeneration;
+    uint64_t mHits;
+    uint64_t mMisses;
+};
+
+}; // namespace android
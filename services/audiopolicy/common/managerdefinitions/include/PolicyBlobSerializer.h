@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "AudioPolicyConfig.h"
+#include <utils/Errors.h>
+#include <string>
+#include <vector>
+
+namespace android {
+
+// Compiled form of the audio policy configuration.
+// The modules, devices, routes and volume curves built from the XML files by PolicySerializer
+// are written to a binary blob, which is mapped and decoded on the following starts without
+// any parsing. The blob records the size and hash of each XML file it was compiled from and
+// is rejected as soon as one of them changed, so that the XML is parsed again.
+class PolicyBlobSerializer
+{
+public:
+    static const uint32_t gMagic;
+    static const uint32_t gVersion; /**< to increment when the layout of the blob changes. */
+
+    /**
+     * Compiles a configuration that was just deserialized from the XML files.
+     *
+     * @param blobFile path of the blob, replaced atomically.
+     * @param sourceFiles the XML files of the configuration, the main file first.
+     */
+    status_t serialize(const char *blobFile, const std::vector<std::string> &sourceFiles,
+                       const AudioPolicyConfig &config);
+
+    /**
+     * Loads a configuration compiled from configFile, if none of its XML files changed since.
+     *
+     * @return NO_ERROR if the configuration was loaded, NAME_NOT_FOUND if there is no blob,
+     *         BAD_VALUE if the blob is stale, corrupted or of another version.
+     *         The configuration is only modified on success.
+     */
+    status_t deserialize(const char *blobFile, const char *configFile,
+                         AudioPolicyConfig &config);
+};
+
+}; // namespace android
@@ -23,6 +23,7 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 struct _xmlNode;
 struct _xmlDoc;
@@ -225,11 +226,15 @@ public:
     PolicySerializer();
     status_t deserialize(const char *str, AudioPolicyConfig &config);
 
+    /** The main file and the files it includes, as read by the last call to deserialize. */
+    const std::vector<std::string> &getSourceFiles() const { return mSourceFiles; }
+
 private:
     typedef AudioPolicyConfig Element;
 
     std::string mRootElementName;
     std::string mVersion;
+    std::vector<std::string> mSourceFiles;
 
     // Children are: ModulesTraits, VolumeTraits
 };
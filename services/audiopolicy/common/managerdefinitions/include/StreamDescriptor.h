@@ -21,6 +21,7 @@
 #include <utils/StrongPointer.h>
 #include <utils/SortedVector.h>
 #include <system/audio.h>
+#include <vector>
 
 namespace android {
 
@@ -52,8 +53,15 @@ public:
         return mVolumeCurve[deviceCategory];
     }
 
+    // Uses a table of the attenuation of every index compiled from the curve when first needed.
+    float volIndexToDb(device_category deviceCategory, int indexInUi) const;
+
 private:
+    void clearDbTables();
+
     const VolumeCurvePoint *mVolumeCurve[DEVICE_CATEGORY_CNT];
+    /** attenuation in dB per index from mIndexMin to mIndexMax, per device category. */
+    mutable std::vector<float> mDbTables[DEVICE_CATEGORY_CNT];
     KeyedVector<audio_devices_t, int> mIndexCur; /**< current volume index per device. */
     int mIndexMin; /**< min volume index. */
     int mIndexMax; /**< max volume index. */
@@ -26,6 +26,7 @@
 #include <cutils/config_utils.h>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -56,6 +57,7 @@ public:
     audio_stream_type_t getStreamType() const { return mStreamType; }
 
     void add(const CurvePoint &point) { mCurvePoints.add(point); }
+    const SortedVector<CurvePoint> &getCurvePoints() const { return mCurvePoints; }
 
     float volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const;
 
@@ -98,10 +100,18 @@ public:
     void clearCurrentVolumeIndex() { mIndexCur.clear(); }
     void addCurrentVolumeIndex(audio_devices_t device, int index) { mIndexCur.add(device, index); }
 
-    void setVolumeIndexMin(int volIndexMin) { mIndexMin = volIndexMin; }
+    void setVolumeIndexMin(int volIndexMin)
+    {
+        mIndexMin = volIndexMin;
+        clearDbTables();
+    }
     int getVolumeIndexMin() const { return mIndexMin; }
 
-    void setVolumeIndexMax(int volIndexMax) { mIndexMax = volIndexMax; }
+    void setVolumeIndexMax(int volIndexMax)
+    {
+        mIndexMax = volIndexMax;
+        clearDbTables();
+    }
     int getVolumeIndexMax() const { return mIndexMax; }
 
     bool hasVolumeIndexForDevice(audio_devices_t device) const
@@ -119,6 +129,7 @@ public:
     {
         ALOG_ASSERT(indexOfKey(deviceCategory) >= 0, "Invalid device category for Volume Curve");
         replaceValueFor(deviceCategory, volumeCurve);
+        mDbTables[deviceCategory].clear();
     }
 
     ssize_t add(const sp<VolumeCurve> &volumeCurve)
@@ -128,19 +139,28 @@ public:
         if (index < 0) {
             // Keep track of original Volume Curves per device category in order to switch curves.
             mOriginVolumeCurves.add(deviceCategory, volumeCurve);
+            mDbTables[deviceCategory].clear();
             return KeyedVector::add(deviceCategory, volumeCurve);
         }
         return index;
     }
 
-    float volIndexToDb(device_category deviceCat, int indexInUi) const
-    {
-        return getCurvesFor(deviceCat)->volIndexToDb(indexInUi, mIndexMin, mIndexMax);
-    }
+    // Uses a table of the attenuation of every index compiled from the curve when first needed,
+    // so that only the indexes out of the range of the stream are interpolated.
+    float volIndexToDb(device_category deviceCat, int indexInUi) const;
 
     void dump(int fd, int spaces, bool curvePoints = false) const;
 
 private:
+    void clearDbTables()
+    {
+        for (size_t i = 0; i < DEVICE_CATEGORY_CNT; i++) {
+            mDbTables[i].clear();
+        }
+    }
+
+    /** attenuation in dB per index from mIndexMin to mIndexMax, per device category. */
+    mutable std::vector<float> mDbTables[DEVICE_CATEGORY_CNT];
     KeyedVector<device_category, sp<VolumeCurve> > mOriginVolumeCurves;
     KeyedVector<audio_devices_t, int> mIndexCur; /**< current volume index per device. */
     int mIndexMin; /**< min volume index. */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::OutputRoutingCache"
+//#define LOG_NDEBUG 0
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+#include "OutputRoutingCache.h"
+
+namespace android {
+
+bool OutputRoutingCache::Key::operator<(const Key& other) const
+{
+    if (device != other.device) {
+        return device < other.device;
+    }
+    if (stream != other.stream) {
+        return stream < other.stream;
+    }
+    if (samplingRate != other.samplingRate) {
+        return samplingRate < other.samplingRate;
+    }
+    if (format != other.format) {
+        return format < other.format;
+    }
+    if (channelMask != other.channelMask) {
+        return channelMask < other.channelMask;
+    }
+    return flags < other.flags;
+}
+
+OutputRoutingCache::OutputRoutingCache()
+    : mGeneration(1), mHits(0), mMisses(0)
+{
+}
+
+audio_io_handle_t OutputRoutingCache::getOutput(const Key& key)
+{
+    ssize_t index = mOutputs.indexOfKey(key);
+    if (index < 0) {
+        mMisses++;
+        return AUDIO_IO_HANDLE_NONE;
+    }
+    mHits++;
+    return mOutputs.valueAt(index);
+}
+
+void OutputRoutingCache::putOutput(const Key& key, audio_io_handle_t output)
+{
+    if (mOutputs.size() >= kMaxEntries) {
+        ALOGV("putOutput() cache full, starting over");
+        mOutputs.clear();
+    }
+    mOutputs.add(key, output);
+}
+
+void OutputRoutingCache::invalidate()
+{
+    mOutputs.clear();
+    mGeneration++;
+}
+
+status_t OutputRoutingCache::dump(int fd) const
+{
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    String8 result;
+
+    uint64_t lookups = mHits + mMisses;
+    snprintf(buffer, SIZE, "\nOutput Routing Cache:\n"
+             " generation %u, %zu entries, %" PRIu64 " hits, %" PRIu64 " misses"
+             " (%.1f%% hit rate)\n",
+             mGeneration, mOutputs.size(), mHits, mMisses,
+             lookups > 0 ? 100.0 * mHits / lookups : 0.0);
+    result.append(buffer);
+    for (size_t i = 0; i < mOutputs.size(); i++) {
+        const Key& key = mOutputs.keyAt(i);
+        snprintf(buffer, SIZE, "  device %08x stream %d rate %u format %08x mask %08x"
+                 " flags %08x -> output %d\n",
+                 key.device, key.stream, key.samplingRate, key.format, key.channelMask,
+                 key.flags, mOutputs.valueAt(i));
+        result.append(buffer);
+    }
+    write(fd, result.string(), result.size());
+    return NO_ERROR;
+}
+
+}; //namespace android
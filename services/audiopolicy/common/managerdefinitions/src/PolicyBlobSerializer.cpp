@@ -0,0 +1,658 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::PolicyBlobSerializer"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+#include "PolicyBlobSerializer.h"
+
+namespace android {
+
+const uint32_t PolicyBlobSerializer::gMagic = 0x42435041; // "APCB"
+const uint32_t PolicyBlobSerializer::gVersion = 1;
+
+// Layout of the blob, all values in the native byte order as it never leaves the device:
+//   header
+//   source files: path, size and hash of each, the main configuration file first
+//   modules: name, HAL version, mix ports, device ports, routes, attached and default devices
+//   volume curves
+//   speaker DRC
+// The routes and the devices refer to the ports of their module by index, the mix ports being
+// numbered first, outputs then inputs, followed by the device ports.
+struct BlobHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; /**< size of the body following the header. */
+    uint32_t reserved;
+    uint64_t hash; /**< hash of the body. */
+};
+
+static const uint32_t kNoIndex = UINT32_MAX;
+
+enum {
+    DYNAMIC_FORMAT = 0x1,
+    DYNAMIC_CHANNELS = 0x2,
+    DYNAMIC_RATE = 0x4,
+};
+
+// 64 bit FNV-1a.
+static uint64_t hashBytes(const uint8_t *data, size_t size,
+                          uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static status_t hashFile(const char *path, uint64_t &size, uint64_t &hash)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+    uint8_t buffer[4096];
+    ssize_t count;
+    size = 0;
+    hash = hashBytes(NULL, 0);
+    while ((count = TEMP_FAILURE_RETRY(read(fd, buffer, sizeof(buffer)))) > 0) {
+        hash = hashBytes(buffer, count, hash);
+        size += count;
+    }
+    close(fd);
+    return count < 0 ? UNKNOWN_ERROR : NO_ERROR;
+}
+
+static bool writeFully(int fd, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    while (size > 0) {
+        ssize_t count = TEMP_FAILURE_RETRY(write(fd, bytes, size));
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+class BlobWriter
+{
+public:
+    void writeUint32(uint32_t value) { write(&value, sizeof(value)); }
+    void writeInt32(int32_t value) { write(&value, sizeof(value)); }
+    void writeUint64(uint64_t value) { write(&value, sizeof(value)); }
+    void writeString(const char *value)
+    {
+        uint32_t length = strlen(value);
+        writeUint32(length);
+        write(value, length);
+    }
+
+    const std::vector<uint8_t> &getData() const { return mData; }
+
+private:
+    void write(const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        mData.insert(mData.end(), bytes, bytes + size);
+    }
+
+    std::vector<uint8_t> mData;
+};
+
+// Reads the body of a mapped blob. Reading past the end sets an error, reported by hasError(),
+// and returns zeros from then on.
+class BlobReader
+{
+public:
+    BlobReader(const uint8_t *data, size_t size) :
+        mData(data), mSize(size), mOffset(0), mError(false) {}
+
+    uint32_t readUint32()
+    {
+        uint32_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+    int32_t readInt32()
+    {
+        int32_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+    uint64_t readUint64()
+    {
+        uint64_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+    String8 readString8()
+    {
+        uint32_t length = readUint32();
+        if (!check(length)) {
+            return String8();
+        }
+        String8 value(reinterpret_cast<const char *>(mData + mOffset), length);
+        mOffset += length;
+        return value;
+    }
+    // Every element takes at least a byte, which bounds the count of a corrupted blob.
+    uint32_t readCount()
+    {
+        uint32_t count = readUint32();
+        return check(count) ? count : 0;
+    }
+
+    bool hasError() const { return mError; }
+    bool atEnd() const { return mOffset == mSize; }
+
+private:
+    bool check(size_t size)
+    {
+        if (mError || size > mSize - mOffset) {
+            mError = true;
+            return false;
+        }
+        return true;
+    }
+    void read(void *value, size_t size)
+    {
+        if (check(size)) {
+            memcpy(value, mData + mOffset, size);
+            mOffset += size;
+        }
+    }
+
+    const uint8_t *mData;
+    const size_t mSize;
+    size_t mOffset;
+    bool mError;
+};
+
+static void writeProfiles(BlobWriter &writer, const AudioProfileVector &profiles)
+{
+    writer.writeUint32(profiles.size());
+    for (size_t i = 0; i < profiles.size(); i++) {
+        const sp<AudioProfile> &profile = profiles[i];
+        writer.writeUint32(profile->getFormat());
+        const ChannelsVector &channels = profile->getChannels();
+        writer.writeUint32(channels.size());
+        for (size_t j = 0; j < channels.size(); j++) {
+            writer.writeUint32(channels[j]);
+        }
+        const SampleRateVector &rates = profile->getSampleRates();
+        writer.writeUint32(rates.size());
+        for (size_t j = 0; j < rates.size(); j++) {
+            writer.writeUint32(rates[j]);
+        }
+        writer.writeUint32((profile->isDynamicFormat() ? DYNAMIC_FORMAT : 0) |
+                           (profile->isDynamicChannels() ? DYNAMIC_CHANNELS : 0) |
+                           (profile->isDynamicRate() ? DYNAMIC_RATE : 0));
+    }
+}
+
+static void readProfiles(BlobReader &reader, AudioProfileVector &profiles)
+{
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        audio_format_t format = static_cast<audio_format_t>(reader.readUint32());
+        ChannelsVector channels;
+        for (uint32_t n = reader.readCount(); n > 0 && !reader.hasError(); n--) {
+            channels.add(static_cast<audio_channel_mask_t>(reader.readUint32()));
+        }
+        SampleRateVector rates;
+        for (uint32_t n = reader.readCount(); n > 0 && !reader.hasError(); n--) {
+            rates.add(reader.readUint32());
+        }
+        uint32_t dynamic = reader.readUint32();
+        sp<AudioProfile> profile = new AudioProfile(format, channels, rates);
+        profile->setDynamicFormat((dynamic & DYNAMIC_FORMAT) != 0);
+        profile->setDynamicChannels((dynamic & DYNAMIC_CHANNELS) != 0);
+        profile->setDynamicRate((dynamic & DYNAMIC_RATE) != 0);
+        profiles.add(profile);
+    }
+}
+
+static void writeGains(BlobWriter &writer, const AudioGainCollection &gains)
+{
+    writer.writeUint32(gains.size());
+    for (size_t i = 0; i < gains.size(); i++) {
+        const sp<AudioGain> &gain = gains[i];
+        const struct audio_gain &values = gain->getGain();
+        writer.writeInt32(gain->getIndex());
+        writer.writeUint32(gain->getUseInChannelMask());
+        writer.writeUint32(values.mode);
+        writer.writeUint32(values.channel_mask);
+        writer.writeInt32(values.min_value);
+        writer.writeInt32(values.max_value);
+        writer.writeInt32(values.default_value);
+        writer.writeUint32(values.step_value);
+        writer.writeUint32(values.min_ramp_ms);
+        writer.writeUint32(values.max_ramp_ms);
+    }
+}
+
+static void readGains(BlobReader &reader, AudioGainCollection &gains)
+{
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        int index = reader.readInt32();
+        bool useInChannelMask = reader.readUint32() != 0;
+        sp<AudioGain> gain = new AudioGain(index, useInChannelMask);
+        gain->setMode(static_cast<audio_gain_mode_t>(reader.readUint32()));
+        gain->setChannelMask(static_cast<audio_channel_mask_t>(reader.readUint32()));
+        gain->setMinValueInMb(reader.readInt32());
+        gain->setMaxValueInMb(reader.readInt32());
+        gain->setDefaultValueInMb(reader.readInt32());
+        gain->setStepValueInMb(reader.readUint32());
+        gain->setMinRampInMs(reader.readUint32());
+        gain->setMaxRampInMs(reader.readUint32());
+        gains.add(gain);
+    }
+}
+
+static uint32_t indexOfPort(const AudioPortVector &ports, const sp<AudioPort> &port)
+{
+    for (size_t i = 0; i < ports.size(); i++) {
+        if (ports[i] == port) {
+            return i;
+        }
+    }
+    return kNoIndex;
+}
+
+static status_t writeModule(BlobWriter &writer, const sp<HwModule> &module,
+                            const AudioPolicyConfig &config)
+{
+    writer.writeString(module->getName());
+    writer.writeUint32(module->getHalVersionMajor());
+    writer.writeUint32(module->getHalVersionMinor());
+
+    AudioPortVector ports;
+    IOProfileCollection mixPorts;
+    mixPorts.appendVector(module->getOutputProfiles());
+    mixPorts.appendVector(module->getInputProfiles());
+    writer.writeUint32(mixPorts.size());
+    for (size_t i = 0; i < mixPorts.size(); i++) {
+        const sp<IOProfile> &mixPort = mixPorts[i];
+        writer.writeString(mixPort->getName().string());
+        writer.writeUint32(mixPort->getRole());
+        writer.writeUint32(mixPort->getFlags());
+        writeProfiles(writer, mixPort->getAudioProfiles());
+        writeGains(writer, mixPort->getGains());
+        ports.add(mixPort);
+    }
+
+    const DeviceVector &devices = module->getDeclaredDevices();
+    uint32_t defaultOutputDevice = kNoIndex;
+    std::vector<uint32_t> attachedDevices;
+    writer.writeUint32(devices.size());
+    for (size_t i = 0; i < devices.size(); i++) {
+        const sp<DeviceDescriptor> &device = devices[i];
+        writer.writeUint32(device->type());
+        writer.writeString(device->getTagName().string());
+        writer.writeString(device->mAddress.string());
+        writeProfiles(writer, device->getAudioProfiles());
+        writeGains(writer, device->getGains());
+        ports.add(device);
+
+        if (config.getAvailableOutputDevices().indexOf(device) >= 0 ||
+                config.getAvailableInputDevices().indexOf(device) >= 0) {
+            attachedDevices.push_back(i);
+        }
+        if (device == config.getDefaultOutputDevice()) {
+            defaultOutputDevice = i;
+        }
+    }
+
+    const AudioRouteVector &routes = module->getRoutes();
+    writer.writeUint32(routes.size());
+    for (size_t i = 0; i < routes.size(); i++) {
+        const sp<AudioRoute> &route = routes[i];
+        uint32_t sink = indexOfPort(ports, route->getSink());
+        if (sink == kNoIndex) {
+            ALOGE("%s: sink of route %zu of module %s not declared", __FUNCTION__, i,
+                  module->getName());
+            return BAD_VALUE;
+        }
+        writer.writeUint32(route->getType());
+        writer.writeUint32(sink);
+        const AudioPortVector &sources = route->getSources();
+        writer.writeUint32(sources.size());
+        for (size_t j = 0; j < sources.size(); j++) {
+            uint32_t source = indexOfPort(ports, sources[j]);
+            if (source == kNoIndex) {
+                ALOGE("%s: source of route %zu of module %s not declared", __FUNCTION__, i,
+                      module->getName());
+                return BAD_VALUE;
+            }
+            writer.writeUint32(source);
+        }
+    }
+
+    writer.writeUint32(attachedDevices.size());
+    for (uint32_t device : attachedDevices) {
+        writer.writeUint32(device);
+    }
+    writer.writeUint32(defaultOutputDevice);
+    return NO_ERROR;
+}
+
+// Builds the module the same way as ModuleTraits::deserialize().
+static status_t readModule(BlobReader &reader, sp<HwModule> &module,
+                           Vector<sp<DeviceDescriptor> > &attachedDevices,
+                           sp<DeviceDescriptor> &defaultOutputDevice)
+{
+    String8 name = reader.readString8();
+    uint32_t versionMajor = reader.readUint32();
+    uint32_t versionMinor = reader.readUint32();
+    module = new HwModule(name.string(), versionMajor, versionMinor);
+
+    AudioPortVector ports;
+    IOProfileCollection mixPorts;
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        String8 portName = reader.readString8();
+        audio_port_role_t role = static_cast<audio_port_role_t>(reader.readUint32());
+        uint32_t flags = reader.readUint32();
+        sp<IOProfile> mixPort = new IOProfile(portName, role);
+        AudioProfileVector profiles;
+        readProfiles(reader, profiles);
+        mixPort->setAudioProfiles(profiles);
+        mixPort->setFlags(flags);
+        AudioGainCollection gains;
+        readGains(reader, gains);
+        mixPort->setGains(gains);
+        mixPorts.add(mixPort);
+        ports.add(mixPort);
+    }
+
+    Vector<sp<DeviceDescriptor> > deviceList;
+    DeviceVector devices;
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        audio_devices_t type = static_cast<audio_devices_t>(reader.readUint32());
+        String8 tagName = reader.readString8();
+        sp<DeviceDescriptor> device = new DeviceDescriptor(type, tagName);
+        device->mAddress = reader.readString8();
+        AudioProfileVector profiles;
+        readProfiles(reader, profiles);
+        device->setAudioProfiles(profiles);
+        readGains(reader, device->mGains);
+        deviceList.add(device);
+        devices.add(device);
+        ports.add(device);
+    }
+    if (reader.hasError()) {
+        return BAD_VALUE;
+    }
+    module->setProfiles(mixPorts);
+    module->setDeclaredDevices(devices);
+
+    AudioRouteVector routes;
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        sp<AudioRoute> route = new AudioRoute(static_cast<audio_route_type_t>(reader.readUint32()));
+        uint32_t sink = reader.readUint32();
+        AudioPortVector sources;
+        for (uint32_t n = reader.readCount(); n > 0 && !reader.hasError(); n--) {
+            uint32_t source = reader.readUint32();
+            if (source >= ports.size()) {
+                return BAD_VALUE;
+            }
+            sources.add(ports[source]);
+        }
+        if (sink >= ports.size()) {
+            return BAD_VALUE;
+        }
+        route->setSink(ports[sink]);
+        ports[sink]->addRoute(route);
+        for (size_t i = 0; i < sources.size(); i++) {
+            sources[i]->addRoute(route);
+        }
+        route->setSources(sources);
+        routes.add(route);
+    }
+    module->setRoutes(routes);
+
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        uint32_t device = reader.readUint32();
+        if (device >= deviceList.size()) {
+            return BAD_VALUE;
+        }
+        attachedDevices.add(deviceList[device]);
+    }
+    uint32_t device = reader.readUint32();
+    if (device != kNoIndex) {
+        if (device >= deviceList.size()) {
+            return BAD_VALUE;
+        }
+        if (defaultOutputDevice == 0) {
+            defaultOutputDevice = deviceList[device];
+        }
+    }
+    return reader.hasError() ? BAD_VALUE : NO_ERROR;
+}
+
+static void writeVolumes(BlobWriter &writer, const VolumeCurvesCollection *volumes)
+{
+    Vector<sp<VolumeCurve> > curves;
+    for (size_t i = 0; volumes != nullptr && i < volumes->size(); i++) {
+        const VolumeCurvesForStream &streamCurves = volumes->valueAt(i);
+        for (size_t j = 0; j < streamCurves.size(); j++) {
+            curves.add(streamCurves.valueAt(j));
+        }
+    }
+    writer.writeUint32(curves.size());
+    for (size_t i = 0; i < curves.size(); i++) {
+        writer.writeUint32(curves[i]->getStreamType());
+        writer.writeUint32(curves[i]->getDeviceCategory());
+        const SortedVector<CurvePoint> &points = curves[i]->getCurvePoints();
+        writer.writeUint32(points.size());
+        for (size_t j = 0; j < points.size(); j++) {
+            writer.writeUint32(points[j].mIndex);
+            writer.writeInt32(points[j].mAttenuationInMb);
+        }
+    }
+}
+
+static status_t readVolumes(BlobReader &reader, VolumeCurvesCollection &volumes)
+{
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        uint32_t stream = reader.readUint32();
+        uint32_t deviceCategory = reader.readUint32();
+        if (stream >= AUDIO_STREAM_CNT || deviceCategory >= DEVICE_CATEGORY_CNT) {
+            return BAD_VALUE;
+        }
+        sp<VolumeCurve> curve = new VolumeCurve(static_cast<device_category>(deviceCategory),
+                                                static_cast<audio_stream_type_t>(stream));
+        for (uint32_t n = reader.readCount(); n > 0 && !reader.hasError(); n--) {
+            uint32_t index = reader.readUint32();
+            curve->add(CurvePoint(index, reader.readInt32()));
+        }
+        volumes.add(curve);
+    }
+    return reader.hasError() ? BAD_VALUE : NO_ERROR;
+}
+
+status_t PolicyBlobSerializer::serialize(const char *blobFile,
+                                         const std::vector<std::string> &sourceFiles,
+                                         const AudioPolicyConfig &config)
+{
+    BlobWriter writer;
+    writer.writeUint32(sourceFiles.size());
+    for (const std::string &sourceFile : sourceFiles) {
+        uint64_t size;
+        uint64_t hash;
+        if (hashFile(sourceFile.c_str(), size, hash) != NO_ERROR) {
+            ALOGE("%s: could not read %s", __FUNCTION__, sourceFile.c_str());
+            return BAD_VALUE;
+        }
+        writer.writeString(sourceFile.c_str());
+        writer.writeUint64(size);
+        writer.writeUint64(hash);
+    }
+
+    const HwModuleCollection modules = config.getHwModules();
+    writer.writeUint32(modules.size());
+    for (size_t i = 0; i < modules.size(); i++) {
+        status_t status = writeModule(writer, modules[i], config);
+        if (status != NO_ERROR) {
+            return status;
+        }
+    }
+    writeVolumes(writer, config.getVolumes());
+    writer.writeUint32(config.isSpeakerDrcEnabled());
+
+    const std::vector<uint8_t> &body = writer.getData();
+    BlobHeader header = {};
+    header.magic = gMagic;
+    header.version = gVersion;
+    header.size = body.size();
+    header.hash = hashBytes(body.data(), body.size());
+
+    // Written aside and renamed, so that a partially written blob is never loaded.
+    std::string tmpFile = std::string(blobFile) + ".tmp";
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGW("%s: could not create %s: %s", __FUNCTION__, tmpFile.c_str(), strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    bool written = writeFully(fd, &header, sizeof(header)) &&
+            writeFully(fd, body.data(), body.size()) && fsync(fd) == 0;
+    close(fd);
+    if (!written || rename(tmpFile.c_str(), blobFile) != 0) {
+        ALOGW("%s: could not write %s: %s", __FUNCTION__, blobFile, strerror(errno));
+        unlink(tmpFile.c_str());
+        return UNKNOWN_ERROR;
+    }
+    ALOGI("%s: compiled %s into %s, %zu bytes", __FUNCTION__, sourceFiles[0].c_str(), blobFile,
+          sizeof(header) + body.size());
+    return NO_ERROR;
+}
+
+static status_t decodeBlob(const uint8_t *data, size_t size, const char *configFile,
+                           AudioPolicyConfig &config)
+{
+    BlobHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != PolicyBlobSerializer::gMagic ||
+            header.version != PolicyBlobSerializer::gVersion) {
+        ALOGI("%s: version %u, expected %u", __FUNCTION__, header.version,
+              PolicyBlobSerializer::gVersion);
+        return BAD_VALUE;
+    }
+    if (header.size != size - sizeof(header) ||
+            hashBytes(data + sizeof(header), header.size) != header.hash) {
+        ALOGE("%s: corrupted", __FUNCTION__);
+        return BAD_VALUE;
+    }
+    BlobReader reader(data + sizeof(header), header.size);
+
+    uint32_t numSourceFiles = reader.readCount();
+    if (numSourceFiles == 0) {
+        return BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < numSourceFiles && !reader.hasError(); i++) {
+        String8 sourceFile = reader.readString8();
+        uint64_t expectedSize = reader.readUint64();
+        uint64_t expectedHash = reader.readUint64();
+        if (i == 0 && sourceFile != configFile) {
+            ALOGI("%s: compiled from %s instead of %s", __FUNCTION__, sourceFile.string(),
+                  configFile);
+            return BAD_VALUE;
+        }
+        uint64_t sourceSize;
+        uint64_t sourceHash;
+        if (hashFile(sourceFile.string(), sourceSize, sourceHash) != NO_ERROR ||
+                sourceSize != expectedSize || sourceHash != expectedHash) {
+            ALOGI("%s: %s changed", __FUNCTION__, sourceFile.string());
+            return BAD_VALUE;
+        }
+    }
+
+    HwModuleCollection modules;
+    Vector<sp<DeviceDescriptor> > attachedDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    for (uint32_t count = reader.readCount(); count > 0 && !reader.hasError(); count--) {
+        sp<HwModule> module;
+        if (readModule(reader, module, attachedDevices, defaultOutputDevice) != NO_ERROR) {
+            ALOGE("%s: invalid module", __FUNCTION__);
+            return BAD_VALUE;
+        }
+        modules.add(module);
+    }
+    VolumeCurvesCollection volumes;
+    if (readVolumes(reader, volumes) != NO_ERROR) {
+        ALOGE("%s: invalid volume curves", __FUNCTION__);
+        return BAD_VALUE;
+    }
+    bool speakerDrcEnabled = reader.readUint32() != 0;
+    if (reader.hasError() || !reader.atEnd()) {
+        ALOGE("%s: truncated", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    config.setHwModules(modules);
+    for (size_t i = 0; i < attachedDevices.size(); i++) {
+        config.addAvailableDevice(attachedDevices[i]);
+    }
+    if (defaultOutputDevice != 0 && config.getDefaultOutputDevice() == 0) {
+        config.setDefaultOutputDevice(defaultOutputDevice);
+    }
+    config.setVolumes(volumes);
+    config.setSpeakerDrcEnabled(speakerDrcEnabled);
+    return NO_ERROR;
+}
+
+status_t PolicyBlobSerializer::deserialize(const char *blobFile, const char *configFile,
+                                           AudioPolicyConfig &config)
+{
+    int fd = open(blobFile, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGV("%s: no %s", __FUNCTION__, blobFile);
+        return NAME_NOT_FOUND;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(BlobHeader)) {
+        close(fd);
+        ALOGE("%s: invalid %s", __FUNCTION__, blobFile);
+        return BAD_VALUE;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: could not map %s: %s", __FUNCTION__, blobFile, strerror(errno));
+        return BAD_VALUE;
+    }
+    status_t status = decodeBlob(static_cast<const uint8_t *>(data), st.st_size, configFile,
+                                 config);
+    munmap(data, st.st_size);
+    ALOGV("%s: %s status %d", __FUNCTION__, blobFile, status);
+    return status;
+}
+
+}; // namespace android
@@ -21,6 +21,7 @@
 #include <media/convert.h>
 #include "TypeConverter.h"
 #include <libxml/parser.h>
+#include <libxml/uri.h>
 #include <libxml/xinclude.h>
 #include <string>
 #include <sstream>
@@ -577,6 +578,25 @@ status_t VolumeTraits::deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElemen
     return NO_ERROR;
 }
 
+// The include elements are kept as XINCLUDE_START nodes before the content they included.
+static void getIncludedFiles(xmlDocPtr doc, xmlNodePtr node, std::vector<string> &files)
+{
+    for (; node != NULL; node = node->next) {
+        if (node->type == XML_XINCLUDE_START) {
+            string href = getXmlAttribute(node, "href");
+            xmlChar *base = xmlNodeGetBase(doc, node);
+            xmlChar *uri = xmlBuildURI((const xmlChar *)href.c_str(), base);
+            if (uri != NULL) {
+                files.push_back((const char *)uri);
+                xmlFree(uri);
+            }
+            xmlFree(base);
+        } else if (node->type == XML_ELEMENT_NODE) {
+            getIncludedFiles(doc, node->children, files);
+        }
+    }
+}
+
 PolicySerializer::PolicySerializer() : mRootElementName(rootName)
 {
     std::ostringstream oss;
@@ -602,6 +622,8 @@ status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig
     if (xmlXIncludeProcess(doc) < 0) {
          ALOGE("%s: libxml failed to resolve XIncludes on %s document.", __FUNCTION__, configFile);
     }
+    mSourceFiles.assign(1, configFile);
+    getIncludedFiles(doc, cur->children, mSourceFiles);
 
     if (xmlStrcmp(cur->name, (const xmlChar *) mRootElementName.c_str()))  {
         ALOGE("%s: No %s root element found in xml data %s.", __FUNCTION__, mRootElementName.c_str(),
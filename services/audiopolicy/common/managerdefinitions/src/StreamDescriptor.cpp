@@ -66,17 +66,43 @@ void StreamDescriptor::addCurrentVolumeIndex(audio_devices_t device, int index)
 void StreamDescriptor::setVolumeIndexMin(int volIndexMin)
 {
     mIndexMin = volIndexMin;
+    clearDbTables();
 }
 
 void StreamDescriptor::setVolumeIndexMax(int volIndexMax)
 {
     mIndexMax = volIndexMax;
+    clearDbTables();
 }
 
 void StreamDescriptor::setVolumeCurvePoint(device_category deviceCategory,
                                            const VolumeCurvePoint *point)
 {
     mVolumeCurve[deviceCategory] = point;
+    mDbTables[deviceCategory].clear();
+}
+
+void StreamDescriptor::clearDbTables()
+{
+    for (size_t i = 0; i < DEVICE_CATEGORY_CNT; i++) {
+        mDbTables[i].clear();
+    }
+}
+
+float StreamDescriptor::volIndexToDb(device_category deviceCategory, int indexInUi) const
+{
+    const VolumeCurvePoint *curve = mVolumeCurve[deviceCategory];
+    if (indexInUi < mIndexMin || indexInUi > mIndexMax) {
+        return Gains::volIndexToDb(curve, mIndexMin, mIndexMax, indexInUi);
+    }
+    std::vector<float> &dbTable = mDbTables[deviceCategory];
+    if (dbTable.empty()) {
+        dbTable.reserve(mIndexMax - mIndexMin + 1);
+        for (int index = mIndexMin; index <= mIndexMax; index++) {
+            dbTable.push_back(Gains::volIndexToDb(curve, mIndexMin, mIndexMax, index));
+        }
+    }
+    return dbTable[indexInUi - mIndexMin];
 }
 
 void StreamDescriptor::dump(int fd) const
@@ -148,10 +174,7 @@ void StreamDescriptorCollection::setVolumeIndexMax(audio_stream_type_t stream,in
 float StreamDescriptorCollection::volIndexToDb(audio_stream_type_t stream, device_category category,
                                                int indexInUi) const
 {
-    const StreamDescriptor &streamDesc = valueAt(stream);
-    return Gains::volIndexToDb(streamDesc.getVolumeCurvePoint(category),
-                               streamDesc.getVolumeIndexMin(), streamDesc.getVolumeIndexMax(),
-                               indexInUi);
+    return valueAt(stream).volIndexToDb(category, indexInUi);
 }
 
 status_t StreamDescriptorCollection::initStreamVolume(audio_stream_type_t stream,
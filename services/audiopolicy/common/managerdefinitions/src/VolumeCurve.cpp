@@ -61,6 +61,23 @@ float VolumeCurve::volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax)
     return decibels;
 }
 
+float VolumeCurvesForStream::volIndexToDb(device_category deviceCat, int indexInUi) const
+{
+    ALOG_ASSERT(deviceCat < DEVICE_CATEGORY_CNT, "Invalid device category");
+    if (indexInUi < mIndexMin || indexInUi > mIndexMax) {
+        return getCurvesFor(deviceCat)->volIndexToDb(indexInUi, mIndexMin, mIndexMax);
+    }
+    std::vector<float> &dbTable = mDbTables[deviceCat];
+    if (dbTable.empty()) {
+        const sp<VolumeCurve> curve = getCurvesFor(deviceCat);
+        dbTable.reserve(mIndexMax - mIndexMin + 1);
+        for (int index = mIndexMin; index <= mIndexMax; index++) {
+            dbTable.push_back(curve->volIndexToDb(index, mIndexMin, mIndexMax));
+        }
+    }
+    return dbTable[indexInUi - mIndexMin];
+}
+
 void VolumeCurve::dump(int fd) const
 {
     const size_t SIZE = 256;
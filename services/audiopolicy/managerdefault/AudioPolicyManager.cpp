@@ -29,6 +29,7 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <unistd.h>
 
 #include <AudioPolicyManagerInterface.h>
 #include <AudioPolicyEngineInstance.h>
@@ -45,6 +46,7 @@
 #include <ConfigParsingUtils.h>
 #include <StreamDescriptor.h>
 #endif
+#include <PolicyBlobSerializer.h>
 #include <Serializer.h>
 #include "TypeConverter.h"
 #include <policy.h>
@@ -944,13 +946,25 @@ audio_io_handle_t AudioPolicyManager::getOutputForDevice(
         ALOGV("Set VoIP and Direct output flags for PCM format");
     }
 
-    sp<IOProfile> profile;
-
     // skip direct output selection if the request can obviously be attached to a mixed output
     // and not explicitly requested
-    if (((flags & AUDIO_OUTPUT_FLAG_DIRECT) == 0) &&
+    const bool mixedOutputOnly = ((flags & AUDIO_OUTPUT_FLAG_DIRECT) == 0) &&
             audio_is_linear_pcm(format) && samplingRate <= SAMPLE_RATE_HZ_MAX &&
-            audio_channel_count_from_out_mask(channelMask) <= 2) {
+            audio_channel_count_from_out_mask(channelMask) <= 2;
+    // only the mixed output selection is cached: direct outputs belong to a session and
+    // are opened and closed on demand
+    const OutputRoutingCache::Key cacheKey = {
+            device, stream, samplingRate, format, channelMask, flags };
+
+    sp<IOProfile> profile;
+
+    if (mixedOutputOnly) {
+        output = mOutputRoutingCache.getOutput(cacheKey);
+        if (output != AUDIO_IO_HANDLE_NONE && mOutputs.indexOfKey(output) >= 0) {
+            ALOGV("getOutput() returns cached output %d", output);
+            return output;
+        }
+        output = AUDIO_IO_HANDLE_NONE;
         goto non_direct_output;
     }
 
@@ -1093,6 +1107,9 @@ non_direct_output:
         // at this stage we should ignore the DIRECT flag as no direct output could be found earlier
         flags = (audio_output_flags_t)(flags & ~AUDIO_OUTPUT_FLAG_DIRECT);
         output = selectOutput(outputs, flags, format);
+        if (mixedOutputOnly && output != AUDIO_IO_HANDLE_NONE) {
+            mOutputRoutingCache.putOutput(cacheKey, output);
+        }
     }
     ALOGW_IF((output == 0), "getOutput() could not find output for stream %d, samplingRate %d,"
             "format %d, channels %x, flags %x", stream, samplingRate, format, channelMask, flags);
@@ -2253,21 +2270,31 @@ status_t AudioPolicyManager::setStreamVolumeIndex(audio_stream_type_t stream,
     // requested device or one of the devices selected by the strategy
     // - For default requested device (AUDIO_DEVICE_OUT_DEFAULT_FOR_VOLUME), apply volume only if
     // no specific device volume value exists for currently selected device.
+    // The device selected for each stream does not depend on the output: find it once for all
+    // outputs, which are then updated in a single pass.
+    audio_devices_t streamDevices[AUDIO_STREAM_FOR_POLICY_CNT];
+    for (int curStream = 0; curStream < AUDIO_STREAM_FOR_POLICY_CNT; curStream++) {
+        streamDevices[curStream] = AUDIO_DEVICE_NONE;
+        if (streamsMatchForvolume(stream, (audio_stream_type_t)curStream)) {
+            routing_strategy curStrategy = getStrategy((audio_stream_type_t)curStream);
+            streamDevices[curStream] = Volume::getDeviceForVolume(getDeviceForStrategy(
+                    curStrategy, false /*fromCache*/));
+        }
+    }
+    const bool inCall = isInCall();
     status_t status = NO_ERROR;
     for (size_t i = 0; i < mOutputs.size(); i++) {
-        sp<SwAudioOutputDescriptor> desc = mOutputs.valueAt(i);
+        const sp<SwAudioOutputDescriptor>& desc = mOutputs.valueAt(i);
         audio_devices_t curDevice = Volume::getDeviceForVolume(desc->device());
         for (int curStream = 0; curStream < AUDIO_STREAM_FOR_POLICY_CNT; curStream++) {
             if (!streamsMatchForvolume(stream, (audio_stream_type_t)curStream)) {
                 continue;
             }
             if (!(desc->isStreamActive((audio_stream_type_t)curStream) ||
-                    (isInCall() && (curStream == AUDIO_STREAM_VOICE_CALL)))) {
+                    (inCall && (curStream == AUDIO_STREAM_VOICE_CALL)))) {
                 continue;
             }
-            routing_strategy curStrategy = getStrategy((audio_stream_type_t)curStream);
-            audio_devices_t curStreamDevice = Volume::getDeviceForVolume(getDeviceForStrategy(
-                    curStrategy, false /*fromCache*/));
+            audio_devices_t curStreamDevice = streamDevices[curStream];
             if ((device != AUDIO_DEVICE_OUT_DEFAULT_FOR_VOLUME) &&
                     ((curStreamDevice & device) == 0)) {
                 continue;
@@ -2665,6 +2692,7 @@ status_t AudioPolicyManager::dump(int fd)
     mEffects.dump(fd);
     mAudioPatches.dump(fd);
     mPolicyMixes.dump(fd);
+    mOutputRoutingCache.dump(fd);
 
     return NO_ERROR;
 }
@@ -3558,11 +3586,36 @@ static const char *kConfigLocationList[] =
         {"/odm/etc", "/vendor/etc", "/system/etc"};
 static const int kConfigLocationListSize =
         (sizeof(kConfigLocationList) / sizeof(kConfigLocationList[0]));
+// The xml config compiled on the first start, loaded instead of the xml files until they change.
+static const char *kConfigBlobFile = "/data/misc/audioserver/audio_policy_configuration.bin";
 
-static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
+static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config,
+                                                const char *configFile) {
     char audioPolicyXmlConfigFile[AUDIO_POLICY_XML_CONFIG_FILE_PATH_MAX_LENGTH];
     status_t ret;
 
+    if (configFile != NULL) {
+        PolicySerializer serializer;
+        return serializer.deserialize(configFile, config);
+    }
+    // The blob can only replace the first xml config found.
+    for (int i = 0; i < kConfigLocationListSize; i++) {
+        snprintf(audioPolicyXmlConfigFile,
+                 sizeof(audioPolicyXmlConfigFile),
+                 "%s/%s",
+                 kConfigLocationList[i],
+                 AUDIO_POLICY_XML_CONFIG_FILE_NAME);
+        if (access(audioPolicyXmlConfigFile, R_OK) == 0) {
+            PolicyBlobSerializer blobSerializer;
+            if (blobSerializer.deserialize(kConfigBlobFile, audioPolicyXmlConfigFile,
+                                           config) == NO_ERROR) {
+                ALOGI("%s: loaded %s compiled from %s", __FUNCTION__, kConfigBlobFile,
+                      audioPolicyXmlConfigFile);
+                return NO_ERROR;
+            }
+            break;
+        }
+    }
     for (int i = 0; i < kConfigLocationListSize; i++) {
         PolicySerializer serializer;
         snprintf(audioPolicyXmlConfigFile,
@@ -3572,6 +3625,8 @@ static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
                  AUDIO_POLICY_XML_CONFIG_FILE_NAME);
         ret = serializer.deserialize(audioPolicyXmlConfigFile, config);
         if (ret == NO_ERROR) {
+            PolicyBlobSerializer blobSerializer;
+            blobSerializer.serialize(kConfigBlobFile, serializer.getSourceFiles(), config);
             break;
         }
     }
@@ -3580,6 +3635,12 @@ static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
 #endif
 
 AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterface)
+    : AudioPolicyManager(clientInterface, NULL /* configFile */)
+{
+}
+
+AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterface,
+                                       const char *configFile)
     :
 #ifdef AUDIO_POLICY_TEST
     Thread(false),
@@ -3608,13 +3669,19 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
     AudioPolicyConfig config(mHwModules, mAvailableOutputDevices, mAvailableInputDevices,
                              mDefaultOutputDevice, speakerDrcEnabled,
                              static_cast<VolumeCurvesCollection *>(mVolumeCurves));
-    if (deserializeAudioPolicyXmlConfig(config) != NO_ERROR) {
+    if (deserializeAudioPolicyXmlConfig(config, configFile) != NO_ERROR) {
 #else
     mVolumeCurves = new StreamDescriptorCollection();
     AudioPolicyConfig config(mHwModules, mAvailableOutputDevices, mAvailableInputDevices,
                              mDefaultOutputDevice, speakerDrcEnabled);
-    if ((ConfigParsingUtils::loadConfig(AUDIO_POLICY_VENDOR_CONFIG_FILE, config) != NO_ERROR) &&
-            (ConfigParsingUtils::loadConfig(AUDIO_POLICY_CONFIG_FILE, config) != NO_ERROR)) {
+    status_t loadStatus;
+    if (configFile != NULL) {
+        loadStatus = ConfigParsingUtils::loadConfig(configFile, config);
+    } else if ((loadStatus = ConfigParsingUtils::loadConfig(AUDIO_POLICY_VENDOR_CONFIG_FILE,
+                                                            config)) != NO_ERROR) {
+        loadStatus = ConfigParsingUtils::loadConfig(AUDIO_POLICY_CONFIG_FILE, config);
+    }
+    if (loadStatus != NO_ERROR) {
 #endif
         ALOGE("could not load audio policy configuration file, setting defaults");
         config.setDefault();
@@ -4040,12 +4107,14 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output, const sp<SwAudioOut
     updateMono(output); // update mono status when adding to output list
     selectOutputForMusicEffects();
     nextAudioPortGeneration();
+    mOutputRoutingCache.invalidate();
 }
 
 void AudioPolicyManager::removeOutput(audio_io_handle_t output)
 {
     mOutputs.removeItem(output);
     selectOutputForMusicEffects();
+    mOutputRoutingCache.invalidate();
 }
 
 void AudioPolicyManager::addInput(audio_io_handle_t input, const sp<AudioInputDescriptor>& inputDesc)
@@ -4963,6 +5032,8 @@ void AudioPolicyManager::updateDevicesAndOutputs()
         mDeviceForStrategy[i] = getDeviceForStrategy((routing_strategy)i, false /*fromCache*/);
     }
     mPreviousOutputs = mOutputs;
+    // device connection, phone state and forced usage all end here
+    mOutputRoutingCache.invalidate();
 }
 
 uint32_t AudioPolicyManager::checkDeviceMuteStrategies(const sp<AudioOutputDescriptor>& outputDesc,
@@ -42,6 +42,7 @@
 #include <EffectDescriptor.h>
 #include <SoundTriggerSession.h>
 #include <SessionRoute.h>
+#include <OutputRoutingCache.h>
 #include <VolumeCurve.h>
 
 namespace android {
@@ -276,6 +277,10 @@ protected:
             return mDefaultOutputDevice;
         }
 protected:
+        // Load the policy configuration from configFile instead of the default locations.
+        // Used by tests to run the policy on a known configuration.
+        AudioPolicyManager(AudioPolicyClientInterface *clientInterface, const char *configFile);
+
         void addOutput(audio_io_handle_t output, const sp<SwAudioOutputDescriptor>& outputDesc);
         void removeOutput(audio_io_handle_t output);
         void addInput(audio_io_handle_t input, const sp<AudioInputDescriptor>& inputDesc);
@@ -534,6 +539,9 @@ protected:
         SessionRouteMap mOutputRoutes = SessionRouteMap(SessionRouteMap::MAPTYPE_OUTPUT);
         SessionRouteMap mInputRoutes = SessionRouteMap(SessionRouteMap::MAPTYPE_INPUT);
 
+        // mixed output selected by getOutputForDevice() for recent requests
+        OutputRoutingCache mOutputRoutingCache;
+
         IVolumeCurvesCollection *mVolumeCurves; // Volume Curves per use case and device category
 
         bool    mLimitRingtoneVolume;        // limit ringtone volume to music volume if headset connected
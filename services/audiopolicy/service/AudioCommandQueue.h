@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_COMMAND_QUEUE_H
+#define ANDROID_AUDIO_COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Pending commands of the AudioCommandThread.
+//
+// Commands are executed in the order of their time stamps, so in the order in which they were
+// sent unless they were delayed, and in the order of their sequence number given at insertion
+// when due at the same time.  All commands share one queue: any of them may depend on another
+// command of a different type, like a patch on the device connection sent as parameters or a
+// mute sent before a delayed patch, so none may overtake another.  Floods of commands are kept
+// short by coalescing them instead.
+//
+// Command is a RefBase with the members int mCommand, nsecs_t mTime, set before insertion,
+// and uint64_t mSeq, set by insert().  Not thread safe: the AudioCommandThread lock must be held.
+template <typename Command>
+class AudioCommandQueue {
+public:
+    AudioCommandQueue() : mNextSeq(0) {}
+
+    bool isEmpty() const { return mCommands.isEmpty(); }
+
+    void clear() { mCommands.clear(); }
+
+    // Pending commands in the order of execution, by increasing time stamp then sequence number.
+    // Commands may be removed, but only inserted with insert().
+    Vector< sp<Command> >& commands() { return mCommands; }
+    const Vector< sp<Command> >& commands() const { return mCommands; }
+
+    // Inserts a command after the commands with the same or an earlier time stamp.
+    void insert(const sp<Command>& command) {
+        command->mSeq = mNextSeq++;
+        ssize_t i = mCommands.size() - 1;
+        while (i >= 0 && mCommands[i]->mTime > command->mTime) {
+            i--;
+        }
+        mCommands.insertAt(command, i + 1);
+    }
+
+    // True if no command was inserted after this one.  A command sent next may then be merged
+    // into it without changing the order of execution.
+    bool isLastInserted(const sp<Command>& command) const {
+        return command->mSeq + 1 == mNextSeq;
+    }
+
+    // True if all the pending commands inserted after this one are of the same type.  Replacing
+    // it with a command sent next then only reorders commands of that type.
+    bool isLastOfOtherTypes(const sp<Command>& command) const {
+        for (size_t i = 0; i < mCommands.size(); i++) {
+            const sp<Command>& command2 = mCommands[i];
+            if (command2->mSeq > command->mSeq && command2->mCommand != command->mCommand) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Removes and returns the next command if it is due at curTime.  Otherwise returns 0 and
+    // sets *waitTime to the time until the next command is due, or -1 if there is none.
+    sp<Command> dequeue(nsecs_t curTime, nsecs_t *waitTime) {
+        if (mCommands.isEmpty()) {
+            *waitTime = -1;
+            return 0;
+        }
+        sp<Command> command = mCommands[0];
+        if (command->mTime > curTime) {
+            *waitTime = command->mTime - curTime;
+            return 0;
+        }
+        *waitTime = -1;
+        mCommands.removeAt(0);
+        return command;
+    }
+
+private:
+    Vector< sp<Command> > mCommands;
+    uint64_t mNextSeq;
+};
+
+}; // namespace android
+
+#endif // ANDROID_AUDIO_COMMAND_QUEUE_H
@@ -397,6 +397,7 @@ AudioPolicyService::AudioCommandThread::AudioCommandThread(String8 name,
     : Thread(false), mName(name), mService(service)
 {
     mpToneGenerator = NULL;
+    memset(mCommandStats, 0, sizeof(mCommandStats));
 }
 
 
@@ -409,6 +410,74 @@ AudioPolicyService::AudioCommandThread::~AudioCommandThread()
     delete mpToneGenerator;
 }
 
+const int AudioPolicyService::AudioCommandThread::kLatencyBucketLimitsMs[kNumLatencyBuckets - 1] =
+        { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+const char *AudioPolicyService::AudioCommandThread::getCommandName(int command)
+{
+    static const char * const kNames[kNumCommands] = {
+        "START_TONE",
+        "STOP_TONE",
+        "SET_VOLUME",
+        "SET_PARAMETERS",
+        "SET_VOICE_VOLUME",
+        "STOP_OUTPUT",
+        "RELEASE_OUTPUT",
+        "CREATE_AUDIO_PATCH",
+        "RELEASE_AUDIO_PATCH",
+        "UPDATE_AUDIOPORT_LIST",
+        "UPDATE_AUDIOPATCH_LIST",
+        "SET_AUDIOPORT_CONFIG",
+        "DYN_POLICY_MIX_STATE_UPDATE",
+        "RECORDING_CONFIGURATION_UPDATE",
+        "EFFECT_SESSION_UPDATE",
+    };
+    if (command < 0 || command >= kNumCommands) {
+        return "UNKNOWN";
+    }
+    return kNames[command];
+}
+
+void AudioPolicyService::AudioCommandThread::completeCommand(const sp<AudioCommand>& command)
+{
+    for (size_t i = 0; i < command->mMergedCommands.size(); i++) {
+        const sp<AudioCommand>& merged = command->mMergedCommands[i];
+        Mutex::Autolock _l(merged->mLock);
+        merged->mStatus = command->mStatus;
+        if (merged->mWaitStatus) {
+            merged->mWaitStatus = false;
+            merged->mCond.signal();
+        }
+    }
+    command->mMergedCommands.clear();
+
+    Mutex::Autolock _l(command->mLock);
+    if (command->mWaitStatus) {
+        command->mWaitStatus = false;
+        command->mCond.signal();
+    }
+}
+
+void AudioPolicyService::AudioCommandThread::updateLatencyStats_l(
+        const sp<AudioCommand>& command, nsecs_t curTime)
+{
+    if (command->mCommand < 0 || command->mCommand >= kNumCommands) {
+        return;
+    }
+    CommandStats &stats = mCommandStats[command->mCommand];
+    nsecs_t latency = curTime - command->mTime;
+    int bucket = 0;
+    while (bucket < kNumLatencyBuckets - 1 &&
+            latency >= milliseconds(kLatencyBucketLimitsMs[bucket])) {
+        bucket++;
+    }
+    stats.mExecuted++;
+    stats.mLatencyHistogram[bucket]++;
+    if (latency > stats.mMaxLatency) {
+        stats.mMaxLatency = latency;
+    }
+}
+
 void AudioPolicyService::AudioCommandThread::onFirstRef()
 {
     run(mName.string(), ANDROID_PRIORITY_AUDIO);
@@ -424,11 +493,10 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
         sp<AudioPolicyService> svc;
         while (!mAudioCommands.isEmpty() && !exitPending()) {
             nsecs_t curTime = systemTime();
-            // commands are sorted by increasing time stamp: execute them from index 0 and up
-            if (mAudioCommands[0]->mTime <= curTime) {
-                sp<AudioCommand> command = mAudioCommands[0];
-                mAudioCommands.removeAt(0);
+            sp<AudioCommand> command = mAudioCommands.dequeue(curTime, &waitTime);
+            if (command != 0) {
                 mLastCommand = command;
+                updateLatencyStats_l(command, curTime);
 
                 switch (command->mCommand) {
                 case START_TONE: {
@@ -590,13 +658,7 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 default:
                     ALOGW("AudioCommandThread() unknown command %d", command->mCommand);
                 }
-                {
-                    Mutex::Autolock _l(command->mLock);
-                    if (command->mWaitStatus) {
-                        command->mWaitStatus = false;
-                        command->mCond.signal();
-                    }
-                }
+                completeCommand(command);
                 waitTime = -1;
                 // release mLock before releasing strong reference on the service as
                 // AudioPolicyService destructor calls AudioCommandThread::exit() which
@@ -605,7 +667,6 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 svc.clear();
                 mLock.lock();
             } else {
-                waitTime = mAudioCommands[0]->mTime - curTime;
                 break;
             }
         }
@@ -653,8 +714,9 @@ status_t AudioPolicyService::AudioCommandThread::dump(int fd)
     snprintf(buffer, SIZE, "- Commands:\n");
     result = String8(buffer);
     result.append("   Command Time        Wait pParam\n");
-    for (size_t i = 0; i < mAudioCommands.size(); i++) {
-        mAudioCommands[i]->dump(buffer, SIZE);
+    const Vector < sp<AudioCommand> > &commands = mAudioCommands.commands();
+    for (size_t i = 0; i < commands.size(); i++) {
+        commands[i]->dump(buffer, SIZE);
         result.append(buffer);
     }
     result.append("  Last Command\n");
@@ -665,6 +727,36 @@ status_t AudioPolicyService::AudioCommandThread::dump(int fd)
         result.append("     none\n");
     }
 
+    result.append("- Dispatch latency (ms):\n");
+    snprintf(buffer, SIZE, "   %-30s %8s %6s %5s", "Command", "Executed", "Merged", "Max");
+    result.append(buffer);
+    for (int bucket = 0; bucket < kNumLatencyBuckets; bucket++) {
+        char limit[8];
+        if (bucket < kNumLatencyBuckets - 1) {
+            snprintf(limit, sizeof(limit), "<%d", kLatencyBucketLimitsMs[bucket]);
+        } else {
+            snprintf(limit, sizeof(limit), ">=%d", kLatencyBucketLimitsMs[bucket - 1]);
+        }
+        snprintf(buffer, SIZE, " %6s", limit);
+        result.append(buffer);
+    }
+    result.append("\n");
+    for (int command = 0; command < kNumCommands; command++) {
+        const CommandStats &stats = mCommandStats[command];
+        if (stats.mExecuted == 0 && stats.mMerged == 0) {
+            continue;
+        }
+        snprintf(buffer, SIZE, "   %-30s %8u %6u %5d",
+                 getCommandName(command), stats.mExecuted, stats.mMerged,
+                 (int)ns2ms(stats.mMaxLatency));
+        result.append(buffer);
+        for (int bucket = 0; bucket < kNumLatencyBuckets; bucket++) {
+            snprintf(buffer, SIZE, " %6u", stats.mLatencyHistogram[bucket]);
+            result.append(buffer);
+        }
+        result.append("\n");
+    }
+
     write(fd, result.string(), result.size());
 
     if (locked) mLock.unlock();
@@ -910,10 +1002,12 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& c
         acquire_wake_lock(PARTIAL_WAKE_LOCK, mName.string());
     }
 
+    Vector < sp<AudioCommand> > &commands = mAudioCommands.commands();
+
     // check same pending commands with later time stamps and eliminate them
-    for (i = mAudioCommands.size()-1; i >= 0; i--) {
-        sp<AudioCommand> command2 = mAudioCommands[i];
-        // commands are sorted by increasing time stamp: no need to scan the rest of mAudioCommands
+    for (i = commands.size()-1; i >= 0; i--) {
+        sp<AudioCommand> command2 = commands[i];
+        // commands are sorted by increasing time stamp: no need to scan the rest of commands
         if (command2->mTime <= command->mTime) break;
 
         // create audio patch or release audio patch commands are equivalent
@@ -1049,19 +1143,24 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& c
         }
     }
 
-    // remove filtered commands
+    // remove filtered commands, their callers get the status of the current command
     for (size_t j = 0; j < removedCommands.size(); j++) {
         // removed commands always have time stamps greater than current command
-        for (size_t k = i + 1; k < mAudioCommands.size(); k++) {
-            if (mAudioCommands[k].get() == removedCommands[j].get()) {
-                ALOGV("suppressing command: %d", mAudioCommands[k]->mCommand);
-                mAudioCommands.removeAt(k);
+        for (size_t k = i + 1; k < commands.size(); k++) {
+            if (commands[k].get() == removedCommands[j].get()) {
+                ALOGV("suppressing command: %d", commands[k]->mCommand);
+                mergeCommand_l(command, commands[k]);
+                commands.removeAt(k);
                 break;
             }
         }
     }
     removedCommands.clear();
 
+    if (delayMs == 0 && coalesceCommand_l(commands, command)) {
+        return;
+    }
+
     // Disable wait for status if delay is not 0.
     // Except for create audio patch command because the returned patch handle
     // is needed by audio policy manager
@@ -1070,9 +1169,79 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& c
     }
 
     // insert command at the right place according to its time stamp
-    ALOGV("inserting command: %d at index %zd, num commands %zu",
-            command->mCommand, i+1, mAudioCommands.size());
-    mAudioCommands.insertAt(command, i + 1);
+    ALOGV("inserting command: %d, num commands %zu", command->mCommand, commands.size());
+    mAudioCommands.insert(command);
+}
+
+// coalesceCommand_l() must be called with mLock held
+bool AudioPolicyService::AudioCommandThread::coalesceCommand_l(
+        Vector < sp<AudioCommand> >& commands, sp<AudioCommand>& command)
+{
+    // The pending commands with a time stamp up to that of the current command are due: they
+    // were only delayed by the commands executed before them.
+    for (ssize_t i = commands.size() - 1; i >= 0; i--) {
+        sp<AudioCommand> command2 = commands[i];
+        if (command2->mTime > command->mTime || command2->mCommand != command->mCommand) {
+            continue;
+        }
+
+        switch (command->mCommand) {
+        // The last writer wins: the pending volume is replaced by the current one, unless a
+        // command of another type was sent in between.
+        case SET_VOLUME: {
+            if (!mAudioCommands.isLastOfOtherTypes(command2)) return false;
+            VolumeData *data = (VolumeData *)command->mParam.get();
+            VolumeData *data2 = (VolumeData *)command2->mParam.get();
+            if ((data->mIO != data2->mIO) || (data->mStream != data2->mStream)) break;
+            ALOGV("merging pending command %d into new command", command2->mCommand);
+            mergeCommand_l(command, command2);
+            commands.removeAt(i);
+        } break;
+
+        case SET_VOICE_VOLUME:
+            if (!mAudioCommands.isLastOfOtherTypes(command2)) return false;
+            ALOGV("merging pending command %d into new command", command2->mCommand);
+            mergeCommand_l(command, command2);
+            commands.removeAt(i);
+            break;
+
+        // Parameters may depend on the other commands, so the current command is only added
+        // to a pending one that was the last command sent. Its values replace the pending
+        // values of the same keys.
+        case SET_PARAMETERS: {
+            if (!mAudioCommands.isLastInserted(command2)) return false;
+            ParametersData *data = (ParametersData *)command->mParam.get();
+            ParametersData *data2 = (ParametersData *)command2->mParam.get();
+            if (data->mIO != data2->mIO) return false;
+            AudioParameter param = AudioParameter(data->mKeyValuePairs);
+            AudioParameter param2 = AudioParameter(data2->mKeyValuePairs);
+            for (size_t j = 0; j < param.size(); j++) {
+                String8 key;
+                String8 value;
+                param.getAt(j, key, value);
+                param2.add(key, value);
+            }
+            ALOGV("merging new command %d into pending command", command->mCommand);
+            data2->mKeyValuePairs = param2.toString();
+            mergeCommand_l(command2, command);
+            return true;
+        }
+
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+// mergeCommand_l() must be called with mLock held
+void AudioPolicyService::AudioCommandThread::mergeCommand_l(const sp<AudioCommand>& command,
+                                                            const sp<AudioCommand>& merged)
+{
+    command->mMergedCommands.appendVector(merged->mMergedCommands);
+    merged->mMergedCommands.clear();
+    command->mMergedCommands.add(merged);
+    mCommandStats[merged->mCommand].mMerged++;
 }
 
 void AudioPolicyService::AudioCommandThread::exit()
@@ -30,6 +30,7 @@
 #include <media/ToneGenerator.h>
 #include <media/AudioEffect.h>
 #include <media/AudioPolicy.h>
+#include "AudioCommandQueue.h"
 #include "AudioPolicyEffects.h"
 #include "managerdefault/AudioPolicyManager.h"
 
@@ -275,6 +276,7 @@ private:
             RECORDING_CONFIGURATION_UPDATE,
             EFFECT_SESSION_UPDATE,
         };
+        static const int kNumCommands = EFFECT_SESSION_UPDATE + 1;
 
         AudioCommandThread (String8 name, const wp<AudioPolicyService>& service);
         virtual             ~AudioCommandThread();
@@ -324,22 +326,37 @@ private:
     private:
         class AudioCommandData;
 
+        static const char *getCommandName(int command);
+
+        // Merge into command the pending commands that are already due and that it
+        // overrides, or merge command into the last command sent if independent.
+        // Called for commands without delay only, so that no change is applied earlier than
+        // requested. Returns true if command was merged and must not be inserted.
+        bool coalesceCommand_l(Vector < sp<AudioCommand> >& commands, sp<AudioCommand>& command);
+        // Complete merged with the status of command
+        void mergeCommand_l(const sp<AudioCommand>& command, const sp<AudioCommand>& merged);
+        void completeCommand(const sp<AudioCommand>& command);
+        void updateLatencyStats_l(const sp<AudioCommand>& command, nsecs_t curTime);
+
         // descriptor for requested tone playback event
         class AudioCommand: public RefBase {
 
         public:
             AudioCommand()
-            : mCommand(-1), mStatus(NO_ERROR), mWaitStatus(false) {}
+            : mCommand(-1), mTime(0), mSeq(0), mStatus(NO_ERROR), mWaitStatus(false) {}
 
             void dump(char* buffer, size_t size);
 
             int mCommand;   // START_TONE, STOP_TONE ...
             nsecs_t mTime;  // time stamp
+            uint64_t mSeq;  // order of insertion, set by AudioCommandQueue
             Mutex mLock;    // mutex associated to mCond
             Condition mCond; // condition for status return
             status_t mStatus; // command status
             bool mWaitStatus; // true if caller is waiting for status
             sp<AudioCommandData> mParam;     // command specific parameter data
+            // commands merged into this one, completed with its status
+            Vector < sp<AudioCommand> > mMergedCommands;
         };
 
         class AudioCommandData: public RefBase {
@@ -424,9 +441,20 @@ private:
             bool mAdded;
         };
 
+        // Dispatch latency, from the time stamp of a command to the start of its execution.
+        static const int kNumLatencyBuckets = 10;
+        static const int kLatencyBucketLimitsMs[kNumLatencyBuckets - 1];
+        struct CommandStats {
+            uint32_t mExecuted;
+            uint32_t mMerged;  // commands merged into others or filtered out
+            uint32_t mLatencyHistogram[kNumLatencyBuckets];
+            nsecs_t mMaxLatency;
+        };
+
         Mutex   mLock;
         Condition mWaitWorkCV;
-        Vector < sp<AudioCommand> > mAudioCommands; // list of pending commands
+        AudioCommandQueue<AudioCommand> mAudioCommands; // pending commands
+        CommandStats mCommandStats[kNumCommands];
         ToneGenerator *mpToneGenerator;     // the tone generator
         sp<AudioCommand> mLastCommand;      // last processed command (used by dump)
         String8 mName;                      // string used by wake lock fo delayed commands
@@ -0,0 +1,82 @@
+LOCAL_PATH:= $(call my-dir)
+
+# The tests load the stub configuration, which is only available in the XML format.
+ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    audiopolicymanager_tests.cpp
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/services/audiopolicy \
+    frameworks/av/services/audiopolicy/common/include \
+    frameworks/av/services/audiopolicy/engine/interface \
+    frameworks/av/services/audiopolicy/managerdefault \
+    frameworks/av/services/audiopolicy/utilities
+
+LOCAL_SHARED_LIBRARIES := \
+    libaudiopolicymanagerdefault \
+    libcutils \
+    liblog \
+    libmedia_helper \
+    libutils \
+    libxml2
+
+LOCAL_STATIC_LIBRARIES := \
+    libaudiopolicycomponents
+
+LOCAL_CFLAGS := -Wall -Werror -DUSE_XML_AUDIO_POLICY_CONF
+
+LOCAL_MODULE := audiopolicymanager_tests
+LOCAL_MODULE_TAGS := tests
+
+# The stub and the shipped configurations and their includes, installed next to the test.
+audiopolicymanager_tests_config_files := \
+    audio_policy_configuration_stub.xml \
+    stub_audio_policy_configuration.xml \
+    audio_policy_configuration.xml \
+    a2dp_audio_policy_configuration.xml \
+    usb_audio_policy_configuration.xml \
+    r_submix_audio_policy_configuration.xml \
+    audio_policy_volumes.xml \
+    default_volume_tables.xml
+
+LOCAL_REQUIRED_MODULES := \
+    $(addprefix audiopolicymanager_tests_,$(audiopolicymanager_tests_config_files))
+
+include $(BUILD_NATIVE_TEST)
+
+define audiopolicymanager_tests_config
+include $$(CLEAR_VARS)
+LOCAL_MODULE := audiopolicymanager_tests_$(1)
+LOCAL_MODULE_STEM := $(1)
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_PATH := $$(TARGET_OUT_DATA_NATIVE_TESTS)/audiopolicymanager_tests
+LOCAL_SRC_FILES := ../config/$(1)
+include $$(BUILD_PREBUILT)
+endef
+
+$(foreach file,$(audiopolicymanager_tests_config_files), \
+    $(eval $(call audiopolicymanager_tests_config,$(file))))
+
+endif #ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    audio_command_queue_tests.cpp
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/services/audiopolicy/service
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils
+
+LOCAL_CFLAGS := -Wall -Werror
+
+LOCAL_MODULE := audio_command_queue_tests
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AudioCommandQueue.h"
+
+using namespace android;
+
+namespace {
+
+// A few commands of the AudioCommandThread
+enum {
+    SET_VOLUME,
+    SET_PARAMETERS,
+    CREATE_AUDIO_PATCH,
+    RECORDING_CONFIGURATION_UPDATE,
+};
+
+class Command : public RefBase {
+public:
+    Command(int command, nsecs_t time, int id)
+        : mCommand(command), mTime(time), mSeq(0), mId(id) {}
+
+    int mCommand;
+    nsecs_t mTime;
+    uint64_t mSeq;
+    int mId;    // to check the order of execution
+};
+
+class AudioCommandQueueTest : public ::testing::Test {
+protected:
+    void insert(int command, nsecs_t time, int id) {
+        mQueue.insert(new Command(command, time, id));
+    }
+
+    // Executes the commands due at curTime, returns their ids in the order of execution
+    std::vector<int> executeAll(nsecs_t curTime) {
+        std::vector<int> ids;
+        nsecs_t waitTime;
+        sp<Command> command;
+        while ((command = mQueue.dequeue(curTime, &waitTime)) != 0) {
+            ids.push_back(command->mId);
+        }
+        return ids;
+    }
+
+    AudioCommandQueue<Command> mQueue;
+};
+
+// Commands of all types sent one after the other run in the order in which they were sent.
+TEST_F(AudioCommandQueueTest, mixedCommandsRunInOrderSent) {
+    insert(SET_PARAMETERS, 10, 0);
+    insert(SET_VOLUME, 11, 1);
+    insert(RECORDING_CONFIGURATION_UPDATE, 12, 2);
+    insert(CREATE_AUDIO_PATCH, 13, 3);
+    insert(SET_VOLUME, 14, 4);
+    insert(SET_PARAMETERS, 15, 5);
+    insert(CREATE_AUDIO_PATCH, 16, 6);
+
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6}), executeAll(100));
+    EXPECT_TRUE(mQueue.isEmpty());
+}
+
+// No type of command overtakes another: commands due at the same time run in the order of
+// insertion.
+TEST_F(AudioCommandQueueTest, sameTimeRunsInOrderSent) {
+    insert(RECORDING_CONFIGURATION_UPDATE, 10, 0);
+    insert(SET_PARAMETERS, 10, 1);
+    insert(SET_VOLUME, 10, 2);
+    insert(SET_PARAMETERS, 10, 3);
+    insert(CREATE_AUDIO_PATCH, 10, 4);
+    insert(SET_VOLUME, 9, 5);
+
+    EXPECT_EQ(std::vector<int>({5, 0, 1, 2, 3, 4}), executeAll(100));
+}
+
+// Delayed commands run at their time, after the commands sent later without delay.
+TEST_F(AudioCommandQueueTest, delayedCommandsWait) {
+    insert(CREATE_AUDIO_PATCH, 50, 0);
+    insert(SET_VOLUME, 10, 1);
+    insert(SET_PARAMETERS, 20, 2);
+    insert(CREATE_AUDIO_PATCH, 30, 3);
+
+    EXPECT_EQ(std::vector<int>({1, 2}), executeAll(25));
+    nsecs_t waitTime;
+    EXPECT_TRUE(mQueue.dequeue(25, &waitTime) == 0);
+    EXPECT_EQ(5, waitTime);
+
+    EXPECT_EQ(std::vector<int>({3, 0}), executeAll(50));
+    EXPECT_TRUE(mQueue.dequeue(50, &waitTime) == 0);
+    EXPECT_EQ(-1, waitTime);
+}
+
+TEST_F(AudioCommandQueueTest, lastInserted) {
+    sp<Command> parameters = new Command(SET_PARAMETERS, 10, 0);
+    mQueue.insert(parameters);
+    EXPECT_TRUE(mQueue.isLastInserted(parameters));
+
+    insert(SET_VOLUME, 11, 1);
+    EXPECT_FALSE(mQueue.isLastInserted(parameters));
+}
+
+TEST_F(AudioCommandQueueTest, lastOfOtherTypes) {
+    sp<Command> volume = new Command(SET_VOLUME, 10, 0);
+    mQueue.insert(volume);
+    insert(SET_VOLUME, 11, 1);
+    EXPECT_TRUE(mQueue.isLastOfOtherTypes(volume));
+
+    insert(SET_PARAMETERS, 12, 2);
+    EXPECT_FALSE(mQueue.isLastOfOtherTypes(volume));
+
+    EXPECT_EQ(std::vector<int>({0, 1, 2}), executeAll(100));
+}
+
+} // namespace
@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Run the default policy manager on the stub configuration, with a client that
+// pretends to open the outputs.
+
+#include <algorithm>
+#include <libgen.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include "AudioPolicyInterface.h"
+#include "AudioPolicyManager.h"
+#include "PolicyBlobSerializer.h"
+#include "Serializer.h"
+
+using namespace android;
+
+#define CONFIG_FILE_NAME "audio_policy_configuration_stub.xml"
+#define SHIPPED_CONFIG_FILE_NAME "audio_policy_configuration.xml"
+#define BLOB_FILE_NAME "audio_policy_configuration.bin"
+
+class MockAudioPolicyClient : public AudioPolicyClientInterface
+{
+public:
+    MockAudioPolicyClient() : mNextModuleHandle(1), mNextIoHandle(1), mNextUniqueId(1),
+            mOpenedOutputs(0) {}
+
+    virtual audio_module_handle_t loadHwModule(const char * /*name*/) {
+        return mNextModuleHandle++;
+    }
+
+    virtual status_t openOutput(audio_module_handle_t /*module*/,
+                                audio_io_handle_t *output,
+                                audio_config_t * /*config*/,
+                                audio_devices_t * /*devices*/,
+                                const String8& /*address*/,
+                                uint32_t * /*latencyMs*/,
+                                audio_output_flags_t /*flags*/) {
+        *output = mNextIoHandle++;
+        mOpenedOutputs++;
+        return NO_ERROR;
+    }
+    virtual audio_io_handle_t openDuplicateOutput(audio_io_handle_t /*output1*/,
+                                                  audio_io_handle_t /*output2*/) {
+        return mNextIoHandle++;
+    }
+    virtual status_t closeOutput(audio_io_handle_t /*output*/) { return NO_ERROR; }
+    virtual status_t suspendOutput(audio_io_handle_t /*output*/) { return NO_ERROR; }
+    virtual status_t restoreOutput(audio_io_handle_t /*output*/) { return NO_ERROR; }
+
+    virtual status_t openInput(audio_module_handle_t /*module*/,
+                               audio_io_handle_t *input,
+                               audio_config_t * /*config*/,
+                               audio_devices_t * /*device*/,
+                               const String8& /*address*/,
+                               audio_source_t /*source*/,
+                               audio_input_flags_t /*flags*/) {
+        *input = mNextIoHandle++;
+        return NO_ERROR;
+    }
+    virtual status_t closeInput(audio_io_handle_t /*input*/) { return NO_ERROR; }
+
+    virtual status_t setStreamVolume(audio_stream_type_t /*stream*/, float /*volume*/,
+                                     audio_io_handle_t /*output*/, int /*delayMs*/) {
+        return NO_ERROR;
+    }
+    virtual status_t invalidateStream(audio_stream_type_t /*stream*/) { return NO_ERROR; }
+    virtual void setParameters(audio_io_handle_t /*ioHandle*/,
+                               const String8& /*keyValuePairs*/, int /*delayMs*/) {}
+    virtual String8 getParameters(audio_io_handle_t /*ioHandle*/, const String8& /*keys*/) {
+        return String8();
+    }
+    virtual status_t startTone(audio_policy_tone_t /*tone*/, audio_stream_type_t /*stream*/) {
+        return NO_ERROR;
+    }
+    virtual status_t stopTone() { return NO_ERROR; }
+    virtual status_t setVoiceVolume(float /*volume*/, int /*delayMs*/) { return NO_ERROR; }
+    virtual status_t moveEffects(audio_session_t /*session*/,
+                                 audio_io_handle_t /*srcOutput*/,
+                                 audio_io_handle_t /*dstOutput*/) {
+        return NO_ERROR;
+    }
+    virtual status_t createAudioPatch(const struct audio_patch * /*patch*/,
+                                      audio_patch_handle_t *handle,
+                                      int /*delayMs*/) {
+        *handle = (audio_patch_handle_t) mNextUniqueId++;
+        return NO_ERROR;
+    }
+    virtual status_t releaseAudioPatch(audio_patch_handle_t /*handle*/, int /*delayMs*/) {
+        return NO_ERROR;
+    }
+    virtual status_t setAudioPortConfig(const struct audio_port_config * /*config*/,
+                                        int /*delayMs*/) {
+        return NO_ERROR;
+    }
+    virtual void onAudioPortListUpdate() {}
+    virtual void onAudioPatchListUpdate() {}
+    virtual audio_unique_id_t newAudioUniqueId(audio_unique_id_use_t /*use*/) {
+        return mNextUniqueId++;
+    }
+    virtual void onDynamicPolicyMixStateUpdate(String8 /*regId*/, int32_t /*state*/) {}
+    virtual void onRecordingConfigurationUpdate(int /*event*/,
+                    const record_client_info_t * /*clientInfo*/,
+                    const struct audio_config_base * /*clientConfig*/,
+                    const struct audio_config_base * /*deviceConfig*/,
+                    audio_patch_handle_t /*patchHandle*/) {}
+    virtual void onOutputSessionEffectsUpdate(sp<AudioSessionInfo>& /*streamInfo*/,
+                                              bool /*added*/) {}
+
+    int getOpenedOutputs() const { return mOpenedOutputs; }
+
+private:
+    audio_module_handle_t mNextModuleHandle;
+    audio_io_handle_t mNextIoHandle;
+    audio_unique_id_t mNextUniqueId;
+    int mOpenedOutputs;
+};
+
+// Gives access to the configuration file and to the routing cache.
+class AudioPolicyTestManager : public AudioPolicyManager
+{
+public:
+    AudioPolicyTestManager(AudioPolicyClientInterface *clientInterface, const char *configFile)
+            : AudioPolicyManager(clientInterface, configFile) {}
+
+    const OutputRoutingCache& getOutputRoutingCache() const { return mOutputRoutingCache; }
+};
+
+// The configurations are installed in the directory of the test.
+static String8 getTestFile(const char *name) {
+    char path[PATH_MAX] = {};
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0) {
+        return String8(name);
+    }
+    path[length] = '\0';
+    return String8::format("%s/%s", dirname(path), name);
+}
+
+class AudioPolicyManagerTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp() {
+        mManager = new AudioPolicyTestManager(&mClient, getTestFile(CONFIG_FILE_NAME).string());
+        ASSERT_EQ(NO_ERROR, mManager->initCheck());
+    }
+
+    virtual void TearDown() {
+        delete mManager;
+    }
+
+    audio_io_handle_t getOutput(audio_usage_t usage, audio_session_t session,
+                                audio_output_flags_t flags = AUDIO_OUTPUT_FLAG_NONE) {
+        audio_attributes_t attributes = {};
+        attributes.usage = usage;
+        audio_config_t config = AUDIO_CONFIG_INITIALIZER;
+        config.sample_rate = 48000;
+        config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        audio_io_handle_t output = AUDIO_IO_HANDLE_NONE;
+        audio_stream_type_t stream = AUDIO_STREAM_DEFAULT;
+        audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+        audio_port_handle_t portId = AUDIO_PORT_HANDLE_NONE;
+        EXPECT_EQ(NO_ERROR, mManager->getOutputForAttr(&attributes, &output, session, &stream,
+                                                       getuid(), &config, flags,
+                                                       &selectedDeviceId, &portId));
+        return output;
+    }
+
+    MockAudioPolicyClient mClient;
+    AudioPolicyTestManager *mManager;
+};
+
+TEST_F(AudioPolicyManagerTest, init_opens_stub_output) {
+    EXPECT_EQ(1, mClient.getOpenedOutputs());
+}
+
+// The sessions of the sound effects of an app share the output found for the first one.
+TEST_F(AudioPolicyManagerTest, cache_hits_across_sessions) {
+    const OutputRoutingCache& cache = mManager->getOutputRoutingCache();
+    audio_io_handle_t output = getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 1);
+    ASSERT_NE(AUDIO_IO_HANDLE_NONE, output);
+    EXPECT_EQ(0u, cache.getHits());
+    EXPECT_EQ(1u, cache.getMisses());
+    EXPECT_EQ(1u, cache.size());
+
+    for (int session = 2; session < 100; session++) {
+        EXPECT_EQ(output, getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) session));
+    }
+    EXPECT_EQ(98u, cache.getHits());
+    EXPECT_EQ(1u, cache.getMisses());
+
+    // another stream type is another entry
+    EXPECT_EQ(output, getOutput(AUDIO_USAGE_NOTIFICATION, (audio_session_t) 100));
+    EXPECT_EQ(2u, cache.getMisses());
+    EXPECT_EQ(2u, cache.size());
+}
+
+TEST_F(AudioPolicyManagerTest, cache_invalidated_by_devices) {
+    const OutputRoutingCache& cache = mManager->getOutputRoutingCache();
+    ASSERT_NE(AUDIO_IO_HANDLE_NONE, getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 1));
+    uint32_t generation = cache.getGeneration();
+
+    // connecting the remote submix opens its output
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(AUDIO_DEVICE_OUT_REMOTE_SUBMIX,
+            AUDIO_POLICY_DEVICE_STATE_AVAILABLE, "0", "remote submix"));
+    EXPECT_EQ(2, mClient.getOpenedOutputs());
+    EXPECT_GT(cache.getGeneration(), generation);
+    EXPECT_EQ(0u, cache.size());
+    generation = cache.getGeneration();
+
+    ASSERT_NE(AUDIO_IO_HANDLE_NONE, getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 2));
+    EXPECT_EQ(2u, cache.getMisses());
+
+    mManager->setForceUse(AUDIO_POLICY_FORCE_FOR_MEDIA, AUDIO_POLICY_FORCE_NO_BT_A2DP);
+    EXPECT_GT(cache.getGeneration(), generation);
+    EXPECT_EQ(0u, cache.size());
+
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(AUDIO_DEVICE_OUT_REMOTE_SUBMIX,
+            AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE, "0", "remote submix"));
+    ASSERT_NE(AUDIO_IO_HANDLE_NONE, getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 3));
+    EXPECT_EQ(3u, cache.getMisses());
+}
+
+// Direct and offloaded outputs are opened for a session and are never cached.
+TEST_F(AudioPolicyManagerTest, direct_requests_not_cached) {
+    const OutputRoutingCache& cache = mManager->getOutputRoutingCache();
+    getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 1, AUDIO_OUTPUT_FLAG_DIRECT);
+    getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 2, AUDIO_OUTPUT_FLAG_DIRECT);
+    EXPECT_EQ(0u, cache.getHits());
+    EXPECT_EQ(0u, cache.getMisses());
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST_F(AudioPolicyManagerTest, dump_shows_cache) {
+    getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 1);
+    getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 2);
+
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(NO_ERROR, mManager->dump(fileno(file)));
+    rewind(file);
+    char line[256];
+    bool found = false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strstr(line, "1 hits, 1 misses") != NULL) {
+            found = true;
+        }
+    }
+    fclose(file);
+    EXPECT_TRUE(found);
+}
+
+// The compiled tables give the same attenuation as the interpolation of the curves.
+TEST(VolumeCurvesForStreamTest, tables_match_curves) {
+    VolumeCurvesForStream curves;
+    sp<VolumeCurve> curve = new VolumeCurve(DEVICE_CATEGORY_SPEAKER, AUDIO_STREAM_MUSIC);
+    curve->add(CurvePoint(1, -5800));
+    curve->add(CurvePoint(20, -4000));
+    curve->add(CurvePoint(60, -1700));
+    curve->add(CurvePoint(100, 0));
+    curves.add(curve);
+
+    for (int indexMax = 7; indexMax <= 25; indexMax += 9) {
+        curves.setVolumeIndexMin(0);
+        curves.setVolumeIndexMax(indexMax);
+        for (int index = 0; index <= indexMax; index++) {
+            EXPECT_EQ(curve->volIndexToDb(index, 0, indexMax),
+                      curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, index))
+                    << "index " << index << " of " << indexMax;
+        }
+    }
+
+    sp<VolumeCurve> flatCurve = new VolumeCurve(DEVICE_CATEGORY_SPEAKER, AUDIO_STREAM_MUSIC);
+    flatCurve->add(CurvePoint(0, -1000));
+    flatCurve->add(CurvePoint(100, -1000));
+    curves.setVolumeCurve(DEVICE_CATEGORY_SPEAKER, flatCurve);
+    EXPECT_EQ(-10.0f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 3));
+}
+
+// Volume key presses while music plays, with the remote submix connected.
+TEST_F(AudioPolicyManagerTest, volume_keys_benchmark) {
+    const int kPresses = 10000;
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(AUDIO_DEVICE_OUT_REMOTE_SUBMIX,
+            AUDIO_POLICY_DEVICE_STATE_AVAILABLE, "0", "remote submix"));
+    audio_io_handle_t output = getOutput(AUDIO_USAGE_MEDIA, (audio_session_t) 1);
+    ASSERT_EQ(NO_ERROR, mManager->startOutput(output, AUDIO_STREAM_MUSIC, (audio_session_t) 1));
+
+    const int indexMin = 0;
+    const int indexMax = 15;
+    mManager->initStreamVolume(AUDIO_STREAM_MUSIC, indexMin, indexMax);
+    nsecs_t startNanos = systemTime();
+    for (int i = 0; i < kPresses; i++) {
+        int index = indexMin + i % (indexMax - indexMin + 1);
+        ASSERT_EQ(NO_ERROR, mManager->setStreamVolumeIndex(AUDIO_STREAM_MUSIC, index,
+                                                           AUDIO_DEVICE_OUT_DEFAULT_FOR_VOLUME));
+    }
+    printf("setStreamVolumeIndex() %.1f usec per key press\n",
+           (systemTime() - startNanos) / 1000.0 / kPresses);
+
+    EXPECT_EQ(NO_ERROR, mManager->stopOutput(output, AUDIO_STREAM_MUSIC, (audio_session_t) 1));
+}
+
+// What the policy manager keeps of a configuration file.
+struct LoadedConfig
+{
+    LoadedConfig() : speakerDrcEnabled(false),
+            config(hwModules, outputDevices, inputDevices, defaultOutputDevice, speakerDrcEnabled,
+                   &volumes) {}
+
+    HwModuleCollection hwModules;
+    DeviceVector outputDevices;
+    DeviceVector inputDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    bool speakerDrcEnabled;
+    VolumeCurvesCollection volumes;
+    AudioPolicyConfig config;
+};
+
+static std::string describeProfiles(AudioProfileVector &profiles) {
+    std::string description;
+    for (size_t i = 0; i < profiles.size(); i++) {
+        const sp<AudioProfile> &profile = profiles[i];
+        description += String8::format(" [%#x%s%s%s", profile->getFormat(),
+                profile->isDynamicFormat() ? " dynamic" : "",
+                profile->isDynamicChannels() ? " dynamic channels" : "",
+                profile->isDynamicRate() ? " dynamic rates" : "").string();
+        for (size_t j = 0; j < profile->getChannels().size(); j++) {
+            description += String8::format(" %#x", profile->getChannels()[j]).string();
+        }
+        for (size_t j = 0; j < profile->getSampleRates().size(); j++) {
+            description += String8::format(" %u", profile->getSampleRates()[j]).string();
+        }
+        description += "]";
+    }
+    return description;
+}
+
+static std::string describeGains(const AudioGainCollection &gains) {
+    std::string description;
+    for (size_t i = 0; i < gains.size(); i++) {
+        description += String8::format(" gain %#x %#x %d..%d", gains[i]->getMode(),
+                gains[i]->getChannelMask(), gains[i]->getMinValueInMb(),
+                gains[i]->getMaxValueInMb()).string();
+    }
+    return description;
+}
+
+// Describes a loaded configuration independently of the order of the devices,
+// which are sorted by address.
+static std::string describe(LoadedConfig &loaded) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < loaded.hwModules.size(); i++) {
+        const sp<HwModule> &module = loaded.hwModules[i];
+        lines.push_back(String8::format("%s: version %u.%u, %zu routes", module->getName(),
+                module->getHalVersionMajor(), module->getHalVersionMinor(),
+                module->getRoutes().size()).string());
+        IOProfileCollection mixPorts;
+        mixPorts.appendVector(module->getOutputProfiles());
+        mixPorts.appendVector(module->getInputProfiles());
+        for (size_t j = 0; j < mixPorts.size(); j++) {
+            const sp<IOProfile> &mixPort = mixPorts[j];
+            lines.push_back(String8::format("%s: mix %s role %d flags %#x devices %#x routes %zu",
+                    module->getName(), mixPort->getName().string(), mixPort->getRole(),
+                    mixPort->getFlags(), mixPort->getSupportedDevicesType(),
+                    mixPort->getRoutes().size()).string() +
+                    describeProfiles(mixPort->getAudioProfiles()) +
+                    describeGains(mixPort->getGains()));
+        }
+        const DeviceVector &devices = module->getDeclaredDevices();
+        for (size_t j = 0; j < devices.size(); j++) {
+            const sp<DeviceDescriptor> &device = devices[j];
+            bool attached = loaded.outputDevices.indexOf(device) >= 0 ||
+                    loaded.inputDevices.indexOf(device) >= 0;
+            lines.push_back(String8::format("%s: device %s type %#x address %s routes %zu%s%s",
+                    module->getName(), device->getTagName().string(), device->type(),
+                    device->mAddress.string(), device->getRoutes().size(),
+                    attached ? " attached" : "",
+                    device == loaded.defaultOutputDevice ? " default" : "").string() +
+                    describeProfiles(device->getAudioProfiles()) +
+                    describeGains(device->getGains()));
+        }
+    }
+    for (size_t i = 0; i < loaded.volumes.size(); i++) {
+        const VolumeCurvesForStream &curves = loaded.volumes.valueAt(i);
+        for (size_t j = 0; j < curves.size(); j++) {
+            const SortedVector<CurvePoint> &points = curves.valueAt(j)->getCurvePoints();
+            std::string line = String8::format("volume %d %d:", loaded.volumes.keyAt(i),
+                                               curves.keyAt(j)).string();
+            for (size_t k = 0; k < points.size(); k++) {
+                line += String8::format(" %u,%d", points[k].mIndex,
+                                        points[k].mAttenuationInMb).string();
+            }
+            lines.push_back(line);
+        }
+    }
+    lines.push_back(loaded.speakerDrcEnabled ? "speaker drc" : "no speaker drc");
+
+    std::sort(lines.begin(), lines.end());
+    std::string description;
+    for (const std::string &line : lines) {
+        description += line + "\n";
+    }
+    return description;
+}
+
+// The compiled configuration loads the same objects as the xml files it was compiled from.
+TEST(PolicyBlobSerializerTest, blob_matches_xml) {
+    const String8 blobFile = getTestFile(BLOB_FILE_NAME);
+    for (const char *name : {CONFIG_FILE_NAME, SHIPPED_CONFIG_FILE_NAME}) {
+        const String8 configFile = getTestFile(name);
+        LoadedConfig fromXml;
+        PolicySerializer serializer;
+        ASSERT_EQ(NO_ERROR, serializer.deserialize(configFile.string(), fromXml.config)) << name;
+        ASSERT_LT(1u, serializer.getSourceFiles().size()) << name;
+
+        PolicyBlobSerializer blobSerializer;
+        ASSERT_EQ(NO_ERROR, blobSerializer.serialize(blobFile.string(),
+                                                     serializer.getSourceFiles(),
+                                                     fromXml.config)) << name;
+        LoadedConfig fromBlob;
+        ASSERT_EQ(NO_ERROR, blobSerializer.deserialize(blobFile.string(), configFile.string(),
+                                                       fromBlob.config)) << name;
+        EXPECT_EQ(describe(fromXml), describe(fromBlob)) << name;
+        EXPECT_NE(0u, fromBlob.outputDevices.size()) << name;
+        EXPECT_TRUE(fromBlob.defaultOutputDevice != 0) << name;
+
+        // a blob is only valid for the configuration it was compiled from
+        LoadedConfig other;
+        EXPECT_EQ(BAD_VALUE, blobSerializer.deserialize(blobFile.string(),
+                getTestFile("other_" SHIPPED_CONFIG_FILE_NAME).string(), other.config)) << name;
+        EXPECT_EQ(0u, other.hwModules.size()) << name;
+    }
+    unlink(blobFile.string());
+}
+
+// A change to any of the source files makes the configuration be parsed again.
+TEST(PolicyBlobSerializerTest, stale_blob_rejected) {
+    const String8 blobFile = getTestFile(BLOB_FILE_NAME);
+    const String8 configFile = getTestFile(CONFIG_FILE_NAME);
+    const String8 includedFile = getTestFile("included.xml");
+    FILE *file = fopen(includedFile.string(), "w");
+    ASSERT_NE(nullptr, file);
+    fputs("<volumes/>\n", file);
+    fclose(file);
+
+    LoadedConfig fromXml;
+    PolicySerializer serializer;
+    ASSERT_EQ(NO_ERROR, serializer.deserialize(configFile.string(), fromXml.config));
+    std::vector<std::string> sourceFiles = serializer.getSourceFiles();
+    sourceFiles.push_back(includedFile.string());
+    PolicyBlobSerializer blobSerializer;
+    ASSERT_EQ(NO_ERROR, blobSerializer.serialize(blobFile.string(), sourceFiles,
+                                                 fromXml.config));
+
+    LoadedConfig fromBlob;
+    EXPECT_EQ(NO_ERROR, blobSerializer.deserialize(blobFile.string(), configFile.string(),
+                                                   fromBlob.config));
+
+    file = fopen(includedFile.string(), "w");
+    ASSERT_NE(nullptr, file);
+    fputs("<volumes></volumes>\n", file);
+    fclose(file);
+    LoadedConfig stale;
+    EXPECT_EQ(BAD_VALUE, blobSerializer.deserialize(blobFile.string(), configFile.string(),
+                                                    stale.config));
+    EXPECT_EQ(0u, stale.hwModules.size());
+
+    unlink(includedFile.string());
+    unlink(blobFile.string());
+    LoadedConfig missing;
+    EXPECT_EQ(NAME_NOT_FOUND, blobSerializer.deserialize(blobFile.string(), configFile.string(),
+                                                         missing.config));
+}
+
+// Startup time of the configuration, parsed from the xml files or loaded from the blob.
+TEST(PolicyBlobSerializerTest, loaders_benchmark) {
+    const int kLoads = 100;
+    const String8 blobFile = getTestFile(BLOB_FILE_NAME);
+    for (const char *name : {CONFIG_FILE_NAME, SHIPPED_CONFIG_FILE_NAME}) {
+        const String8 configFile = getTestFile(name);
+        PolicySerializer serializer;
+        PolicyBlobSerializer blobSerializer;
+        {
+            LoadedConfig loaded;
+            ASSERT_EQ(NO_ERROR, serializer.deserialize(configFile.string(), loaded.config));
+            ASSERT_EQ(NO_ERROR, blobSerializer.serialize(blobFile.string(),
+                                                         serializer.getSourceFiles(),
+                                                         loaded.config));
+        }
+
+        nsecs_t startNanos = systemTime();
+        for (int i = 0; i < kLoads; i++) {
+            LoadedConfig loaded;
+            ASSERT_EQ(NO_ERROR, serializer.deserialize(configFile.string(), loaded.config));
+        }
+        double xmlMicros = (systemTime() - startNanos) / 1000.0 / kLoads;
+
+        startNanos = systemTime();
+        for (int i = 0; i < kLoads; i++) {
+            LoadedConfig loaded;
+            ASSERT_EQ(NO_ERROR, blobSerializer.deserialize(blobFile.string(), configFile.string(),
+                                                           loaded.config));
+        }
+        double blobMicros = (systemTime() - startNanos) / 1000.0 / kLoads;
+
+        printf("%s: xml %.1f usec, blob %.1f usec per load, %.1fx faster\n",
+               name, xmlMicros, blobMicros, xmlMicros / blobMicros);
+        EXPECT_LT(blobMicros, xmlMicros) << name;
+    }
+    unlink(blobFile.string());
+}
@@ -17,7 +17,11 @@
 #define LOG_TAG "MediaLog"
 //#define LOG_NDEBUG 0
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <binder/PermissionCache.h>
 #include <media/nbaio/NBLog.h>
@@ -32,8 +36,19 @@ MediaLogService::MediaLogService() :
     mMergerShared((NBLog::Shared*) malloc(NBLog::Timeline::sharedSize(kMergeBufferSize))),
     mMerger(mMergerShared, kMergeBufferSize),
     mMergeReader(mMergerShared, kMergeBufferSize, mMerger),
-    mMergeThread(new NBLog::MergeThread(mMerger))
+    mMergeThread(new NBLog::MergeThread(mMerger)),
+    mExportFd(-1)
 {
+    // Continuous binary export of all logs, for offline analysis with nblog_analyzer
+    char path[PROPERTY_VALUE_MAX];
+    if (property_get("media.log.export_file", path, NULL) > 0) {
+        mExportFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+        if (mExportFd >= 0) {
+            mMerger.setExportFd(mExportFd);
+        } else {
+            ALOGW("cannot open export file %s: %s", path, strerror(errno));
+        }
+    }
     mMergeThread->run("MergeThread");
 }
 
@@ -42,6 +57,10 @@ MediaLogService::~MediaLogService()
     mMergeThread->requestExit();
     mMergeThread->setTimeoutUs(0);
     mMergeThread->join();
+    if (mExportFd >= 0) {
+        mMerger.setExportFd(-1);
+        close(mExportFd);
+    }
     free(mMergerShared);
 }
 
@@ -101,6 +120,11 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
 
     if (args.size() > 0) {
         const String8 arg0(args[0]);
+        if (!strcmp(arg0.string(), "-b")) {
+            // binary export of the merged log, see NBLogExport.h
+            mMergeReader.exportBinary(fd);
+            return NO_ERROR;
+        }
         if (!strcmp(arg0.string(), "-r")) {
             // needed because mNamedReaders is protected by mLock
             bool locked = dumpTryLock(mLock);
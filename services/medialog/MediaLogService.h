@@ -62,6 +62,7 @@ private:
     NBLog::Merger mMerger;
     NBLog::MergeReader mMergeReader;
     const sp<NBLog::MergeThread> mMergeThread;
+    int mExportFd;      // file opened for continuous export, or -1
 };
 
 }   // namespace android
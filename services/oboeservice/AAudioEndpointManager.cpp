@@ -108,11 +108,17 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::findExclusiveEndpoint_l(
 }
 
 // Try to find an existing endpoint.
+// The streams convert their sample rate and channel count, so any endpoint of the device will do.
 sp<AAudioServiceEndpointShared> AAudioEndpointManager::findSharedEndpoint_l(
         const AAudioStreamConfiguration &configuration) {
+    AAudioStreamConfiguration deviceConfiguration;
+    deviceConfiguration.copyFrom(configuration);
+    deviceConfiguration.setSampleRate(AAUDIO_UNSPECIFIED);
+    deviceConfiguration.setSamplesPerFrame(AAUDIO_UNSPECIFIED);
+
     sp<AAudioServiceEndpointShared> endpoint;
     for (const auto ep  : mSharedStreams) {
-        if (ep->matches(configuration)) {
+        if (ep->matches(deviceConfiguration)) {
             endpoint = ep;
             break;
         }
@@ -29,6 +29,20 @@
 #define AAUDIO_MIXER_ATRACE_ENABLED    1
 #endif
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define USE_NEON (true)
+#include <arm_neon.h>
+#else
+#define USE_NEON (false)
+#endif
+
+#if !USE_NEON && defined(__SSE__)
+#define USE_SSE (true)
+#include <xmmintrin.h>
+#else
+#define USE_SSE (false)
+#endif
+
 using android::WrappingBuffer;
 using android::FifoBuffer;
 using android::fifo_frames_t;
@@ -46,20 +60,19 @@ void AAudioMixer::allocate(int32_t samplesPerFrame, int32_t framesPerBurst) {
 }
 
 void AAudioMixer::clear() {
-    memset(mOutputBuffer, 0, mBufferSizeInBytes);
+    mClearPending = true;
 }
 
 bool AAudioMixer::mix(int trackIndex, FifoBuffer *fifo, float volume) {
     WrappingBuffer wrappingBuffer;
     float *destination = mOutputBuffer;
-    fifo_frames_t framesLeft = mFramesPerBurst;
 
 #if AAUDIO_MIXER_ATRACE_ENABLED
     ATRACE_BEGIN("aaMix");
 #endif /* AAUDIO_MIXER_ATRACE_ENABLED */
 
-    // Gather the data from the client. May be in two parts.
-    fifo_frames_t fullFrames = fifo->getFullDataAvailable(&wrappingBuffer);
+    // Gather the data from the client in place. May be in two parts.
+    fifo_frames_t fullFrames = fifo->beginRead(&wrappingBuffer, mFramesPerBurst);
 #if AAUDIO_MIXER_ATRACE_ENABLED
     if (ATRACE_ENABLED()) {
         char rdyText[] = "aaMixRdy#";
@@ -69,45 +82,109 @@ bool AAudioMixer::mix(int trackIndex, FifoBuffer *fifo, float volume) {
     }
 #else /* MIXER_ATRACE_ENABLED */
     (void) trackIndex;
-    (void) fullFrames;
 #endif /* AAUDIO_MIXER_ATRACE_ENABLED */
 
     // Mix data in one or two parts.
-    int partIndex = 0;
-    while (framesLeft > 0 && partIndex < WrappingBuffer::SIZE) {
-        fifo_frames_t framesToMix = framesLeft;
-        fifo_frames_t framesAvailable = wrappingBuffer.numFrames[partIndex];
-        if (framesAvailable > 0) {
-            if (framesToMix > framesAvailable) {
-                framesToMix = framesAvailable;
+    // The first track overwrites the output, which saves clearing it and reading it back.
+    for (int partIndex = 0; partIndex < WrappingBuffer::SIZE; partIndex++) {
+        fifo_frames_t framesToMix = wrappingBuffer.numFrames[partIndex];
+        if (framesToMix > 0) {
+            if (mClearPending) {
+                copyPart(destination, (const float *)wrappingBuffer.data[partIndex], framesToMix,
+                         volume);
+            } else {
+                mixPart(destination, (const float *)wrappingBuffer.data[partIndex], framesToMix,
+                        volume);
             }
-            mixPart(destination, (float *)wrappingBuffer.data[partIndex], framesToMix, volume);
-
             destination += framesToMix * mSamplesPerFrame;
-            framesLeft -= framesToMix;
         }
-        partIndex++;
+    }
+    if (mClearPending) {
+        float *end = mOutputBuffer + mFramesPerBurst * mSamplesPerFrame;
+        memset(destination, 0, (end - destination) * sizeof(float));
+        mClearPending = false;
     }
     // Always advance by one burst even if we do not have the data.
     // Otherwise the stream timing will drift whenever there is an underflow.
     // This actual underflow can then be detected by the client for XRun counting.
-    fifo->getFifoControllerBase()->advanceReadIndex(mFramesPerBurst);
+    fifo->endRead(mFramesPerBurst);
 
 #if AAUDIO_MIXER_ATRACE_ENABLED
     ATRACE_END();
 #endif /* AAUDIO_MIXER_ATRACE_ENABLED */
 
-    return (framesLeft > 0); // did not get all the frames we needed, ie. "underflow"
+    return (fullFrames < mFramesPerBurst); // did not get all the frames we needed, ie. "underflow"
 }
 
-void AAudioMixer::mixPart(float *destination, float *source, int32_t numFrames, float volume) {
+void AAudioMixer::mix(int trackIndex, const float *buffer, float volume) {
+    (void) trackIndex;
+    if (mClearPending) {
+        copyPart(mOutputBuffer, buffer, mFramesPerBurst, volume);
+        mClearPending = false;
+    } else {
+        mixPart(mOutputBuffer, buffer, mFramesPerBurst, volume);
+    }
+}
+
+void AAudioMixer::mixPart(float *destination, const float *source, int32_t numFrames,
+                          float volume) {
     int32_t numSamples = numFrames * mSamplesPerFrame;
-    // TODO maybe optimize using SIMD
-    for (int sampleIndex = 0; sampleIndex < numSamples; sampleIndex++) {
-        *destination++ += *source++ * volume;
+    float * __restrict dst = destination;
+    const float * __restrict src = source;
+#if USE_NEON
+    for (; numSamples >= 8; numSamples -= 8) {
+        vst1q_f32(dst, vmlaq_n_f32(vld1q_f32(dst), vld1q_f32(src), volume));
+        vst1q_f32(dst + 4, vmlaq_n_f32(vld1q_f32(dst + 4), vld1q_f32(src + 4), volume));
+        dst += 8;
+        src += 8;
+    }
+#elif USE_SSE
+    const __m128 volumes = _mm_set1_ps(volume);
+    for (; numSamples >= 8; numSamples -= 8) {
+        _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst),
+                                      _mm_mul_ps(_mm_loadu_ps(src), volumes)));
+        _mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4),
+                                          _mm_mul_ps(_mm_loadu_ps(src + 4), volumes)));
+        dst += 8;
+        src += 8;
+    }
+#endif
+    for (; numSamples > 0; numSamples--) {
+        *dst++ += *src++ * volume;
+    }
+}
+
+void AAudioMixer::copyPart(float *destination, const float *source, int32_t numFrames,
+                           float volume) {
+    int32_t numSamples = numFrames * mSamplesPerFrame;
+    float * __restrict dst = destination;
+    const float * __restrict src = source;
+#if USE_NEON
+    for (; numSamples >= 8; numSamples -= 8) {
+        vst1q_f32(dst, vmulq_n_f32(vld1q_f32(src), volume));
+        vst1q_f32(dst + 4, vmulq_n_f32(vld1q_f32(src + 4), volume));
+        dst += 8;
+        src += 8;
+    }
+#elif USE_SSE
+    const __m128 volumes = _mm_set1_ps(volume);
+    for (; numSamples >= 8; numSamples -= 8) {
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_loadu_ps(src), volumes));
+        _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_loadu_ps(src + 4), volumes));
+        dst += 8;
+        src += 8;
+    }
+#endif
+    for (; numSamples > 0; numSamples--) {
+        *dst++ = *src++ * volume;
     }
 }
 
 float *AAudioMixer::getOutputBuffer() {
+    if (mClearPending) {
+        // No track was mixed so output silence.
+        memset(mOutputBuffer, 0, mBufferSizeInBytes);
+        mClearPending = false;
+    }
     return mOutputBuffer;
 }
@@ -29,6 +29,9 @@ public:
 
     void allocate(int32_t samplesPerFrame, int32_t framesPerBurst);
 
+    /**
+     * Start a new mix. The output buffer is only cleared if no track gets mixed.
+     */
     void clear();
 
     /**
@@ -39,15 +42,26 @@ public:
      */
     bool mix(int trackIndex, android::FifoBuffer *fifo, float volume);
 
-    void mixPart(float *destination, float *source, int32_t numFrames, float volume);
+    /**
+     * Mix one burst that was already converted to the format of the mixer.
+     * @param buffer
+     * @param volume
+     */
+    void mix(int trackIndex, const float *buffer, float volume);
+
+    void mixPart(float *destination, const float *source, int32_t numFrames, float volume);
 
     float *getOutputBuffer();
 
 private:
+    // Like mixPart() but overwrites the destination, for the first track of a mix.
+    void copyPart(float *destination, const float *source, int32_t numFrames, float volume);
+
     float   *mOutputBuffer = nullptr;
     int32_t  mSamplesPerFrame = 0;
     int32_t  mFramesPerBurst = 0;
     int32_t  mBufferSizeInBytes = 0;
+    bool     mClearPending = false; // nothing mixed since clear()
 };
 
 
@@ -31,6 +31,7 @@
 #include "AAudioServiceStreamShared.h"
 #include "AAudioServiceEndpointCapture.h"
 #include "AAudioServiceEndpointShared.h"
+#include "AAudioStreamConverter.h"
 
 using namespace android;  // TODO just import names needed
 using namespace aaudio;   // TODO just import names needed
@@ -99,10 +100,18 @@ void *AAudioServiceEndpointCapture::callbackLoop() {
                             // vs the underlying MMAP stream.
                             clientFramesWritten = fifo->getWriteCounter();
                             // There are two indices that refer to the same frame.
-                            int64_t positionOffset = mmapFramesRead - clientFramesWritten;
+                            int64_t positionOffset =
+                                    streamShared->convertEndpointPosition(mmapFramesRead)
+                                    - clientFramesWritten;
                             streamShared->setTimestampPositionOffset(positionOffset);
 
-                            if (fifo->getFifoControllerBase()->getEmptyFramesAvailable() <
+                            AAudioStreamConverter *converter = streamShared->getConverter_l();
+                            if (converter != nullptr) {
+                                if (!converter->writeToClient(
+                                        fifo, (const float *) mDistributionBuffer)) {
+                                    underflowCount++;
+                                }
+                            } else if (fifo->getFifoControllerBase()->getEmptyFramesAvailable() <
                                 getFramesPerBurst()) {
                                 underflowCount++;
                             } else {
@@ -34,6 +34,7 @@
 #include "AAudioServiceStreamShared.h"
 #include "AAudioServiceEndpointPlay.h"
 #include "AAudioServiceEndpointShared.h"
+#include "AAudioStreamConverter.h"
 
 using namespace android;  // TODO just import names needed
 using namespace aaudio;   // TODO just import names needed
@@ -101,11 +102,20 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
                         // vs the underlying MMAP stream.
                         clientFramesRead = fifo->getReadCounter();
                         // These two indices refer to the same frame.
-                        int64_t positionOffset = mmapFramesWritten - clientFramesRead;
+                        int64_t positionOffset =
+                                streamShared->convertEndpointPosition(mmapFramesWritten)
+                                - clientFramesRead;
                         streamShared->setTimestampPositionOffset(positionOffset);
 
                         float volume = 1.0; // to match legacy volume
-                        bool underflowed = mMixer.mix(index, fifo, volume);
+                        bool underflowed;
+                        AAudioStreamConverter *converter = streamShared->getConverter_l();
+                        if (converter == nullptr) {
+                            underflowed = mMixer.mix(index, fifo, volume);
+                        } else {
+                            underflowed = converter->readFromClient(fifo);
+                            mMixer.mix(index, converter->getBuffer(), volume);
+                        }
                         if (underflowed) {
                             streamShared->incrementXRunCount();
                         }
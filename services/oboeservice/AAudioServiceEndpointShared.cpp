@@ -68,6 +68,8 @@ aaudio_result_t AAudioServiceEndpointShared::open(const aaudio::AAudioStreamRequ
     builder.setSharingModeMatchRequired(true);
     builder.setDeviceId(mRequestedDeviceId);
     builder.setFormat(configuration.getFormat());
+    // Open in the configuration of the first stream, as before, so that it needs no conversion.
+    // The streams that share the endpoint later convert to or from it if needed.
     builder.setSampleRate(configuration.getSampleRate());
     builder.setSamplesPerFrame(configuration.getSamplesPerFrame());
     builder.setDirection(configuration.getDirection());
@@ -174,6 +174,10 @@ aaudio_result_t AAudioServiceStreamBase::start() {
 
     // Start with fresh presentation timestamps.
     mAtomicTimestamp.clear();
+    {
+        std::lock_guard<std::mutex> lock(mTimestampFilterLock);
+        mTimestampFilter.reset(getSampleRate());
+    }
 
     mClientHandle = AUDIO_PORT_HANDLE_NONE;
     result = startDevice();
@@ -298,6 +302,13 @@ void AAudioServiceStreamBase::run() {
             AudioClock::sleepUntilNanoTime(nextTime);
         }
     }
+    {
+        std::lock_guard<std::mutex> lock(mTimestampFilterLock);
+        if (mTimestampFilter.isValid()) {
+            ALOGD("AAudioServiceStreamBase::run() device drift %.1f ppm",
+                  mTimestampFilter.getDriftPpm());
+        }
+    }
     ALOGD("AAudioServiceStreamBase::run() exiting ----------------");
 }
 
@@ -339,6 +350,7 @@ aaudio_result_t AAudioServiceStreamBase::sendCurrentTimestamp() {
     // Send a timestamp for the clock model.
     aaudio_result_t result = getFreeRunningPosition(&command.timestamp.position,
                                                     &command.timestamp.timestamp);
+    command.timestamp.rate = 0.0;
     if (result == AAUDIO_OK) {
         ALOGV("sendCurrentTimestamp() SERVICE  %8lld at %lld",
               (long long) command.timestamp.position,
@@ -351,6 +363,7 @@ aaudio_result_t AAudioServiceStreamBase::sendCurrentTimestamp() {
             result = getHardwareTimestamp(&command.timestamp.position,
                                           &command.timestamp.timestamp);
             if (result == AAUDIO_OK) {
+                filterHardwareTimestamp(&command.timestamp);
                 ALOGV("sendCurrentTimestamp() HARDWARE %8lld at %lld",
                       (long long) command.timestamp.position,
                       (long long) command.timestamp.timestamp);
@@ -366,6 +379,19 @@ aaudio_result_t AAudioServiceStreamBase::sendCurrentTimestamp() {
     return result;
 }
 
+// The raw position jitters by up to a burst of the HAL so send the filtered one.
+void AAudioServiceStreamBase::filterHardwareTimestamp(AAudioMessageTimestamp *timestamp) {
+    std::lock_guard<std::mutex> lock(mTimestampFilterLock);
+    if (!mTimestampFilter.processTimestamp(timestamp->position, timestamp->timestamp)
+            && !mTimestampFilter.isValid()) {
+        return;
+    }
+    // An outlier is replaced by the latest estimate.
+    timestamp->position = mTimestampFilter.getPosition();
+    timestamp->timestamp = mTimestampFilter.getNanoseconds();
+    timestamp->rate = mTimestampFilter.getFramesPerSecond();
+}
+
 /**
  * Get an immutable description of the in-memory queues
  * used to communicate with the underlying HAL or Service.
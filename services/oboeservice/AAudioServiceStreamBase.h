@@ -32,6 +32,7 @@
 
 #include "SharedRingBuffer.h"
 #include "AAudioThread.h"
+#include "TimestampFilter.h"
 
 namespace android {
     class AAudioService;
@@ -204,6 +205,8 @@ protected:
 
     aaudio_result_t sendCurrentTimestamp();
 
+    void filterHardwareTimestamp(AAudioMessageTimestamp *timestamp);
+
     /**
      * @param positionFrames
      * @param timeNanos
@@ -232,6 +235,11 @@ protected:
 
     SimpleDoubleBuffer<Timestamp>  mAtomicTimestamp;
 
+    // Smooths the hardware timestamps and measures the drift of the device.
+    // Timestamps are sent by the timestamp thread, and by pause() and stop().
+    TimestampFilter         mTimestampFilter;
+    std::mutex              mTimestampFilterLock;
+
     android::AAudioService &mAudioService;
     android::sp<AAudioServiceEndpoint> mServiceEndpoint;
 
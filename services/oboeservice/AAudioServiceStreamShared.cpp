@@ -32,6 +32,7 @@
 #include "AAudioEndpointManager.h"
 #include "AAudioService.h"
 #include "AAudioServiceEndpoint.h"
+#include "AAudioStreamConverter.h"
 
 using namespace android;
 using namespace aaudio;
@@ -50,26 +51,51 @@ AAudioServiceStreamShared::AAudioServiceStreamShared(AAudioService &audioService
 std::string AAudioServiceStreamShared::dumpHeader() {
     std::stringstream result;
     result << AAudioServiceStreamBase::dumpHeader();
-    result << "    Write#     Read#   Avail   XRuns";
+    result << "    Write#     Read#   Avail   XRuns Conversion";
     return result.str();
 }
 
 std::string AAudioServiceStreamShared::dump() const {
     std::stringstream result;
 
+    // The endpoint thread holds this lock for one burst at most, so do not wait for long.
+    const bool isLocked = AAudio_tryUntilTrue(
+            [this]()->bool { return mAudioDataQueueLock.try_lock(); } /* f */,
+            5 /* times */,
+            2 /* sleepMs */);
+    if (!isLocked) {
+        result << "AAudioServiceStreamShared may be deadlocked\n";
+    }
+
     result << AAudioServiceStreamBase::dump();
 
-    auto fifo = mAudioDataQueue->getFifoBuffer();
-    int32_t readCounter = fifo->getReadCounter();
-    int32_t writeCounter = fifo->getWriteCounter();
-    result << std::setw(10) << writeCounter;
-    result << std::setw(10) << readCounter;
-    result << std::setw(8) << (writeCounter - readCounter);
-    result << std::setw(8) << getXRunCount();
+    if (mAudioDataQueue != nullptr) {
+        auto fifo = mAudioDataQueue->getFifoBuffer();
+        int32_t readCounter = fifo->getReadCounter();
+        int32_t writeCounter = fifo->getWriteCounter();
+        result << std::setw(10) << writeCounter;
+        result << std::setw(10) << readCounter;
+        result << std::setw(8) << (writeCounter - readCounter);
+        result << std::setw(8) << getXRunCount();
+        // Rates, channels and the time spent converting each burst of the endpoint.
+        if (mConverter != nullptr) {
+            result << mConverter->dump();
+        }
+    }
 
+    if (isLocked) {
+        mAudioDataQueueLock.unlock();
+    }
     return result.str();
 }
 
+int64_t AAudioServiceStreamShared::convertEndpointPosition(int64_t endpointFrames) const {
+    if (mEndpointSampleRate == getSampleRate()) {
+        return endpointFrames;
+    }
+    return endpointFrames * getSampleRate() / mEndpointSampleRate;
+}
+
 int32_t AAudioServiceStreamShared::calculateBufferCapacity(int32_t requestedCapacityFrames,
                                                            int32_t framesPerBurst) {
 
@@ -139,24 +165,20 @@ aaudio_result_t AAudioServiceStreamShared::open(const aaudio::AAudioStreamReques
         goto error;
     }
 
+    // A different rate or channel count is converted by the service.
+    mEndpointSampleRate = mServiceEndpoint->getSampleRate();
     setSampleRate(configurationInput.getSampleRate());
     if (getSampleRate() == AAUDIO_UNSPECIFIED) {
-        setSampleRate(mServiceEndpoint->getSampleRate());
-    } else if (getSampleRate() != mServiceEndpoint->getSampleRate()) {
-        ALOGE("AAudioServiceStreamShared::open() mSampleRate = %d, need %d",
-              getSampleRate(), mServiceEndpoint->getSampleRate());
-        result = AAUDIO_ERROR_INVALID_RATE;
-        goto error;
+        setSampleRate(mEndpointSampleRate);
+    } else if (getSampleRate() != mEndpointSampleRate) {
+        // The client transfers this many frames for each burst of the endpoint.
+        mFramesPerBurst = (int32_t) (((int64_t) mFramesPerBurst * getSampleRate()
+                                      + mEndpointSampleRate - 1) / mEndpointSampleRate);
     }
 
     setSamplesPerFrame(configurationInput.getSamplesPerFrame());
     if (getSamplesPerFrame() == AAUDIO_UNSPECIFIED) {
         setSamplesPerFrame(mServiceEndpoint->getSamplesPerFrame());
-    } else if (getSamplesPerFrame() != mServiceEndpoint->getSamplesPerFrame()) {
-        ALOGE("AAudioServiceStreamShared::open() mSamplesPerFrame = %d, need %d",
-              getSamplesPerFrame(), mServiceEndpoint->getSamplesPerFrame());
-        result = AAUDIO_ERROR_OUT_OF_RANGE;
-        goto error;
     }
 
     setBufferCapacity(calculateBufferCapacity(configurationInput.getBufferCapacity(),
@@ -178,6 +200,18 @@ aaudio_result_t AAudioServiceStreamShared::open(const aaudio::AAudioStreamReques
             result = AAUDIO_ERROR_NO_MEMORY;
             goto error;
         }
+
+        if (getSampleRate() != mEndpointSampleRate
+                || getSamplesPerFrame() != mServiceEndpoint->getSamplesPerFrame()) {
+            mConverter = new AAudioStreamConverter();
+            result = mConverter->open(getDirection(),
+                                      getSampleRate(), getSamplesPerFrame(),
+                                      mEndpointSampleRate, mServiceEndpoint->getSamplesPerFrame(),
+                                      mServiceEndpoint->getFramesPerBurst());
+            if (result != AAUDIO_OK) {
+                goto error;
+            }
+        }
     }
 
     ALOGD("AAudioServiceStreamShared::open() actual rate = %d, channels = %d, deviceId = %d",
@@ -204,6 +238,8 @@ aaudio_result_t AAudioServiceStreamShared::close()  {
         std::lock_guard<std::mutex> lock(mAudioDataQueueLock);
         delete mAudioDataQueue;
         mAudioDataQueue = nullptr;
+        delete mConverter;
+        mConverter = nullptr;
     }
 
     return result;
@@ -229,6 +265,13 @@ aaudio_result_t AAudioServiceStreamShared::getAudioDataDescription(
 
 void AAudioServiceStreamShared::markTransferTime(Timestamp &timestamp) {
     mAtomicTimestamp.write(timestamp);
+    // Also share it with the client through the data queue, so it does not have to wait
+    // for the next TIMESTAMP_SERVICE message.
+    std::lock_guard<std::mutex> lock(mAudioDataQueueLock);
+    if (mAudioDataQueue != nullptr) {
+        mAudioDataQueue->getFifoBuffer()->publishTimestamp(timestamp.getPosition(),
+                                                           timestamp.getNanoseconds());
+    }
 }
 
 // Get timestamp that was written by mixer or distributor.
@@ -252,6 +295,7 @@ aaudio_result_t AAudioServiceStreamShared::getHardwareTimestamp(int64_t *positio
     int64_t position = 0;
     aaudio_result_t result = mServiceEndpoint->getTimestamp(&position, timeNanos);
     if (result == AAUDIO_OK) {
+        position = convertEndpointPosition(position);
         int64_t offset = mTimestampPositionOffset.load();
         // TODO, do not go below starting value
         position -= offset; // Offset from shared MMAP stream
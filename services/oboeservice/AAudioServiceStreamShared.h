@@ -33,6 +33,7 @@ namespace aaudio {
 
 class AAudioEndpointManager;
 class AAudioServiceEndpoint;
+class AAudioStreamConverter;
 class SharedRingBuffer;
 
 /**
@@ -70,6 +71,17 @@ public:
                                                       ? nullptr
                                                       : mAudioDataQueue->getFifoBuffer(); }
 
+    /**
+     * This must only be called under getAudioDataQueueLock().
+     * @return converter to the format of the endpoint, or nullptr if the formats match
+     */
+    AAudioStreamConverter *getConverter_l() { return mConverter; }
+
+    /**
+     * Convert a position of the endpoint to the sample rate of this stream.
+     */
+    int64_t convertEndpointPosition(int64_t endpointFrames) const;
+
     /* Keep a record of when a buffer transfer completed.
      * This allows for a more accurate timing model.
      */
@@ -105,7 +117,9 @@ protected:
 
 private:
     SharedRingBuffer        *mAudioDataQueue = nullptr; // protected by mAudioDataQueueLock
-    std::mutex               mAudioDataQueueLock;
+    AAudioStreamConverter   *mConverter = nullptr; // protected by mAudioDataQueueLock
+    mutable std::mutex       mAudioDataQueueLock;
+    int32_t                  mEndpointSampleRate = 0;
 
     std::atomic<int64_t>     mTimestampPositionOffset;
     std::atomic<int32_t>     mXRunCount;
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AAudioStreamConverter"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <media/RecordBufferConverter.h>
+#include <system/audio.h>
+#include <utility/AudioClock.h>
+
+#include "AAudioStreamConverter.h"
+
+using namespace android;
+using namespace aaudio;
+
+// Bursts of an input endpoint that can wait for the resampler.
+#define INPUT_FIFO_BURSTS   4
+
+// The converter works with input channel masks.
+// Mono and stereo use the legacy up and down mix, other channel counts are mapped by index.
+static audio_channel_mask_t channelMaskFromCount(int32_t samplesPerFrame) {
+    if (samplesPerFrame <= 2) {
+        return audio_channel_in_mask_from_count(samplesPerFrame);
+    }
+    return audio_channel_mask_for_index_assignment_from_count(samplesPerFrame);
+}
+
+AAudioStreamConverter::AAudioStreamConverter()
+        : mConversionCount(0)
+        , mConversionNanos(0)
+        , mMaxConversionNanos(0) {
+}
+
+AAudioStreamConverter::~AAudioStreamConverter() {
+    delete mConverter;
+    delete mInputFifo;
+    delete[] mSilence;
+    delete[] mBuffer;
+}
+
+aaudio_result_t AAudioStreamConverter::open(aaudio_direction_t direction,
+                                            int32_t clientSampleRate,
+                                            int32_t clientSamplesPerFrame,
+                                            int32_t endpointSampleRate,
+                                            int32_t endpointSamplesPerFrame,
+                                            int32_t endpointFramesPerBurst) {
+    mDirection = direction;
+    mClientSampleRate = clientSampleRate;
+    mClientSamplesPerFrame = clientSamplesPerFrame;
+    mEndpointSampleRate = endpointSampleRate;
+    mEndpointSamplesPerFrame = endpointSamplesPerFrame;
+    mEndpointFramesPerBurst = endpointFramesPerBurst;
+
+    audio_channel_mask_t clientChannelMask = channelMaskFromCount(clientSamplesPerFrame);
+    audio_channel_mask_t endpointChannelMask = channelMaskFromCount(endpointSamplesPerFrame);
+    if (direction == AAUDIO_DIRECTION_OUTPUT) {
+        mConverter = new RecordBufferConverter(
+                clientChannelMask, AUDIO_FORMAT_PCM_FLOAT, clientSampleRate,
+                endpointChannelMask, AUDIO_FORMAT_PCM_FLOAT, endpointSampleRate);
+    } else {
+        mConverter = new RecordBufferConverter(
+                endpointChannelMask, AUDIO_FORMAT_PCM_FLOAT, endpointSampleRate,
+                clientChannelMask, AUDIO_FORMAT_PCM_FLOAT, clientSampleRate);
+    }
+    if (mConverter->initCheck() != NO_ERROR) {
+        ALOGE("AAudioStreamConverter::open() cannot convert %d Hz %d channels to %d Hz %d channels",
+              clientSampleRate, clientSamplesPerFrame,
+              endpointSampleRate, endpointSamplesPerFrame);
+        return AAUDIO_ERROR_OUT_OF_RANGE;
+    }
+
+    // Round up, and allow for the phase of the resampler.
+    mClientFramesPerBurst = (int32_t) (((int64_t) endpointFramesPerBurst * clientSampleRate
+                                        + endpointSampleRate - 1) / endpointSampleRate) + 1;
+
+    if (direction == AAUDIO_DIRECTION_OUTPUT) {
+        mBuffer = new float[endpointFramesPerBurst * endpointSamplesPerFrame];
+        mSilenceFrames = mClientFramesPerBurst;
+        mSilence = new float[mSilenceFrames * clientSamplesPerFrame];
+        memset(mSilence, 0, mSilenceFrames * clientSamplesPerFrame * sizeof(float));
+    } else {
+        mBuffer = new float[mClientFramesPerBurst * clientSamplesPerFrame];
+        mInputFifo = new FifoBuffer(endpointSamplesPerFrame * sizeof(float),
+                                    INPUT_FIFO_BURSTS * endpointFramesPerBurst);
+        mSourceFifo = mInputFifo;
+    }
+    ALOGD("AAudioStreamConverter::open() %s %d Hz %d channels, endpoint %d Hz %d channels",
+          (direction == AAUDIO_DIRECTION_OUTPUT) ? "output" : "input",
+          clientSampleRate, clientSamplesPerFrame, endpointSampleRate, endpointSamplesPerFrame);
+    return AAUDIO_OK;
+}
+
+bool AAudioStreamConverter::readFromClient(FifoBuffer *fifo) {
+    int64_t startNanos = AudioClock::getNanoseconds();
+    mSourceFifo = fifo;
+    mUnderflowed = false;
+    size_t framesConverted = mConverter->convert(mBuffer, this, mEndpointFramesPerBurst);
+    if (framesConverted < (size_t) mEndpointFramesPerBurst) {
+        // Should not happen because underflows are filled with silence.
+        int32_t samplesConverted = framesConverted * mEndpointSamplesPerFrame;
+        memset(&mBuffer[samplesConverted], 0,
+               (mEndpointFramesPerBurst * mEndpointSamplesPerFrame - samplesConverted)
+               * sizeof(float));
+        mUnderflowed = true;
+    }
+    mSourceFifo = nullptr;
+    addCost(AudioClock::getNanoseconds() - startNanos);
+    return mUnderflowed;
+}
+
+bool AAudioStreamConverter::writeToClient(FifoBuffer *fifo, const float *buffer) {
+    int64_t startNanos = AudioClock::getNanoseconds();
+    mInputFifo->write(buffer, mEndpointFramesPerBurst);
+    mEndpointFramesConverted += mEndpointFramesPerBurst;
+
+    // Produce the client frames that correspond to the endpoint frames so far.
+    // Stay one frame behind so that the resampler never runs out of data,
+    // because it would then reset its history and cause a glitch.
+    int64_t clientFramesDue = (mEndpointFramesConverted * mClientSampleRate / mEndpointSampleRate)
+                              - 1 - mClientFramesConverted;
+    size_t framesToConvert = (size_t) std::max((int64_t) 0,
+            std::min(clientFramesDue, (int64_t) mClientFramesPerBurst));
+    size_t framesConverted = mConverter->convert(mBuffer, this, framesToConvert);
+    mClientFramesConverted += framesConverted;
+
+    bool written = false;
+    if (fifo->getFifoControllerBase()->getEmptyFramesAvailable() >=
+            (fifo_frames_t) framesConverted) {
+        fifo->write(mBuffer, framesConverted);
+        written = true;
+    }
+    addCost(AudioClock::getNanoseconds() - startNanos);
+    return written;
+}
+
+status_t AAudioStreamConverter::getNextBuffer(AudioBufferProvider::Buffer *buffer) {
+    WrappingBuffer wrappingBuffer;
+    fifo_frames_t framesAvailable = mSourceFifo->beginRead(&wrappingBuffer,
+                                                           (fifo_frames_t) buffer->frameCount);
+    if (framesAvailable > 0) {
+        // Just the first part, the converter asks again for the rest.
+        buffer->raw = wrappingBuffer.data[0];
+        buffer->frameCount = wrappingBuffer.numFrames[0];
+        return NO_ERROR;
+    } else if (mSilence != nullptr) {
+        // The silence is consumed from the FIFO like real data.
+        mUnderflowed = true;
+        buffer->raw = mSilence;
+        buffer->frameCount = std::min(buffer->frameCount, (size_t) mSilenceFrames);
+        return NO_ERROR;
+    }
+    buffer->raw = nullptr;
+    buffer->frameCount = 0;
+    return NOT_ENOUGH_DATA;
+}
+
+void AAudioStreamConverter::releaseBuffer(AudioBufferProvider::Buffer *buffer) {
+    mSourceFifo->endRead((fifo_frames_t) buffer->frameCount);
+    buffer->frameCount = 0;
+}
+
+void AAudioStreamConverter::addCost(int64_t nanoseconds) {
+    mConversionCount++;
+    mConversionNanos += nanoseconds;
+    if (nanoseconds > mMaxConversionNanos.load()) {
+        mMaxConversionNanos.store(nanoseconds);
+    }
+}
+
+std::string AAudioStreamConverter::dump() const {
+    std::stringstream result;
+    int64_t count = mConversionCount.load();
+    int64_t nanos = mConversionNanos.load();
+    result << " " << mClientSampleRate << "/" << mClientSamplesPerFrame
+           << ((mDirection == AAUDIO_DIRECTION_OUTPUT) ? ">" : "<")
+           << mEndpointSampleRate << "/" << mEndpointSamplesPerFrame;
+    if (count > 0) {
+        // Compare the time spent converting with the duration of the converted bursts.
+        double burstNanos = (double) AAUDIO_NANOS_PER_SECOND * mEndpointFramesPerBurst
+                            / mEndpointSampleRate;
+        double averageMicros = (double) nanos / count / 1000.0;
+        result << std::fixed << std::setprecision(1)
+               << " " << averageMicros << "us"
+               << " max " << (mMaxConversionNanos.load() / 1000.0) << "us"
+               << std::setprecision(2)
+               << " " << (100.0 * nanos / (burstNanos * count)) << "%";
+    }
+    return result.str();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_AAUDIO_STREAM_CONVERTER_H
+#define AAUDIO_AAUDIO_STREAM_CONVERTER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#include <aaudio/AAudio.h>
+#include <fifo/FifoBuffer.h>
+#include <media/AudioBufferProvider.h>
+
+namespace android {
+class RecordBufferConverter;
+}
+
+namespace aaudio {
+
+/**
+ * Convert the sample rate and channel count of a shared stream
+ * to or from those of its endpoint.
+ *
+ * For output, the mixer reads one burst of the endpoint from the converter,
+ * which reads as many frames as needed from the FIFO of the client.
+ * For input, each burst read from the endpoint is converted and written to the FIFO
+ * of the client.
+ *
+ * The data is always float. The conversion is done by a RecordBufferConverter,
+ * which uses the dynamic resampler and remixes before resampling when that is cheaper.
+ *
+ * This must only be used under the data queue lock of the stream.
+ */
+class AAudioStreamConverter : public android::AudioBufferProvider {
+public:
+    AAudioStreamConverter();
+    virtual ~AAudioStreamConverter();
+
+    /**
+     * @param direction of the stream
+     * @param clientSampleRate
+     * @param clientSamplesPerFrame
+     * @param endpointSampleRate
+     * @param endpointSamplesPerFrame
+     * @param endpointFramesPerBurst number of frames transferred with the endpoint at once
+     * @return AAUDIO_OK or a negative error
+     */
+    aaudio_result_t open(aaudio_direction_t direction,
+                         int32_t clientSampleRate,
+                         int32_t clientSamplesPerFrame,
+                         int32_t endpointSampleRate,
+                         int32_t endpointSamplesPerFrame,
+                         int32_t endpointFramesPerBurst);
+
+    /**
+     * Convert one burst of the endpoint from the FIFO of an output stream.
+     * Missing frames are replaced by silence and still consumed, like the mixer does,
+     * so that the stream timing does not drift.
+     *
+     * @param fifo of the client
+     * @return true if the FIFO underflowed
+     */
+    bool readFromClient(android::FifoBuffer *fifo);
+
+    /**
+     * @return the burst converted by readFromClient()
+     */
+    const float *getBuffer() const {
+        return mBuffer;
+    }
+
+    /**
+     * Convert one burst of the endpoint into the FIFO of an input stream.
+     *
+     * @param fifo of the client
+     * @param buffer containing one burst of the endpoint
+     * @return false if there was no room in the FIFO and the data was dropped
+     */
+    bool writeToClient(android::FifoBuffer *fifo, const float *buffer);
+
+    /**
+     * @return the largest number of client frames read or written for one burst of the endpoint
+     */
+    int32_t getClientFramesPerBurst() const {
+        return mClientFramesPerBurst;
+    }
+
+    /**
+     * @return a description of the conversion and its cost, for dumpsys
+     */
+    std::string dump() const;
+
+    // AudioBufferProvider interface, used by the RecordBufferConverter.
+    android::status_t getNextBuffer(android::AudioBufferProvider::Buffer *buffer) override;
+
+    void releaseBuffer(android::AudioBufferProvider::Buffer *buffer) override;
+
+private:
+    void addCost(int64_t nanoseconds);
+
+    android::RecordBufferConverter *mConverter = nullptr;
+
+    // Source of the converter, either the FIFO of an output client
+    // or mInputFifo for an input stream.
+    android::FifoBuffer            *mSourceFifo = nullptr;
+    // Holds the bursts of an input endpoint until the resampler has consumed them.
+    android::FifoBuffer            *mInputFifo = nullptr;
+    // Given to the converter when an output client underflows.
+    float                          *mSilence = nullptr;
+    int32_t                         mSilenceFrames = 0;
+    bool                            mUnderflowed = false;
+
+    // Converted burst of an output stream, or data for an input client.
+    float                          *mBuffer = nullptr;
+
+    aaudio_direction_t              mDirection = AAUDIO_DIRECTION_OUTPUT;
+    int32_t                         mClientSampleRate = 0;
+    int32_t                         mClientSamplesPerFrame = 0;
+    int32_t                         mEndpointSampleRate = 0;
+    int32_t                         mEndpointSamplesPerFrame = 0;
+    int32_t                         mEndpointFramesPerBurst = 0;
+    int32_t                         mClientFramesPerBurst = 0;
+
+    // Frames of an input stream, to produce the exact number of client frames over time.
+    int64_t                         mEndpointFramesConverted = 0;
+    int64_t                         mClientFramesConverted = 0;
+
+    // Cost of the conversion, read by dump() from another thread.
+    std::atomic<int64_t>            mConversionCount;
+    std::atomic<int64_t>            mConversionNanos;
+    std::atomic<int64_t>            mMaxConversionNanos;
+};
+
+} /* namespace aaudio */
+
+#endif //AAUDIO_AAUDIO_STREAM_CONVERTER_H
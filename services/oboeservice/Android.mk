@@ -16,6 +16,7 @@ LOCAL_C_INCLUDES := \
     system/core/base/include \
     $(TOP)/frameworks/native/media/libaaudio/include/include \
     $(TOP)/frameworks/av/media/libaaudio/include \
+    $(TOP)/frameworks/av/media/libmedia/include \
     $(TOP)/frameworks/av/media/utils/include \
     frameworks/native/include \
     $(TOP)/external/tinyalsa/include \
@@ -36,7 +37,9 @@ LOCAL_SRC_FILES += \
     AAudioServiceStreamBase.cpp \
     AAudioServiceStreamMMAP.cpp \
     AAudioServiceStreamShared.cpp \
+    AAudioStreamConverter.cpp \
     AAudioStreamTracker.cpp \
+    TimestampFilter.cpp \
     TimestampScheduler.cpp \
     AAudioThread.cpp
 
@@ -50,6 +53,7 @@ LOCAL_SHARED_LIBRARIES :=  \
     libaaudio \
     libaudioflinger \
     libaudioclient \
+    libaudioprocessing \
     libbinder \
     libcutils \
     libmediautils \
@@ -60,3 +64,5 @@ LOCAL_SHARED_LIBRARIES :=  \
 include $(BUILD_SHARED_LIBRARY)
 
 
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
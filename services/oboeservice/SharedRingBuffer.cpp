@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <new>
 #include <sys/mman.h>
 
 #include "binding/RingBufferParcelable.h"
@@ -41,9 +42,10 @@ aaudio_result_t SharedRingBuffer::allocate(fifo_frames_t   bytesPerFrame,
                                          fifo_frames_t   capacityInFrames) {
     mCapacityInFrames = capacityInFrames;
 
-    // Create shared memory large enough to hold the data and the read and write counters.
+    // Create shared memory large enough to hold the data, the read and write counters
+    // and the latest timestamp.
     mDataMemorySizeInBytes = bytesPerFrame * capacityInFrames;
-    mSharedMemorySizeInBytes = mDataMemorySizeInBytes + (2 * (sizeof(fifo_counter_t)));
+    mSharedMemorySizeInBytes = mDataMemorySizeInBytes + SHARED_RINGBUFFER_DATA_OFFSET;
     mFileDescriptor.reset(ashmem_create_region("AAudioSharedRingBuffer", mSharedMemorySizeInBytes));
     if (mFileDescriptor.get() == -1) {
         ALOGE("SharedRingBuffer::allocate() ashmem_create_region() failed %d", errno);
@@ -74,10 +76,13 @@ aaudio_result_t SharedRingBuffer::allocate(fifo_frames_t   bytesPerFrame,
             (fifo_counter_t *) &mSharedMemory[SHARED_RINGBUFFER_READ_OFFSET];
     fifo_counter_t *writeCounterAddress =
             (fifo_counter_t *) &mSharedMemory[SHARED_RINGBUFFER_WRITE_OFFSET];
+    FifoTimestampSlot *timestampAddress =
+            new (&mSharedMemory[SHARED_RINGBUFFER_TIMESTAMP_OFFSET]) FifoTimestampSlot();
     uint8_t *dataAddress = &mSharedMemory[SHARED_RINGBUFFER_DATA_OFFSET];
 
     mFifoBuffer = new FifoBuffer(bytesPerFrame, capacityInFrames,
-                                 readCounterAddress, writeCounterAddress, dataAddress);
+                                 readCounterAddress, writeCounterAddress, dataAddress,
+                                 timestampAddress);
     return AAUDIO_OK;
 }
 
@@ -90,6 +95,9 @@ void SharedRingBuffer::fillParcelable(AudioEndpointParcelable &endpointParcelabl
                                      SHARED_RINGBUFFER_READ_OFFSET,
                                      SHARED_RINGBUFFER_WRITE_OFFSET,
                                      sizeof(fifo_counter_t));
+    ringBufferParcelable.setupTimestamp(fdIndex,
+                                        SHARED_RINGBUFFER_TIMESTAMP_OFFSET,
+                                        sizeof(FifoTimestampSlot));
     ringBufferParcelable.setBytesPerFrame(mFifoBuffer->getBytesPerFrame());
     ringBufferParcelable.setFramesPerBurst(1);
     ringBufferParcelable.setCapacityInFrames(mCapacityInFrames);
@@ -28,10 +28,12 @@
 
 namespace aaudio {
 
-// Determine the placement of the counters and data in shared memory.
+// Determine the placement of the counters, timestamp and data in shared memory.
 #define SHARED_RINGBUFFER_READ_OFFSET   0
 #define SHARED_RINGBUFFER_WRITE_OFFSET  sizeof(fifo_counter_t)
-#define SHARED_RINGBUFFER_DATA_OFFSET   (SHARED_RINGBUFFER_WRITE_OFFSET + sizeof(fifo_counter_t))
+#define SHARED_RINGBUFFER_TIMESTAMP_OFFSET  (SHARED_RINGBUFFER_WRITE_OFFSET + sizeof(fifo_counter_t))
+#define SHARED_RINGBUFFER_DATA_OFFSET   (SHARED_RINGBUFFER_TIMESTAMP_OFFSET \
+                                         + sizeof(android::FifoTimestampSlot))
 
 /**
  * Atomic FIFO that uses shared memory.
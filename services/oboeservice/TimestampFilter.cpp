@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AAudioService"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include "TimestampFilter.h"
+
+using namespace aaudio;
+
+#define NANOS_PER_SECOND  1.0e9
+
+void TimestampFilter::reset(int32_t sampleRate) {
+    mSampleRate = sampleRate;
+    mTimestampCount = 0;
+    mRejectedCount = 0;
+    mFramesPerSecond = sampleRate;
+    // The drift is unknown but within the limit.
+    const double maxDeviation = sampleRate * kMaxDriftPpm * 1.0e-6;
+    mVarianceRate = maxDeviation * maxDeviation;
+}
+
+bool TimestampFilter::processTimestamp(int64_t position, int64_t nanoseconds) {
+    const double jitterFrames = mSampleRate * kPositionJitterNanos / NANOS_PER_SECOND;
+    const double measurementVariance = jitterFrames * jitterFrames;
+
+    if (mTimestampCount > 0) {
+        if (nanoseconds <= mNanoseconds) {
+            return false; // nothing new
+        }
+
+        // Predict the state at the time of the timestamp.
+        const double deltaSeconds = (nanoseconds - mNanoseconds) / NANOS_PER_SECOND;
+        const double wanderFrames = mSampleRate * kRateWanderPpm * 1.0e-6;
+        const double predictedPosition = mPosition + mFramesPerSecond * deltaSeconds;
+        const double variancePosition = mVariancePosition + 2.0 * deltaSeconds * mCovariance
+                + deltaSeconds * deltaSeconds * mVarianceRate;
+        const double covariance = mCovariance + deltaSeconds * mVarianceRate;
+        const double varianceRate = mVarianceRate + wanderFrames * wanderFrames * deltaSeconds;
+
+        const double innovation = position - predictedPosition;
+        const double errorNanos = innovation * NANOS_PER_SECOND / mFramesPerSecond;
+        if (fabs(errorNanos) <= kMaxErrorNanos) {
+            // Correct the prediction with the timestamp.
+            const double innovationVariance = variancePosition + measurementVariance;
+            const double gainPosition = variancePosition / innovationVariance;
+            const double gainRate = covariance / innovationVariance;
+            mPosition = predictedPosition + gainPosition * innovation;
+            mFramesPerSecond += gainRate * innovation;
+            mVariancePosition = (1.0 - gainPosition) * variancePosition;
+            mCovariance = (1.0 - gainPosition) * covariance;
+            mVarianceRate = varianceRate - gainRate * covariance;
+
+            const double maxDeviation = mSampleRate * kMaxDriftPpm * 1.0e-6;
+            mFramesPerSecond = std::min(std::max(mFramesPerSecond, mSampleRate - maxDeviation),
+                                        mSampleRate + maxDeviation);
+            mNanoseconds = nanoseconds;
+            mTimestampCount++;
+            mRejectedCount = 0;
+            return true;
+        } else if (++mRejectedCount < kMaxRejectedTimestamps) {
+            ALOGV("TimestampFilter: ignore timestamp %d usec from the model",
+                  (int) (errorNanos / 1000));
+            return false;
+        }
+        // A jump of the position does not change the rate of the clock, so keep it.
+        ALOGD("TimestampFilter: position jumped by %d usec, start again",
+              (int) (errorNanos / 1000));
+        mVarianceRate = varianceRate;
+    }
+
+    mPosition = position;
+    mNanoseconds = nanoseconds;
+    mVariancePosition = measurementVariance;
+    mCovariance = 0.0;
+    mTimestampCount = 1;
+    mRejectedCount = 0;
+    return true;
+}
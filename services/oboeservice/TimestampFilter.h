@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_TIMESTAMP_FILTER_H
+#define AAUDIO_TIMESTAMP_FILTER_H
+
+#include <math.h>
+#include <stdint.h>
+
+namespace aaudio {
+
+/**
+ * Model the clock of an MMAP/NOIRQ buffer from the positions reported by the HAL.
+ *
+ * The HAL position only advances in DMA or DSP bursts and it is read at times
+ * that depend on scheduling, so the raw timestamps jitter by up to a burst.
+ * The TimestampScheduler samples the position at uncorrelated times, so that this jitter
+ * can be averaged out.
+ *
+ * A Kalman filter tracks the position and the rate of the device against CLOCK_MONOTONIC.
+ * The rate is allowed to wander slowly, so after a few seconds it measures the drift
+ * of the device clock, which is too small to see between two timestamps.
+ *
+ * Timestamps that are far from the model are ignored, unless several in a row are,
+ * in which case the position jumped and the model starts again.
+ *
+ * Note that this object is not thread safe. Only call it from a single thread.
+ */
+class TimestampFilter
+{
+public:
+    TimestampFilter() {};
+    virtual ~TimestampFilter() = default;
+
+    /**
+     * Forget all timestamps.
+     * @param sampleRate nominal rate of the device
+     */
+    void reset(int32_t sampleRate);
+
+    /**
+     * @param position frame position reported by the HAL
+     * @param nanoseconds CLOCK_MONOTONIC time of that position
+     * @return true if the timestamp was used, false if it was rejected as an outlier
+     */
+    bool processTimestamp(int64_t position, int64_t nanoseconds);
+
+    /**
+     * @return true if there is an estimate
+     */
+    bool isValid() const {
+        return mTimestampCount > 0;
+    }
+
+    /**
+     * @return position estimated at the time of the latest timestamp used
+     */
+    int64_t getPosition() const {
+        return (int64_t) llround(mPosition);
+    }
+
+    /**
+     * @return time of the latest timestamp used
+     */
+    int64_t getNanoseconds() const {
+        return mNanoseconds;
+    }
+
+    /**
+     * @return measured rate in frames per second
+     */
+    double getFramesPerSecond() const {
+        return mFramesPerSecond;
+    }
+
+    /**
+     * @return drift of the device against CLOCK_MONOTONIC in parts per million
+     */
+    double getDriftPpm() const {
+        return (mSampleRate == 0) ? 0.0 : (1.0e6 * (mFramesPerSecond / mSampleRate - 1.0));
+    }
+
+private:
+    // Typical jitter of the HAL position.
+    static constexpr double  kPositionJitterNanos = 500000.0;
+    // How fast the rate of the device may change, in ppm per second.
+    static constexpr double  kRateWanderPpm = 1.0;
+    // Crystals are usually within 100 ppm, anything beyond this is not drift.
+    static constexpr double  kMaxDriftPpm = 1000.0;
+    // Timestamps further from the model are outliers.
+    static constexpr int64_t kMaxErrorNanos = 5000000;
+    // The position jumped if this many timestamps in a row are outliers.
+    static constexpr int32_t kMaxRejectedTimestamps = 3;
+
+    int32_t  mSampleRate = 0;
+    int32_t  mTimestampCount = 0;
+    int32_t  mRejectedCount = 0;
+
+    // State of the filter at mNanoseconds, and its covariance.
+    int64_t  mNanoseconds = 0;
+    double   mPosition = 0.0;
+    double   mFramesPerSecond = 0.0;
+    double   mVariancePosition = 0.0;
+    double   mCovariance = 0.0;
+    double   mVarianceRate = 0.0;
+};
+
+} /* namespace aaudio */
+
+#endif /* AAUDIO_TIMESTAMP_FILTER_H */
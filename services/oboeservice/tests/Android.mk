@@ -0,0 +1,89 @@
+# Build the unit tests for the AAudio service
+
+LOCAL_PATH := $(call my-dir)
+
+#
+# shared endpoint mixer test and benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+    libaaudio \
+    libcutils \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/.. \
+    $(TOP)/frameworks/av/media/libaaudio/include \
+    $(TOP)/frameworks/av/media/libaaudio/src \
+
+LOCAL_SRC_FILES := \
+    ../AAudioMixer.cpp \
+    test_aaudio_mixer.cpp \
+
+LOCAL_MODULE := test_aaudio_mixer
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_TEST)
+
+#
+# filter of the MMAP HAL timestamps
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/.. \
+    $(TOP)/frameworks/av/media/libaaudio/include \
+    $(TOP)/frameworks/av/media/libaaudio/src \
+
+LOCAL_SRC_FILES := \
+    ../TimestampFilter.cpp \
+    ../TimestampScheduler.cpp \
+    test_timestamp_filter.cpp \
+
+LOCAL_MODULE := test_timestamp_filter
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_TEST)
+
+#
+# rate and channel conversion of shared streams
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+    libaaudio \
+    libaudioprocessing \
+    libcutils \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/.. \
+    $(call include-path-for, audio-utils) \
+    $(TOP)/frameworks/av/media/libaaudio/include \
+    $(TOP)/frameworks/av/media/libaaudio/src \
+
+LOCAL_SRC_FILES := \
+    ../AAudioStreamConverter.cpp \
+    test_aaudio_stream_converter.cpp \
+
+LOCAL_MODULE := test_aaudio_stream_converter
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test and benchmark the mixer of the shared MMAP output endpoint.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AAudioMixer.h"
+
+using android::FifoBuffer;
+
+#define SAMPLE_RATE        48000
+#define CHANNEL_COUNT      2
+#define FRAMES_PER_BURST   96
+#define SAMPLES_PER_BURST  (FRAMES_PER_BURST * CHANNEL_COUNT)
+#define FIFO_CAPACITY      (FRAMES_PER_BURST * 4 + 17) // so the bursts wrap around
+
+static int64_t getNanoseconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// A client stream writing bursts of random samples into its shared FIFO.
+class SyntheticStream {
+public:
+    explicit SyntheticStream(unsigned seed)
+            : mFifo(CHANNEL_COUNT * sizeof(float), FIFO_CAPACITY)
+            , mBurst(SAMPLES_PER_BURST)
+            , mSeed(seed) {
+    }
+
+    const std::vector<float> &writeBurst(int32_t numFrames = FRAMES_PER_BURST) {
+        for (float &sample : mBurst) {
+            sample = (float) rand_r(&mSeed) / RAND_MAX * 2.0f - 1.0f;
+        }
+        mFifo.write(mBurst.data(), numFrames);
+        return mBurst;
+    }
+
+    FifoBuffer *getFifo() { return &mFifo; }
+
+private:
+    FifoBuffer         mFifo;
+    std::vector<float> mBurst;
+    unsigned           mSeed;
+};
+
+// The mix of the first track replaces the output, and the missing frames are silent.
+TEST(test_aaudio_mixer, mix_tracks) {
+    const float volumes[] = {1.0f, 0.5f, 0.25f};
+    const int numTracks = sizeof(volumes) / sizeof(volumes[0]);
+    std::vector<SyntheticStream *> streams;
+    for (int i = 0; i < numTracks; i++) {
+        streams.push_back(new SyntheticStream(i + 1));
+    }
+
+    AAudioMixer mixer;
+    mixer.allocate(CHANNEL_COUNT, FRAMES_PER_BURST);
+    for (int burst = 0; burst < 20; burst++) {
+        std::vector<float> expected(SAMPLES_PER_BURST, 0.0f);
+        mixer.clear();
+        for (int i = 0; i < numTracks; i++) {
+            // The first track underflows every few bursts.
+            int32_t numFrames = (i == 0 && burst % 3 == 0) ? FRAMES_PER_BURST / 2 - 1
+                                                           : FRAMES_PER_BURST;
+            const std::vector<float> &samples = streams[i]->writeBurst(numFrames);
+            for (int32_t j = 0; j < numFrames * CHANNEL_COUNT; j++) {
+                expected[j] += samples[j] * volumes[i];
+            }
+            bool underflowed = mixer.mix(i, streams[i]->getFifo(), volumes[i]);
+            EXPECT_EQ(numFrames < FRAMES_PER_BURST, underflowed);
+            // The mixer advanced by a whole burst so the client skips the missing frames.
+            streams[i]->getFifo()->getFifoControllerBase()->advanceWriteIndex(
+                    FRAMES_PER_BURST - numFrames);
+        }
+        const float *output = mixer.getOutputBuffer();
+        for (int32_t j = 0; j < SAMPLES_PER_BURST; j++) {
+            ASSERT_FLOAT_EQ(expected[j], output[j]);
+        }
+    }
+
+    for (SyntheticStream *stream : streams) {
+        delete stream;
+    }
+}
+
+TEST(test_aaudio_mixer, silence_without_tracks) {
+    SyntheticStream stream(1);
+    AAudioMixer mixer;
+    mixer.allocate(CHANNEL_COUNT, FRAMES_PER_BURST);
+    mixer.clear();
+    stream.writeBurst();
+    mixer.mix(0, stream.getFifo(), 1.0f);
+
+    mixer.clear();
+    const float *output = mixer.getOutputBuffer();
+    for (int32_t j = 0; j < SAMPLES_PER_BURST; j++) {
+        ASSERT_EQ(0.0f, output[j]);
+    }
+}
+
+// The sample by sample loop that the mixer used before, after clearing the output.
+static void mixReference(float *output, FifoBuffer *fifo, float volume) {
+    android::WrappingBuffer wrappingBuffer;
+    fifo->getFullDataAvailable(&wrappingBuffer);
+    int32_t framesLeft = FRAMES_PER_BURST;
+    for (int part = 0; part < android::WrappingBuffer::SIZE && framesLeft > 0; part++) {
+        int32_t numFrames = std::min(framesLeft, wrappingBuffer.numFrames[part]);
+        const float *source = (const float *) wrappingBuffer.data[part];
+        for (int32_t i = 0; i < numFrames * CHANNEL_COUNT; i++) {
+            *output++ += *source++ * volume;
+        }
+        framesLeft -= numFrames;
+    }
+    fifo->getFifoControllerBase()->advanceReadIndex(FRAMES_PER_BURST);
+}
+
+// Mix N streams per burst, as AAudioServiceEndpointPlay::callbackLoop() does,
+// and report the time spent mixing per burst compared to the burst duration.
+TEST(test_aaudio_mixer, benchmark_streams) {
+    const int32_t kNumBursts = 20000;
+    const double burstMicros = 1e6 * FRAMES_PER_BURST / SAMPLE_RATE;
+    AAudioMixer mixer;
+    mixer.allocate(CHANNEL_COUNT, FRAMES_PER_BURST);
+    std::vector<float> referenceOutput(SAMPLES_PER_BURST);
+
+    for (int numStreams : {1, 2, 4, 8, 16, 32}) {
+        std::vector<SyntheticStream *> streams;
+        for (int i = 0; i < numStreams; i++) {
+            streams.push_back(new SyntheticStream(i + 1));
+        }
+
+        int64_t mixerNanos = 0;
+        int64_t referenceNanos = 0;
+        float sum = 0.0f;
+        for (int32_t burst = 0; burst < kNumBursts; burst++) {
+            // The clients write outside of the measurement, twice so both mixers have data.
+            for (SyntheticStream *stream : streams) {
+                stream->writeBurst();
+                stream->writeBurst();
+            }
+
+            int64_t start = getNanoseconds();
+            mixer.clear();
+            for (int i = 0; i < numStreams; i++) {
+                mixer.mix(i, streams[i]->getFifo(), 1.0f);
+            }
+            sum += mixer.getOutputBuffer()[burst % SAMPLES_PER_BURST];
+            mixerNanos += getNanoseconds() - start;
+
+            start = getNanoseconds();
+            memset(referenceOutput.data(), 0, referenceOutput.size() * sizeof(float));
+            for (int i = 0; i < numStreams; i++) {
+                mixReference(referenceOutput.data(), streams[i]->getFifo(), 1.0f);
+            }
+            sum += referenceOutput[burst % SAMPLES_PER_BURST];
+            referenceNanos += getNanoseconds() - start;
+        }
+
+        double mixerMicros = mixerNanos * 1e-3 / kNumBursts;
+        double referenceMicros = referenceNanos * 1e-3 / kNumBursts;
+        printf("%2d streams: mix %6.2f usec per burst (%5.2f%% of %.0f usec),"
+               " scalar %6.2f usec, sum %f\n",
+               numStreams, mixerMicros, 100.0 * mixerMicros / burstMicros, burstMicros,
+               referenceMicros, sum);
+        EXPECT_LT(mixerMicros, burstMicros);
+
+        for (SyntheticStream *stream : streams) {
+            delete stream;
+        }
+    }
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test the rate and channel conversion of shared streams.
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AAudioStreamConverter.h"
+
+using android::FifoBuffer;
+using aaudio::AAudioStreamConverter;
+
+#define ENDPOINT_FRAMES_PER_BURST  96
+#define NUM_BURSTS                 1000      // 2 seconds at 48000 Hz
+#define SINE_HZ                    1000.0
+#define SINE_AMPLITUDE             0.5f
+// Bursts ignored while the resampler fills its history.
+#define SETTLING_BURSTS            4
+
+// Writes a sine wave, the same in every channel but scaled by the channel number plus one
+// over the number of channels.
+class SineSource {
+public:
+    SineSource(int32_t sampleRate, int32_t samplesPerFrame)
+            : mSampleRate(sampleRate)
+            , mSamplesPerFrame(samplesPerFrame) {
+    }
+
+    void generate(float *buffer, int32_t numFrames) {
+        for (int32_t i = 0; i < numFrames; i++) {
+            float sample = SINE_AMPLITUDE
+                    * sinf((float) (2.0 * M_PI * SINE_HZ * mFrames++ / mSampleRate));
+            for (int32_t channel = 0; channel < mSamplesPerFrame; channel++) {
+                *buffer++ = sample * (channel + 1) / mSamplesPerFrame;
+            }
+        }
+    }
+
+private:
+    const int32_t mSampleRate;
+    const int32_t mSamplesPerFrame;
+    int64_t       mFrames = 0;
+};
+
+// Measures the frequency and peak of one channel of a sine wave.
+class SineAnalyzer {
+public:
+    void add(float sample) {
+        if (mCount > 0 && (mPrevious < 0.0f) != (sample < 0.0f)) {
+            mCrossings++;
+        }
+        mPeak = std::max(mPeak, fabsf(sample));
+        mPrevious = sample;
+        mCount++;
+    }
+
+    double getFrequency(int32_t sampleRate) const {
+        return mCrossings * 0.5 * sampleRate / mCount;
+    }
+
+    float getPeak() const { return mPeak; }
+    int64_t getCount() const { return mCount; }
+
+private:
+    int64_t mCount = 0;
+    int64_t mCrossings = 0;
+    float   mPrevious = 0.0f;
+    float   mPeak = 0.0f;
+};
+
+// Amplitude of a channel after conversion of a SineSource:
+// mono is copied to both channels, stereo is averaged to mono.
+static float getAmplitude(int32_t sourceSamplesPerFrame, int32_t samplesPerFrame,
+                          int32_t channel) {
+    if (sourceSamplesPerFrame == samplesPerFrame) {
+        return SINE_AMPLITUDE * (channel + 1) / samplesPerFrame;
+    } else if (sourceSamplesPerFrame == 1) {
+        return SINE_AMPLITUDE;
+    }
+    return SINE_AMPLITUDE * (0.5f + 1.0f) / 2;
+}
+
+// The peak can fall between two samples, by up to a 16th of a period at 16000 Hz.
+static void checkSine(const SineAnalyzer &analyzer, int32_t sampleRate, float amplitude) {
+    EXPECT_NEAR(SINE_HZ, analyzer.getFrequency(sampleRate), 2.0);
+    EXPECT_NEAR(amplitude, analyzer.getPeak(), 0.05f * amplitude);
+}
+
+// Reads NUM_BURSTS bursts of an output endpoint from a client that keeps its FIFO full.
+static void testOutput(int32_t clientSampleRate, int32_t clientSamplesPerFrame,
+                       int32_t endpointSampleRate, int32_t endpointSamplesPerFrame) {
+    AAudioStreamConverter converter;
+    ASSERT_EQ(AAUDIO_OK, converter.open(AAUDIO_DIRECTION_OUTPUT,
+                                        clientSampleRate, clientSamplesPerFrame,
+                                        endpointSampleRate, endpointSamplesPerFrame,
+                                        ENDPOINT_FRAMES_PER_BURST));
+    const int32_t clientFramesPerBurst = converter.getClientFramesPerBurst();
+    FifoBuffer fifo(clientSamplesPerFrame * sizeof(float), 4 * clientFramesPerBurst);
+    SineSource source(clientSampleRate, clientSamplesPerFrame);
+    std::vector<float> clientBurst(clientFramesPerBurst * clientSamplesPerFrame);
+    std::vector<SineAnalyzer> analyzers(endpointSamplesPerFrame);
+    int64_t framesReadAtHalf = 0;
+
+    for (int burst = 0; burst < NUM_BURSTS; burst++) {
+        // Keep the FIFO full, so that the resampler never lacks data.
+        int32_t room;
+        while ((room = fifo.getFifoControllerBase()->getEmptyFramesAvailable()) > 0) {
+            int32_t numFrames = std::min(room, clientFramesPerBurst);
+            source.generate(clientBurst.data(), numFrames);
+            ASSERT_EQ(numFrames, fifo.write(clientBurst.data(), numFrames));
+        }
+
+        if (burst == NUM_BURSTS / 2) {
+            framesReadAtHalf = fifo.getReadCounter();
+        }
+        ASSERT_FALSE(converter.readFromClient(&fifo)) << "burst " << burst;
+        if (burst < SETTLING_BURSTS) {
+            continue;
+        }
+        const float *endpointBurst = converter.getBuffer();
+        for (int32_t i = 0; i < ENDPOINT_FRAMES_PER_BURST; i++) {
+            for (int32_t channel = 0; channel < endpointSamplesPerFrame; channel++) {
+                analyzers[channel].add(*endpointBurst++);
+            }
+        }
+    }
+
+    // Once the resampler has filled its history, the client frames are consumed at the client
+    // rate; the resampler releases them by whole buffers, hence the tolerance.
+    const double expectedFrames = (double) (NUM_BURSTS - NUM_BURSTS / 2)
+            * ENDPOINT_FRAMES_PER_BURST * clientSampleRate / endpointSampleRate;
+    EXPECT_NEAR(expectedFrames, (double) (fifo.getReadCounter() - framesReadAtHalf),
+                clientFramesPerBurst);
+
+    for (int32_t channel = 0; channel < endpointSamplesPerFrame; channel++) {
+        checkSine(analyzers[channel], endpointSampleRate,
+                  getAmplitude(clientSamplesPerFrame, endpointSamplesPerFrame, channel));
+    }
+}
+
+// Writes NUM_BURSTS bursts of an input endpoint to a client that keeps its FIFO empty.
+static void testInput(int32_t clientSampleRate, int32_t clientSamplesPerFrame,
+                      int32_t endpointSampleRate, int32_t endpointSamplesPerFrame) {
+    AAudioStreamConverter converter;
+    ASSERT_EQ(AAUDIO_OK, converter.open(AAUDIO_DIRECTION_INPUT,
+                                        clientSampleRate, clientSamplesPerFrame,
+                                        endpointSampleRate, endpointSamplesPerFrame,
+                                        ENDPOINT_FRAMES_PER_BURST));
+    const int32_t clientFramesPerBurst = converter.getClientFramesPerBurst();
+    FifoBuffer fifo(clientSamplesPerFrame * sizeof(float), 4 * clientFramesPerBurst);
+    SineSource source(endpointSampleRate, endpointSamplesPerFrame);
+    std::vector<float> endpointBurst(ENDPOINT_FRAMES_PER_BURST * endpointSamplesPerFrame);
+    std::vector<float> clientBurst(clientFramesPerBurst * clientSamplesPerFrame);
+    std::vector<SineAnalyzer> analyzers(clientSamplesPerFrame);
+
+    for (int burst = 0; burst < NUM_BURSTS; burst++) {
+        source.generate(endpointBurst.data(), ENDPOINT_FRAMES_PER_BURST);
+        ASSERT_TRUE(converter.writeToClient(&fifo, endpointBurst.data())) << "burst " << burst;
+
+        int32_t numFrames = fifo.read(clientBurst.data(), clientFramesPerBurst);
+        ASSERT_LE(numFrames, clientFramesPerBurst);
+        if (burst < SETTLING_BURSTS) {
+            continue;
+        }
+        const float *sample = clientBurst.data();
+        for (int32_t i = 0; i < numFrames; i++) {
+            for (int32_t channel = 0; channel < clientSamplesPerFrame; channel++) {
+                analyzers[channel].add(*sample++);
+            }
+        }
+    }
+
+    // The client gets the number of frames due at its rate, one frame behind.
+    const double expectedFrames = (double) ((int64_t) NUM_BURSTS * ENDPOINT_FRAMES_PER_BURST
+            * clientSampleRate / endpointSampleRate - 1);
+    EXPECT_NEAR(expectedFrames, (double) fifo.getWriteCounter(), 2.0);
+
+    for (int32_t channel = 0; channel < clientSamplesPerFrame; channel++) {
+        checkSine(analyzers[channel], clientSampleRate,
+                  getAmplitude(endpointSamplesPerFrame, clientSamplesPerFrame, channel));
+    }
+}
+
+TEST(test_aaudio_stream_converter, output_rate) {
+    testOutput(44100, 2, 48000, 2);
+}
+
+TEST(test_aaudio_stream_converter, output_rate_and_mono_to_stereo) {
+    testOutput(16000, 1, 48000, 2);
+}
+
+TEST(test_aaudio_stream_converter, output_stereo_to_mono) {
+    testOutput(48000, 2, 48000, 1);
+}
+
+TEST(test_aaudio_stream_converter, input_rate) {
+    testInput(44100, 2, 48000, 2);
+}
+
+TEST(test_aaudio_stream_converter, input_rate_and_stereo_to_mono) {
+    testInput(16000, 1, 48000, 2);
+}
+
+TEST(test_aaudio_stream_converter, input_mono_to_stereo) {
+    testInput(48000, 2, 48000, 1);
+}
+
+// An empty client FIFO is replaced by silence, which is still consumed.
+TEST(test_aaudio_stream_converter, output_underflow) {
+    AAudioStreamConverter converter;
+    ASSERT_EQ(AAUDIO_OK, converter.open(AAUDIO_DIRECTION_OUTPUT, 44100, 2, 48000, 2,
+                                        ENDPOINT_FRAMES_PER_BURST));
+    FifoBuffer fifo(2 * sizeof(float), 4 * converter.getClientFramesPerBurst());
+
+    EXPECT_TRUE(converter.readFromClient(&fifo));
+    const float *endpointBurst = converter.getBuffer();
+    for (int32_t i = 0; i < ENDPOINT_FRAMES_PER_BURST * 2; i++) {
+        ASSERT_EQ(0.0f, endpointBurst[i]);
+    }
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replay traces of MMAP HAL timestamps through the filter of the service.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TimestampFilter.h"
+#include "TimestampScheduler.h"
+
+using namespace aaudio;
+
+#define SAMPLE_RATE        48000
+#define FRAMES_PER_BURST   96
+#define DRIFT_PPM          80.0
+#define TRACE_SECONDS      30
+
+// A timestamp as returned by getMmapPosition(), and where the device really was at that time.
+struct HalTimestamp {
+    int64_t position;
+    int64_t nanoseconds;
+    double  truePosition;
+};
+
+enum HalBehavior {
+    // The position only advances once per DMA burst, but the time is when it was read.
+    HAL_QUANTIZED,
+    // The position is exact, but the time is taken later when the thread was preempted.
+    HAL_LATE_TIME,
+};
+
+// Generate the timestamps that a HAL with this behavior gives at the times
+// chosen by the TimestampScheduler, for a device clock that drifts.
+static std::vector<HalTimestamp> captureTrace(HalBehavior behavior, unsigned seed) {
+    std::vector<HalTimestamp> trace;
+    const double framesPerNano = SAMPLE_RATE * (1.0 + DRIFT_PPM * 1.0e-6) / 1.0e9;
+    const int64_t startNanos = 1000000000LL;
+    TimestampScheduler scheduler;
+    scheduler.setBurstPeriod(FRAMES_PER_BURST, SAMPLE_RATE);
+    scheduler.start(startNanos);
+    srandom(seed);
+    int64_t nanoseconds = scheduler.nextAbsoluteTime();
+    while (nanoseconds < startNanos + TRACE_SECONDS * 1000000000LL) {
+        double position = (nanoseconds - startNanos) * framesPerNano;
+        HalTimestamp timestamp;
+        switch (behavior) {
+            case HAL_QUANTIZED:
+                timestamp.position = (int64_t) (floor(position / FRAMES_PER_BURST)
+                                                * FRAMES_PER_BURST);
+                timestamp.nanoseconds = nanoseconds;
+                timestamp.truePosition = position;
+                break;
+            case HAL_LATE_TIME: {
+                int64_t lateNanos = random() % 400000;
+                if (random() % 20 == 0) {
+                    lateNanos += 1000000 + random() % 2000000;
+                }
+                timestamp.position = (int64_t) position;
+                timestamp.nanoseconds = nanoseconds + lateNanos;
+                timestamp.truePosition = (timestamp.nanoseconds - startNanos) * framesPerNano;
+            }
+                break;
+        }
+        trace.push_back(timestamp);
+        nanoseconds = scheduler.nextAbsoluteTime();
+    }
+    return trace;
+}
+
+struct ReplayResult {
+    double rawErrorFrames;       // standard deviation of the raw positions
+    double filteredErrorFrames;  // standard deviation of the filtered positions
+    double driftPpm;             // measured at the end
+    int32_t rejected;
+};
+
+static double standardDeviation(const std::vector<double> &errors) {
+    double sum = 0.0;
+    for (double error : errors) {
+        sum += error;
+    }
+    double mean = sum / errors.size();
+    double sumSquares = 0.0;
+    for (double error : errors) {
+        sumSquares += (error - mean) * (error - mean);
+    }
+    return sqrt(sumSquares / errors.size());
+}
+
+// Feed the trace to the filter and compare both the raw and the filtered positions
+// with where the device really was, once the filter had some time to settle.
+static ReplayResult replay(const std::vector<HalTimestamp> &trace) {
+    const size_t kSettleTimestamps = 20;
+    TimestampFilter filter;
+    filter.reset(SAMPLE_RATE);
+    std::vector<double> rawErrors;
+    std::vector<double> filteredErrors;
+    ReplayResult result = {};
+    for (size_t i = 0; i < trace.size(); i++) {
+        const HalTimestamp &timestamp = trace[i];
+        if (!filter.processTimestamp(timestamp.position, timestamp.nanoseconds)) {
+            result.rejected++;
+            continue;
+        }
+        if (i >= kSettleTimestamps) {
+            EXPECT_EQ(timestamp.nanoseconds, filter.getNanoseconds());
+            rawErrors.push_back(timestamp.position - timestamp.truePosition);
+            filteredErrors.push_back(filter.getPosition() - timestamp.truePosition);
+        }
+    }
+    result.rawErrorFrames = standardDeviation(rawErrors);
+    result.filteredErrorFrames = standardDeviation(filteredErrors);
+    result.driftPpm = filter.getDriftPpm();
+    printf("raw jitter %5.1f frames, filtered %5.1f frames, drift %6.1f ppm, %d rejected\n",
+           result.rawErrorFrames, result.filteredErrorFrames, result.driftPpm, result.rejected);
+    return result;
+}
+
+TEST(test_timestamp_filter, quantized_positions) {
+    ReplayResult result = replay(captureTrace(HAL_QUANTIZED, 1));
+    EXPECT_LT(result.filteredErrorFrames, result.rawErrorFrames / 2);
+    EXPECT_NEAR(DRIFT_PPM, result.driftPpm, 20.0);
+    EXPECT_EQ(0, result.rejected);
+}
+
+TEST(test_timestamp_filter, late_times) {
+    ReplayResult result = replay(captureTrace(HAL_LATE_TIME, 2));
+    EXPECT_LT(result.filteredErrorFrames, result.rawErrorFrames / 2);
+    EXPECT_NEAR(DRIFT_PPM, result.driftPpm, 20.0);
+}
+
+// A single bad timestamp is ignored but a jump of the position is followed.
+TEST(test_timestamp_filter, outliers_and_jumps) {
+    std::vector<HalTimestamp> trace = captureTrace(HAL_QUANTIZED, 3);
+    TimestampFilter filter;
+    filter.reset(SAMPLE_RATE);
+    const size_t kGlitch = 200;
+    const size_t kJump = 300;
+    const int64_t kJumpFrames = SAMPLE_RATE / 10;
+    ASSERT_LT(kJump + 10, trace.size());
+    for (size_t i = 0; i < trace.size(); i++) {
+        int64_t position = trace[i].position;
+        if (i == kGlitch) {
+            position += SAMPLE_RATE / 50;
+        } else if (i >= kJump) {
+            position += kJumpFrames;
+        }
+        bool accepted = filter.processTimestamp(position, trace[i].nanoseconds);
+        if (i == kGlitch || i == kJump || i == kJump + 1) {
+            EXPECT_FALSE(accepted) << "timestamp " << i;
+        } else {
+            EXPECT_TRUE(accepted) << "timestamp " << i;
+        }
+        if (i == kJump + 2) {
+            EXPECT_EQ(position, filter.getPosition());
+        }
+    }
+    EXPECT_NEAR(DRIFT_PPM, filter.getDriftPpm(), 20.0);
+}
+
+TEST(test_timestamp_filter, no_timestamps) {
+    TimestampFilter filter;
+    filter.reset(SAMPLE_RATE);
+    EXPECT_FALSE(filter.isValid());
+    EXPECT_EQ(0.0, filter.getDriftPpm());
+    EXPECT_TRUE(filter.processTimestamp(1000, 2000));
+    EXPECT_TRUE(filter.isValid());
+    EXPECT_EQ(1000, filter.getPosition());
+    EXPECT_FALSE(filter.processTimestamp(1000, 2000));
+}
@@ -0,0 +1,20 @@
+# Copyright 2017 The Android Open Source Project
+#
+# Android.mk for nblog_analyzer
+#
+
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	nblog_analyzer.cpp
+
+LOCAL_C_INCLUDES := \
+	frameworks/av/media/libnbaio/include
+
+LOCAL_MODULE := nblog_analyzer
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,510 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Offline analyzer of NBLog binary exports (see NBLogExport.h), as written by
+// "dumpsys media.log -b" or continuously to the file named by property media.log.export_file.
+//
+// For each thread (author) and log site (hash) of histogram timestamps, typically one per
+// FastMixer, MixerThread or RecordThread cycle, it reconstructs the timeline of cycle periods,
+// prints period statistics and a jitter histogram, finds glitches (periods much longer than
+// the median), and correlates glitches across threads.
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <media/nbaio/NBLogExport.h>
+
+using namespace android;
+using namespace android::NBLogExport;
+
+// A cycle timestamp of one series; a break marks an audio state change before the timestamp
+struct Sample {
+    int64_t ts;
+    bool afterBreak;
+};
+
+// Timestamps logged by one author from one log site
+struct Series {
+    int author;
+    uint64_t hash;
+    std::vector<Sample> samples;
+    bool pendingBreak = false;
+    // results of analyze()
+    std::vector<double> periodsMs;
+    double medianMs = 0;
+    std::vector<int64_t> glitches;      // timestamps at the end of glitch periods
+};
+
+struct FormatLine {
+    int64_t ts;
+    int author;
+    std::string text;
+};
+
+struct Options {
+    double binWidthMs = 0.5;            // jitter histogram bin width
+    double glitchRatio = 1.5;           // period / median above which a period is a glitch
+    double windowMs = -1;               // correlation window, default is twice the median
+    bool timeline = false;              // print format entries
+};
+
+class Analyzer {
+public:
+    explicit Analyzer(const Options &options) : mOptions(options) { }
+
+    bool load(const char *path);
+    void report();
+
+private:
+    void parseAuthors(const uint8_t *p, size_t size);
+    void parseEntries(const uint8_t *p, size_t size);
+    const uint8_t *parseFormat(const uint8_t *p, const uint8_t *end, int author);
+    void analyze(Series *series);
+    std::string seriesName(const Series &series) const;
+    std::string authorName(int author) const;
+
+    const Options mOptions;
+    int64_t mStartNs = 0;
+    std::map<int, std::string> mAuthors;
+    std::map<std::pair<int, uint64_t>, Series> mSeries;
+    std::map<int, uint64_t> mLostBytes;
+    std::map<int, int64_t> mStateChanges;
+    std::vector<FormatLine> mLines;
+    size_t mBadEntries = 0;
+};
+
+template <typename T>
+static T readAt(const uint8_t *p)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));   // entries are not aligned
+    return value;
+}
+
+bool Analyzer::load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(f);
+
+    if (data.size() < sizeof(FileHeader)) {
+        fprintf(stderr, "%s: too short\n", path);
+        return false;
+    }
+    const FileHeader header = readAt<FileHeader>(data.data());
+    if (header.mMagic != kMagic || header.mVersion > kVersion) {
+        fprintf(stderr, "%s: not an NBLog export, or unsupported version\n", path);
+        return false;
+    }
+    mStartNs = header.mStartNs;
+
+    // Continuous exports may contain several file headers if the service restarted;
+    // a truncated last record is ignored.
+    size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= data.size()) {
+        if (readAt<uint32_t>(&data[offset]) == kMagic) {
+            offset += sizeof(FileHeader);
+            continue;
+        }
+        const RecordHeader record = readAt<RecordHeader>(&data[offset]);
+        offset += sizeof(RecordHeader);
+        if (record.mLength > data.size() - offset) {
+            fprintf(stderr, "%s: truncated record at offset %zu\n", path, offset);
+            break;
+        }
+        switch (record.mType) {
+        case RECORD_AUTHORS:
+            parseAuthors(&data[offset], record.mLength);
+            break;
+        case RECORD_ENTRIES:
+            parseEntries(&data[offset], record.mLength);
+            break;
+        default:
+            break;
+        }
+        offset += record.mLength;
+    }
+    return true;
+}
+
+void Analyzer::parseAuthors(const uint8_t *p, size_t size)
+{
+    const uint8_t *end = p + size;
+    while (p + sizeof(int32_t) + 1 <= end) {
+        const int32_t author = readAt<int32_t>(p);
+        const uint8_t length = p[sizeof(int32_t)];
+        p += sizeof(int32_t) + 1;
+        if (p + length > end) {
+            break;
+        }
+        mAuthors[author] = std::string((const char *) p, length);
+        p += length;
+    }
+}
+
+void Analyzer::parseEntries(const uint8_t *p, size_t size)
+{
+    if (size < sizeof(EntriesHeader)) {
+        return;
+    }
+    const EntriesHeader header = readAt<EntriesHeader>(p);
+    mLostBytes[header.mAuthor] += header.mLost;
+    const uint8_t *end = p + size;
+    p += sizeof(EntriesHeader);
+
+    while (p + kEntryOverhead <= end) {
+        const uint8_t type = p[0];
+        const uint8_t length = p[1];
+        if (p + length + kEntryOverhead > end || p[length + 2] != length) {
+            ++mBadEntries;
+            break;
+        }
+        const uint8_t *data = p + 2;
+        switch (type) {
+        case EVENT_START_FMT:
+            p = parseFormat(p, end, header.mAuthor);
+            continue;
+        case EVENT_HISTOGRAM_ENTRY_TS:
+        case EVENT_AUDIO_STATE: {
+            if (length < sizeof(uint64_t) + sizeof(int64_t)) {
+                ++mBadEntries;
+                break;
+            }
+            const uint64_t hash = readAt<uint64_t>(data);
+            const int64_t ts = readAt<int64_t>(data + sizeof(uint64_t));
+            int author = header.mAuthor;
+            if (length >= sizeof(uint64_t) + sizeof(int64_t) + sizeof(int32_t)) {
+                author = readAt<int32_t>(data + sizeof(uint64_t) + sizeof(int64_t));
+            }
+            if (type == EVENT_AUDIO_STATE) {
+                // the next period of every series of this author spans the state change
+                for (auto &it : mSeries) {
+                    if (it.second.author == author) {
+                        it.second.pendingBreak = true;
+                    }
+                }
+                mStateChanges[author]++;
+                break;
+            }
+            Series &series = mSeries[std::make_pair(author, hash)];
+            series.author = author;
+            series.hash = hash;
+            series.samples.push_back(Sample{ts, series.pendingBreak});
+            series.pendingBreak = false;
+            break;
+        }
+        default:
+            ++mBadEntries;
+            break;
+        }
+        p += length + kEntryOverhead;
+    }
+}
+
+// Parses a format entry from START_FMT to END_FMT, and returns a pointer past its end
+const uint8_t *Analyzer::parseFormat(const uint8_t *p, const uint8_t *end, int author)
+{
+    const std::string fmt((const char *) p + 2, p[1]);
+    p += p[1] + kEntryOverhead;
+
+    int64_t ts = 0;
+    std::vector<std::pair<uint8_t, std::string>> args;
+    while (p + kEntryOverhead <= end) {
+        const uint8_t type = p[0];
+        const uint8_t length = p[1];
+        if (p + length + kEntryOverhead > end) {
+            ++mBadEntries;
+            return end;
+        }
+        const uint8_t *data = p + 2;
+        p += length + kEntryOverhead;
+        char text[64];
+        switch (type) {
+        case EVENT_TIMESTAMP:
+            if (ts == 0) {
+                ts = readAt<int64_t>(data);
+                continue;
+            }
+            snprintf(text, sizeof(text), "%.3f", readAt<int64_t>(data) * 1e-9);
+            args.emplace_back(type, text);
+            continue;
+        case EVENT_HASH:
+            continue;
+        case EVENT_AUTHOR:
+            author = readAt<int32_t>(data);
+            continue;
+        case EVENT_INTEGER:
+            snprintf(text, sizeof(text), "%d", readAt<int32_t>(data));
+            args.emplace_back(type, text);
+            continue;
+        case EVENT_FLOAT:
+            snprintf(text, sizeof(text), "%f", readAt<float>(data));
+            args.emplace_back(type, text);
+            continue;
+        case EVENT_PID:
+            snprintf(text, sizeof(text), "%d %.*s", readAt<int32_t>(data),
+                    (int) (length - sizeof(int32_t)), (const char *) data + sizeof(int32_t));
+            args.emplace_back(type, text);
+            continue;
+        case EVENT_STRING:
+            args.emplace_back(type, std::string((const char *) data, length));
+            continue;
+        case EVENT_END_FMT:
+            break;
+        default:
+            ++mBadEntries;
+            break;
+        }
+        break;
+    }
+
+    if (mOptions.timeline) {
+        // substitute arguments in order, each conversion consumes one argument
+        std::string text;
+        size_t arg = 0;
+        for (size_t i = 0; i < fmt.size(); ++i) {
+            if (fmt[i] != '%' || i + 1 >= fmt.size()) {
+                text += fmt[i];
+                continue;
+            }
+            ++i;
+            while (i < fmt.size() && strchr("0123456789.-+ lhz", fmt[i]) != NULL) {
+                ++i;
+            }
+            if (i < fmt.size() && fmt[i] == '%') {
+                text += '%';
+            } else if (arg < args.size()) {
+                text += args[arg++].second;
+            }
+        }
+        mLines.push_back(FormatLine{ts, author, text});
+    }
+    return p;
+}
+
+std::string Analyzer::authorName(int author) const
+{
+    auto it = mAuthors.find(author);
+    if (it != mAuthors.end()) {
+        return it->second;
+    }
+    char name[16];
+    snprintf(name, sizeof(name), "author %d", author);
+    return name;
+}
+
+std::string Analyzer::seriesName(const Series &series) const
+{
+    char hash[24];
+    snprintf(hash, sizeof(hash), "/%016" PRIx64, series.hash);
+    return authorName(series.author) + hash;
+}
+
+void Analyzer::analyze(Series *series)
+{
+    std::sort(series->samples.begin(), series->samples.end(),
+            [](const Sample &a, const Sample &b) { return a.ts < b.ts; });
+    std::vector<int64_t> ends;
+    for (size_t i = 1; i < series->samples.size(); ++i) {
+        // periods across an audio state change are not cycle periods
+        if (series->samples[i].afterBreak) {
+            continue;
+        }
+        series->periodsMs.push_back(
+                (series->samples[i].ts - series->samples[i - 1].ts) * 1e-6);
+        ends.push_back(series->samples[i].ts);
+    }
+    if (series->periodsMs.empty()) {
+        return;
+    }
+    std::vector<double> sorted(series->periodsMs);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    series->medianMs = sorted[sorted.size() / 2];
+    for (size_t i = 0; i < series->periodsMs.size(); ++i) {
+        if (series->periodsMs[i] > series->medianMs * mOptions.glitchRatio) {
+            series->glitches.push_back(ends[i]);
+        }
+    }
+}
+
+void Analyzer::report()
+{
+    printf("Export started at %.3f s, %zu threads, %zu series\n",
+            mStartNs * 1e-9, mAuthors.size(), mSeries.size());
+    for (const auto &it : mLostBytes) {
+        if (it.second > 0) {
+            printf("  %s: lost %" PRIu64 " bytes of log\n",
+                    authorName(it.first).c_str(), it.second);
+        }
+    }
+    if (mBadEntries > 0) {
+        printf("  %zu malformed entries skipped\n", mBadEntries);
+    }
+
+    std::vector<Series *> series;
+    for (auto &it : mSeries) {
+        analyze(&it.second);
+        if (!it.second.periodsMs.empty()) {
+            series.push_back(&it.second);
+        }
+    }
+
+    // per series timeline statistics and jitter histogram
+    for (const Series *s : series) {
+        const std::vector<double> &periods = s->periodsMs;
+        double sum = 0, sum2 = 0;
+        double minMs = periods[0], maxMs = periods[0];
+        for (double period : periods) {
+            sum += period;
+            sum2 += period * period;
+            minMs = std::min(minMs, period);
+            maxMs = std::max(maxMs, period);
+        }
+        const double mean = sum / periods.size();
+        const double stddev = sqrt(std::max(0.0, sum2 / periods.size() - mean * mean));
+        printf("\n%s: %zu periods from %.3f s to %.3f s, %" PRId64 " state changes\n",
+                seriesName(*s).c_str(), periods.size(), s->samples.front().ts * 1e-9,
+                s->samples.back().ts * 1e-9, mStateChanges[s->author]);
+        printf("  period ms: median %.3f mean %.3f stddev %.3f min %.3f max %.3f\n",
+                s->medianMs, mean, stddev, minMs, maxMs);
+        printf("  glitches (> %.2f x median): %zu\n", mOptions.glitchRatio, s->glitches.size());
+
+        // jitter histogram of period - median
+        std::map<long, size_t> bins;
+        for (double period : periods) {
+            bins[lround(floor((period - s->medianMs) / mOptions.binWidthMs))]++;
+        }
+        size_t peak = 0;
+        for (const auto &bin : bins) {
+            peak = std::max(peak, bin.second);
+        }
+        printf("  jitter histogram (ms from median):\n");
+        for (const auto &bin : bins) {
+            const int width = (int) ((bin.second * 50 + peak - 1) / peak);
+            printf("  %+8.2f %8zu %.*s\n", bin.first * mOptions.binWidthMs, bin.second,
+                    width, "**************************************************");
+        }
+    }
+
+    // glitch correlation: fraction of glitches of A with a glitch of B within the window
+    printf("\nGlitch correlation (%% of row glitches with a column glitch nearby):\n");
+    for (size_t i = 0; i < series.size(); ++i) {
+        printf("  [%zu] %s\n", i, seriesName(*series[i]).c_str());
+    }
+    printf("      ");
+    for (size_t j = 0; j < series.size(); ++j) {
+        printf(" [%2zu]", j);
+    }
+    printf("\n");
+    for (size_t i = 0; i < series.size(); ++i) {
+        const Series *a = series[i];
+        const double windowMs = mOptions.windowMs >= 0 ? mOptions.windowMs : 2 * a->medianMs;
+        const int64_t windowNs = (int64_t) (windowMs * 1e6);
+        printf("  [%2zu]", i);
+        for (size_t j = 0; j < series.size(); ++j) {
+            const Series *b = series[j];
+            if (i == j || a->glitches.empty()) {
+                printf("    -");
+                continue;
+            }
+            size_t correlated = 0;
+            for (int64_t ts : a->glitches) {
+                auto it = std::lower_bound(b->glitches.begin(), b->glitches.end(),
+                        ts - windowNs);
+                if (it != b->glitches.end() && *it <= ts + windowNs) {
+                    ++correlated;
+                }
+            }
+            printf(" %4zu", correlated * 100 / a->glitches.size());
+        }
+        printf("\n");
+    }
+
+    if (mOptions.timeline) {
+        std::stable_sort(mLines.begin(), mLines.end(),
+                [](const FormatLine &a, const FormatLine &b) { return a.ts < b.ts; });
+        printf("\nTimeline:\n");
+        for (const FormatLine &line : mLines) {
+            printf("[%.3f] %s: %s\n", line.ts * 1e-9, authorName(line.author).c_str(),
+                    line.text.c_str());
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t] [-w bin_ms] [-g ratio] [-c window_ms] export_file\n"
+            "  -t  print the timeline of formatted log entries\n"
+            "  -w  jitter histogram bin width in ms (default 0.5)\n"
+            "  -g  period / median ratio above which a period is a glitch (default 1.5)\n"
+            "  -c  glitch correlation window in ms (default twice the median period)\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    int ch;
+    while ((ch = getopt(argc, argv, "tw:g:c:")) != -1) {
+        switch (ch) {
+        case 't':
+            options.timeline = true;
+            break;
+        case 'w':
+            options.binWidthMs = atof(optarg);
+            break;
+        case 'g':
+            options.glitchRatio = atof(optarg);
+            break;
+        case 'c':
+            options.windowMs = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || options.binWidthMs <= 0 || options.glitchRatio <= 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Analyzer analyzer(options);
+    if (!analyzer.load(argv[optind])) {
+        return EXIT_FAILURE;
+    }
+    analyzer.report();
+    return EXIT_SUCCESS;
+}